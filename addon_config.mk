@@ -29,6 +29,12 @@ osx:
 	# If your processor supports SIMD AVX instructions.
 	ADDON_CPPFLAGS += -mavx
 
+	# If your processor supports AVX2, the int8 kernels in
+	# ofxDlib::QuantizedNetwork will use them. Processors with AVX2 also
+	# support FMA, which LeNet5::InferenceKernel uses for its multiply-adds.
+	# ADDON_CPPFLAGS += -mavx2
+	# ADDON_CPPFLAGS += -mfma
+
 	# If dlib is compiled with MKL support, you need to add these.
 	# ADDON_INCLUDES += /opt/intel/mkl/include
 	# ADDON_INCLUDES += /opt/intel/include
@@ -46,6 +52,14 @@ linux64:
 	# If your processor supports SIMD AVX instructions.
 	ADDON_CPPFLAGS += -mavx
 
+	# If your processor supports AVX2 (or AVX-512 VNNI), the int8 kernels in
+	# ofxDlib::QuantizedNetwork will use them. Processors with AVX2 also
+	# support FMA, which LeNet5::InferenceKernel uses for its multiply-adds.
+	# The AVX-512 flags imply -mavx512f, which widens the kernel's registers.
+	# ADDON_CPPFLAGS += -mavx2
+	# ADDON_CPPFLAGS += -mfma
+	# ADDON_CPPFLAGS += -mavx512vnni -mavx512vl
+
 	# If dlib is compiled with libblas/liblapack support, you may need to include these.
 	ADDON_PKG_CONFIG_LIBRARIES += blas lapack
 
@@ -16,6 +16,9 @@ void ofApp::setup()
     // Let's make a point cloud that looks like a 3D spiral.
     dlib::rand rnd;
 
+    std::vector<dlib::vector<float>> points;
+    std::vector<dlib::rgb_pixel> colors;
+
     for (float i = -10; i < 10; i += 0.001)
     {
         // Get a point on a spiral.
@@ -33,10 +36,14 @@ void ofApp::setup()
         // Pick a color based on how far we are along the spiral.
         dlib::rgb_pixel color = dlib::colormap_jet(i, 0, 20);
 
-        mesh.addVertex(ofxDlib::toOf(val));
-        mesh.addColor(ofxDlib::toOf(color));
+        points.push_back(val);
+        colors.push_back(color);
     }
 
+    // Copy all points and colors to the mesh at once, rather than calling
+    // mesh.addVertex(ofxDlib::toOf(val)) and mesh.addColor(...) per point.
+    ofxDlib::setPoints(mesh, points, colors);
+
     ofEnableDepthTest();
 }
 
@@ -37,7 +37,6 @@ void ofApp::setup()
     shape_predictor sp;
     deserialize(ofToDataPath("shape_predictor_5_face_landmarks.dat", true)) >> sp;
     // And finally we load the DNN responsible for face recognition.
-    anet_type net;
     deserialize(ofToDataPath("dlib_face_recognition_resnet_model_v1.dat", true)) >> net;
 
     matrix<rgb_pixel> img;
@@ -51,7 +50,6 @@ void ofApp::setup()
     // Run the face detector on the image of our action heroes, and for each face extract a
     // copy that has been normalized to 150x150 pixels in size and appropriately rotated
     // and centered.
-    std::vector<matrix<rgb_pixel>> faces;
     std::vector<dlib::rectangle> faceRects;
     for (auto face : detector(img))
     {
@@ -73,8 +71,24 @@ void ofApp::setup()
         // In this 128D vector space, images from the same person will be close to each other
         // but vectors from different people will be far apart.  So we can use these vectors to
         // identify if a pair of images are from the same person or from different people.
-        std::vector<matrix<float,0,1>> face_descriptors = net(faces);
+        uint64_t start = ofGetElapsedTimeMillis();
+        std::vector<matrix<float,0,1>> reference_descriptors = net(faces);
+        uint64_t netTime = ofGetElapsedTimeMillis() - start;
 
+        // Fold the affine layers into the convolutions for faster inference.
+        // The fused network gives the same descriptors up to rounding.
+        ofxDlib::fuseLayers(net, fnet, faces[0]);
+
+        start = ofGetElapsedTimeMillis();
+        std::vector<matrix<float,0,1>> face_descriptors = fnet(faces);
+        uint64_t fnetTime = ofGetElapsedTimeMillis() - start;
+
+        float maxError = 0;
+        for (size_t i = 0; i < face_descriptors.size(); ++i)
+            maxError = std::max(maxError, length(face_descriptors[i] - reference_descriptors[i]));
+
+        cout << "anet_type: " << netTime << " ms, fnet_type: " << fnetTime << " ms, max descriptor difference: " << maxError << endl;
+        cout << "Press p to profile both networks layer by layer." << endl;
 
         // In particular, one simple thing we can do is face clustering.  This next bit of code
         // creates a graph of connected faces and then uses the Chinese whispers graph clustering
@@ -151,7 +165,7 @@ void ofApp::setup()
         // is used when creating face descriptors.  In particular, to get 99.38% on the LFW
         // benchmark you need to use the jitter_image() routine to compute the descriptors,
         // like so:
-        matrix<float,0,1> face_descriptor = mean(mat(net(jitter_image(faces[0]))));
+        matrix<float,0,1> face_descriptor = mean(mat(fnet(jitter_image(faces[0]))));
         cout << "jittered face descriptor for one face: " << trans(face_descriptor) << endl;
         // If you use the model without jittering, as we did when clustering the bald guys, it
         // gets an accuracy of 99.13% on the LFW benchmark.  So jittering makes the whole
@@ -161,6 +175,21 @@ void ofApp::setup()
 
 
 
+void ofApp::profile()
+{
+    if (faces.empty())
+        return;
+
+    // Profile both networks layer by layer to see where the time goes.
+    // The trace can be opened in chrome://tracing.
+    ofxDlib::NetworkProfile netProfile = ofxDlib::NetworkProfiler::profile(net, faces);
+    ofxDlib::NetworkProfile fnetProfile = ofxDlib::NetworkProfiler::profile(fnet, faces);
+    cout << fnetProfile.toString() << endl;
+    cout << ofxDlib::NetworkProfile::compare(netProfile, fnetProfile) << endl;
+    fnetProfile.saveChromeTrace("fnet_profile.json");
+}
+
+
 void ofApp::draw()
 {
     ofSetColor(255);
@@ -181,3 +210,9 @@ void ofApp::draw()
     }
 }
 
+
+void ofApp::keyPressed(int key)
+{
+    if (key == 'p')
+        profile();
+}
@@ -79,15 +79,48 @@ using anet_type = loss_metric<fc_no_bias<128,avg_pool_everything<
                             input_rgb_image_sized<150>
                             >>>>>>>>>>>>;
 
+// The same network for inference with each con and its affine (and relu) folded
+// into a single layer.  ofxDlib::fuseLayers() copies the trained anet_type into
+// it.  It gives the same descriptors as anet_type, but makes one pass over the
+// output of each convolution instead of three.
+template <int N, template <typename> class BN, int stride, typename SUBNET>
+using fblock = con_affine<N,3,3,1,1,con_affine_relu<N,3,3,stride,stride,SUBNET>>;
+
+template <int N, typename SUBNET> using fres      = relu<residual<fblock,N,affine,SUBNET>>;
+template <int N, typename SUBNET> using fres_down = relu<residual_down<fblock,N,affine,SUBNET>>;
+
+template <typename SUBNET> using flevel0 = fres_down<256,SUBNET>;
+template <typename SUBNET> using flevel1 = fres<256,fres<256,fres_down<256,SUBNET>>>;
+template <typename SUBNET> using flevel2 = fres<128,fres<128,fres_down<128,SUBNET>>>;
+template <typename SUBNET> using flevel3 = fres<64,fres<64,fres<64,fres_down<64,SUBNET>>>>;
+template <typename SUBNET> using flevel4 = fres<32,fres<32,fres<32,SUBNET>>>;
+
+using fnet_type = loss_metric<fc_no_bias<128,avg_pool_everything<
+                            flevel0<
+                            flevel1<
+                            flevel2<
+                            flevel3<
+                            flevel4<
+                            max_pool<3,3,2,2,con_affine_relu<32,7,7,2,2,
+                            input_rgb_image_sized<150>
+                            >>>>>>>>>>;
+
 
 class ofApp: public ofBaseApp
 {
 public:
     void setup() override;
     void draw() override;
+    void keyPressed(int key) override;
 
+    /// \brief Profile both networks layer by layer.
+    void profile();
 
     std::map<std::size_t, std::vector<ofRectangle>> results;
 
     ofImage image;
+
+    anet_type net;
+    fnet_type fnet;
+    std::vector<matrix<rgb_pixel>> faces;
 };
@@ -0,0 +1,114 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofApp.h"
+
+
+void ofApp::setup()
+{
+    dlib::deserialize(ofToDataPath("dlib_face_recognition_resnet_model_v1.dat", true)) >> net;
+
+    std::vector<dlib::matrix<dlib::rgb_pixel>> chips = loadFaces("faces");
+
+    if (chips.empty())
+    {
+        ofLogError("ofApp::setup") << "No faces found in bin/data/faces/.";
+        return;
+    }
+
+    for (auto& chip: chips)
+    {
+        faces.push_back(ofTexture());
+        faces.back().loadData(ofxDlib::toOf(chip));
+    }
+
+    // Convert the network. The con / affine pairs are folded together and
+    // the weights are quantized to int8 with one scale per output channel.
+    quantizedNet.quantize(net);
+
+    // Calibrate the activation ranges on half of the faces and validate on
+    // all of them. With larger local image sets, keep the calibration set
+    // separate from the validation set.
+    quantizedNet.calibrate(net, chips.begin(), chips.begin() + (chips.size() + 1) / 2);
+
+    report = ofxDlib::validate(net, quantizedNet, chips);
+
+    std::stringstream ss;
+    ss << "Faces:                      " << report.numSamples << std::endl;
+    ss << "Weights (float / int8):     " << quantizedNet.floatWeightBytes() / 1024 << " KB / " << quantizedNet.quantizedWeightBytes() / 1024 << " KB" << std::endl;
+    ss << "Descriptor error (mean):    " << report.meanOutputError << std::endl;
+    ss << "Descriptor error (max):     " << report.maxOutputError << std::endl;
+    ss << "Pair distance error (mean): " << report.meanPairDistanceError << std::endl;
+    ss << "Pair distance error (max):  " << report.maxPairDistanceError << std::endl;
+    ss << "Changed decisions:          " << report.numDecisionChanges << " / " << report.numPairs << std::endl;
+    ss << "Float time:                 " << report.float32Ms << " ms" << std::endl;
+    ss << "Int8 time:                  " << report.int8Ms << " ms" << std::endl;
+    ss << "Speedup:                    " << report.speedup() << "x" << std::endl;
+    summary = ss.str();
+
+    std::cout << summary;
+}
+
+
+void ofApp::draw()
+{
+    ofBackground(0);
+    ofSetColor(255);
+
+    float x = 0;
+    float y = 0;
+    float size = 75;
+
+    for (auto& face: faces)
+    {
+        face.draw(x, y, size, size);
+        x += size;
+
+        if (x + size > ofGetWidth())
+        {
+            x = 0;
+            y += size;
+        }
+    }
+
+    ofDrawBitmapStringHighlight(summary, 14, y + size + 20);
+}
+
+
+std::vector<dlib::matrix<dlib::rgb_pixel>> ofApp::loadFaces(const std::string& path) const
+{
+    dlib::frontal_face_detector detector = dlib::get_frontal_face_detector();
+    dlib::shape_predictor sp;
+    dlib::deserialize(ofToDataPath("shape_predictor_5_face_landmarks.dat", true)) >> sp;
+
+    std::vector<dlib::matrix<dlib::rgb_pixel>> chips;
+
+    ofDirectory directory(path);
+    directory.allowExt("jpg");
+    directory.allowExt("png");
+    directory.listDir();
+
+    for (auto& file: directory)
+    {
+        ofPixels pixels;
+
+        if (!ofLoadImage(pixels, file.getAbsolutePath()))
+            continue;
+
+        dlib::matrix<dlib::rgb_pixel> img;
+        dlib::assign_image(img, ofxDlib::toDlib<dlib::rgb_pixel>(pixels));
+
+        for (auto face: detector(img))
+        {
+            dlib::matrix<dlib::rgb_pixel> chip;
+            dlib::extract_image_chip(img, dlib::get_face_chip_details(sp(img, face), 150, 0.25), chip);
+            chips.push_back(std::move(chip));
+        }
+    }
+
+    return chips;
+}
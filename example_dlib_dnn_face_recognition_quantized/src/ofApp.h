@@ -0,0 +1,72 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+//
+// This example quantizes the dlib_face_recognition_resnet_model_v1 network to
+// int8 and compares the int8 face descriptors with the float descriptors on
+// all faces found in the images in bin/data/faces/.
+//
+// The int8 kernels use AVX2 (and AVX-512 VNNI where available). Enable them in
+// addon_config.mk for the best throughput.
+//
+// See example_dlib_dnn_face_recognition for an introduction to the network.
+//
+
+
+#include "ofMain.h"
+#include "ofxDlib.h"
+
+
+template <template <int,template<typename>class,int,typename> class block, int N, template<typename>class BN, typename SUBNET>
+using residual = dlib::add_prev1<block<N,BN,1,dlib::tag1<SUBNET>>>;
+
+template <template <int,template<typename>class,int,typename> class block, int N, template<typename>class BN, typename SUBNET>
+using residual_down = dlib::add_prev2<dlib::avg_pool<2,2,2,2,dlib::skip1<dlib::tag2<block<N,BN,2,dlib::tag1<SUBNET>>>>>>;
+
+template <int N, template <typename> class BN, int stride, typename SUBNET>
+using block  = BN<dlib::con<N,3,3,1,1,dlib::relu<BN<dlib::con<N,3,3,stride,stride,SUBNET>>>>>;
+
+template <int N, typename SUBNET> using ares      = dlib::relu<residual<block,N,dlib::affine,SUBNET>>;
+template <int N, typename SUBNET> using ares_down = dlib::relu<residual_down<block,N,dlib::affine,SUBNET>>;
+
+template <typename SUBNET> using alevel0 = ares_down<256,SUBNET>;
+template <typename SUBNET> using alevel1 = ares<256,ares<256,ares_down<256,SUBNET>>>;
+template <typename SUBNET> using alevel2 = ares<128,ares<128,ares_down<128,SUBNET>>>;
+template <typename SUBNET> using alevel3 = ares<64,ares<64,ares<64,ares_down<64,SUBNET>>>>;
+template <typename SUBNET> using alevel4 = ares<32,ares<32,ares<32,SUBNET>>>;
+
+using anet_type = dlib::loss_metric<dlib::fc_no_bias<128,dlib::avg_pool_everything<
+                            alevel0<
+                            alevel1<
+                            alevel2<
+                            alevel3<
+                            alevel4<
+                            dlib::max_pool<3,3,2,2,dlib::relu<dlib::affine<dlib::con<32,7,7,2,2,
+                            dlib::input_rgb_image_sized<150>
+                            >>>>>>>>>>>>;
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+    void draw() override;
+
+    /// \brief Find and align all faces in the images in the given directory.
+    std::vector<dlib::matrix<dlib::rgb_pixel>> loadFaces(const std::string& path) const;
+
+    anet_type net;
+    ofxDlib::QuantizedNetwork quantizedNet;
+    ofxDlib::QuantizationReport report;
+
+    std::vector<ofTexture> faces;
+
+    std::string summary;
+};
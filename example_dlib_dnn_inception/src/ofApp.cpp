@@ -37,9 +37,58 @@ void ofApp::setup()
     trainer.set_min_learning_rate(0.00001);
     trainer.set_mini_batch_size(128);
     trainer.be_verbose();
-    trainer.set_synchronization_file(ofToDataPath("inception_sync", true), std::chrono::seconds(20));
-    // Train the network.  This might take a few minutes...
-    trainer.train(training_images, training_labels);
+
+    // Instead of the trainer's synchronization file, the parameters and the
+    // learning rate are checkpointed on a background thread every 20 seconds.
+    // A resumed run restarts the solver's momentum and the trainer's count of
+    // steps without progress, which a synchronization file would have kept.
+    ofxDlib::Checkpointer::Settings checkpointSettings;
+    checkpointSettings.directory = "inception_checkpoints";
+    checkpointSettings.interval = std::chrono::seconds(20);
+    ofxDlib::Checkpointer checkpointer(checkpointSettings);
+
+    // Continue from the newest checkpoint, if there is one.  The network is
+    // run once first so its layers allocate their parameters.
+    uint64_t first_step = 0;
+    if (!checkpointer.getCheckpoints().empty())
+    {
+        net(testing_images[0]);
+        double learning_rate = 0;
+        first_step = checkpointer.restoreLatest(net, &learning_rate);
+        if (learning_rate > 0)
+            trainer.set_learning_rate(learning_rate);
+        cout << "restored checkpoint from step " << first_step << endl;
+    }
+
+    // Train the network.  This might take a few minutes...  Like trainer.train(),
+    // the loop steps through the training data in order, one mini-batch at a
+    // time, until the learning rate drops below its minimum.  It also shuffles
+    // the data at the start of every epoch and takes checkpoints between steps.
+    dlib::rand rnd(time(0));
+    std::vector<matrix<unsigned char>> mini_batch_samples;
+    std::vector<unsigned long> mini_batch_labels;
+    while (trainer.get_learning_rate() >= trainer.get_min_learning_rate())
+    {
+        randomize_samples(training_images, training_labels, rnd);
+
+        for (size_t i = 0; i < training_images.size() && trainer.get_learning_rate() >= trainer.get_min_learning_rate(); i += trainer.get_mini_batch_size())
+        {
+            size_t end = std::min<size_t>(i + trainer.get_mini_batch_size(), training_images.size());
+            mini_batch_samples.assign(training_images.begin() + i, training_images.begin() + end);
+            mini_batch_labels.assign(training_labels.begin() + i, training_labels.begin() + end);
+
+            trainer.train_one_step(mini_batch_samples, mini_batch_labels);
+
+            // get_net() waits for the trainer to finish its pending steps, so
+            // only call it when a checkpoint is due.
+            if (checkpointer.isDue())
+                checkpointer.snapshot(trainer.get_net(), first_step + trainer.get_train_one_step_calls(), trainer.get_learning_rate());
+        }
+    }
+
+    // Wait for the training threads to stop and write the final checkpoint.
+    checkpointer.snapshot(trainer.get_net(), first_step + trainer.get_train_one_step_calls(), trainer.get_learning_rate());
+    checkpointer.flush();
 
     // At this point our net object should have learned how to classify MNIST images.  But
     // before we try it out let's save it to disk.  Note that, since the trainer has been
@@ -54,41 +103,20 @@ void ofApp::setup()
     // deserialize(ofToDataPath("mnist_network_inception.dat", true)) >> net;
 
 
-    // Now let's run the training images through the network.  This statement runs all the
-    // images through it and asks the loss layer to convert the network's raw output into
-    // labels.  In our case, these labels are the numbers between 0 and 9.
-    std::vector<unsigned long> predicted_labels = net(training_images);
-    int num_right = 0;
-    int num_wrong = 0;
-    // And then let's see if it classified them correctly.
-    for (size_t i = 0; i < training_images.size(); ++i)
-    {
-        if (predicted_labels[i] == training_labels[i])
-            ++num_right;
-        else
-            ++num_wrong;
+    // Now let's run the training images through the network.  The evaluator runs
+    // batches of images through copies of the network on every CPU core, takes the
+    // label with the largest network output and counts which images were
+    // classified correctly.  In our case, these labels are the numbers between 0
+    // and 9.
+    ofxDlib::ClassifierEvaluator<net_type> evaluator(net);
 
-    }
-    cout << "training num_right: " << num_right << endl;
-    cout << "training num_wrong: " << num_wrong << endl;
-    cout << "training accuracy:  " << num_right/(double)(num_right+num_wrong) << endl;
+    ofxDlib::ClassificationReport training_report = evaluator.evaluate(training_images, training_labels);
+    cout << "training " << training_report.toString() << endl;
 
     // Let's also see if the network can correctly classify the testing images.
     // Since MNIST is an easy dataset, we should see 99% accuracy.
-    predicted_labels = net(testing_images);
-    num_right = 0;
-    num_wrong = 0;
-    for (size_t i = 0; i < testing_images.size(); ++i)
-    {
-        if (predicted_labels[i] == testing_labels[i])
-            ++num_right;
-        else
-            ++num_wrong;
-
-    }
-    cout << "testing num_right: " << num_right << endl;
-    cout << "testing num_wrong: " << num_wrong << endl;
-    cout << "testing accuracy:  " << num_right/(double)(num_right+num_wrong) << endl;
+    ofxDlib::ClassificationReport testing_report = evaluator.evaluate(testing_images, testing_labels);
+    cout << "testing " << testing_report.toString() << endl;
 
     // Finish benchmarking.
     auto end = std::chrono::system_clock::now();
@@ -57,7 +57,7 @@ void ofApp::setup()
     //                                            dlib::input<dlib::matrix<unsigned char>>
     //                                            >>>>>>>>>>>>;
     
-    using net_type = ofx::Dlib::Network::TaggedLeNet;
+    using net_type = ofx::Dlib::LeNet5::Net;
 
     
     
@@ -110,41 +110,104 @@ void ofApp::setup()
     // Now if we later wanted to recall the network from disk we can simply say:
     // dlib::deserialize(ofToDataPath("mnist_network.dat", true)) >> net;
 
-    // Now let's run the training images through the network.  This statement runs all the
-    // images through it and asks the loss layer to convert the network's raw output into
-    // labels.  In our case, these labels are the numbers between 0 and 9.
-    std::vector<unsigned long> predicted_labels = net(training_images);
-    int num_right = 0;
-    int num_wrong = 0;
-    // And then let's see if it classified them correctly.
-    for (size_t i = 0; i < training_images.size(); ++i)
-    {
-        if (predicted_labels[i] == training_labels[i])
-            ++num_right;
-        else
-            ++num_wrong;
+    // Now let's run the training images through the network.  The evaluator runs
+    // batches of images through copies of the network on every CPU core and takes
+    // the label with the largest network output, just like the loss layer does.
+    // In our case, these labels are the numbers between 0 and 9.  It then counts
+    // which images were classified correctly, per digit.
+    ofxDlib::ClassifierEvaluator<net_type> evaluator(net);
 
-    }
-    std::cout << "training num_right: " << num_right << std::endl;
-    std::cout << "training num_wrong: " << num_wrong << std::endl;
-    std::cout << "training accuracy:  " << num_right/double(num_right+num_wrong) << std::endl;
+    ofxDlib::ClassificationReport training_report = evaluator.evaluate(training_images, training_labels);
+    std::cout << "training " << training_report.toString() << std::endl;
 
     // Let's also see if the network can correctly classify the testing images.  Since
     // MNIST is an easy dataset, we should see at least 99% accuracy.
-    predicted_labels = net(testing_images);
-    num_right = 0;
-    num_wrong = 0;
-    for (size_t i = 0; i < testing_images.size(); ++i)
+    ofxDlib::ClassificationReport testing_report = evaluator.evaluate(testing_images, testing_labels);
+    std::cout << "testing " << testing_report.toString() << std::endl;
+    std::cout << testing_report.confusionToString() << std::endl;
+
+    // A view gives typed access to every layer of the network without tagging
+    // it. Run one digit through the network and print each layer's output shape.
+    // The relu layers overwrite the fc and con outputs in place, so those
+    // layers are skipped here and view.output<11>() wouldn't compile. Tag the
+    // layers, as LeNet5::TaggedNet does, to keep their pre-activation outputs.
+    ofxDlib::LeNet5::NetView view(net);
+    net(testing_images[0]);
+
+    view.forEachOutput([](std::size_t i, const dlib::tensor& output) {
+        std::cout << "layer " << i << ": " << output.k() << "x" << output.nr() << "x" << output.nc() << std::endl;
+    });
+
+    const dlib::tensor& first_relu = view.output<10>();
+    std::cout << "first relu: " << dlib::max(dlib::mat(first_relu)) << " max activation" << std::endl;
+    std::cout << "con 6 filters: " << view.parameters<11>().size() << " parameters" << std::endl;
+
+    // LeNet5 is small enough that a kernel written for exactly this topology
+    // is much faster than dlib's generic layers. It copies the trained
+    // parameters and gives the same labels up to float rounding.
+    ofxDlib::LeNet5::InferenceKernel kernel;
+    kernel.load(net);
+
+    auto kernel_start = std::chrono::high_resolution_clock::now();
+    std::vector<unsigned long> kernel_labels = kernel(testing_images);
+    std::chrono::duration<double> kernel_seconds = std::chrono::high_resolution_clock::now() - kernel_start;
+
+    std::size_t kernel_right = 0;
+
+    for (std::size_t i = 0; i < testing_images.size(); ++i)
+    {
+        if (kernel_labels[i] == testing_labels[i])
+            ++kernel_right;
+    }
+
+    std::cout << "kernel testing accuracy: " << double(kernel_right) / testing_images.size();
+    std::cout << " (" << testing_images.size() / kernel_seconds.count() << " images/s on one core)" << std::endl;
+
+    // Check the kernel against dlib. Each chunk of images is run through the
+    // network in one batch, so the subnet output holds the 10 scores of every
+    // image in the chunk. The scores must agree to a relative tolerance of
+    // 1e-4, which allows for the different order of the sums.
+    const float score_tolerance = 1e-4f;
+    const std::size_t chunk_size = 100;
+    std::vector<unsigned long> net_labels(testing_images.size());
+    std::size_t label_mismatches = 0;
+    std::size_t score_mismatches = 0;
+    float max_score_difference = 0;
+
+    for (std::size_t begin = 0; begin < testing_images.size(); begin += chunk_size)
     {
-        if (predicted_labels[i] == testing_labels[i])
-            ++num_right;
-        else
-            ++num_wrong;
+        const std::size_t end = std::min(testing_images.size(), begin + chunk_size);
+        net(testing_images.begin() + begin, testing_images.begin() + end, net_labels.begin() + begin);
+        const float* net_scores = net.subnet().get_output().host();
+
+        for (std::size_t i = begin; i < end; ++i)
+        {
+            float scores[ofxDlib::LeNet5::InferenceKernel::NUM_CLASSES];
+            kernel.classify(&testing_images[i](0, 0), scores);
 
+            if (kernel_labels[i] != net_labels[i])
+                ++label_mismatches;
+
+            bool scores_match = true;
+
+            for (std::size_t c = 0; c < ofxDlib::LeNet5::InferenceKernel::NUM_CLASSES; ++c)
+            {
+                const float expected = net_scores[(i - begin) * ofxDlib::LeNet5::InferenceKernel::NUM_CLASSES + c];
+                const float difference = std::abs(scores[c] - expected);
+                max_score_difference = std::max(max_score_difference, difference);
+
+                if (difference > score_tolerance * std::max(1.0f, std::abs(expected)))
+                    scores_match = false;
+            }
+
+            if (!scores_match)
+                ++score_mismatches;
+        }
     }
-    std::cout << "testing num_right: " << num_right << std::endl;
-    std::cout << "testing num_wrong: " << num_wrong << std::endl;
-    std::cout << "testing accuracy:  " << num_right/double(num_right+num_wrong) << std::endl;
+
+    std::cout << "kernel vs. dlib: " << label_mismatches << " label mismatches, ";
+    std::cout << score_mismatches << " score mismatches (relative tolerance " << score_tolerance << ")";
+    std::cout << ", max score difference " << max_score_difference << std::endl;
 
     // Finally, you can also save network parameters to XML files if you want to do
     // something with the network in another tool.  For example, you could use dlib's
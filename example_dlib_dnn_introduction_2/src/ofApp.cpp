@@ -13,15 +13,23 @@ void ofApp::setup()
     // Set up a timing mechanism for benchmarking.
     auto start = std::chrono::system_clock::now();
 
-    std::vector<matrix<unsigned char>> training_images;
-    std::vector<unsigned long> training_labels;
-    std::vector<matrix<unsigned char>> testing_images;
-    std::vector<unsigned long> testing_labels;
-    load_mnist_dataset(ofToDataPath("mnist/", true),
-                       training_images,
-                       training_labels,
-                       testing_images,
-                       testing_labels);
+    // The MNIST files are converted once into packed datasets. Opening a
+    // packed dataset only maps the file, so training starts immediately and
+    // images are paged in as they are sampled.
+    if (!ofFile::doesFileExist("mnist_train.dat") || !ofFile::doesFileExist("mnist_test.dat"))
+    {
+        if (!ofxDlib::PackedDataset::convertMnist("mnist/",
+                                                  "mnist_train.dat",
+                                                  "mnist_test.dat"))
+        {
+            ofLogError("ofApp::setup") << "Unable to convert the MNIST dataset in data/mnist/.";
+            ofExit();
+            return;
+        }
+    }
+
+    ofxDlib::PackedDataset training("mnist_train.dat");
+    ofxDlib::PackedDataset testing("mnist_test.dat");
 
     // dlib uses cuDNN under the covers.  One of the features of cuDNN is the
     // option to use slower methods that use less RAM or faster methods that use
@@ -159,28 +167,43 @@ void ofApp::setup()
     // make mini-batches yourself, any way you like, and you send them to the
     // trainer by repeatedly calling trainer.train_one_step().
     //
-    // For example, the loop below stream MNIST data to out trainer.
-    std::vector<matrix<unsigned char>> mini_batch_samples;
-    std::vector<unsigned long> mini_batch_labels;
-    dlib::rand rnd(time(0));
+    // For example, the loop below stream MNIST data to out trainer.  The
+    // mini-batches are sampled on worker threads by a BatchPipeline so the next
+    // mini-batch is ready as soon as the trainer wants it.
+    typedef ofxDlib::BatchPipeline<matrix<unsigned char>, unsigned long> Pipeline;
+    Pipeline::Settings pipelineSettings;
+    pipelineSettings.seed = time(0);
+
+    Pipeline pipeline([&](Pipeline::Batch& batch, dlib::rand& rnd) {
+        // make a 128 image mini-batch
+        training.sample(rnd, 128, batch.samples, batch.labels);
+    }, pipelineSettings);
+
+    // The telemetry times how long we wait for mini-batches (data) and how
+    // long train_one_step() blocks while the trainer is busy (compute).  If
+    // most of each step is data, the run is input-bound and more pipeline
+    // workers will help more than a faster network.
+    ofxDlib::TrainingTelemetry telemetry;
+
+    Pipeline::Batch batch;
     // Loop until the trainer's automatic shrinking has shrunk the learning rate to 1e-6.
     // Given our settings, this means it will stop training after it has shrunk the
     // learning rate 3 times.
     while(trainer.get_learning_rate() >= 1e-6)
     {
-        mini_batch_samples.clear();
-        mini_batch_labels.clear();
-
-        // make a 128 image mini-batch
-        while(mini_batch_samples.size() < 128)
         {
-            auto idx = rnd.get_random_32bit_number()%training_images.size();
-            mini_batch_samples.push_back(training_images[idx]);
-            mini_batch_labels.push_back(training_labels[idx]);
+            auto timer = telemetry.time(ofxDlib::TrainingTelemetry::PHASE_DATA);
+            if (!pipeline.next(batch))
+                break;
         }
 
         // Tell the trainer to update the network given this mini-batch
-        trainer.train_one_step(mini_batch_samples, mini_batch_labels);
+        {
+            auto timer = telemetry.time(ofxDlib::TrainingTelemetry::PHASE_COMPUTE);
+            trainer.train_one_step(batch.samples, batch.labels);
+        }
+
+        telemetry.endStep(batch.samples.size());
 
         // You can also feed validation data into the trainer by periodically
         // calling trainer.test_one_step(samples,labels).  Unlike train_one_step(),
@@ -198,6 +221,11 @@ void ofApp::setup()
     // still executing to stop before we mess with the net object.  Calling
     // get_net() performs the necessary synchronization.
     trainer.get_net();
+    pipeline.stop();
+
+    cout << "mean mini-batch stall: " << pipeline.stats().meanStallMs() << " ms" << endl;
+    cout << "average " << telemetry.getAverage(telemetry.getStepCount()).toString() << endl;
+    telemetry.saveCsv("mnist_res_telemetry.csv");
 
     net.clean();
     serialize(ofToDataPath("mnist_res_network.dat",true)) << net;
@@ -223,36 +251,22 @@ void ofApp::setup()
     deserialize(ofToDataPath("mnist_res_network.dat", true)) >> tnet;
 
 
-    // And finally, we can run the testing network over our data.
-    std::vector<unsigned long> predicted_labels = tnet(training_images);
-    int num_right = 0;
-    int num_wrong = 0;
-    for (size_t i = 0; i < training_images.size(); ++i)
-    {
-        if (predicted_labels[i] == training_labels[i])
-            ++num_right;
-        else
-            ++num_wrong;
+    // And finally, we can run the testing network over our data.  The evaluator
+    // loads the records batch by batch on every CPU core, so the datasets never
+    // have to fit in RAM.
+    ofxDlib::ClassifierEvaluator<test_net_type> evaluator(tnet);
 
-    }
-    cout << "training num_right: " << num_right << endl;
-    cout << "training num_wrong: " << num_wrong << endl;
-    cout << "training accuracy:  " << num_right/(double)(num_right+num_wrong) << endl;
-
-    predicted_labels = tnet(testing_images);
-    num_right = 0;
-    num_wrong = 0;
-    for (size_t i = 0; i < testing_images.size(); ++i)
+    auto evaluate = [&](const ofxDlib::PackedDataset& dataset, const std::string& name)
     {
-        if (predicted_labels[i] == testing_labels[i])
-            ++num_right;
-        else
-            ++num_wrong;
-
-    }
-    cout << "testing num_right: " << num_right << endl;
-    cout << "testing num_wrong: " << num_wrong << endl;
-    cout << "testing accuracy:  " << num_right/(double)(num_right+num_wrong) << endl;
+        ofxDlib::ClassificationReport report = evaluator.evaluate(dataset.size(), [&](size_t i, matrix<unsigned char>& image) {
+            dataset.load(i, image);
+            return dataset.label(i);
+        });
+        cout << name << " " << report.toString() << endl;
+    };
+
+    evaluate(training, "training");
+    evaluate(testing, "testing");
 
 
     // Finish benchmarking.
@@ -33,8 +33,8 @@ void ofApp::setup()
     // holds the locations of the faces in the training images.  So for
     // example, the image images_train[0] has the faces given by the
     // rectangles in face_boxes_train[0].
-    std::vector<matrix<rgb_pixel>> images_train, images_test;
-    std::vector<std::vector<mmod_rect>> face_boxes_train, face_boxes_test;
+    std::vector<matrix<rgb_pixel>> images_test;
+    std::vector<std::vector<mmod_rect>> face_boxes_test;
 
     // Now we load the data.  These XML files list the images in each dataset
     // and also contain the positions of the face boxes.  Obviously you can use
@@ -45,7 +45,16 @@ void ofApp::setup()
     // can be found in the tools/imglab folder.  It is a simple graphical tool
     // for labeling objects in images with boxes.  To see how to use it read the
     // tools/imglab/README.txt file.
-    load_image_dataset(images_train, face_boxes_train, faces_directory + "/training.xml");
+    //
+    // The training set is streamed instead.  Only its file names and boxes are
+    // loaded here.  The images are decoded on demand by a pool of threads and
+    // kept in a 512 MB cache, so the same code works for datasets that don't
+    // fit in memory.
+    ofxDlib::StreamingImageDataset::Settings datasetSettings;
+    datasetSettings.cacheBytes = 512 * 1024 * 1024;
+    ofxDlib::StreamingImageDataset images_train(faces_directory + "/training.xml", datasetSettings);
+    const std::vector<std::vector<mmod_rect>>& face_boxes_train = images_train.boxes();
+
     load_image_dataset(images_test, face_boxes_test, faces_directory + "/testing.xml");
 
     cout << "num training images: " << images_train.size() << endl;
@@ -80,57 +89,152 @@ void ofApp::setup()
     // dnn_trainer<net_type> trainer(net, sgd(), { 0, 1 });
     trainer.set_learning_rate(0.1);
     trainer.be_verbose();
-    trainer.set_synchronization_file(ofToDataPath("mmod_sync", true), std::chrono::minutes(5));
+
+    // Instead of the trainer's synchronization file, which serializes the
+    // whole trainer on the training thread, the parameters are checkpointed
+    // on a background thread.  Only changed tensors are written and the 3
+    // newest checkpoints are kept in bin/data/mmod_checkpoints/.
+    ofxDlib::Checkpointer::Settings checkpointSettings;
+    checkpointSettings.directory = "mmod_checkpoints";
+    checkpointSettings.numCheckpoints = 3;
+    checkpointSettings.interval = std::chrono::minutes(5);
+    ofxDlib::Checkpointer checkpointer(checkpointSettings);
+
+    // Continue from the newest checkpoint, if there is one.  The network is
+    // run once first so its layers allocate their parameters.  A new trainer
+    // counts its steps from 0, so the restored step is added to the steps of
+    // this run.  Checkpoints are numbered in the order they are written, so the
+    // ones written by this run are the newest even before its steps catch up.
+    //
+    // Unlike a synchronization file, a checkpoint doesn't hold the solver's
+    // momentum or the trainer's count of steps without progress.  The learning
+    // rate is restored, but the trainer waits for another 300 steps without
+    // progress before it lowers it again.
+    uint64_t first_step = 0;
+    if (!checkpointer.getCheckpoints().empty())
+    {
+        net(images_test[0]);
+        double learning_rate = 0;
+        first_step = checkpointer.restoreLatest(net, &learning_rate);
+        if (learning_rate > 0)
+            trainer.set_learning_rate(learning_rate);
+        cout << "restored checkpoint from step " << first_step << " with learning rate " << trainer.get_learning_rate() << endl;
+    }
     trainer.set_iterations_without_progress_threshold(300);
 
 
     // Now let's train the network.  We are going to use mini-batches of 150
     // images.   The images are random crops from our training set (see
     // random_cropper_ex.cpp for a discussion of the random_cropper).
-    std::vector<matrix<rgb_pixel>> mini_batch_samples;
-    std::vector<std::vector<mmod_rect>> mini_batch_labels;
-    random_cropper cropper;
-    cropper.set_chip_dims(200, 200);
-    // Usually you want to give the cropper whatever min sizes you passed to the
-    // mmod_options constructor, which is what we do here.
-    cropper.set_min_object_size(40,40);
-    dlib::rand rnd;
-    // Run the trainer until the learning rate gets small.  This will probably take several
-    // hours.
-    while(trainer.get_learning_rate() >= 1e-4)
+    //
+    // The crops are made on worker threads by a BatchPipeline, which keeps a
+    // few mini-batches ready so the trainer doesn't wait between steps.
+    typedef ofxDlib::BatchPipeline<matrix<rgb_pixel>, std::vector<mmod_rect>> Pipeline;
+    Pipeline::Settings pipelineSettings;
+    pipelineSettings.queueSize = 4;
+
+    // One seed drives the workers' random number generators and their
+    // croppers. time(0) gives new crops on every run. Set it to a constant to
+    // repeat a run.
+    const time_t seed = time(0);
+    pipelineSettings.seed = seed;
+
+    // Each worker gets its own cropper, seeded with the seed plus the worker
+    // index, so its crops only depend on the seed.
+    std::vector<random_cropper> croppers(pipelineSettings.numWorkers);
+    for (std::size_t i = 0; i < croppers.size(); ++i)
     {
-        cropper(150, images_train, face_boxes_train, mini_batch_samples, mini_batch_labels);
+        croppers[i].set_seed(seed + time_t(i));
+        croppers[i].set_chip_dims(200, 200);
+        // Usually you want to give the cropper whatever min sizes you passed to the
+        // mmod_options constructor, which is what we do here.
+        croppers[i].set_min_object_size(40,40);
+    }
+
+    Pipeline pipeline([&](Pipeline::Batch& batch, dlib::rand& rnd) {
+        images_train.crop(croppers[batch.worker], 150, rnd, batch.samples, batch.labels);
         // We can also randomly jitter the colors and that often helps a detector
         // generalize better to new images.
-        for (auto&& img : mini_batch_samples)
+        for (auto&& img : batch.samples)
             disturb_colors(img, rnd);
+    }, pipelineSettings);
 
-        trainer.train_one_step(mini_batch_samples, mini_batch_labels);
+    Pipeline::Batch batch;
+    // Run the trainer until the learning rate gets small.  This will probably take several
+    // hours.
+    while(trainer.get_learning_rate() >= 1e-4 && pipeline.next(batch))
+    {
+        trainer.train_one_step(batch.samples, batch.labels);
+
+        // get_net() waits for the trainer to finish its pending steps, so
+        // only call it when a checkpoint is due.
+        if (checkpointer.isDue())
+            checkpointer.snapshot(trainer.get_net(), first_step + trainer.get_train_one_step_calls(), trainer.get_learning_rate());
     }
+    pipeline.stop();
+
+    auto pipelineStats = pipeline.stats();
+    cout << "batches: " << pipelineStats.numBatches
+         << " mean stall: " << pipelineStats.meanStallMs() << " ms"
+         << " mean batch time: " << pipelineStats.meanProduceMs() << " ms" << endl;
+
+    auto datasetStats = images_train.stats();
+    cout << "image cache hit rate: " << datasetStats.hitRate()
+         << " cached: " << datasetStats.numCached << " images, "
+         << datasetStats.cachedBytes / (1024 * 1024) << " MB" << endl;
+
     // wait for training threads to stop
-    trainer.get_net();
+    const uint64_t last_step = first_step + trainer.get_train_one_step_calls();
+    checkpointer.snapshot(trainer.get_net(), last_step, trainer.get_learning_rate());
+    checkpointer.flush();
+    cout << checkpointer.getLastStats().toString() << endl;
     cout << "done training" << endl;
 
+    // This is what the next run will resume from: the checkpoint just written,
+    // not an older one with a larger step count.
+    {
+        net_type resumed(options);
+        resumed.subnet().layer_details().set_num_filters(options.detector_windows.size());
+        resumed(images_test[0]);
+        cout << "the next run resumes from step " << checkpointer.restoreLatest(resumed)
+             << " (this run ended at step " << last_step << ")" << endl;
+    }
+
     // Save the network to disk
     net.clean();
     serialize(ofToDataPath("mmod_network.dat", true)) << net;
 
-    // Now that we have a face detector we can test it.  The first statement tests it
-    // on the training data.  It will print the precision, recall, and then average precision.
-    // This statement should indicate that the network works perfectly on the
-    // training data.
-    cout << "training results: " << test_object_detection_function(net, images_train, face_boxes_train) << endl;
+    // Now that we have a face detector we can test it.  The evaluator runs copies
+    // of the network on every CPU core and matches the detections to the true
+    // boxes just like dlib's test_object_detection_function().  It will print the
+    // precision, recall, and then average precision, followed by how long each
+    // image took.  The first test on the training data should indicate that the
+    // network works perfectly on the training data.
+    //
+    // The training images are decoded as the evaluator needs them, so the
+    // whole training set is tested without holding it in memory.
+    ofxDlib::DetectionEvaluator<net_type> evaluator(net);
+
+    ofxDlib::DetectionReport training_report = evaluator.evaluate(images_train.size(),
+                                                                  [&](std::size_t i,
+                                                                      matrix<rgb_pixel>& image,
+                                                                      std::vector<mmod_rect>& boxes) {
+        image = *images_train.get(i);
+        boxes = images_train.boxes(i);
+    });
+    cout << "training results: " << training_report.toString() << endl;
     // However, to get an idea if it really worked without overfitting we need to run
-    // it on images it wasn't trained on.  The next line does this.   Happily,
-    // this statement indicates that the detector finds most of the faces in the
+    // it on images it wasn't trained on.  The next lines do this.   Happily,
+    // this indicates that the detector finds most of the faces in the
     // testing data.
-    cout << "testing results:  " << test_object_detection_function(net, images_test, face_boxes_test) << endl;
+    ofxDlib::DetectionReport testing_report = evaluator.evaluate(images_test, face_boxes_test);
+    cout << "testing results:  " << testing_report.toString() << endl;
 
 
     // If you are running many experiments, it's also useful to log the settings used
     // during the training experiment.  This statement will print the settings we used to
     // the screen.
-    cout << trainer << cropper << endl;
+    cout << trainer << croppers[0] << endl;
 
     // Here we iterate through our test images and run the detector.
     for (auto&& img : images_test)
@@ -0,0 +1,188 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofApp.h"
+
+
+void ofApp::setup()
+{
+    std::vector<dlib::matrix<unsigned char>> training_images;
+    std::vector<unsigned long> training_labels;
+    std::vector<dlib::matrix<unsigned char>> testing_images;
+    std::vector<unsigned long> testing_labels;
+
+    dlib::load_mnist_dataset(ofToDataPath("mnist/", true),
+                             training_images,
+                             training_labels,
+                             testing_images,
+                             testing_labels);
+
+    using net_type = ofxDlib::LeNet5::Net;
+    using trainer_type = ofxDlib::ParallelTrainer<net_type>;
+
+    const std::size_t batch_size = 128;
+    const std::size_t warmup_steps = 5;
+    const std::size_t timed_steps = 50;
+    const std::size_t max_replicas = std::max(1u, std::thread::hardware_concurrency());
+
+    // Every configuration trains on the same mini-batches.
+    std::vector<std::vector<dlib::matrix<unsigned char>>> batches(warmup_steps + timed_steps);
+    std::vector<std::vector<unsigned long>> batch_labels(batches.size());
+
+    dlib::rand rnd;
+
+    for (std::size_t i = 0; i < batches.size(); ++i)
+    {
+        for (std::size_t j = 0; j < batch_size; ++j)
+        {
+            auto idx = rnd.get_random_32bit_number() % training_images.size();
+            batches[i].push_back(training_images[idx]);
+            batch_labels[i].push_back(training_labels[idx]);
+        }
+    }
+
+    std::cout << "Scaling benchmark: " << timed_steps << " steps of "
+              << batch_size << " samples." << std::endl;
+    std::cout << std::setw(10) << "replicas"
+              << std::setw(14) << "samples/s"
+              << std::setw(10) << "speedup"
+              << std::setw(12) << "efficiency"
+              << std::setw(10) << "forward"
+              << std::setw(10) << "backward"
+              << std::setw(10) << "sync"
+              << std::setw(10) << "update" << std::endl;
+
+    double baseline = 0;
+
+    for (std::size_t replicas = 1; ; replicas = std::min(replicas * 2, max_replicas))
+    {
+        net_type net;
+
+        trainer_type::Settings settings;
+        settings.numReplicas = replicas;
+
+        // The phase split shows where the scaling efficiency goes.
+        ofxDlib::TrainingTelemetry telemetry;
+
+        trainer_type trainer(net, dlib::sgd(), settings);
+        trainer.setLearningRate(0.01);
+        trainer.setTelemetry(&telemetry);
+
+        for (std::size_t i = 0; i < warmup_steps; ++i)
+            trainer.trainOneStep(batches[i], batch_labels[i]);
+
+        telemetry.reset();
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t i = warmup_steps; i < batches.size(); ++i)
+            trainer.trainOneStep(batches[i], batch_labels[i]);
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double samples_per_second = timed_steps * batch_size / elapsed.count();
+
+        if (replicas == 1)
+            baseline = samples_per_second;
+
+        double speedup = samples_per_second / baseline;
+
+        ofxDlib::TrainingTelemetry::Record average = telemetry.getAverage(timed_steps);
+
+        auto percent = [&](ofxDlib::TrainingTelemetry::Phase phase) {
+            return 100.0 * average.phaseMs[phase] / average.stepMs;
+        };
+
+        std::cout << std::setw(10) << replicas
+                  << std::setw(14) << std::fixed << std::setprecision(1) << samples_per_second
+                  << std::setw(10) << std::setprecision(2) << speedup
+                  << std::setw(11) << std::setprecision(0) << 100.0 * speedup / replicas << "%"
+                  << std::setw(9) << percent(ofxDlib::TrainingTelemetry::PHASE_FORWARD) << "%"
+                  << std::setw(9) << percent(ofxDlib::TrainingTelemetry::PHASE_BACKWARD) << "%"
+                  << std::setw(9) << percent(ofxDlib::TrainingTelemetry::PHASE_SYNC) << "%"
+                  << std::setw(9) << percent(ofxDlib::TrainingTelemetry::PHASE_UPDATE) << "%"
+                  << std::endl;
+
+        if (replicas == max_replicas)
+            break;
+    }
+
+    // A step that throws, here on a label the network has no output for, is
+    // abandoned without changing the network. The next step trains as usual.
+    {
+        net_type net;
+        trainer_type trainer(net);
+
+        std::vector<unsigned long> bad_labels = batch_labels[0];
+        bad_labels[0] = 10;
+
+        try
+        {
+            trainer.trainOneStep(batches[0], bad_labels);
+        }
+        catch (const std::exception& exc)
+        {
+            std::cout << "A step with a bad label failed: " << exc.what() << std::endl;
+        }
+
+        trainer.trainOneStep(batches[0], batch_labels[0]);
+
+        std::cout << "The next step succeeded. Steps trained: " << trainer.getTrainOneStepCalls() << std::endl;
+    }
+
+    // Now train with all cores.  The synchronization file lets an interrupted
+    // run continue where it stopped, and dlib::dnn_trainer can continue from
+    // it too.
+    net_type net;
+
+    // Stream every step to a CSV file that can be plotted while training.
+    ofxDlib::TrainingTelemetry::Settings telemetry_settings;
+    telemetry_settings.csvPath = "mnist_parallel_telemetry.csv";
+
+    ofxDlib::TrainingTelemetry telemetry(telemetry_settings);
+
+    trainer_type::Settings settings;
+    settings.numReplicas = max_replicas;
+
+    trainer_type trainer(net, dlib::sgd(), settings);
+    trainer.setLearningRate(0.01);
+    trainer.setMinLearningRate(0.00001);
+    trainer.setMiniBatchSize(batch_size);
+    trainer.beVerbose();
+    trainer.setSynchronizationFile(ofToDataPath("mnist_parallel_sync", true), std::chrono::seconds(20));
+    trainer.setTelemetry(&telemetry);
+
+    auto start = std::chrono::steady_clock::now();
+    trainer.train(training_images, training_labels);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Trained " << trainer.getTrainOneStepCalls() << " steps on "
+              << trainer.numReplicas() << " replicas in " << elapsed.count() << "s" << std::endl;
+    std::cout << "Average " << telemetry.getAverage(telemetry.getStepCount()).toString() << std::endl;
+
+    telemetry.saveJson("mnist_parallel_telemetry.json");
+
+    net.clean();
+    dlib::serialize(ofToDataPath("mnist_network.dat", true)) << net;
+
+    std::vector<unsigned long> predicted_labels = net(testing_images);
+    int num_right = 0;
+    int num_wrong = 0;
+    for (std::size_t i = 0; i < testing_images.size(); ++i)
+    {
+        if (predicted_labels[i] == testing_labels[i])
+            ++num_right;
+        else
+            ++num_wrong;
+    }
+
+    std::cout << "testing num_right: " << num_right << std::endl;
+    std::cout << "testing num_wrong: " << num_wrong << std::endl;
+    std::cout << "testing accuracy:  " << num_right/double(num_right+num_wrong) << std::endl;
+
+    ofExit();
+}
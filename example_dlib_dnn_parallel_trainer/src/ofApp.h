@@ -0,0 +1,33 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+//
+// This example trains LeNet on MNIST with ofxDlib::ParallelTrainer, which
+// splits every mini-batch across network replicas on separate CPU threads.
+//
+// Before training it runs a scaling benchmark that times the same number of
+// training steps with 1, 2, 4, ... replicas and prints the throughput and
+// the speedup over a single replica, along with the share of each step
+// spent in the forward, backward, sync and update phases.
+//
+// See example_dlib_dnn_introduction_1 for an introduction to the network.
+//
+
+
+#include "ofMain.h"
+#include "ofxDlib.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+
+};
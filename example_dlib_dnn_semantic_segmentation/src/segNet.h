@@ -203,6 +203,42 @@ using anet_type = dlib::loss_multiclass_log_per_pixel<
                             dlib::input<dlib::matrix<dlib::rgb_pixel>>
                             >>>>>>>>>>>>>>;
 
+// ----------------------------------------------------------------------------------------
+
+// Fused testing network type.  Each con and the affine (and relu) following it are folded
+// into a single layer, so every convolution makes one pass over its output instead of
+// three.  Use ofxDlib::fuseLayers() to copy a trained anet_type into it.  The transposed
+// convolutions in the upsampling blocks are left as they are.
+
+template <int N, template <typename> class BN, int stride, typename SUBNET>
+using fblock = dlib::con_affine<N,3,3,1,1,dlib::con_affine_relu<N,3,3,stride,stride,SUBNET>>;
+
+template <int N, typename SUBNET> using fres      = dlib::relu<residual<fblock,N,dlib::affine,SUBNET>>;
+template <int N, typename SUBNET> using fres_down = dlib::relu<residual_down<fblock,N,dlib::affine,SUBNET>>;
+
+template <typename SUBNET> using fres512 = fres<512, SUBNET>;
+template <typename SUBNET> using fres256 = fres<256, SUBNET>;
+template <typename SUBNET> using fres128 = fres<128, SUBNET>;
+template <typename SUBNET> using fres64  = fres<64, SUBNET>;
+
+template <typename SUBNET> using flevel1 = dlib::repeat<2,fres512,fres_down<512,SUBNET>>;
+template <typename SUBNET> using flevel2 = dlib::repeat<2,fres256,fres_down<256,SUBNET>>;
+template <typename SUBNET> using flevel3 = dlib::repeat<2,fres128,fres_down<128,SUBNET>>;
+template <typename SUBNET> using flevel4 = dlib::repeat<2,fres64,fres<64,SUBNET>>;
+
+template <typename SUBNET> using flevel1t = dlib::repeat<2,fres512,ares_up<512,SUBNET>>;
+template <typename SUBNET> using flevel2t = dlib::repeat<2,fres256,ares_up<256,SUBNET>>;
+template <typename SUBNET> using flevel3t = dlib::repeat<2,fres128,ares_up<128,SUBNET>>;
+template <typename SUBNET> using flevel4t = dlib::repeat<2,fres64,ares_up<64,SUBNET>>;
+
+using fnet_type = dlib::loss_multiclass_log_per_pixel<
+                            dlib::cont<class_count,7,7,2,2,
+                            flevel4t<flevel3t<flevel2t<flevel1t<
+                            flevel1<flevel2<flevel3<flevel4<
+                            dlib::max_pool<3,3,2,2,dlib::con_affine_relu<64,7,7,2,2,
+                            dlib::input<dlib::matrix<dlib::rgb_pixel>>
+                            >>>>>>>>>>>>;
+
 const Voc2012class& find_voc2012_class(const uint16_t& index_label)
 {
     return find_voc2012_class(
@@ -10,57 +10,83 @@
 
 void ofApp::setup()
 {
+    ofAddListener(loader.onModelLoaded, this, &ofApp::onModelLoaded);
+
     // We need a face detector. We will use this to get bounding boxes for
-    // each face in an image.
-    dlib::frontal_face_detector detector = dlib::get_frontal_face_detector();
+    // each face in an image. Building it takes a moment, so we let the
+    // loader do it on a background thread.
+    loader.load<dlib::frontal_face_detector>("detector", [](dlib::frontal_face_detector& detector) {
+        detector = dlib::get_frontal_face_detector();
+    });
+
+    // And we also need a shape_predictor.  This is the tool that will predict face
+    // landmark positions given an image and face bounding box.  Here we are just
+    // loading the model from the shape_predictor_68_face_landmarks.dat.  The file
+    // is large, so it is loaded in parallel with the detector and the app keeps
+    // drawing while it loads.
+    loader.load<dlib::shape_predictor>("sp", "shape_predictor_68_face_landmarks.dat");
+
+    // You can also try the 5 landmark detector, which is accurate and fast.
+    // loader.load<dlib::shape_predictor>("sp", "shape_predictor_5_face_landmarks.dat");
 
-    ofPixels pix;
     ofLoadImage(pix, "people.jpg");
 
     // Make the image larger so we can detect small faces.
     dlib::pyramid_up(pix);
 
-    // Now tell the face detector to give us a list of bounding boxes
-    // around all the faces in the image.
-    std::vector<dlib::rectangle> dets = detector(pix);
-
-    std::cout << "Number of faces detected: " << dets.size() << std::endl;
-
-    // And we also need a shape_predictor.  This is the tool that will predict face
-    // landmark positions given an image and face bounding box.  Here we are just
-    // loading the model from the shape_predictor_68_face_landmarks.dat.
-    dlib::shape_predictor sp;
+    // Load the image intou our pixels.
+    image.setFromPixels(pix);
+}
 
-    // Load the face landmark detector.
-    dlib::deserialize(ofToDataPath("shape_predictor_68_face_landmarks.dat", true)) >> sp;
 
-    // You can also try the 5 landmark detector, which is accurate and fast.
-    // dlib::deserialize(ofToDataPath("shape_predictor_5_face_landmarks.dat", true)) >> sp;
+void ofApp::update()
+{
+    // Dispatch onModelLoaded events on the main thread.
+    loader.update();
 
-    // Now we will go ask the shape_predictor to tell us the pose of
-    // each face we detected.
-    for (std::size_t j = 0; j < dets.size(); ++j)
+    // Detection can start as soon as the detector is ready, even if the
+    // shape predictor is still loading.
+    if (!detected)
     {
-        dlib::full_object_detection shape = sp(pix, dets[j]);
-        shapes.push_back(shape);
-    }
-
-    // We can also extract copies of each face that are cropped, rotated upright,
-    // and scaled to a standard size as shown here:
-    std::vector<dlib::chip_details> chipDetails = dlib::get_face_chip_details(shapes);
+        if (auto detector = loader.get<dlib::frontal_face_detector>("detector"))
+        {
+            detected = true;
 
-    // Create a collection of faces.
-    dlib::array<ofPixels> face_chips;
+            // Now tell the face detector to give us a list of bounding boxes
+            // around all the faces in the image.
+            dets = (*detector)(pix);
 
-    dlib::extract_image_chips(pix, chipDetails, face_chips);
+            std::cout << "Number of faces detected: " << dets.size() << std::endl;
+        }
+    }
 
-    for (auto& f: face_chips)
+    if (!dets.empty() && shapes.empty())
     {
-        faceChips.push_back(ofImage(f));
+        if (auto sp = loader.get<dlib::shape_predictor>("sp"))
+        {
+            // Now we will go ask the shape_predictor to tell us the pose of
+            // each face we detected.
+            for (std::size_t j = 0; j < dets.size(); ++j)
+            {
+                dlib::full_object_detection shape = (*sp)(pix, dets[j]);
+                shapes.push_back(shape);
+            }
+
+            // We can also extract copies of each face that are cropped, rotated upright,
+            // and scaled to a standard size as shown here:
+            std::vector<dlib::chip_details> chipDetails = dlib::get_face_chip_details(shapes);
+
+            // Create a collection of faces.
+            dlib::array<ofPixels> face_chips;
+
+            dlib::extract_image_chips(pix, chipDetails, face_chips);
+
+            for (auto& f: face_chips)
+            {
+                faceChips.push_back(ofImage(f));
+            }
+        }
     }
-
-    // Load the image intou our pixels.
-    image.setFromPixels(pix);
 }
 
 
@@ -74,6 +100,14 @@ void ofApp::draw()
 
     image.draw(0, 0);
 
+    // Draw the detections while the landmarks are still loading.
+    if (shapes.empty())
+    {
+        ofSetColor(ofColor::yellow);
+        for (auto& rect: dets)
+            ofDrawRectangle(ofxDlib::toOf(rect));
+    }
+
     for (auto& shape: shapes)
     {
         ofSetColor(ofColor::yellow);
@@ -109,3 +143,16 @@ void ofApp::draw()
     ofPopMatrix();
 }
 
+
+void ofApp::onModelLoaded(const ofxDlib::ModelLoadStats& stats)
+{
+    if (stats.failed)
+    {
+        ofLogError("ofApp::onModelLoaded") << "Unable to load " << stats.name << ": " << stats.error;
+        return;
+    }
+
+    ofLogNotice("ofApp::onModelLoaded") << stats.name << " loaded in "
+                                        << stats.loadTimeMs << " ms ("
+                                        << stats.residentMemoryDelta / 1024 << " KB resident).";
+}
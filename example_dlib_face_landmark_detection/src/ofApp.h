@@ -42,10 +42,22 @@ class ofApp: public ofBaseApp
 {
 public:
     void setup() override;
+    void update() override;
     void draw() override;
 
+    void onModelLoaded(const ofxDlib::ModelLoadStats& stats);
+
+    /// \brief Loads the detector and shape predictor in the background.
+    ofxDlib::ModelLoader loader;
+
+    /// \brief The image to search, scaled up to find small faces.
+    ofPixels pix;
+
     ofImage image;
 
+    bool detected = false;
+    std::vector<dlib::rectangle> dets;
+
     std::vector<dlib::full_object_detection> shapes;
 
     std::vector<ofImage> faceChips;
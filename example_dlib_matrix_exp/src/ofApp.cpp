@@ -145,6 +145,9 @@ void ofApp::setup()
     // will define three different matrix expressions and show their use.
     custom_matrix_expressions_example();
 
+    // ofxDlib defines expressions like these for openFrameworks data.
+    of_matrix_views_example();
+
     // The end.
     ofExit();
 }
@@ -205,3 +208,101 @@ void ofApp::custom_matrix_expressions_example()
 }
 
 
+void ofApp::of_matrix_views_example()
+{
+    // dlib/of_matrix.h wraps openFrameworks data in matrix expressions, like
+    // example_vector_to_matrix() above. They read the data in place, so dlib
+    // functions run on it without copying it into a dlib::matrix first.
+    //
+    //   dlib::mat_channel(pixels, channel)  height x width
+    //   dlib::mat_points(std::vector<glm::vec3>)  N x 3 (also vec2 and vec4)
+    //   dlib::mat_colors(std::vector<ofFloatColor>)  N x 4
+    //   dlib::mat_vertices(mesh), mat_normals(mesh), mat_tex_coords(mesh),
+    //   mat_colors(mesh)
+    //
+    // Here each one is timed against copying into a dlib::matrix first.
+    const std::size_t numPoints = 1000000;
+
+    ofMesh mesh;
+    mesh.getVertices().resize(numPoints);
+
+    for (auto& vertex: mesh.getVertices())
+        vertex = glm::vec3(ofRandomf(), ofRandomf(), ofRandomf() * 0.1);
+
+    const std::vector<glm::vec3>& points = mesh.getVertices();
+
+    // The centroid and scatter matrix of the points.
+    uint64_t start = ofGetElapsedTimeMicros();
+
+    dlib::matrix<float> copied(numPoints, 3);
+
+    for (std::size_t i = 0; i < numPoints; ++i)
+    {
+        copied(i, 0) = points[i].x;
+        copied(i, 1) = points[i].y;
+        copied(i, 2) = points[i].z;
+    }
+
+    dlib::matrix<float, 1, 3> copiedCentroid = dlib::sum_rows(copied) / float(numPoints);
+    dlib::matrix<float, 3, 3> copiedScatter = dlib::trans(copied) * copied;
+
+    uint64_t copyMicros = ofGetElapsedTimeMicros() - start;
+
+    start = ofGetElapsedTimeMicros();
+
+    dlib::matrix<float, 1, 3> centroid = dlib::sum_rows(dlib::mat_vertices(mesh)) / float(numPoints);
+    dlib::matrix<float, 3, 3> scatter = dlib::trans(dlib::mat_points(points)) * dlib::mat_points(points);
+
+    uint64_t viewMicros = ofGetElapsedTimeMicros() - start;
+
+    cout << "Centroid of " << numPoints << " points: " << centroid;
+    cout << "Scatter matrix:\n" << scatter;
+    cout << "Largest difference to the copy: "
+         << std::max(dlib::max(dlib::abs(centroid - copiedCentroid)),
+                     dlib::max(dlib::abs(scatter - copiedScatter))) << endl;
+    cout << "  copy then compute: " << copyMicros / 1000.0 << " ms" << endl;
+    cout << "  view:              " << viewMicros / 1000.0 << " ms" << endl;
+
+    // Per channel statistics of an image.
+    ofFloatPixels pixels;
+    pixels.allocate(1920, 1080, OF_PIXELS_RGB);
+
+    for (std::size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = ofRandomuf();
+
+    start = ofGetElapsedTimeMicros();
+
+    dlib::matrix<float> red(pixels.getHeight(), pixels.getWidth());
+    dlib::matrix<float> green(pixels.getHeight(), pixels.getWidth());
+
+    for (std::size_t y = 0; y < pixels.getHeight(); ++y)
+    {
+        for (std::size_t x = 0; x < pixels.getWidth(); ++x)
+        {
+            const std::size_t i = pixels.getPixelIndex(x, y);
+            red(y, x) = pixels[i];
+            green(y, x) = pixels[i + 1];
+        }
+    }
+
+    float copiedMean = dlib::mean(red);
+    float copiedDifference = dlib::max(dlib::abs(red - green));
+
+    copyMicros = ofGetElapsedTimeMicros() - start;
+
+    start = ofGetElapsedTimeMicros();
+
+    float mean = dlib::mean(dlib::mat_channel(pixels, 0));
+    float difference = dlib::max(dlib::abs(dlib::mat_channel(pixels, 0) - dlib::mat_channel(pixels, 1)));
+
+    viewMicros = ofGetElapsedTimeMicros() - start;
+
+    cout << "Red mean: " << mean << " (copy: " << copiedMean << ")" << endl;
+    cout << "Largest red - green difference: " << difference << " (copy: " << copiedDifference << ")" << endl;
+    cout << "  copy then compute: " << copyMicros / 1000.0 << " ms" << endl;
+    cout << "  view:              " << viewMicros / 1000.0 << " ms" << endl;
+
+    // Note that dlib only calls BLAS for products of dlib::matrix objects, so
+    // with BLAS a copy may still win for large products. Views win for
+    // element-wise work and reductions, which only read the data once.
+}
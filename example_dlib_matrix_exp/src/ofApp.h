@@ -33,4 +33,5 @@ public:
     void setup() override;
 
     void custom_matrix_expressions_example();
+    void of_matrix_views_example();
 };
@@ -15,38 +15,34 @@ void ofApp::setup()
     // Load the program data.
     loadData();
 
+    // Snapshot the convolution outputs after each prediction. The atlases
+    // are built on the activation tap's worker thread.
+    inference.reset(new ofxDlib::InferenceChannel<ofxDlib::LeNet5::TaggedNet>(net));
+    inference->setHook([&](ofxDlib::LeNet5::TaggedNet& _net) {
+        activationTap.capture<ofxDlib::LeNet5::tag_9_relu_3>("relu_3", _net);
+        activationTap.capture<ofxDlib::LeNet5::tag_6_relu_2>("relu_2", _net);
+        activationTap.submit();
+    });
+
     cout << "The pnet has " << net.num_layers << " layers in it." << endl;
     cout << net << endl;
 
     std::cout << "#layers: " << net.num_layers<< " #complayers: " << net.num_computational_layers << std::endl;
 
+    // Pack the filters of the first convolution into one atlas, one filter
+    // per row, with each filter mapped from its own range.
     auto& layer = dlib::layer<ofxDlib::LeNet5::tag_10_con_1, 1>(net);
-    auto& layer_details = layer.layer_details();
-    auto& layer_output = layer.get_output();
-    auto& layer_parameters = layer_details.get_layer_params();
 
-    auto filter_nr = layer_details.nr();
-    auto filter_nc = layer_details.nc();
-    auto filter_k = 1;
-    auto filter_ns = layer_details.num_filters();
+    ofxDlib::WeightAtlas::Settings atlasSettings;
+    atlasSettings.columns = 1;
+    weightAtlas = ofxDlib::WeightAtlas(atlasSettings);
+    weightAtlas.build(layer.layer_details());
 
-    for (std::size_t i = 0; i < filter_ns; ++i)
-    {
-        std::size_t offset = i * filter_k * filter_nr * filter_nc;
-        dlib::alias_tensor a(1, 1, filter_nr, filter_nc);
-//        dlib::matrix<float, 5, 5> m = dlib::mat(a(layer_params, offset));
-        dlib::matrix<float, 5, 5> m = dlib::mat(a(layer_parameters, offset));
-        std::cout << i << ": " << ofToString(std::vector<float>(m.begin(), m.end())) << std::endl;
-
-        auto mm = std::minmax(m.begin(), m.end());
-        std::cout << "---- " << *mm.first << "," << *mm.second << std::endl;
-        ofFloatPixels p = ofxDlib::toOf(m);
-        ofxDlib::map(p, *mm.first, *mm.second);
-
-        layer11Kernels.push_back(ofTexture());
-        layer11Kernels.back().loadData(p);
-        layer11Kernels.back().setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
-    }
+    for (auto& tile: weightAtlas.tiles())
+        std::cout << "filter " << tile.filter << ": " << tile.minValue << "," << tile.maxValue << std::endl;
+
+    weightAtlasTexture.loadData(weightAtlas.getPixels());
+    weightAtlasTexture.setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
     
     
     
@@ -93,41 +89,42 @@ void ofApp::update()
             drawingArea.begin();
             ofClear(0);
             drawingArea.end();
+            rasterizer.clear();
             needsClear = false;
         }
 
-        ofPixels pixels;
-        drawingArea.readToPixels(pixels);
-        pixels = ofxDlib::toGrayscale(pixels);
-        pixels.resize(MNIST_WIDTH, MNIST_HEIGHT);
-        auto dlib_img = ofxDlib::toDlib<unsigned char>(pixels);
-        dlib::matrix<unsigned char> dlib_mat = dlib::mat(dlib_img);
-
-        predictedLabel = net(dlib_mat);
-
-
-//        dlib::resizable_tensor p = dlib::layer<11>(net).layer_details().
-//
-//        dlib::alias_tensor_instance t = dlib::layer<1>(net).layer_details().get_weights();
-        dlib::resizable_tensor t = dlib::layer<1>(net).get_output();
-
-//        dlib::resizable_tensor t0 = dlib::layer<11>(net).layer_details().get_layer_params();
-
-//        std::cout << "lp: " << ofToString(std::vector<float>(t0.begin(), t0.end())) << std::endl;
-
-        lastLayer = std::vector<float>(t.begin(), t.end());
+        if (useRasterizer)
+        {
+            // The rasterizer input is already centered and 28x28.
+            inference->submit(rasterizer.input());
+        }
+        else
+        {
+            // Only the read back stays on the main thread. Downsampling and
+            // inference run on the channel's worker thread.
+            drawingArea.readToPixels(drawingPixels);
+            inference->submit(drawingPixels);
+        }
 
+        needsPrediction = false;
+    }
 
-        using namespace ofx::Dlib;
-        using namespace ofx::Dlib::LeNet5;
-  
-        
-//        layer11Convolutions = GetLayerOutputsAsTextures<tag_7_con_0, 14, 14>(net);
-        layer11Convolutions = layerOutputsToTextures<tag_9_relu_3, 28, 28>(net);
-//        layer11Convolutions = GetLayerOutputsAsTextures<tag_10_con_1, 28, 28>(net);
+    if (inference->update())
+    {
+        const auto& result = inference->getResult();
+        lastInput = result.input;
+        predictedLabel = result.label;
+        lastLayer = result.output;
+    }
 
-        
-        needsPrediction = false;
+    if (activationTap.update())
+    {
+        for (auto& name: activationTap.getNames())
+        {
+            ofTexture& texture = activationAtlases[name];
+            texture.loadData(activationTap.getAtlas(name));
+            texture.setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+        }
     }
 }
 
@@ -151,6 +148,12 @@ void ofApp::draw()
         ofFill();
         ofDrawCircle(x, y, brushRadius);
         drawingArea.end();
+
+        if (wasMousePressed)
+            rasterizer.lineTo({ x, y });
+        else
+            rasterizer.moveTo({ x, y });
+
         needsPrediction = true;
     }
     else if (drawingAreaDisplay.inside(ofGetMouseX(), ofGetMouseY()))
@@ -161,6 +164,8 @@ void ofApp::draw()
                      y + drawingAreaDisplay.y, brushRadius);
     }
 
+    wasMousePressed = ofGetMousePressed();
+
     ofSetColor(255);
     ofFill();
 
@@ -210,14 +215,12 @@ void ofApp::draw()
     {
     ofPushMatrix();
     ofTranslate(ofGetMouseX(), ofGetMouseY());
-    float yy = 0;
-    float v = 30;
-    for (auto& t: layer11Kernels)
-    {
-        ofSetColor(255);
-        t.draw(0, yy, v, v);
-        yy += (v * 1.1);
-    }
+    float scale = 6;
+    ofSetColor(255);
+    weightAtlasTexture.draw(0,
+                            0,
+                            weightAtlasTexture.getWidth() * scale,
+                            weightAtlasTexture.getHeight() * scale);
     
     ofPopMatrix();
     }
@@ -227,18 +230,23 @@ void ofApp::draw()
         ofPushMatrix();
         ofTranslate(ofGetMouseX() + 50, ofGetMouseY());
         float yy = 0;
-        float v = 56;
-        for (auto& t: layer11Convolutions)
+        float scale = 2;
+        for (auto& entry: activationAtlases)
         {
             ofSetColor(255);
-            t.draw(0, yy, v, v);
-            yy += (v * 1.1);
+            entry.second.draw(0, yy, entry.second.getWidth() * scale, entry.second.getHeight() * scale);
+            yy += entry.second.getHeight() * scale + 10;
         }
         
         ofPopMatrix();
     }
 
-    
+    if (mosaicTexture.isAllocated())
+    {
+        ofSetColor(255);
+        mosaicTexture.draw(drawingAreaDisplay.x,
+                           drawingAreaDisplay.getBottom() + 10);
+    }
 }
 
 
@@ -252,10 +260,37 @@ void ofApp::keyPressed(int key)
     else if (key == '-')
     {
         brushRadius = std::max(1.0f, brushRadius - 1.0f);
+        rasterizer.setRadius(brushRadius);
     }
     else if (key == '=')
     {
         brushRadius = std::min(50.0f, brushRadius + 1.0f);
+        rasterizer.setRadius(brushRadius);
+    }
+    else if (key == 'r')
+    {
+        useRasterizer = !useRasterizer;
+        needsPrediction = true;
+        std::cout << "Input: " << (useRasterizer ? "stroke rasterizer" : "drawing area read back") << std::endl;
+    }
+    else if (key == 'b')
+    {
+        buildMosaic();
+    }
+    else if (key == '[' || key == ']')
+    {
+        mosaicChannel += (key == ']' ? 1 : -1);
+        buildMosaic();
+    }
+    else if (key == 'p')
+    {
+        // Profile each layer on the current drawing.
+        if (lastInput.size() == 0)
+            lastInput = dlib::zeros_matrix<unsigned char>(MNIST_HEIGHT, MNIST_WIDTH);
+
+        ofxDlib::NetworkProfile profile = ofxDlib::NetworkProfiler::profile(net, lastInput, 100);
+        std::cout << profile.toString() << std::endl;
+        profile.saveChromeTrace("lenet_profile.json");
     }
 }
 
@@ -309,6 +344,11 @@ void ofApp::loadData()
     convertToTextures(training_images, training_labels, mnistTrainingData);
     convertToTextures(testing_images, testing_labels, mnistTestingData);
 
+    // Keep a batch of test digits for the activation mosaic.
+    const std::size_t maxMosaicImages = 256;
+    mosaicImages.assign(testing_images.begin(),
+                        testing_images.begin() + std::min(maxMosaicImages, testing_images.size()));
+
     // Try to load a brush.
     if (!ofLoadImage(brush, "brush.png"))
     {
@@ -334,6 +374,43 @@ void ofApp::loadData()
     ofClear(0);
     drawingArea.end();
 
+    // Rasterize strokes in drawing area coordinates.
+    ofxDlib::StrokeRasterizer::Settings rasterizerSettings;
+    rasterizerSettings.width = drawingArea.getWidth();
+    rasterizerSettings.height = drawingArea.getHeight();
+    rasterizerSettings.radius = brushRadius;
+    rasterizerSettings.size = MNIST_WIDTH;
+    rasterizer = ofxDlib::StrokeRasterizer(rasterizerSettings);
+
     // Make sure it's not empty to start.
     lastLayer.resize(10);
 }
+
+
+void ofApp::buildMosaic()
+{
+    // The network only runs the first time. Changing the channel just
+    // rebuilds the mosaic from the store.
+    if (activationStore.numSamples() == 0)
+    {
+        auto start = ofGetElapsedTimeMicros();
+        activationStore.capture(net, mosaicImages, { ofxDlib::LeNet5::relu_3 });
+        std::cout << "Captured " << activationStore.numSamples() << " samples in "
+                  << (ofGetElapsedTimeMicros() - start) / 1000.0 << " ms." << std::endl;
+    }
+
+    if (activationStore.numSamples() == 0)
+        return;
+
+    std::size_t layer = activationStore.indexOf(ofxDlib::LeNet5::relu_3);
+    std::size_t channels = activationStore.layer(layer).k;
+
+    // Wrap around in both directions.
+    mosaicChannel = (mosaicChannel + channels) % channels;
+
+    activationMosaic.buildChannel(activationStore, layer, mosaicChannel);
+    mosaicTexture.loadData(activationMosaic.getPixels());
+    mosaicTexture.setTextureMinMagFilter(GL_NEAREST, GL_NEAREST);
+
+    std::cout << "relu_3 channel " << mosaicChannel << " of " << channels << std::endl;
+}
@@ -23,6 +23,9 @@ public:
 
     void loadData();
 
+    /// \brief Tile one relu_3 channel across the stored test digits.
+    void buildMosaic();
+
     ofx::Dlib::LeNet5::TaggedNet net;
 
 
@@ -32,6 +35,7 @@ public:
     bool needsPrediction = false;
     bool needsClear = true;
 
+    dlib::matrix<unsigned char> lastInput;
     std::size_t predictedLabel = 0;
     std::vector<float> lastLayer;
     
@@ -40,8 +44,34 @@ public:
     std::map<unsigned long, std::vector<ofTexture>> mnistTrainingData;
     std::map<unsigned long, std::vector<ofTexture>> mnistTestingData;
 
-    std::vector<ofTexture> layer11Kernels;
-    std::vector<ofTexture> layer11Convolutions;
+    // The filters of the first convolution, packed into one texture.
+    ofxDlib::WeightAtlas weightAtlas;
+    ofTexture weightAtlasTexture;
+
+    // Tiles layer outputs into atlases on a worker thread.
+    ofxDlib::ActivationTap activationTap;
+    std::map<std::string, ofTexture> activationAtlases;
+
+    // Downsamples drawings and runs a copy of the net on a worker thread. It
+    // is declared after the activation tap because its hook uses the tap.
+    std::unique_ptr<ofxDlib::InferenceChannel<ofxDlib::LeNet5::TaggedNet>> inference;
+    ofPixels drawingPixels;
+
+    // Rasterizes the strokes straight into the 28x28 network input. The
+    // drawing area is then only used for display. Toggle with 'r'.
+    ofxDlib::StrokeRasterizer rasterizer;
+    bool useRasterizer = true;
+    bool wasMousePressed = false;
+
+    // The tagged layer outputs of a batch of test digits, captured with one
+    // pass per batch, and a mosaic of one channel across all of them. Build
+    // it with 'b' and change the channel with '[' and ']'.
+    std::vector<dlib::matrix<unsigned char>> mosaicImages;
+    ofxDlib::ActivationStore activationStore;
+    ofxDlib::ActivationMosaic activationMosaic;
+    ofTexture mosaicTexture;
+    std::size_t mosaicChannel = 0;
+
     std::vector<ofTexture> layer11ManualConvolutions;
 
 
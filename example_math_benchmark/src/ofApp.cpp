@@ -0,0 +1,31 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofApp.h"
+
+
+void ofApp::setup()
+{
+    // Time matrix products, decompositions and inverses from 8 x 8 up to
+    // 4096 x 4096. Sizes that would take longer than maxSeconds per run are
+    // skipped, so slow builds still finish in a few minutes.
+    ofxDlib::LinearAlgebraBenchmark::Settings settings;
+    settings.maxSeconds = 5;
+
+    std::cout << "Running with " << ofxDlib::LinearAlgebraBenchmark::configuration() << std::endl;
+
+    ofxDlib::LinearAlgebraReport report = ofxDlib::LinearAlgebraBenchmark::run(settings);
+
+    // The table ends with notes on whether linking BLAS or LAPACK (see
+    // addon_config.mk) or using ofxDlib::blockedMultiply() would help.
+    std::cout << report.toString() << std::endl;
+
+    // Save the numbers to compare builds and machines.
+    report.saveCSV("linear_algebra.csv");
+
+    ofExit();
+}
@@ -0,0 +1,20 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include "ofMain.h"
+#include "ofxDlib.h"
+
+
+class ofApp: public ofBaseApp
+{
+public:
+    void setup() override;
+
+};
@@ -40,6 +40,102 @@ void ofApp::setup()
 
     // The reconstructed A matrix may not be exact due to rounding and numerical
     // errors, especially if using dlib::svd_fast(...).
-    
+
+    // Many small decompositions, e.g. one per detected pose, are faster in a
+    // batch with fixed-size matrices.
+    const std::size_t numMatrices = 100000;
+
+    std::vector<dlib::matrix<double, 3, 3>> batch(numMatrices);
+
+    for (auto& m: batch)
+        m = dlib::randm(3, 3);
+
+    std::vector<dlib::matrix<double, 3, 3>> batchU, batchV;
+    std::vector<dlib::matrix<double, 3, 1>> batchW;
+
+    uint64_t start = ofGetElapsedTimeMicros();
+
+    for (auto& m: batch)
+        dlib::svd3(m, U, Σ, V);
+
+    uint64_t dlibMicros = ofGetElapsedTimeMicros() - start;
+
+    // dlib::svd3 runs on one thread, so compare it with one thread first.
+    // Singular values are sorted in descending order.
+    start = ofGetElapsedTimeMicros();
+    ofxDlib::BatchedJacobi<3>::svd(batch, batchU, batchW, batchV, 1);
+    uint64_t batchedMicros = ofGetElapsedTimeMicros() - start;
+
+    // By default the batch is split across one thread per core.
+    start = ofGetElapsedTimeMicros();
+    ofxDlib::BatchedJacobi<3>::svd(batch, batchU, batchW, batchV);
+    uint64_t threadedMicros = ofGetElapsedTimeMicros() - start;
+
+    std::cout << numMatrices << " 3x3 SVDs:" << std::endl;
+    std::cout << "  dlib::svd3 (1 thread):                      " << dlibMicros / 1000.0 << " ms" << std::endl;
+    std::cout << "  ofxDlib::BatchedJacobi<3>::svd (1 thread):  " << batchedMicros / 1000.0 << " ms" << std::endl;
+    std::cout << "  ofxDlib::BatchedJacobi<3>::svd (all cores): " << threadedMicros / 1000.0 << " ms" << std::endl;
+
+    dlib::matrix<double> batchReconstructed = batchU[0] * dlib::diagm(batchW[0]) * dlib::trans(batchV[0]);
+    std::cout << "Batch reconstruction error = " << dlib::max(dlib::abs(batchReconstructed - batch[0])) << std::endl;
+
+    // PCA of a tall matrix only needs its first few components. The
+    // randomized SVD finds them in a few passes over chunks of rows, so the
+    // same code works on a FileRowReader over data larger than memory.
+    const long numSamples = 5000;
+    const long numFeatures = 32;
+    const long numComponents = 4;
+
+    dlib::matrix<double> scales(numComponents, 1);
+    scales = 8, 4, 2, 1;
+
+    dlib::matrix<double> data = dlib::randm(numSamples, numComponents)
+                              * dlib::diagm(scales)
+                              * dlib::randm(numComponents, numFeatures)
+                              + 0.01 * dlib::randm(numSamples, numFeatures);
+
+    ofxDlib::RandomizedSVD::Settings pcaSettings;
+    pcaSettings.rank = numComponents;
+    pcaSettings.center = true;
+    pcaSettings.chunkRows = 1000;
+
+    ofxDlib::RandomizedSVD pca(pcaSettings);
+
+    start = ofGetElapsedTimeMicros();
+
+    pca.compute(data);
+
+    uint64_t pcaMicros = ofGetElapsedTimeMicros() - start;
+
+    // The same components from a full SVD of the centered data. dlib::svd()
+    // doesn't sort the singular values, so sort them and the axes first.
+    dlib::matrix<double, 1, 0> mean = dlib::sum_rows(data) / double(numSamples);
+    dlib::matrix<double> centered = data - dlib::ones_matrix<double>(numSamples, 1) * mean;
+
+    start = ofGetElapsedTimeMicros();
+
+    dlib::svd(centered, U, Σ, V);
+
+    uint64_t fullMicros = ofGetElapsedTimeMicros() - start;
+
+    dlib::matrix<double, 0, 1> fullValues = dlib::diag(Σ);
+    dlib::rsort_columns(V, fullValues);
+
+    // Both errors should be close to 0. The axes are only defined up to sign.
+    double valueError = 0;
+    double axisError = 0;
+
+    for (long k = 0; k < numComponents; ++k)
+    {
+        valueError = std::max(valueError, std::abs(pca.singularValues()(k) - fullValues(k)) / fullValues(k));
+        axisError = std::max(axisError, 1 - std::abs(dlib::dot(dlib::colm(pca.v(), k), dlib::colm(V, k))));
+    }
+
+    std::cout << "PCA of " << numSamples << "x" << numFeatures << ", " << numComponents << " components:" << std::endl;
+    std::cout << "  dlib::svd:              " << fullMicros / 1000.0 << " ms" << std::endl;
+    std::cout << "  ofxDlib::RandomizedSVD: " << pcaMicros / 1000.0 << " ms" << std::endl;
+    std::cout << "  Singular value error = " << valueError << std::endl;
+    std::cout << "  Axis error = " << axisError << std::endl;
+
     ofExit();
 }
@@ -0,0 +1,312 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <dlib/dnn.h>
+
+
+/// \sa http://dlib.net/dlib/dnn/layers_abstract.h.html
+namespace dlib
+{
+
+
+/// \brief The activation applied in the epilogue of a con_fused_ layer.
+enum fused_activation
+{
+    FUSED_NONE = 0,
+    FUSED_RELU = 1
+};
+
+
+/// \brief An inference-only convolution with a folded affine transform and
+/// an optional fused relu.
+///
+/// This layer computes relu(conv(x) * gamma + beta) as a single convolution
+/// with the scale folded into the filters and the shift folded into the
+/// biases. The bias and the activation are applied in one pass over the
+/// output, replacing the separate bias, affine and relu passes of the
+/// unfused con<affine<relu<...>>> sequence.
+///
+/// Parameters are not learned. They are assigned from a trained network with
+/// ofx::Dlib::fuseLayers(), so backward() is not supported.
+template <long _num_filters,
+          long _nr,
+          long _nc,
+          int _stride_y,
+          int _stride_x,
+          fused_activation _activation,
+          int _padding_y = _stride_y != 1 ? 0 : _nr / 2,
+          int _padding_x = _stride_x != 1 ? 0 : _nc / 2>
+class con_fused_
+{
+public:
+    static_assert(_num_filters > 0, "The number of filters must be > 0");
+    static_assert(_nr >= 0, "The number of rows in a filter must be >= 0");
+    static_assert(_nc >= 0, "The number of columns in a filter must be >= 0");
+    static_assert(_stride_y > 0, "The filter stride must be > 0");
+    static_assert(_stride_x > 0, "The filter stride must be > 0");
+    static_assert(0 <= _padding_y && ((_nr == 0 && _padding_y == 0) || (_nr != 0 && _padding_y < _nr)),
+        "The padding must be smaller than the filter size.");
+    static_assert(0 <= _padding_x && ((_nc == 0 && _padding_x == 0) || (_nc != 0 && _padding_x < _nc)),
+        "The padding must be smaller than the filter size.");
+
+    con_fused_():
+        num_filters_(_num_filters),
+        padding_y_(_padding_y),
+        padding_x_(_padding_x)
+    {
+    }
+
+    con_fused_(const con_fused_& item):
+        params(item.params),
+        filters(item.filters),
+        biases(item.biases),
+        num_filters_(item.num_filters_),
+        padding_y_(item.padding_y_),
+        padding_x_(item.padding_x_)
+    {
+        // The tensor_conv object is stateless and not copyable.
+    }
+
+    con_fused_& operator = (const con_fused_& item)
+    {
+        if (this == &item)
+            return *this;
+
+        params = item.params;
+        filters = item.filters;
+        biases = item.biases;
+        num_filters_ = item.num_filters_;
+        padding_y_ = item.padding_y_;
+        padding_x_ = item.padding_x_;
+        return *this;
+    }
+
+    long num_filters() const { return num_filters_; }
+    long nr() const { return _nr; }
+    long nc() const { return _nc; }
+    long stride_y() const { return _stride_y; }
+    long stride_x() const { return _stride_x; }
+    long padding_y() const { return padding_y_; }
+    long padding_x() const { return padding_x_; }
+    fused_activation activation() const { return _activation; }
+
+    void set_num_filters(long num)
+    {
+        DLIB_CASSERT(num > 0);
+        DLIB_CASSERT(get_layer_params().size() == 0,
+            "You can't change the number of filters in con_fused_ if the parameter tensor has already been allocated.");
+        num_filters_ = num;
+    }
+
+    /// \brief Assign the fused filters and biases.
+    /// \param k The number of input channels.
+    /// \param new_filters num_filters() * k * nr() * nc() filter weights.
+    /// \param new_biases num_filters() biases.
+    void set_fused_parameters(long k, const float* new_filters, const float* new_biases)
+    {
+        filters = alias_tensor(num_filters_, k, _nr, _nc);
+        biases = alias_tensor(1, num_filters_);
+        params.set_size(filters.size() + biases.size());
+
+        float* data = params.host();
+        std::copy(new_filters, new_filters + filters.size(), data);
+        std::copy(new_biases, new_biases + biases.size(), data + filters.size());
+    }
+
+    template <typename SUBNET>
+    void setup(const SUBNET& sub)
+    {
+        const long k = sub.get_output().k();
+
+        filters = alias_tensor(num_filters_, k, _nr, _nc);
+        biases = alias_tensor(1, num_filters_);
+
+        // Keep parameters that were assigned before the first forward pass.
+        if (params.size() != filters.size() + biases.size())
+        {
+            params.set_size(filters.size() + biases.size());
+            params = 0;
+        }
+    }
+
+    template <typename SUBNET>
+    void forward(const SUBNET& sub, resizable_tensor& output)
+    {
+        conv.setup(sub.get_output(),
+                   filters(params, 0),
+                   _stride_y,
+                   _stride_x,
+                   padding_y_,
+                   padding_x_);
+
+        conv(false, output, sub.get_output(), filters(params, 0));
+
+#if defined(DLIB_USE_CUDA)
+        tt::add(1, output, 1, biases(params, filters.size()));
+
+        if (_activation == FUSED_RELU)
+            tt::relu(output, output);
+#else
+        // Apply the bias and the activation in a single pass.
+        float* out = output.host();
+        const float* b = params.host() + filters.size();
+        const long plane_size = output.nr() * output.nc();
+
+        for (long n = 0; n < output.num_samples(); ++n)
+        {
+            for (long k = 0; k < output.k(); ++k)
+            {
+                const float bias = b[k];
+
+                if (_activation == FUSED_RELU)
+                {
+                    for (long i = 0; i < plane_size; ++i)
+                        out[i] = std::max(0.0f, out[i] + bias);
+                }
+                else
+                {
+                    for (long i = 0; i < plane_size; ++i)
+                        out[i] += bias;
+                }
+
+                out += plane_size;
+            }
+        }
+#endif
+    }
+
+    template <typename SUBNET>
+    void backward(const tensor&, SUBNET&, tensor&)
+    {
+        throw dlib::error("con_fused_ is an inference-only layer and can't be trained.");
+    }
+
+    dpoint map_input_to_output(dpoint p) const
+    {
+        p.x() = (p.x() + padding_x() - nc() / 2) / stride_x();
+        p.y() = (p.y() + padding_y() - nr() / 2) / stride_y();
+        return p;
+    }
+
+    dpoint map_output_to_input(dpoint p) const
+    {
+        p.x() = p.x() * stride_x() - padding_x() + nc() / 2;
+        p.y() = p.y() * stride_y() - padding_y() + nr() / 2;
+        return p;
+    }
+
+    const tensor& get_layer_params() const { return params; }
+    tensor& get_layer_params() { return params; }
+
+    friend void serialize(const con_fused_& item, std::ostream& out)
+    {
+        serialize("con_fused_", out);
+        serialize(item.params, out);
+        serialize(item.num_filters_, out);
+        serialize(_nr, out);
+        serialize(_nc, out);
+        serialize(_stride_y, out);
+        serialize(_stride_x, out);
+        serialize(item.padding_y_, out);
+        serialize(item.padding_x_, out);
+        serialize(int(_activation), out);
+        serialize(item.filters, out);
+        serialize(item.biases, out);
+    }
+
+    friend void deserialize(con_fused_& item, std::istream& in)
+    {
+        std::string version;
+        deserialize(version, in);
+
+        if (version != "con_fused_")
+            throw serialization_error("Unexpected version '" + version + "' found while deserializing dlib::con_fused_.");
+
+        long nr;
+        long nc;
+        int stride_y;
+        int stride_x;
+        int activation;
+
+        deserialize(item.params, in);
+        deserialize(item.num_filters_, in);
+        deserialize(nr, in);
+        deserialize(nc, in);
+        deserialize(stride_y, in);
+        deserialize(stride_x, in);
+        deserialize(item.padding_y_, in);
+        deserialize(item.padding_x_, in);
+        deserialize(activation, in);
+        deserialize(item.filters, in);
+        deserialize(item.biases, in);
+
+        if (nr != _nr) throw serialization_error("Wrong nr found while deserializing dlib::con_fused_");
+        if (nc != _nc) throw serialization_error("Wrong nc found while deserializing dlib::con_fused_");
+        if (stride_y != _stride_y) throw serialization_error("Wrong stride_y found while deserializing dlib::con_fused_");
+        if (stride_x != _stride_x) throw serialization_error("Wrong stride_x found while deserializing dlib::con_fused_");
+        if (activation != int(_activation)) throw serialization_error("Wrong activation found while deserializing dlib::con_fused_");
+    }
+
+    friend std::ostream& operator<<(std::ostream& out, const con_fused_& item)
+    {
+        out << "con_fused\t ("
+            << "num_filters=" << item.num_filters_
+            << ", nr=" << _nr
+            << ", nc=" << _nc
+            << ", stride_y=" << _stride_y
+            << ", stride_x=" << _stride_x
+            << ", padding_y=" << item.padding_y_
+            << ", padding_x=" << item.padding_x_
+            << ", activation=" << (_activation == FUSED_RELU ? "relu" : "none")
+            << ")";
+        return out;
+    }
+
+    friend void to_xml(const con_fused_& item, std::ostream& out)
+    {
+        out << "<con_fused"
+            << " num_filters='" << item.num_filters_ << "'"
+            << " nr='" << _nr << "'"
+            << " nc='" << _nc << "'"
+            << " stride_y='" << _stride_y << "'"
+            << " stride_x='" << _stride_x << "'"
+            << " padding_y='" << item.padding_y_ << "'"
+            << " padding_x='" << item.padding_x_ << "'"
+            << " activation='" << (_activation == FUSED_RELU ? "relu" : "none") << "'"
+            << ">\n";
+        out << mat(item.params);
+        out << "</con_fused>";
+    }
+
+private:
+    resizable_tensor params;
+    alias_tensor filters;
+    alias_tensor biases;
+
+    tt::tensor_conv conv;
+    long num_filters_;
+    int padding_y_;
+    int padding_x_;
+
+};
+
+
+/// \brief A convolution with a folded affine transform, i.e. affine<con<...>>.
+template <long num_filters, long nr, long nc, int stride_y, int stride_x, typename SUBNET>
+using con_affine = add_layer<con_fused_<num_filters, nr, nc, stride_y, stride_x, FUSED_NONE>, SUBNET>;
+
+
+/// \brief A convolution with a folded affine transform and a fused relu,
+/// i.e. relu<affine<con<...>>>.
+template <long num_filters, long nr, long nc, int stride_y, int stride_x, typename SUBNET>
+using con_affine_relu = add_layer<con_fused_<num_filters, nr, nc, stride_y, stride_x, FUSED_RELU>, SUBNET>;
+
+
+} // namespace dlib
@@ -0,0 +1,184 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <vector>
+#include "ofColor.h"
+#include "ofMesh.h"
+#include "ofPixels.h"
+#include "of_matrix_abstract.h"
+#include <dlib/algs.h>
+#include <dlib/matrix.h>
+
+
+namespace dlib
+{
+
+/// \brief A matrix expression over strided memory owned by openFrameworks.
+///
+/// Element (r, c) is data[r * row_stride + c * column_stride]. Nothing is
+/// copied, so the memory must outlive the expression and any expression built
+/// from it. Like all dlib expressions, don't store it with auto.
+///
+/// \tparam T The element type.
+/// \tparam NC_ The compile time number of columns, or 0 if only known at run
+///         time.
+template <typename T, long NC_ = 0>
+struct op_of_strided
+{
+    op_of_strided(const T* data_,
+                  long rows_,
+                  long columns_,
+                  long row_stride_,
+                  long column_stride_):
+        data(data_),
+        rows(rows_),
+        columns(columns_),
+        row_stride(row_stride_),
+        column_stride(column_stride_)
+    {
+    }
+
+    const T* data;
+    long rows;
+    long columns;
+    long row_stride;
+    long column_stride;
+
+    // Elements are read directly from memory.
+    const static long cost = 1;
+    const static long NR = 0;
+    const static long NC = NC_;
+    typedef T type;
+    typedef const T& const_ret_type;
+    typedef default_memory_manager mem_manager_type;
+    typedef row_major_layout layout_type;
+
+    const_ret_type apply(long r, long c) const
+    {
+        return data[r * row_stride + c * column_stride];
+    }
+
+    long nr() const
+    {
+        return rows;
+    }
+
+    long nc() const
+    {
+        return columns;
+    }
+
+    // The memory isn't owned by a dlib matrix, so it can't be assigned to by
+    // the expression it is part of.
+    template <typename U> bool aliases(const matrix_exp<U>&) const { return false; }
+    template <typename U> bool destructively_aliases(const matrix_exp<U>&) const { return false; }
+};
+
+// ----------------------------------------------------------------------------------------
+
+/// \brief View one channel of interleaved pixels as a matrix.
+/// \param pixels The pixels.
+/// \param channel The channel index, e.g. 0 for red.
+/// \returns a height x width expression of the channel values.
+template <typename T>
+const matrix_op<op_of_strided<T>> mat_channel(const ofPixels_<T>& pixels, std::size_t channel)
+{
+    // make sure requires clause is not broken
+    DLIB_ASSERT(channel < pixels.getNumChannels(),
+        "\tmat_channel(pixels, channel)"
+        << "\n\t you have asked for an out of bounds channel "
+        << "\n\t channel:  " << channel
+        << "\n\t pixels.getNumChannels(): " << pixels.getNumChannels()
+        );
+
+    typedef op_of_strided<T> op;
+
+    const long channels = long(pixels.getNumChannels());
+    const long width = long(pixels.getWidth());
+
+    return matrix_op<op>(op(pixels.getData() + channel,
+                            long(pixels.getHeight()),
+                            width,
+                            width * channels,
+                            channels));
+}
+
+// ----------------------------------------------------------------------------------------
+
+/// \brief View points as an N x 2 matrix with one point per row.
+template <typename T>
+const matrix_op<op_of_strided<T, 2>> mat_points(const std::vector<glm::tvec2<T>>& points)
+{
+    static_assert(sizeof(glm::tvec2<T>) == 2 * sizeof(T), "glm::tvec2 must be tightly packed.");
+    typedef op_of_strided<T, 2> op;
+    return matrix_op<op>(op(reinterpret_cast<const T*>(points.data()), long(points.size()), 2, 2, 1));
+}
+
+
+/// \brief View points as an N x 3 matrix with one point per row.
+template <typename T>
+const matrix_op<op_of_strided<T, 3>> mat_points(const std::vector<glm::tvec3<T>>& points)
+{
+    static_assert(sizeof(glm::tvec3<T>) == 3 * sizeof(T), "glm::tvec3 must be tightly packed.");
+    typedef op_of_strided<T, 3> op;
+    return matrix_op<op>(op(reinterpret_cast<const T*>(points.data()), long(points.size()), 3, 3, 1));
+}
+
+
+/// \brief View points as an N x 4 matrix with one point per row.
+template <typename T>
+const matrix_op<op_of_strided<T, 4>> mat_points(const std::vector<glm::tvec4<T>>& points)
+{
+    static_assert(sizeof(glm::tvec4<T>) == 4 * sizeof(T), "glm::tvec4 must be tightly packed.");
+    typedef op_of_strided<T, 4> op;
+    return matrix_op<op>(op(reinterpret_cast<const T*>(points.data()), long(points.size()), 4, 4, 1));
+}
+
+
+/// \brief View colors as an N x 4 matrix with r, g, b and a columns.
+template <typename T>
+const matrix_op<op_of_strided<T, 4>> mat_colors(const std::vector<ofColor_<T>>& colors)
+{
+    static_assert(sizeof(ofColor_<T>) == 4 * sizeof(T), "ofColor_ must be tightly packed.");
+    typedef op_of_strided<T, 4> op;
+    return matrix_op<op>(op(reinterpret_cast<const T*>(colors.data()), long(colors.size()), 4, 4, 1));
+}
+
+// ----------------------------------------------------------------------------------------
+
+/// \brief View the vertices of a mesh as an N x 3 matrix.
+inline const matrix_op<op_of_strided<float, 3>> mat_vertices(const ofMesh& mesh)
+{
+    return mat_points(mesh.getVertices());
+}
+
+
+/// \brief View the normals of a mesh as an N x 3 matrix.
+inline const matrix_op<op_of_strided<float, 3>> mat_normals(const ofMesh& mesh)
+{
+    return mat_points(mesh.getNormals());
+}
+
+
+/// \brief View the texture coordinates of a mesh as an N x 2 matrix.
+inline const matrix_op<op_of_strided<float, 2>> mat_tex_coords(const ofMesh& mesh)
+{
+    return mat_points(mesh.getTexCoords());
+}
+
+
+/// \brief View the colors of a mesh as an N x 4 matrix.
+inline const matrix_op<op_of_strided<float, 4>> mat_colors(const ofMesh& mesh)
+{
+    return mat_colors(mesh.getColors());
+}
+
+
+} // namespace dlib
@@ -0,0 +1,43 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#undef DLIB_OF_MATRIX_AbSTRACT_H_
+#ifdef DLIB_OF_MATRIX_AbSTRACT_H_
+
+
+#include "ofColor.h"
+#include "ofMesh.h"
+#include "ofPixels.h"
+#include <dlib/matrix.h>
+
+
+/// \sa http://dlib.net/dlib/matrix/matrix_mat_abstract.h.html
+namespace dlib
+{
+
+template <typename T>
+const matrix_exp<T> mat_channel(const ofPixels_<T>& pixels, std::size_t channel);
+
+template <typename T>
+const matrix_exp<T> mat_points(const std::vector<glm::tvec2<T>>& points);
+template <typename T>
+const matrix_exp<T> mat_points(const std::vector<glm::tvec3<T>>& points);
+template <typename T>
+const matrix_exp<T> mat_points(const std::vector<glm::tvec4<T>>& points);
+
+template <typename T>
+const matrix_exp<T> mat_colors(const std::vector<ofColor_<T>>& colors);
+
+const matrix_exp<float> mat_vertices(const ofMesh& mesh);
+const matrix_exp<float> mat_normals(const ofMesh& mesh);
+const matrix_exp<float> mat_tex_coords(const ofMesh& mesh);
+const matrix_exp<float> mat_colors(const ofMesh& mesh);
+
+} // namespace dlib
+
+
+#endif // DLIB_OF_MATRIX_AbSTRACT_H_
@@ -0,0 +1,436 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "dlib/image_processing/full_object_detection.h"
+#include "dlib/image_transforms/assign_image.h"
+#include "dlib/matrix.h"
+#include "dlib/pixel.h"
+#include "dlib/rand.h"
+#include "ofPixels.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief A read-only, memory-mapped dataset of 8-bit images and labels.
+///
+/// A packed dataset is a single file that holds a fixed 64 byte header, the
+/// pixel data of every record and an index at the end of the file. Each
+/// record's pixels are stored row-major with interleaved channels and start on
+/// a 64 byte boundary, so equally sized images (e.g. MNIST) have a fixed
+/// stride. Records may carry a class label and object boxes.
+///
+/// Opening a dataset only maps the file and validates the index. Pixels are
+/// paged in by the operating system when they are first read, so training can
+/// start immediately and several processes training on the same file share
+/// its pages.
+///
+/// Reading is thread-safe, so one dataset can be sampled from all workers of a
+/// BatchPipeline.
+///
+///     PackedDataset::convertMnist("mnist/", "mnist_train.dat", "mnist_test.dat");
+///
+///     PackedDataset dataset;
+///     dataset.open("mnist_train.dat");
+///     dataset.sample(rnd, 128, images, labels);
+///
+/// The file uses the byte order of the machine that wrote it. All supported
+/// platforms are little endian.
+class PackedDataset
+{
+public:
+    /// \brief The file identifier.
+    static const char MAGIC[8];
+
+    /// \brief The file format version.
+    static const uint32_t VERSION;
+
+    /// \brief The byte alignment of the record pixel data.
+    static const uint64_t ALIGNMENT;
+
+    /// \brief The file header.
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        /// \brief 1 for grayscale, 3 for RGB.
+        uint32_t channels;
+        uint64_t numRecords;
+        /// \brief The file offset of the record index.
+        uint64_t indexOffset;
+        uint64_t numBoxes;
+        /// \brief The file offset of the box table.
+        uint64_t boxesOffset;
+        /// \brief The file offset of the box label table.
+        uint64_t labelsOffset;
+        /// \brief The size of the box label table in bytes.
+        uint64_t labelsSize;
+    };
+
+    /// \brief An entry of the record index.
+    struct Record
+    {
+        /// \brief The file offset of the pixel data.
+        uint64_t offset;
+        uint32_t nr;
+        uint32_t nc;
+        uint32_t label;
+        uint32_t numBoxes;
+        /// \brief The index of the first box in the box table.
+        uint64_t firstBox;
+    };
+
+    /// \brief An entry of the box table.
+    struct Box
+    {
+        int32_t left;
+        int32_t top;
+        int32_t right;
+        int32_t bottom;
+        uint32_t ignore;
+        /// \brief The index of the box label in the label table.
+        uint32_t label;
+    };
+
+    PackedDataset();
+
+    /// \brief Open a dataset.
+    /// \param path The path of the dataset file.
+    /// \throws std::runtime_error if the file can't be opened.
+    PackedDataset(const std::string& path);
+
+    /// \brief Unmap the dataset.
+    ~PackedDataset();
+
+    PackedDataset(const PackedDataset&) = delete;
+    PackedDataset& operator = (const PackedDataset&) = delete;
+
+    /// \brief Map a dataset file.
+    /// \param path The path of the dataset file.
+    /// \returns true if the file was mapped and its index is valid.
+    bool open(const std::string& path);
+
+    /// \brief Unmap the dataset file.
+    void close();
+
+    /// \returns true if a dataset is mapped.
+    bool isOpen() const
+    {
+        return _data != nullptr;
+    }
+
+    /// \returns the number of records.
+    std::size_t size() const
+    {
+        return _header ? std::size_t(_header->numRecords) : 0;
+    }
+
+    /// \returns 1 for grayscale or 3 for RGB records.
+    std::size_t channels() const
+    {
+        return _header ? _header->channels : 0;
+    }
+
+    /// \returns the height of a record.
+    long nr(std::size_t i) const
+    {
+        return _records[i].nr;
+    }
+
+    /// \returns the width of a record.
+    long nc(std::size_t i) const
+    {
+        return _records[i].nc;
+    }
+
+    /// \returns the class label of a record.
+    unsigned long label(std::size_t i) const
+    {
+        return _records[i].label;
+    }
+
+    /// \returns the mapped pixel data of a record.
+    const unsigned char* data(std::size_t i) const
+    {
+        return _data + _records[i].offset;
+    }
+
+    /// \brief Get a view of the pixels of a record.
+    ///
+    /// The pixels point directly into the mapped file and are only valid
+    /// while the dataset is open. They must not be modified. Copy the result
+    /// to keep or modify it.
+    ///
+    /// \param i The record index.
+    /// \returns a view of the record pixels.
+    ofPixels pixels(std::size_t i) const;
+
+    /// \brief Get the object boxes of a record.
+    /// \param i The record index.
+    /// \returns the boxes.
+    std::vector<dlib::mmod_rect> boxes(std::size_t i) const;
+
+    /// \returns the box labels.
+    const std::vector<std::string>& boxLabels() const
+    {
+        return _boxLabels;
+    }
+
+    /// \brief Copy a record into an image.
+    ///
+    /// Records are copied row by row if the pixel type matches the stored
+    /// channels, otherwise each pixel is converted with dlib::assign_pixel.
+    ///
+    /// \param i The record index.
+    /// \param image The image to fill. It is resized to the record size.
+    template <typename pixel_type>
+    void load(std::size_t i, dlib::matrix<pixel_type>& image) const;
+
+    /// \brief Copy random records and their class labels.
+    /// \param rnd The random number generator.
+    /// \param n The number of records to copy.
+    /// \param images The images to fill. Existing images are reused.
+    /// \param labels The labels to fill.
+    template <typename pixel_type>
+    void sample(dlib::rand& rnd,
+                std::size_t n,
+                std::vector<dlib::matrix<pixel_type>>& images,
+                std::vector<unsigned long>& labels) const;
+
+    /// \brief Copy random records and their object boxes.
+    /// \param rnd The random number generator.
+    /// \param n The number of records to copy.
+    /// \param images The images to fill. Existing images are reused.
+    /// \param boxes The boxes to fill.
+    template <typename pixel_type>
+    void sample(dlib::rand& rnd,
+                std::size_t n,
+                std::vector<dlib::matrix<pixel_type>>& images,
+                std::vector<std::vector<dlib::mmod_rect>>& boxes) const;
+
+    /// \brief Convert the MNIST IDX files to packed datasets.
+    ///
+    /// The folder must hold the four files read by dlib::load_mnist_dataset.
+    /// Images are streamed from the IDX files and never held in memory.
+    ///
+    /// \param folder The folder with the MNIST files.
+    /// \param trainingPath The path of the packed training set.
+    /// \param testingPath The path of the packed testing set.
+    /// \returns true on success.
+    static bool convertMnist(const std::string& folder,
+                             const std::string& trainingPath,
+                             const std::string& testingPath);
+
+    /// \brief Convert a dlib XML image dataset to a packed dataset.
+    ///
+    /// Images are loaded one at a time and stored as RGB. Box labels are
+    /// kept, images without boxes are stored with no boxes.
+    ///
+    /// \param xmlPath The path of the dataset XML file.
+    /// \param outputPath The path of the packed dataset.
+    /// \returns true on success.
+    static bool convertImageDataset(const std::string& xmlPath,
+                                    const std::string& outputPath);
+
+private:
+    const unsigned char* _data = nullptr;
+    uint64_t _size = 0;
+
+    const Header* _header = nullptr;
+    const Record* _records = nullptr;
+    const Box* _boxes = nullptr;
+
+    std::vector<std::string> _boxLabels;
+
+#if defined(TARGET_WIN32)
+    void* _file = nullptr;
+    void* _mapping = nullptr;
+#endif
+
+};
+
+
+/// \brief Writes a PackedDataset file one record at a time.
+///
+/// Records are written as they are added and the index is kept in memory
+/// until close(), so converting a dataset never needs more than one image in
+/// memory.
+class PackedDatasetWriter
+{
+public:
+    /// \brief Create a dataset file.
+    /// \param path The path of the dataset file.
+    /// \param channels 1 for grayscale or 3 for RGB records.
+    /// \throws std::invalid_argument if channels is not 1 or 3.
+    PackedDatasetWriter(const std::string& path, std::size_t channels);
+
+    /// \brief Close the file if close() wasn't called.
+    ///
+    /// If a write failed or abort() was called, the partial file is deleted
+    /// instead, so it can't be mistaken for a complete dataset.
+    ~PackedDatasetWriter();
+
+    PackedDatasetWriter(const PackedDatasetWriter&) = delete;
+    PackedDatasetWriter& operator = (const PackedDatasetWriter&) = delete;
+
+    /// \returns true if the file is writable.
+    bool isOpen() const;
+
+    /// \brief Add a record.
+    /// \param pixels The row-major pixels with interleaved channels.
+    /// \param nr The image height.
+    /// \param nc The image width.
+    /// \param label The class label.
+    /// \param boxes The object boxes.
+    void add(const unsigned char* pixels,
+             long nr,
+             long nc,
+             unsigned long label,
+             const std::vector<dlib::mmod_rect>& boxes = {});
+
+    /// \brief Add a record from a dlib image.
+    /// \param image An image of unsigned char or dlib::rgb_pixel.
+    /// \param label The class label.
+    /// \param boxes The object boxes.
+    template <typename pixel_type>
+    void add(const dlib::matrix<pixel_type>& image,
+             unsigned long label,
+             const std::vector<dlib::mmod_rect>& boxes = {})
+    {
+        static_assert(std::is_same<pixel_type, unsigned char>::value
+                   || std::is_same<pixel_type, dlib::rgb_pixel>::value,
+                      "PackedDatasetWriter: only unsigned char and rgb_pixel images can be added.");
+
+        add(reinterpret_cast<const unsigned char*>(image.size() > 0 ? &image(0, 0) : nullptr),
+            image.nr(),
+            image.nc(),
+            label,
+            boxes);
+    }
+
+    /// \brief Write the index and close the file.
+    ///
+    /// If a write failed, the partial file is deleted instead.
+    ///
+    /// \returns true if everything was written.
+    bool close();
+
+    /// \brief Stop writing and delete the partial file.
+    void abort();
+
+private:
+    /// \brief Close and delete the partial file.
+    void _remove();
+
+    std::ofstream _stream;
+
+    /// \brief The full path of the dataset file.
+    std::string _path;
+
+    /// \brief True if a write failed or abort() was called.
+    bool _failed = false;
+
+    PackedDataset::Header _header;
+
+    std::vector<PackedDataset::Record> _records;
+    std::vector<PackedDataset::Box> _boxes;
+    std::vector<std::string> _boxLabels;
+
+    uint64_t _offset = 0;
+
+};
+
+
+template <typename pixel_type>
+void PackedDataset::load(std::size_t i, dlib::matrix<pixel_type>& image) const
+{
+    const Record& record = _records[i];
+    const unsigned char* src = _data + record.offset;
+    const long nr = record.nr;
+    const long nc = record.nc;
+
+    image.set_size(nr, nc);
+
+    if (nr == 0 || nc == 0)
+        return;
+
+    if ((channels() == 1 && std::is_same<pixel_type, unsigned char>::value)
+    ||  (channels() == 3 && std::is_same<pixel_type, dlib::rgb_pixel>::value))
+    {
+        // dlib matrices are row-major and contiguous.
+        std::memcpy(&image(0, 0), src, std::size_t(nr * nc) * channels());
+    }
+    else if (channels() == 1)
+    {
+        for (long r = 0; r < nr; ++r)
+            for (long c = 0; c < nc; ++c)
+                dlib::assign_pixel(image(r, c), *src++);
+    }
+    else
+    {
+        for (long r = 0; r < nr; ++r)
+        {
+            for (long c = 0; c < nc; ++c, src += 3)
+                dlib::assign_pixel(image(r, c), dlib::rgb_pixel(src[0], src[1], src[2]));
+        }
+    }
+}
+
+
+template <typename pixel_type>
+void PackedDataset::sample(dlib::rand& rnd,
+                           std::size_t n,
+                           std::vector<dlib::matrix<pixel_type>>& images,
+                           std::vector<unsigned long>& labels) const
+{
+    images.resize(n);
+    labels.resize(n);
+
+    if (size() == 0)
+        return;
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        std::size_t index = rnd.get_random_64bit_number() % size();
+        load(index, images[i]);
+        labels[i] = label(index);
+    }
+}
+
+
+template <typename pixel_type>
+void PackedDataset::sample(dlib::rand& rnd,
+                           std::size_t n,
+                           std::vector<dlib::matrix<pixel_type>>& images,
+                           std::vector<std::vector<dlib::mmod_rect>>& boxes) const
+{
+    images.resize(n);
+    boxes.resize(n);
+
+    if (size() == 0)
+        return;
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        std::size_t index = rnd.get_random_64bit_number() % size();
+        load(index, images[i]);
+        boxes[i] = this->boxes(index);
+    }
+}
+
+
+} } // namespace ofx::Dlib
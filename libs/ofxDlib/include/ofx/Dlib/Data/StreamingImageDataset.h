@@ -0,0 +1,277 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dlib/image_processing/full_object_detection.h"
+#include "dlib/matrix.h"
+#include "dlib/pixel.h"
+#include "dlib/rand.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Cache statistics of a StreamingImageDataset.
+struct StreamingImageDatasetStats
+{
+    /// \brief The number of images found in the cache.
+    uint64_t hits = 0;
+
+    /// \brief The number of images that had to be decoded.
+    uint64_t misses = 0;
+
+    /// \brief The number of images removed from the cache.
+    uint64_t evictions = 0;
+
+    /// \brief The number of images in the cache.
+    std::size_t numCached = 0;
+
+    /// \brief The size of the images in the cache in bytes.
+    uint64_t cachedBytes = 0;
+
+    /// \brief The total decode time of all threads in milliseconds.
+    double decodeMs = 0;
+
+    /// \returns the fraction of requests served from the cache.
+    double hitRate() const
+    {
+        return hits + misses > 0 ? double(hits) / double(hits + misses) : 0;
+    }
+};
+
+
+/// \brief A dlib XML image dataset that decodes images on demand.
+///
+/// Only the file names and object boxes are loaded up front. Images are
+/// decoded on a pool of threads when they are requested and kept in a least
+/// recently used cache that is capped in bytes, so memory use depends on the
+/// cache size instead of the dataset size.
+///
+/// Boxes are loaded like dlib::load_image_dataset() does for mmod_rect, so
+/// boxes() can be passed to dlib::mmod_options directly.
+///
+/// Training crops are made with crop(), which picks the images, decodes the
+/// missing ones in parallel and then crops them with a dlib::random_cropper.
+///
+///     StreamingImageDataset dataset("faces/training.xml");
+///     mmod_options options(dataset.boxes(), 40, 40);
+///     ...
+///     dataset.crop(cropper, 150, rnd, batch.samples, batch.labels);
+///
+/// All methods are thread-safe, so one dataset can be shared by the workers
+/// of a BatchPipeline.
+class StreamingImageDataset
+{
+public:
+    typedef dlib::matrix<dlib::rgb_pixel> image_type;
+
+    /// \brief A decoded image shared between the cache and its users.
+    typedef std::shared_ptr<const image_type> ImagePtr;
+
+    struct Settings
+    {
+        /// \brief The maximum size of the cached images in bytes.
+        uint64_t cacheBytes = uint64_t(1) << 30;
+
+        /// \brief The number of decode threads.
+        std::size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+    };
+
+    /// \brief Load the dataset metadata with default settings.
+    /// \param xmlPath The path of the dlib XML dataset file.
+    /// \throws dlib::error if the XML file can't be loaded.
+    StreamingImageDataset(const std::string& xmlPath);
+
+    /// \brief Load the dataset metadata.
+    /// \param xmlPath The path of the dlib XML dataset file.
+    /// \param settings The cache settings.
+    /// \throws dlib::error if the XML file can't be loaded.
+    StreamingImageDataset(const std::string& xmlPath, const Settings& settings);
+
+    /// \brief Stop the decode threads.
+    ~StreamingImageDataset();
+
+    StreamingImageDataset(const StreamingImageDataset&) = delete;
+    StreamingImageDataset& operator = (const StreamingImageDataset&) = delete;
+
+    /// \returns the number of images.
+    std::size_t size() const
+    {
+        return _filenames.size();
+    }
+
+    /// \returns the absolute path of an image.
+    const std::string& filename(std::size_t i) const
+    {
+        return _filenames[i];
+    }
+
+    /// \returns the boxes of all images.
+    const std::vector<std::vector<dlib::mmod_rect>>& boxes() const
+    {
+        return _boxes;
+    }
+
+    /// \returns the boxes of an image.
+    const std::vector<dlib::mmod_rect>& boxes(std::size_t i) const
+    {
+        return _boxes[i];
+    }
+
+    /// \brief Get an image, decoding it if it isn't cached.
+    ///
+    /// Images requested with get() are decoded before prefetched images. If
+    /// the image is already being decoded, this waits for that decode.
+    ///
+    /// \param i The image index.
+    /// \returns the image.
+    /// \throws dlib::image_load_error if the image can't be decoded.
+    ImagePtr get(std::size_t i);
+
+    /// \brief Get a copy of an image.
+    ///
+    /// This lets the dataset be used where dlib expects an array of images,
+    /// e.g. the single crop overload of dlib::random_cropper.
+    ///
+    /// \param i The image index.
+    /// \returns a copy of the image.
+    image_type operator [] (std::size_t i);
+
+    /// \brief Start decoding images that aren't cached.
+    /// \param indices The image indices.
+    void prefetch(const std::vector<std::size_t>& indices);
+
+    /// \brief Make random crops of random images.
+    ///
+    /// This is the streaming version of calling a random_cropper with all
+    /// images. The images are chosen with \p rnd, decoded in parallel and
+    /// cropped in order, so for a given cropper seed and \p rnd the crops are
+    /// reproducible.
+    ///
+    /// \param cropper A dlib::random_cropper or any cropper with the same
+    ///        single image call operator.
+    /// \param numCrops The number of crops.
+    /// \param rnd The random number generator used to choose the images.
+    /// \param crops The crops. Existing crops are reused.
+    /// \param cropBoxes The boxes of the crops.
+    template <typename Cropper>
+    void crop(Cropper& cropper,
+              std::size_t numCrops,
+              dlib::rand& rnd,
+              std::vector<image_type>& crops,
+              std::vector<std::vector<dlib::mmod_rect>>& cropBoxes);
+
+    /// \returns a copy of the current statistics.
+    StreamingImageDatasetStats stats() const;
+
+    /// \brief Reset the hit, miss, eviction and decode time statistics.
+    void resetStats();
+
+    /// \returns the settings.
+    const Settings& settings() const
+    {
+        return _settings;
+    }
+
+private:
+    /// \brief An image being decoded.
+    struct Pending
+    {
+        std::promise<ImagePtr> promise;
+        std::shared_future<ImagePtr> future;
+    };
+
+    /// \brief A cached image.
+    struct Entry
+    {
+        ImagePtr image;
+        uint64_t bytes = 0;
+        std::list<std::size_t>::iterator position;
+    };
+
+    /// \brief Queue an image for decoding. Must be called with _mutex locked.
+    /// \returns the future of the decoded image.
+    std::shared_future<ImagePtr> _enqueue(std::size_t i, bool first);
+
+    /// \brief Remove the least recently used images. Must be called with _mutex locked.
+    void _evict();
+
+    /// \brief The decode thread loop.
+    void _run();
+
+    Settings _settings;
+
+    std::vector<std::string> _filenames;
+    std::vector<std::vector<dlib::mmod_rect>> _boxes;
+
+    /// \brief Cached images by index.
+    std::map<std::size_t, Entry> _cache;
+
+    /// \brief Cached image indices, most recently used first.
+    std::list<std::size_t> _lru;
+
+    /// \brief Images being decoded by index.
+    std::map<std::size_t, Pending> _pending;
+
+    /// \brief Image indices waiting for a decode thread.
+    std::deque<std::size_t> _queue;
+
+    StreamingImageDatasetStats _stats;
+
+    bool _running = true;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _condition;
+    std::vector<std::thread> _threads;
+
+};
+
+
+template <typename Cropper>
+void StreamingImageDataset::crop(Cropper& cropper,
+                                 std::size_t numCrops,
+                                 dlib::rand& rnd,
+                                 std::vector<image_type>& crops,
+                                 std::vector<std::vector<dlib::mmod_rect>>& cropBoxes)
+{
+    crops.resize(numCrops);
+    cropBoxes.resize(numCrops);
+
+    if (size() == 0)
+        return;
+
+    std::vector<std::size_t> indices(numCrops);
+
+    for (auto& index: indices)
+        index = std::size_t(rnd.get_random_64bit_number() % size());
+
+    prefetch(indices);
+
+    for (std::size_t i = 0; i < numCrops; ++i)
+    {
+        ImagePtr image = get(indices[i]);
+        cropper(*image, _boxes[indices[i]], crops[i], cropBoxes[i]);
+    }
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,157 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <vector>
+#include "dlib/matrix.h"
+#include "ofVectorMath.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Rasterizes pen strokes straight into an MNIST style network input.
+///
+/// Instead of rendering strokes into a large framebuffer, reading it back and
+/// shrinking it, each stroke segment is drawn as an anti-aliased capsule into
+/// a small supersampled coverage buffer (112 x 112 floats by default). Only
+/// the pixels around the new segment are touched, so adding a segment costs a
+/// few hundred pixel operations.
+///
+/// input() resamples the buffer into a 28 x 28 matrix the way the MNIST
+/// digits were prepared: the ink is scaled so that its bounding box fits in a
+/// 20 x 20 box, keeping its aspect ratio, and its center of mass is moved to
+/// the center of the image. The matrix can be passed to LeNet5::Net directly.
+///
+///     StrokeRasterizer rasterizer;
+///
+///     // On mouse press and drag, in drawing coordinates.
+///     rasterizer.moveTo(position);
+///     rasterizer.lineTo(position);
+///
+///     predictedLabel = net(rasterizer.input());
+class StrokeRasterizer
+{
+public:
+    struct Settings
+    {
+        /// \brief The width of the drawing space, e.g. the drawing area on screen.
+        float width = 280;
+
+        /// \brief The height of the drawing space.
+        float height = 280;
+
+        /// \brief The stroke radius in drawing space units.
+        float radius = 20;
+
+        /// \brief The number of rows and columns of the input.
+        long size = 28;
+
+        /// \brief The number of buffer pixels per input pixel along each axis.
+        long supersampling = 4;
+
+        /// \brief True to center and scale the ink like the MNIST digits.
+        bool normalize = true;
+
+        /// \brief The size of the box the ink is scaled to fit when normalizing.
+        float boxSize = 20;
+    };
+
+    /// \brief Create a rasterizer with default settings.
+    StrokeRasterizer();
+
+    /// \brief Create a rasterizer.
+    /// \param settings The rasterizer settings.
+    StrokeRasterizer(const Settings& settings);
+
+    /// \brief Erase all strokes.
+    void clear();
+
+    /// \brief Start a new stroke and draw a dot at its first point.
+    /// \param position The point in drawing space.
+    void moveTo(const glm::vec2& position);
+
+    /// \brief Continue the current stroke to a point.
+    /// \param position The point in drawing space.
+    void lineTo(const glm::vec2& position);
+
+    /// \brief Set the stroke radius of the following segments.
+    /// \param radius The radius in drawing space units.
+    void setRadius(float radius);
+
+    /// \returns true if no ink has been drawn since the last clear().
+    bool empty() const
+    {
+        return _inkMax.x < _inkMin.x;
+    }
+
+    /// \brief Get the network input.
+    ///
+    /// The input is only resampled when strokes were added since the last call.
+    ///
+    /// \returns the strokes as a size x size matrix with values in [0, 255].
+    const dlib::matrix<unsigned char>& input();
+
+    /// \returns the supersampled coverage buffer, row major, with values in [0, 1].
+    const std::vector<float>& buffer() const
+    {
+        return _buffer;
+    }
+
+    /// \returns the number of rows and columns of the coverage buffer.
+    long bufferSize() const
+    {
+        return _bufferSize;
+    }
+
+    /// \returns the settings.
+    const Settings& settings() const
+    {
+        return _settings;
+    }
+
+private:
+    /// \brief Draw a capsule in buffer coordinates.
+    void _drawSegment(const glm::vec2& a, const glm::vec2& b);
+
+    /// \brief Resample the buffer into _input.
+    void _resample();
+
+    /// \brief Sum the buffer over [0, x) x [0, y) with fractional bounds.
+    double _integral(double x, double y) const;
+
+    Settings _settings;
+
+    long _bufferSize = 0;
+
+    /// \brief Drawing space to buffer scale.
+    glm::vec2 _scale;
+
+    std::vector<float> _buffer;
+
+    /// \brief The summed area table of _buffer with one extra row and column.
+    std::vector<double> _sums;
+
+    /// \brief The bounds of the drawn pixels in buffer coordinates.
+    glm::ivec2 _inkMin;
+    glm::ivec2 _inkMax;
+
+    /// \brief The end of the current stroke in buffer coordinates.
+    glm::vec2 _last;
+
+    dlib::matrix<unsigned char> _input;
+
+    /// \brief True if _input is out of date.
+    bool _dirty = true;
+
+};
+
+
+} } // namespace ofx::Dlib
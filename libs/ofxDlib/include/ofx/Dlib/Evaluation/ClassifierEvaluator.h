@@ -0,0 +1,406 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dlib/dnn.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief The results of evaluating a classifier.
+///
+/// Reports are plain counts, so reports of parts of a dataset can be merged
+/// and the result doesn't depend on how the work was split.
+struct ClassificationReport
+{
+    /// \brief The number of classes.
+    std::size_t numClasses = 0;
+
+    /// \brief The number of samples with each true (row) and predicted
+    ///        (column) class, row major.
+    std::vector<uint64_t> confusion;
+
+    /// \brief Element k - 1 is the number of samples whose true class was
+    ///        among the k highest scores.
+    std::vector<uint64_t> topKRight;
+
+    /// \brief The number of samples.
+    uint64_t numSamples = 0;
+
+    /// \brief The wall time of the evaluation in milliseconds.
+    double elapsedMs = 0;
+
+    /// \brief The total time all replicas spent loading samples in milliseconds.
+    double loadMs = 0;
+
+    /// \brief The total time all replicas spent running the network in milliseconds.
+    double inferenceMs = 0;
+
+    /// \brief The number of replicas used.
+    std::size_t numReplicas = 0;
+
+    /// \brief Clear the counts.
+    /// \param classes The number of classes.
+    /// \param topK The largest k counted by topKRight.
+    void reset(std::size_t classes, std::size_t topK);
+
+    /// \brief Count a sample.
+    /// \param truth The true class.
+    /// \param predicted The predicted class.
+    /// \param rank The number of classes scored higher than the true class.
+    void add(std::size_t truth, std::size_t predicted, std::size_t rank);
+
+    /// \brief Add the counts and times of another report with the same classes.
+    void merge(const ClassificationReport& other);
+
+    /// \returns the number of samples of a true class predicted as a class.
+    uint64_t count(std::size_t truth, std::size_t predicted) const
+    {
+        return confusion[truth * numClasses + predicted];
+    }
+
+    /// \returns the number of correctly classified samples.
+    uint64_t numRight() const;
+
+    /// \returns the number of misclassified samples.
+    uint64_t numWrong() const
+    {
+        return numSamples - numRight();
+    }
+
+    /// \returns the fraction of correctly classified samples.
+    double accuracy() const;
+
+    /// \returns the fraction of samples whose true class was among the k
+    ///          highest scores, or 0 if k wasn't counted.
+    double topKAccuracy(std::size_t k) const;
+
+    /// \returns the fraction of samples predicted as a class that belong to it.
+    double precision(std::size_t c) const;
+
+    /// \returns the fraction of samples of a class that were predicted as it.
+    double recall(std::size_t c) const;
+
+    /// \returns the number of samples per second.
+    double samplesPerSecond() const
+    {
+        return elapsedMs > 0 ? 1000.0 * double(numSamples) / elapsedMs : 0;
+    }
+
+    /// \returns accuracy, top-k accuracy, timing and a per-class table.
+    std::string toString() const;
+
+    /// \returns the confusion matrix as a table.
+    std::string confusionToString() const;
+};
+
+
+/// \brief Evaluates a classifier on many CPU cores.
+///
+/// The dataset is split into batches that replicas of the network take from
+/// a shared counter, each on its own thread. Every replica counts its results
+/// in its own report and the reports are merged at the end, so the threads
+/// never share state while evaluating and the report is the same for any
+/// number of replicas.
+///
+/// The network must output one score per class, like a network with a
+/// dlib::loss_multiclass_log layer. The predicted class is the highest score,
+/// as in loss_multiclass_log, and the scores also give the top-k accuracy.
+///
+///     ClassifierEvaluator<net_type> evaluator(net);
+///     ClassificationReport report = evaluator.evaluate(images, labels);
+///     std::cout << report.toString() << std::endl;
+///
+/// Datasets that don't fit in memory are evaluated with a loader function
+/// that is called concurrently for every sample:
+///
+///     report = evaluator.evaluate(dataset.size(), [&](std::size_t i, matrix<unsigned char>& image) {
+///         dataset.load(i, image);
+///         return dataset.label(i);
+///     });
+///
+/// The first replica is the network itself. The others are copied from it at
+/// the start of every evaluate() call.
+///
+/// \tparam NET The network type.
+template <typename NET>
+class ClassifierEvaluator
+{
+public:
+    typedef typename NET::input_type input_type;
+
+    struct Settings
+    {
+        /// \brief The number of network replicas, each on its own thread.
+        std::size_t numReplicas = std::max(1u, std::thread::hardware_concurrency());
+
+        /// \brief The number of samples each replica runs at once.
+        std::size_t batchSize = 256;
+
+        /// \brief The largest k of the top-k accuracy.
+        std::size_t topK = 5;
+    };
+
+    /// \brief Create an evaluator with default settings.
+    /// \param net The network to evaluate.
+    ClassifierEvaluator(NET& net);
+
+    /// \brief Create an evaluator.
+    /// \param net The network to evaluate.
+    /// \param settings The evaluator settings.
+    ClassifierEvaluator(NET& net, const Settings& settings);
+
+    /// \brief Evaluate samples in memory.
+    /// \param data The samples.
+    /// \param labels The true class of each sample.
+    /// \returns the report.
+    /// \throws std::invalid_argument if the sizes don't match or a label is
+    ///         not a class of the network.
+    ClassificationReport evaluate(const std::vector<input_type>& data,
+                                  const std::vector<unsigned long>& labels);
+
+    /// \brief Evaluate samples made by a loader function.
+    /// \param size The number of samples.
+    /// \param loader A function that is called as loader(i, sample) from
+    ///        many threads, fills the sample with index i and returns its true
+    ///        class.
+    /// \returns the report.
+    /// \throws std::invalid_argument if a label is not a class of the network,
+    ///         or any exception thrown by the loader.
+    template <typename LOADER>
+    ClassificationReport evaluate(std::size_t size, LOADER loader);
+
+    /// \returns the settings.
+    const Settings& settings() const
+    {
+        return _settings;
+    }
+
+private:
+    /// \brief Evaluate with a function that turns a range of samples into a
+    ///        tensor and their labels.
+    template <typename BATCH>
+    ClassificationReport _evaluate(std::size_t size, BATCH batch);
+
+    NET& _net;
+
+    Settings _settings;
+
+    /// \brief The replicas of workers 1..N-1. Worker 0 uses _net.
+    std::vector<std::unique_ptr<NET>> _replicas;
+
+};
+
+
+template <typename NET>
+ClassifierEvaluator<NET>::ClassifierEvaluator(NET& net):
+    ClassifierEvaluator(net, Settings())
+{
+}
+
+
+template <typename NET>
+ClassifierEvaluator<NET>::ClassifierEvaluator(NET& net, const Settings& settings):
+    _net(net),
+    _settings(settings)
+{
+    _settings.numReplicas = std::max(std::size_t(1), _settings.numReplicas);
+    _settings.batchSize = std::max(std::size_t(1), _settings.batchSize);
+    _settings.topK = std::max(std::size_t(1), _settings.topK);
+}
+
+
+template <typename NET>
+ClassificationReport ClassifierEvaluator<NET>::evaluate(const std::vector<input_type>& data,
+                                                        const std::vector<unsigned long>& labels)
+{
+    if (data.size() != labels.size())
+        throw std::invalid_argument("ClassifierEvaluator: data and labels must have the same size.");
+
+    // The samples are already in memory, so they go straight to the tensor.
+    return _evaluate(data.size(), [&](NET& replica,
+                                      std::size_t first,
+                                      std::size_t last,
+                                      std::vector<input_type>&,
+                                      dlib::resizable_tensor& tensor,
+                                      std::vector<unsigned long>& batchLabels,
+                                      double&) {
+        replica.to_tensor(data.begin() + first, data.begin() + last, tensor);
+        batchLabels.assign(labels.begin() + first, labels.begin() + last);
+    });
+}
+
+
+template <typename NET>
+template <typename LOADER>
+ClassificationReport ClassifierEvaluator<NET>::evaluate(std::size_t size, LOADER loader)
+{
+    return _evaluate(size, [&](NET& replica,
+                               std::size_t first,
+                               std::size_t last,
+                               std::vector<input_type>& samples,
+                               dlib::resizable_tensor& tensor,
+                               std::vector<unsigned long>& batchLabels,
+                               double& loadMs) {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        samples.resize(last - first);
+        batchLabels.resize(last - first);
+
+        for (std::size_t i = first; i < last; ++i)
+            batchLabels[i - first] = loader(i, samples[i - first]);
+
+        loadMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        replica.to_tensor(samples.begin(), samples.end(), tensor);
+    });
+}
+
+
+template <typename NET>
+template <typename BATCH>
+ClassificationReport ClassifierEvaluator<NET>::_evaluate(std::size_t size, BATCH batch)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const std::size_t numBatches = (size + _settings.batchSize - 1) / _settings.batchSize;
+    const std::size_t numReplicas = std::max(std::size_t(1), std::min(_settings.numReplicas, numBatches));
+
+    for (std::size_t i = 0; i + 1 < numReplicas; ++i)
+    {
+        if (i < _replicas.size())
+            *_replicas[i] = _net;
+        else
+            _replicas.emplace_back(new NET(_net));
+    }
+
+    std::vector<ClassificationReport> reports(numReplicas);
+    std::atomic<std::size_t> nextBatch(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr exception;
+    std::mutex mutex;
+
+    auto run = [&](std::size_t worker) {
+        NET& replica = worker == 0 ? _net : *_replicas[worker - 1];
+        ClassificationReport& report = reports[worker];
+
+        std::vector<input_type> samples;
+        std::vector<unsigned long> labels;
+        dlib::resizable_tensor tensor;
+
+        try
+        {
+            while (!failed)
+            {
+                const std::size_t first = nextBatch++ * _settings.batchSize;
+
+                if (first >= size)
+                    break;
+
+                const std::size_t last = std::min(first + _settings.batchSize, size);
+
+                batch(replica, first, last, samples, tensor, labels, report.loadMs);
+
+                auto inferenceStart = std::chrono::high_resolution_clock::now();
+
+                // The same pass as NET::operator() without converting the
+                // scores to labels, so the scores can be ranked.
+                const dlib::tensor& output = replica.subnet().forward(tensor);
+
+                report.inferenceMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - inferenceStart).count();
+
+                const std::size_t numClasses = output.k() * output.nr() * output.nc();
+
+                if (report.numClasses != numClasses)
+                    report.reset(numClasses, std::min(_settings.topK, numClasses));
+
+                const float* scores = output.host();
+
+                for (std::size_t i = 0; i < labels.size(); ++i, scores += numClasses)
+                {
+                    const std::size_t truth = labels[i];
+
+                    if (truth >= numClasses)
+                        throw std::invalid_argument("ClassifierEvaluator: label " + std::to_string(truth) + " is not a class of the network.");
+
+                    // Ties are ranked like the first index wins in argmax.
+                    std::size_t predicted = 0;
+                    std::size_t rank = 0;
+
+                    for (std::size_t c = 0; c < numClasses; ++c)
+                    {
+                        if (scores[c] > scores[predicted])
+                            predicted = c;
+
+                        if (scores[c] > scores[truth] || (scores[c] == scores[truth] && c < truth))
+                            ++rank;
+                    }
+
+                    report.add(truth, predicted, rank);
+                }
+            }
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            if (!exception)
+                exception = std::current_exception();
+
+            failed = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (std::size_t i = 1; i < numReplicas; ++i)
+        threads.emplace_back(run, i);
+
+    run(0);
+
+    for (auto& thread: threads)
+        thread.join();
+
+    if (exception)
+        std::rethrow_exception(exception);
+
+    ClassificationReport result;
+
+    for (auto& report: reports)
+    {
+        if (report.numClasses == 0)
+            continue;
+
+        if (result.numClasses == 0)
+            result.reset(report.numClasses, report.topKRight.size());
+
+        result.merge(report);
+    }
+
+    result.numReplicas = numReplicas;
+    result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    return result;
+}
+
+
+} } // namespace ofx::Dlib
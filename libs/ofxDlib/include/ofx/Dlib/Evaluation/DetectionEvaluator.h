@@ -0,0 +1,406 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "dlib/dnn.h"
+#include "dlib/image_processing/box_overlap_testing.h"
+#include "dlib/image_processing/full_object_detection.h"
+#include "dlib/statistics/average_precision.h"
+#include "dlib/svm/cross_validate_object_detection_trainer.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief The results of evaluating an object detector.
+///
+/// Like ClassificationReport, reports of parts of a dataset can be merged.
+struct DetectionReport
+{
+    /// \brief The number of images.
+    uint64_t numImages = 0;
+
+    /// \brief The number of true boxes that aren't ignored.
+    uint64_t numTruth = 0;
+
+    /// \brief The number of true boxes that were detected.
+    uint64_t numHits = 0;
+
+    /// \brief The number of true boxes without any detection, which
+    ///        dlib::average_precision() counts as never found.
+    unsigned long numMissing = 0;
+
+    /// \brief The confidence of every detection that doesn't overlap an
+    ///        ignored box and whether it hit a true box, most confident first
+    ///        after finish().
+    std::vector<std::pair<double, bool>> detections;
+
+    /// \brief The inference time of every image in milliseconds, sorted
+    ///        after finish().
+    std::vector<double> latenciesMs;
+
+    /// \brief The wall time of the evaluation in milliseconds.
+    double elapsedMs = 0;
+
+    /// \brief The total time all replicas spent loading images in milliseconds.
+    double loadMs = 0;
+
+    /// \brief The number of replicas used.
+    std::size_t numReplicas = 0;
+
+    /// \brief Add the results of another report.
+    void merge(const DetectionReport& other);
+
+    /// \brief Sort the detections and latencies. Called by the evaluator.
+    void finish();
+
+    /// \returns the fraction of detections that hit a true box, or 1 if
+    ///          there were no detections.
+    double precision() const;
+
+    /// \returns the fraction of true boxes that were detected, or 1 if there
+    ///          were no true boxes.
+    double recall() const;
+
+    /// \returns the average precision as computed by dlib::average_precision().
+    double averagePrecision() const;
+
+    /// \returns precision, recall and average precision in the format of
+    ///          dlib::test_object_detection_function().
+    dlib::matrix<double, 1, 3> toMatrix() const;
+
+    /// \returns the mean inference time per image in milliseconds.
+    double meanLatencyMs() const;
+
+    /// \brief Get a latency percentile.
+    /// \param percentile The percentile in [0, 100].
+    /// \returns the nearest rank latency in milliseconds.
+    double latencyPercentileMs(double percentile) const;
+
+    /// \returns the number of images per second.
+    double imagesPerSecond() const
+    {
+        return elapsedMs > 0 ? 1000.0 * double(numImages) / elapsedMs : 0;
+    }
+
+    /// \returns accuracy and latency for the log.
+    std::string toString() const;
+};
+
+
+/// \brief Evaluates a dlib::loss_mmod object detector on many CPU cores.
+///
+/// The images are taken from a shared counter by replicas of the network,
+/// each on its own thread. Every replica matches its detections to the true
+/// boxes and records the latency of every image in its own report, and the
+/// reports are merged at the end.
+///
+/// Detections are matched exactly like dlib::test_object_detection_function()
+/// does it, so the precision, recall and average precision are the same as
+/// dlib's for any number of replicas.
+///
+///     DetectionEvaluator<net_type> evaluator(net);
+///     DetectionReport report = evaluator.evaluate(images, boxes);
+///     std::cout << report.toString() << std::endl;
+///
+/// Datasets that don't fit in memory are evaluated with a loader function
+/// that is called concurrently for every image:
+///
+///     report = evaluator.evaluate(dataset.size(), [&](std::size_t i,
+///                                                     matrix<rgb_pixel>& image,
+///                                                     std::vector<mmod_rect>& boxes) {
+///         image = *dataset.get(i);
+///         boxes = dataset.boxes(i);
+///     });
+///
+/// The first replica is the network itself. The others are copied from it at
+/// the start of every evaluate() call.
+///
+/// \tparam NET A network with a dlib::loss_mmod layer.
+template <typename NET>
+class DetectionEvaluator
+{
+public:
+    typedef typename NET::input_type input_type;
+
+    struct Settings
+    {
+        /// \brief The number of network replicas, each on its own thread.
+        std::size_t numReplicas = std::max(1u, std::thread::hardware_concurrency());
+
+        /// \brief Decides if a detection hits a true box.
+        dlib::test_box_overlap overlapTester;
+
+        /// \brief Added to the detection threshold of the network.
+        double adjustThreshold = 0;
+
+        /// \brief Decides if a detection hits an ignored box.
+        dlib::test_box_overlap overlapsIgnoreTester;
+    };
+
+    /// \brief Create an evaluator with default settings.
+    /// \param net The network to evaluate.
+    DetectionEvaluator(NET& net);
+
+    /// \brief Create an evaluator.
+    /// \param net The network to evaluate.
+    /// \param settings The evaluator settings.
+    DetectionEvaluator(NET& net, const Settings& settings);
+
+    /// \brief Evaluate images in memory.
+    /// \param images The images.
+    /// \param boxes The true boxes of each image.
+    /// \returns the report.
+    /// \throws std::invalid_argument if the sizes don't match.
+    DetectionReport evaluate(const std::vector<input_type>& images,
+                             const std::vector<std::vector<dlib::mmod_rect>>& boxes);
+
+    /// \brief Evaluate images made by a loader function.
+    /// \param size The number of images.
+    /// \param loader A function that is called as loader(i, image, boxes)
+    ///        from many threads and fills the image with index i and its true
+    ///        boxes.
+    /// \returns the report.
+    /// \throws any exception thrown by the loader.
+    template <typename LOADER>
+    DetectionReport evaluate(std::size_t size, LOADER loader);
+
+    /// \returns the settings.
+    const Settings& settings() const
+    {
+        return _settings;
+    }
+
+private:
+    /// \brief Evaluate with a function that returns an image and its boxes.
+    template <typename FETCH>
+    DetectionReport _evaluate(std::size_t size, FETCH fetch);
+
+    /// \brief Detect objects in one image and match them to the true boxes.
+    /// \returns the inference time in milliseconds.
+    double _detect(NET& replica,
+                   const input_type& image,
+                   const std::vector<dlib::mmod_rect>& truth,
+                   dlib::resizable_tensor& tensor,
+                   DetectionReport& report) const;
+
+    NET& _net;
+
+    Settings _settings;
+
+    /// \brief The replicas of workers 1..N-1. Worker 0 uses _net.
+    std::vector<std::unique_ptr<NET>> _replicas;
+
+};
+
+
+template <typename NET>
+DetectionEvaluator<NET>::DetectionEvaluator(NET& net):
+    DetectionEvaluator(net, Settings())
+{
+}
+
+
+template <typename NET>
+DetectionEvaluator<NET>::DetectionEvaluator(NET& net, const Settings& settings):
+    _net(net),
+    _settings(settings)
+{
+    _settings.numReplicas = std::max(std::size_t(1), _settings.numReplicas);
+}
+
+
+template <typename NET>
+DetectionReport DetectionEvaluator<NET>::evaluate(const std::vector<input_type>& images,
+                                                  const std::vector<std::vector<dlib::mmod_rect>>& boxes)
+{
+    if (images.size() != boxes.size())
+        throw std::invalid_argument("DetectionEvaluator: images and boxes must have the same size.");
+
+    // The images are already in memory, so they aren't copied.
+    return _evaluate(images.size(), [&](std::size_t i,
+                                        input_type&,
+                                        std::vector<dlib::mmod_rect>&) {
+        return std::make_pair(&images[i], &boxes[i]);
+    });
+}
+
+
+template <typename NET>
+template <typename LOADER>
+DetectionReport DetectionEvaluator<NET>::evaluate(std::size_t size, LOADER loader)
+{
+    return _evaluate(size, [&](std::size_t i,
+                               input_type& image,
+                               std::vector<dlib::mmod_rect>& truth) {
+        loader(i, image, truth);
+        return std::pair<const input_type*, const std::vector<dlib::mmod_rect>*>(&image, &truth);
+    });
+}
+
+
+template <typename NET>
+template <typename FETCH>
+DetectionReport DetectionEvaluator<NET>::_evaluate(std::size_t size, FETCH fetch)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    const std::size_t numReplicas = std::max(std::size_t(1), std::min(_settings.numReplicas, size));
+
+    for (std::size_t i = 0; i + 1 < numReplicas; ++i)
+    {
+        if (i < _replicas.size())
+            *_replicas[i] = _net;
+        else
+            _replicas.emplace_back(new NET(_net));
+    }
+
+    std::vector<DetectionReport> reports(numReplicas);
+    std::atomic<std::size_t> nextImage(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr exception;
+    std::mutex mutex;
+
+    auto run = [&](std::size_t worker) {
+        NET& replica = worker == 0 ? _net : *_replicas[worker - 1];
+        DetectionReport& report = reports[worker];
+
+        input_type image;
+        std::vector<dlib::mmod_rect> truth;
+        dlib::resizable_tensor tensor;
+
+        try
+        {
+            while (!failed)
+            {
+                const std::size_t i = nextImage++;
+
+                if (i >= size)
+                    break;
+
+                auto loadStart = std::chrono::high_resolution_clock::now();
+
+                auto sample = fetch(i, image, truth);
+
+                report.loadMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - loadStart).count();
+                report.latenciesMs.push_back(_detect(replica, *sample.first, *sample.second, tensor, report));
+                ++report.numImages;
+            }
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            if (!exception)
+                exception = std::current_exception();
+
+            failed = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for (std::size_t i = 1; i < numReplicas; ++i)
+        threads.emplace_back(run, i);
+
+    run(0);
+
+    for (auto& thread: threads)
+        thread.join();
+
+    if (exception)
+        std::rethrow_exception(exception);
+
+    DetectionReport result;
+
+    for (auto& report: reports)
+        result.merge(report);
+
+    result.finish();
+    result.numReplicas = numReplicas;
+    result.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    return result;
+}
+
+
+template <typename NET>
+double DetectionEvaluator<NET>::_detect(NET& replica,
+                                        const input_type& image,
+                                        const std::vector<dlib::mmod_rect>& truth,
+                                        dlib::resizable_tensor& tensor,
+                                        DetectionReport& report) const
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<dlib::mmod_rect> hits;
+    replica.to_tensor(&image, &image + 1, tensor);
+    replica.subnet().forward(tensor);
+    replica.loss_details().to_label(tensor, replica.subnet(), &hits, _settings.adjustThreshold);
+
+    const double latencyMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    // The matching of dlib::test_object_detection_function(), label by label.
+    std::set<std::string> labels;
+
+    for (auto& box: truth)
+        labels.insert(box.label);
+
+    for (auto& box: hits)
+        labels.insert(box.label);
+
+    for (auto& label: labels)
+    {
+        std::vector<dlib::full_object_detection> truthBoxes;
+        std::vector<dlib::rectangle> ignore;
+        std::vector<std::pair<double, dlib::rectangle>> boxes;
+
+        for (auto& box: truth)
+        {
+            if (box.ignore)
+                ignore.push_back(box.rect);
+            else if (box.label == label)
+                truthBoxes.push_back(dlib::full_object_detection(box.rect));
+        }
+
+        for (auto& box: hits)
+        {
+            if (box.label == label)
+                boxes.push_back(std::make_pair(box.detection_confidence, box.rect));
+        }
+
+        report.numHits += dlib::impl::number_of_truth_hits(truthBoxes,
+                                                           ignore,
+                                                           boxes,
+                                                           _settings.overlapTester,
+                                                           report.detections,
+                                                           report.numMissing,
+                                                           _settings.overlapsIgnoreTester);
+        report.numTruth += truthBoxes.size();
+    }
+
+    return latencyMs;
+}
+
+
+} } // namespace ofx::Dlib
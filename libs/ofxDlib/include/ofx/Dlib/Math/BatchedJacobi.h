@@ -0,0 +1,514 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
+#include "dlib/matrix.h"
+#include "dlib/threads.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Decomposes many small fixed-size matrices at once.
+///
+/// dlib::svd3() and dlib::eigenvalue_decomposition are general and allocate on
+/// every call, which dominates when solving hundreds of thousands of 3 x 3 or
+/// 4 x 4 problems, e.g. for pose estimation or homographies. This solves them
+/// with cyclic Jacobi rotations, LANES matrices at a time.
+///
+/// Each group of LANES matrices is transposed into a structure of arrays, so
+/// every element holds one value per matrix. A rotation then applies the same
+/// branch free arithmetic to all lanes, which the compiler vectorizes (e.g.
+/// with -O3 -mavx). Sweeps stop once every matrix in the group has converged.
+/// Large batches are split across threads.
+///
+/// The results use the dlib types and conventions:
+///
+/// - symmetricEigen() matches eigenvalue_decomposition of a symmetric
+///   matrix: eigenvalues ascending, eigenvectors as the columns of v, so
+///   `a == v * diagm(d) * trans(v)`.
+/// - svd() gives the same factors as svd3(), `a == u * diagm(w) * trans(v)`
+///   with u and v orthonormal, but in a different order. svd3() leaves the
+///   singular values unsorted, while svd() sorts them descending with the
+///   matching columns of u and v, so the last column of v is the least
+///   squares null vector.
+///
+///     std::vector<dlib::matrix<double, 3, 3>> a = ...;
+///     std::vector<dlib::matrix<double, 3, 3>> u, v;
+///     std::vector<dlib::matrix<double, 3, 1>> w;
+///     BatchedJacobi<3>::svd(a, u, w, v);
+///
+/// \tparam N The number of rows and columns of each matrix.
+template <long N>
+class BatchedJacobi
+{
+public:
+    static_assert(N >= 2 && N <= 8, "BatchedJacobi is meant for matrices from 2 x 2 to 8 x 8.");
+
+    typedef dlib::matrix<double, N, N> Matrix;
+    typedef dlib::matrix<double, N, 1> Vector;
+
+    /// \brief The number of matrices solved together.
+    enum
+    {
+        LANES = 8
+    };
+
+    /// \brief The number of sweeps after which a group stops even if it
+    ///        hasn't converged.
+    enum
+    {
+        MAX_SWEEPS = 16
+    };
+
+    /// \brief Batches with at least this many matrices are split across threads.
+    enum
+    {
+        PARALLEL_MATRICES = 1024
+    };
+
+    /// \brief Decompose symmetric matrices.
+    ///
+    /// Only the lower triangle of each matrix is read.
+    ///
+    /// \param a The symmetric matrices.
+    /// \param d The eigenvalues of each matrix in ascending order.
+    /// \param v The eigenvectors of each matrix as columns.
+    /// \param numThreads The number of threads, or 0 for one per core.
+    static void symmetricEigen(const std::vector<Matrix>& a,
+                               std::vector<Vector>& d,
+                               std::vector<Matrix>& v,
+                               unsigned long numThreads = 0)
+    {
+        d.resize(a.size());
+        v.resize(a.size());
+
+        _forEachGroup(a.size(), numThreads, [&](std::size_t first, std::size_t count) {
+            Lanes m[N][N];
+            Lanes vectors[N][N];
+
+            _load(a, first, count, m, true);
+            _identity(vectors);
+            _eigenSweeps(m, vectors);
+
+            for (std::size_t lane = 0; lane < count; ++lane)
+            {
+                Vector& values = d[first + lane];
+                Matrix& vectorsOut = v[first + lane];
+
+                for (long i = 0; i < N; ++i)
+                {
+                    values(i) = m[i][i][lane];
+
+                    for (long j = 0; j < N; ++j)
+                        vectorsOut(i, j) = vectors[i][j][lane];
+                }
+
+                _sort(values, vectorsOut, nullptr, true);
+            }
+        });
+    }
+
+    /// \brief Compute the singular value decompositions.
+    /// \param a The matrices.
+    /// \param u The left singular vectors of each matrix as columns.
+    /// \param w The singular values of each matrix in descending order.
+    /// \param v The right singular vectors of each matrix as columns.
+    /// \param numThreads The number of threads, or 0 for one per core.
+    static void svd(const std::vector<Matrix>& a,
+                    std::vector<Matrix>& u,
+                    std::vector<Vector>& w,
+                    std::vector<Matrix>& v,
+                    unsigned long numThreads = 0)
+    {
+        u.resize(a.size());
+        w.resize(a.size());
+        v.resize(a.size());
+
+        _forEachGroup(a.size(), numThreads, [&](std::size_t first, std::size_t count) {
+            Lanes m[N][N];
+            Lanes vectors[N][N];
+
+            _load(a, first, count, m, false);
+            _identity(vectors);
+            _svdSweeps(m, vectors);
+
+            for (std::size_t lane = 0; lane < count; ++lane)
+            {
+                Matrix& left = u[first + lane];
+                Vector& values = w[first + lane];
+                Matrix& right = v[first + lane];
+
+                // The columns of m are now orthogonal, u * diagm(w).
+                for (long j = 0; j < N; ++j)
+                {
+                    double norm = 0;
+
+                    for (long i = 0; i < N; ++i)
+                    {
+                        left(i, j) = m[i][j][lane];
+                        right(i, j) = vectors[i][j][lane];
+                        norm += left(i, j) * left(i, j);
+                    }
+
+                    values(j) = std::sqrt(norm);
+                }
+
+                _sort(values, right, &left, false);
+                _normalizeColumns(left, values);
+            }
+        });
+    }
+
+private:
+    /// \brief One value per lane.
+    struct alignas(64) Lanes
+    {
+        double value[LANES];
+
+        double& operator[](std::size_t lane)
+        {
+            return value[lane];
+        }
+
+        const double& operator[](std::size_t lane) const
+        {
+            return value[lane];
+        }
+    };
+
+    template <typename FUNCTION>
+    static void _forEachGroup(std::size_t size,
+                              unsigned long numThreads,
+                              const FUNCTION& function)
+    {
+        const long numGroups = long((size + LANES - 1) / LANES);
+
+        auto solveGroup = [&](long group) {
+            const std::size_t first = std::size_t(group) * LANES;
+            function(first, std::min<std::size_t>(LANES, size - first));
+        };
+
+        if (numThreads == 0)
+            numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+        if (numThreads == 1 || size < PARALLEL_MATRICES)
+        {
+            for (long group = 0; group < numGroups; ++group)
+                solveGroup(group);
+        }
+        else
+        {
+            dlib::parallel_for(numThreads, 0, numGroups, solveGroup);
+        }
+    }
+
+    /// \brief Transpose count matrices into lanes. Unused lanes are identity
+    ///        matrices, which are already converged.
+    static void _load(const std::vector<Matrix>& a,
+                      std::size_t first,
+                      std::size_t count,
+                      Lanes (&m)[N][N],
+                      bool symmetric)
+    {
+        for (long i = 0; i < N; ++i)
+        {
+            for (long j = 0; j < N; ++j)
+            {
+                for (std::size_t lane = 0; lane < LANES; ++lane)
+                {
+                    if (lane >= count)
+                        m[i][j][lane] = (i == j) ? 1 : 0;
+                    else if (symmetric && j > i)
+                        m[i][j][lane] = a[first + lane](j, i);
+                    else
+                        m[i][j][lane] = a[first + lane](i, j);
+                }
+            }
+        }
+    }
+
+    static void _identity(Lanes (&m)[N][N])
+    {
+        for (long i = 0; i < N; ++i)
+            for (long j = 0; j < N; ++j)
+                for (std::size_t lane = 0; lane < LANES; ++lane)
+                    m[i][j][lane] = (i == j) ? 1 : 0;
+    }
+
+    /// \brief Find the rotation that diagonalizes [[app, apq], [apq, aqq]].
+    ///
+    /// This is t = sign(theta) / (|theta| + sqrt(theta^2 + 1)) with
+    /// theta = (aqq - app) / (2 apq), rewritten so apq == 0 gives t = 0
+    /// without a branch.
+    static void _rotation(const Lanes& app,
+                          const Lanes& aqq,
+                          const Lanes& apq,
+                          Lanes& c,
+                          Lanes& s)
+    {
+        for (std::size_t lane = 0; lane < LANES; ++lane)
+        {
+            const double tau = aqq[lane] - app[lane];
+            const double offDiagonal = 2 * apq[lane];
+            const double denominator = std::abs(tau) + std::sqrt(tau * tau + offDiagonal * offDiagonal);
+            const double numerator = tau < 0 ? -offDiagonal : offDiagonal;
+            const double t = denominator > 0 ? numerator / denominator : 0;
+            const double cosine = 1 / std::sqrt(1 + t * t);
+            c[lane] = cosine;
+            s[lane] = t * cosine;
+        }
+    }
+
+    /// \brief Rotate columns p and q: p = c p - s q, q = s p + c q.
+    static void _rotateColumns(Lanes (&m)[N][N],
+                               long p,
+                               long q,
+                               const Lanes& c,
+                               const Lanes& s)
+    {
+        for (long k = 0; k < N; ++k)
+        {
+            Lanes& mp = m[k][p];
+            Lanes& mq = m[k][q];
+
+            for (std::size_t lane = 0; lane < LANES; ++lane)
+            {
+                const double x = mp[lane];
+                const double y = mq[lane];
+                mp[lane] = c[lane] * x - s[lane] * y;
+                mq[lane] = s[lane] * x + c[lane] * y;
+            }
+        }
+    }
+
+    /// \brief Rotate rows p and q: p = c p - s q, q = s p + c q.
+    static void _rotateRows(Lanes (&m)[N][N],
+                            long p,
+                            long q,
+                            const Lanes& c,
+                            const Lanes& s)
+    {
+        for (long k = 0; k < N; ++k)
+        {
+            Lanes& mp = m[p][k];
+            Lanes& mq = m[q][k];
+
+            for (std::size_t lane = 0; lane < LANES; ++lane)
+            {
+                const double x = mp[lane];
+                const double y = mq[lane];
+                mp[lane] = c[lane] * x - s[lane] * y;
+                mq[lane] = s[lane] * x + c[lane] * y;
+            }
+        }
+    }
+
+    /// \returns true if every lane has off-diagonal energy below
+    ///          epsilon^2 times its total energy.
+    static bool _isDiagonal(const Lanes (&m)[N][N])
+    {
+        const double epsilon = std::numeric_limits<double>::epsilon();
+
+        for (std::size_t lane = 0; lane < LANES; ++lane)
+        {
+            double offDiagonal = 0;
+            double total = 0;
+
+            for (long i = 0; i < N; ++i)
+            {
+                for (long j = 0; j < N; ++j)
+                {
+                    const double value = m[i][j][lane] * m[i][j][lane];
+                    total += value;
+
+                    if (i != j)
+                        offDiagonal += value;
+                }
+            }
+
+            if (offDiagonal > epsilon * epsilon * total)
+                return false;
+        }
+
+        return true;
+    }
+
+    /// \brief Diagonalize m with two sided rotations, m = trans(J) m J,
+    ///        accumulating v = v J.
+    static void _eigenSweeps(Lanes (&m)[N][N], Lanes (&v)[N][N])
+    {
+        Lanes c;
+        Lanes s;
+
+        for (int sweep = 0; sweep < MAX_SWEEPS && !_isDiagonal(m); ++sweep)
+        {
+            for (long p = 0; p < N - 1; ++p)
+            {
+                for (long q = p + 1; q < N; ++q)
+                {
+                    _rotation(m[p][p], m[q][q], m[p][q], c, s);
+                    _rotateColumns(m, p, q, c, s);
+                    _rotateRows(m, p, q, c, s);
+                    _rotateColumns(v, p, q, c, s);
+                }
+            }
+        }
+    }
+
+    /// \brief Orthogonalize the columns of m with one sided rotations,
+    ///        m = m J, accumulating v = v J.
+    ///
+    /// Each rotation diagonalizes the 2 x 2 Gram matrix of columns p and q.
+    static void _svdSweeps(Lanes (&m)[N][N], Lanes (&v)[N][N])
+    {
+        const double epsilon = std::numeric_limits<double>::epsilon();
+
+        Lanes alpha;
+        Lanes beta;
+        Lanes gamma;
+        Lanes c;
+        Lanes s;
+
+        for (int sweep = 0; sweep < MAX_SWEEPS; ++sweep)
+        {
+            bool orthogonal = true;
+
+            for (long p = 0; p < N - 1; ++p)
+            {
+                for (long q = p + 1; q < N; ++q)
+                {
+                    for (std::size_t lane = 0; lane < LANES; ++lane)
+                    {
+                        alpha[lane] = 0;
+                        beta[lane] = 0;
+                        gamma[lane] = 0;
+                    }
+
+                    for (long k = 0; k < N; ++k)
+                    {
+                        for (std::size_t lane = 0; lane < LANES; ++lane)
+                        {
+                            alpha[lane] += m[k][p][lane] * m[k][p][lane];
+                            beta[lane] += m[k][q][lane] * m[k][q][lane];
+                            gamma[lane] += m[k][p][lane] * m[k][q][lane];
+                        }
+                    }
+
+                    for (std::size_t lane = 0; lane < LANES; ++lane)
+                    {
+                        if (gamma[lane] * gamma[lane] > epsilon * epsilon * alpha[lane] * beta[lane])
+                            orthogonal = false;
+                    }
+
+                    _rotation(alpha, beta, gamma, c, s);
+                    _rotateColumns(m, p, q, c, s);
+                    _rotateColumns(v, p, q, c, s);
+                }
+            }
+
+            if (orthogonal)
+                break;
+        }
+    }
+
+    /// \brief Sort the values and the matching columns of vectors and others.
+    static void _sort(Vector& values, Matrix& vectors, Matrix* others, bool ascending)
+    {
+        // An insertion sort, which is the fastest for a handful of values.
+        for (long i = 1; i < N; ++i)
+        {
+            for (long j = i; j > 0; --j)
+            {
+                const bool ordered = ascending ? values(j - 1) <= values(j)
+                                               : values(j - 1) >= values(j);
+                if (ordered)
+                    break;
+
+                std::swap(values(j - 1), values(j));
+
+                for (long k = 0; k < N; ++k)
+                {
+                    std::swap(vectors(k, j - 1), vectors(k, j));
+
+                    if (others != nullptr)
+                        std::swap((*others)(k, j - 1), (*others)(k, j));
+                }
+            }
+        }
+    }
+
+    /// \brief Divide the columns of u by the singular values.
+    ///
+    /// Columns with zero singular values are replaced by unit vectors
+    /// orthogonal to the others, so u stays orthonormal for rank deficient
+    /// matrices. The values are sorted, so these are the last columns.
+    static void _normalizeColumns(Matrix& u, Vector& values)
+    {
+        const double tolerance = N * std::numeric_limits<double>::epsilon() * values(0);
+
+        for (long j = 0; j < N; ++j)
+        {
+            if (values(j) > tolerance && values(j) > 0)
+            {
+                for (long i = 0; i < N; ++i)
+                    u(i, j) /= values(j);
+
+                continue;
+            }
+
+            values(j) = std::max(values(j), 0.0);
+
+            // Gram-Schmidt the basis vector least covered by the columns so
+            // far.
+            double best[N] = { };
+            double bestNorm = -1;
+
+            for (long axis = 0; axis < N; ++axis)
+            {
+                double e[N] = { };
+                e[axis] = 1;
+
+                for (long k = 0; k < j; ++k)
+                {
+                    const double projection = u(axis, k);
+
+                    for (long i = 0; i < N; ++i)
+                        e[i] -= projection * u(i, k);
+                }
+
+                double norm = 0;
+
+                for (long i = 0; i < N; ++i)
+                    norm += e[i] * e[i];
+
+                if (norm > bestNorm)
+                {
+                    bestNorm = norm;
+                    std::copy(e, e + N, best);
+                }
+            }
+
+            bestNorm = std::sqrt(bestNorm);
+
+            for (long i = 0; i < N; ++i)
+                u(i, j) = best[i] / bestNorm;
+        }
+    }
+
+};
+
+
+} } // namespace ofx::Dlib
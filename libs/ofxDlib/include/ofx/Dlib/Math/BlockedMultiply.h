@@ -0,0 +1,146 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include "dlib/matrix.h"
+#include "dlib/threads.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Multiply two matrices with a cache blocked, multithreaded kernel.
+///
+/// This is the fallback used when dlib is built without BLAS, where
+/// `c = a * b` runs dlib's single threaded built-in kernel. The rows of c are
+/// split into blocks of 64, which run in parallel. Each block walks the
+/// 128 x 256 blocks of b, which stay in the L2 cache, and updates four rows
+/// of c at a time, so every value loaded from b is used for four
+/// multiply-adds.
+///
+/// The innermost loop runs over contiguous columns and is left to the
+/// compiler to vectorize (e.g. with -O3 -mavx).
+///
+/// LinearAlgebraBenchmark compares it to dlib and any linked BLAS.
+///
+/// \param a The m x k left matrix.
+/// \param b The k x n right matrix.
+/// \param c The m x n product. It may be a or b.
+/// \param numThreads The number of threads, or 0 for one per core.
+/// \throws std::invalid_argument if the sizes don't match.
+template <typename T>
+void blockedMultiply(const dlib::matrix<T>& a,
+                     const dlib::matrix<T>& b,
+                     dlib::matrix<T>& c,
+                     unsigned long numThreads = 0)
+{
+    if (a.nc() != b.nr())
+        throw std::invalid_argument("blockedMultiply: The columns of a don't match the rows of b.");
+
+    if (&c == &a || &c == &b)
+    {
+        dlib::matrix<T> product;
+        blockedMultiply(a, b, product, numThreads);
+        c.swap(product);
+        return;
+    }
+
+    const long BLOCK_ROWS = 64;
+    const long BLOCK_DEPTH = 128;
+    const long BLOCK_COLUMNS = 256;
+
+    const long m = a.nr();
+    const long depth = a.nc();
+    const long n = b.nc();
+
+    c.set_size(m, n);
+    c = 0;
+
+    if (m == 0 || n == 0 || depth == 0)
+        return;
+
+    const long numBlocks = (m + BLOCK_ROWS - 1) / BLOCK_ROWS;
+
+    auto multiplyBlock = [&](long block) {
+        const long rowBegin = block * BLOCK_ROWS;
+        const long rowEnd = std::min(m, rowBegin + BLOCK_ROWS);
+
+        for (long j0 = 0; j0 < n; j0 += BLOCK_COLUMNS)
+        {
+            const long columns = std::min(n - j0, BLOCK_COLUMNS);
+
+            for (long k0 = 0; k0 < depth; k0 += BLOCK_DEPTH)
+            {
+                const long kEnd = std::min(depth, k0 + BLOCK_DEPTH);
+
+                long i = rowBegin;
+
+                for (; i + 4 <= rowEnd; i += 4)
+                {
+                    T* c0 = &c(i, j0);
+                    T* c1 = &c(i + 1, j0);
+                    T* c2 = &c(i + 2, j0);
+                    T* c3 = &c(i + 3, j0);
+
+                    for (long k = k0; k < kEnd; ++k)
+                    {
+                        const T a0 = a(i, k);
+                        const T a1 = a(i + 1, k);
+                        const T a2 = a(i + 2, k);
+                        const T a3 = a(i + 3, k);
+                        const T* bk = &b(k, j0);
+
+                        for (long j = 0; j < columns; ++j)
+                        {
+                            const T value = bk[j];
+                            c0[j] += a0 * value;
+                            c1[j] += a1 * value;
+                            c2[j] += a2 * value;
+                            c3[j] += a3 * value;
+                        }
+                    }
+                }
+
+                for (; i < rowEnd; ++i)
+                {
+                    T* ci = &c(i, j0);
+
+                    for (long k = k0; k < kEnd; ++k)
+                    {
+                        const T ai = a(i, k);
+                        const T* bk = &b(k, j0);
+
+                        for (long j = 0; j < columns; ++j)
+                            ci[j] += ai * bk[j];
+                    }
+                }
+            }
+        }
+    };
+
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    if (numThreads == 1 || numBlocks == 1)
+    {
+        for (long block = 0; block < numBlocks; ++block)
+            multiplyBlock(block);
+    }
+    else
+    {
+        dlib::parallel_for(numThreads, 0, numBlocks, multiplyBlock, 1);
+    }
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,160 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <string>
+#include <vector>
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief The timing of one operation, backend and matrix size.
+struct LinearAlgebraResult
+{
+    /// \brief The operation, e.g. "gemm" or "svd".
+    std::string operation;
+
+    /// \brief The implementation, e.g. "dlib", "dlib+blas" or "blocked".
+    std::string backend;
+
+    /// \brief The number of rows and columns of the square input.
+    long size = 0;
+
+    /// \brief The number of timed runs.
+    std::size_t iterations = 0;
+
+    /// \brief The mean time in milliseconds.
+    double meanMs = 0;
+
+    /// \brief The fastest time in milliseconds.
+    double minMs = 0;
+
+    /// \brief The nominal floating point operations of one run.
+    double flops = 0;
+
+    /// \brief True if the size was skipped because a run was predicted to
+    ///        take longer than the time limit.
+    bool skipped = false;
+
+    /// \returns the nominal GFLOP/s of the fastest run.
+    double gflops() const
+    {
+        return minMs > 0 ? flops / (minMs * 1e6) : 0;
+    }
+};
+
+
+/// \brief The results of a LinearAlgebraBenchmark run.
+struct LinearAlgebraReport
+{
+    /// \brief The build configuration, see LinearAlgebraBenchmark::configuration().
+    std::string configuration;
+
+    /// \brief The results ordered by operation, backend and size.
+    std::vector<LinearAlgebraResult> results;
+
+    /// \brief Find a result.
+    /// \returns the result or nullptr if it wasn't run.
+    const LinearAlgebraResult* find(const std::string& operation,
+                                    const std::string& backend,
+                                    long size) const;
+
+    /// \returns a GFLOP/s table per operation with a size per row and a
+    ///          backend per column, followed by build notes.
+    std::string toString() const;
+
+    /// \brief Suggest build changes from the results.
+    ///
+    /// The notes say whether dlib uses BLAS and LAPACK and how the blocked
+    /// multiply compares to dlib's multiply at the largest size both ran.
+    ///
+    /// \returns one note per line.
+    std::string notes() const;
+
+    /// \returns all results as comma separated values with a header row.
+    std::string toCSV() const;
+
+    /// \brief Save the CSV results to a file.
+    /// \param path The file path, relative to the data folder.
+    /// \returns true if the file was written.
+    bool saveCSV(const std::string& path) const;
+};
+
+
+/// \brief Measures dense linear algebra throughput of the current build.
+///
+/// dlib uses BLAS for matrix products and LAPACK for decompositions only if
+/// it was compiled with them (DLIB_USE_BLAS and DLIB_USE_LAPACK, see
+/// addon_config.mk). This runs the same double precision operations over a
+/// range of square sizes and reports nominal GFLOP/s, so builds and machines
+/// can be compared:
+///
+/// - gemm: `c = a * b` with dlib, which calls BLAS when linked, and with
+///   blockedMultiply().
+/// - svd: dlib::svd3().
+/// - eigen: dlib::eigenvalue_decomposition of a symmetric matrix.
+/// - inverse: dlib::inv().
+///
+/// The nominal operation counts are 2n^3 for gemm and inverse, 9n^3 for the
+/// symmetric eigendecomposition with eigenvectors and 21n^3 for the SVD with
+/// both singular vector matrices. Each case runs at least once and then
+/// repeats until minSeconds have passed. A size is skipped if scaling the
+/// time of the previous size by n^3 predicts a run longer than maxSeconds.
+///
+///     LinearAlgebraReport report = LinearAlgebraBenchmark::run();
+///     std::cout << report.toString() << std::endl;
+///     report.saveCSV("linear_algebra.csv");
+class LinearAlgebraBenchmark
+{
+public:
+    struct Settings
+    {
+        /// \brief The matrix sizes.
+        std::vector<long> sizes = { 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+
+        /// \brief The minimum timed duration of each case in seconds.
+        double minSeconds = 0.25;
+
+        /// \brief The longest predicted time of a single run in seconds.
+        double maxSeconds = 5;
+
+        /// \brief The threads used by blockedMultiply(), or 0 for one per core.
+        unsigned long numThreads = 0;
+
+        /// \brief The operations to run.
+        bool gemm = true;
+        bool svd = true;
+        bool eigen = true;
+        bool inverse = true;
+    };
+
+    /// \brief Run the benchmark with default settings.
+    static LinearAlgebraReport run();
+
+    /// \brief Run the benchmark.
+    /// \param settings The benchmark settings.
+    /// \returns the report.
+    static LinearAlgebraReport run(const Settings& settings);
+
+    /// \returns the math libraries and instruction sets dlib and the addon
+    ///          were compiled with and the number of hardware threads.
+    static std::string configuration();
+
+    /// \returns true if dlib was compiled with BLAS.
+    static bool usesBLAS();
+
+    /// \returns true if dlib was compiled with LAPACK.
+    static bool usesLAPACK();
+
+};
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,193 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <vector>
+#include "dlib/matrix.h"
+#include "ofx/Dlib/Math/RowReader.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Computes the top singular values and vectors of a large matrix.
+///
+/// dlib::svd() computes the full decomposition, which is wasteful when only
+/// the first few components of a tall matrix are needed, e.g. for PCA of
+/// millions of 128 dimensional descriptors. This finds them with a randomized
+/// range finder (Halko, Martinsson and Tropp, 2011):
+///
+/// 1. Multiply a random n x l matrix, l = rank + oversampling, by trans(A) A.
+/// 2. Orthonormalize the product and multiply again, powerIterations times.
+///    Each iteration sharpens the gap between the kept and dropped singular
+///    values.
+/// 3. Project trans(A) A onto the final basis Q and take the eigenvectors of
+///    the small l x l result.
+///
+/// Every product trans(A) A Q is accumulated chunk by chunk, as the sum of
+/// trans(C) (C Q) over row chunks C, so each step is one streaming pass and
+/// the m rows never have to be in memory at once. Dense chunks are
+/// multiplied with blockedMultiply() and sparse rows without densifying.
+/// compute() makes powerIterations + 2 passes in total.
+///
+/// With center set, the column mean is subtracted from every row without
+/// modifying the data, which gives PCA. v() then holds the principal axes
+/// and project() the scores.
+///
+/// Because the final step works with trans(A) A, singular values below
+/// about 1e-8 of the largest lose their relative accuracy. This doesn't
+/// affect the leading components this is meant for.
+///
+///     RandomizedSVD::Settings settings;
+///     settings.rank = 16;
+///     settings.center = true;
+///
+///     RandomizedSVD pca(settings);
+///     FileRowReader reader("descriptors.bin", 128);
+///     pca.compute(reader);
+///     dlib::matrix<double> scores = pca.project(queries);
+class RandomizedSVD
+{
+public:
+    struct Settings
+    {
+        /// \brief The number of singular values and vectors to find.
+        long rank = 10;
+
+        /// \brief The number of extra random directions. More improve the
+        ///        accuracy of the last kept components.
+        long oversampling = 10;
+
+        /// \brief The number of power iterations. Use more if the singular
+        ///        values decay slowly.
+        std::size_t powerIterations = 1;
+
+        /// \brief True to subtract the column mean, computing PCA.
+        bool center = false;
+
+        /// \brief The number of rows read per chunk.
+        long chunkRows = 4096;
+
+        /// \brief The number of threads, or 0 for one per core.
+        unsigned long numThreads = 0;
+
+        /// \brief The seed of the random start, so results are repeatable.
+        unsigned long seed = 0;
+    };
+
+    /// \brief Create a decomposition with default settings.
+    RandomizedSVD();
+
+    /// \brief Create a decomposition.
+    /// \param settings The decomposition settings.
+    RandomizedSVD(const Settings& settings);
+
+    /// \brief Decompose a dense matrix in memory.
+    /// \param a The matrix with one sample per row.
+    /// \throws std::invalid_argument if the matrix or settings are invalid.
+    void compute(const dlib::matrix<double>& a);
+
+    /// \brief Decompose a sparse matrix in memory.
+    /// \param rows The sparse rows.
+    /// \param numColumns The number of columns.
+    /// \throws std::invalid_argument if the matrix or settings are invalid.
+    void compute(const std::vector<SparseRow>& rows, long numColumns);
+
+    /// \brief Decompose a matrix read in chunks.
+    /// \param reader The row reader. It is rewound before every pass.
+    /// \throws std::invalid_argument if the matrix or settings are invalid.
+    void compute(RowReader& reader);
+
+    /// \returns the rank largest singular values in descending order.
+    const dlib::matrix<double, 0, 1>& singularValues() const
+    {
+        return _singularValues;
+    }
+
+    /// \returns the n x rank right singular vectors, or principal axes, as
+    ///          columns.
+    const dlib::matrix<double>& v() const
+    {
+        return _v;
+    }
+
+    /// \returns the column mean, or zeros if center isn't set.
+    const dlib::matrix<double, 0, 1>& mean() const
+    {
+        return _mean;
+    }
+
+    /// \returns the number of rows of the decomposed matrix.
+    long numRows() const
+    {
+        return _numRows;
+    }
+
+    /// \returns the variance along each principal axis, the squared
+    ///          singular values divided by numRows() - 1.
+    dlib::matrix<double, 0, 1> explainedVariance() const;
+
+    /// \brief Project rows onto the singular vectors.
+    ///
+    /// For the decomposed rows this is u * diagm(w), the PCA scores.
+    ///
+    /// \param rows The rows to project, one sample per row.
+    /// \returns the rows x rank projections.
+    /// \throws std::invalid_argument if the rows have the wrong size.
+    dlib::matrix<double> project(const dlib::matrix<double>& rows) const;
+
+    /// \brief Compute left singular vectors.
+    ///
+    /// The left singular vectors have one row per decomposed row, so they
+    /// are computed on demand, e.g. chunk by chunk.
+    ///
+    /// \param rows Rows of the decomposed matrix.
+    /// \returns the matching rows of u.
+    /// \throws std::invalid_argument if the rows have the wrong size.
+    dlib::matrix<double> u(const dlib::matrix<double>& rows) const;
+
+    /// \returns the settings.
+    const Settings& settings() const
+    {
+        return _settings;
+    }
+
+private:
+    /// \brief Compute z = trans(A) A q with one pass over the rows.
+    ///
+    /// The first pass also finds the number of rows and the column mean.
+    void _pass(RowReader& reader,
+               const dlib::matrix<double>& q,
+               dlib::matrix<double>& z,
+               bool first);
+
+    Settings _settings;
+
+    dlib::matrix<double, 0, 1> _singularValues;
+
+    dlib::matrix<double> _v;
+
+    dlib::matrix<double, 0, 1> _mean;
+
+    long _numRows = 0;
+
+    unsigned long _numThreads = 1;
+
+    /// \brief The current chunk and products, kept between passes.
+    RowChunk _chunk;
+    dlib::matrix<double> _transposed;
+    dlib::matrix<double> _product;
+    dlib::matrix<double> _chunkProduct;
+    std::vector<dlib::matrix<double>> _partials;
+
+};
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,174 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "dlib/matrix.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief A sparse row of (column, value) pairs, as used by dlib's sparse
+///        vector functions.
+typedef std::vector<std::pair<unsigned long, double>> SparseRow;
+
+
+/// \brief A block of consecutive rows read by a RowReader.
+struct RowChunk
+{
+    /// \brief True if the rows are in sparse, otherwise they are in dense.
+    bool isSparse = false;
+
+    /// \brief The dense rows, one row per matrix row.
+    dlib::matrix<double> dense;
+
+    /// \brief The sparse rows.
+    std::vector<SparseRow> sparse;
+
+    /// \returns the number of rows.
+    long numRows() const
+    {
+        return isSparse ? long(sparse.size()) : dense.nr();
+    }
+};
+
+
+/// \brief Reads the rows of a matrix in chunks.
+///
+/// Algorithms that make several passes over data too large for memory, such
+/// as RandomizedSVD, read it through a RowReader. Subclass it to stream rows
+/// from other storage.
+class RowReader
+{
+public:
+    virtual ~RowReader()
+    {
+    }
+
+    /// \returns the number of columns of every row.
+    virtual long numColumns() const = 0;
+
+    /// \brief Go back to the first row.
+    virtual void rewind() = 0;
+
+    /// \brief Read the next rows.
+    /// \param maxRows The largest number of rows to read.
+    /// \param chunk The chunk to fill. Its storage is reused between reads.
+    /// \returns false if no rows were left.
+    virtual bool read(long maxRows, RowChunk& chunk) = 0;
+
+};
+
+
+/// \brief Reads the rows of a dense matrix in memory.
+///
+/// The matrix is not copied and must outlive the reader.
+class DenseRowReader: public RowReader
+{
+public:
+    /// \brief Create a reader.
+    /// \param rows The matrix with one sample per row.
+    DenseRowReader(const dlib::matrix<double>& rows);
+
+    long numColumns() const override;
+    void rewind() override;
+    bool read(long maxRows, RowChunk& chunk) override;
+
+private:
+    const dlib::matrix<double>& _rows;
+
+    long _next = 0;
+
+};
+
+
+/// \brief Reads sparse rows in memory.
+///
+/// The rows are not copied and must outlive the reader.
+class SparseRowReader: public RowReader
+{
+public:
+    /// \brief Create a reader.
+    /// \param rows The sparse rows.
+    /// \param numColumns The number of columns. All column indices must be
+    ///        less than this.
+    SparseRowReader(const std::vector<SparseRow>& rows, long numColumns);
+
+    long numColumns() const override;
+    void rewind() override;
+    bool read(long maxRows, RowChunk& chunk) override;
+
+private:
+    const std::vector<SparseRow>& _rows;
+
+    long _numColumns = 0;
+
+    std::size_t _next = 0;
+
+};
+
+
+/// \brief Reads dense rows from a raw binary file.
+///
+/// The file holds the rows one after the other, each numColumns float or
+/// double values in the byte order of the machine, with no header. Only one
+/// chunk is in memory at a time, so the file can be far larger than memory.
+class FileRowReader: public RowReader
+{
+public:
+    /// \brief The value type of the file.
+    enum ValueType
+    {
+        /// \brief 32 bit floats.
+        FLOAT32,
+        /// \brief 64 bit doubles.
+        FLOAT64
+    };
+
+    /// \brief Open a file.
+    /// \param path The file path.
+    /// \param numColumns The number of values per row.
+    /// \param type The value type.
+    /// \throws std::runtime_error if the file can't be opened or its size
+    ///         isn't a whole number of rows.
+    /// \throws std::invalid_argument if numColumns isn't positive.
+    FileRowReader(const std::string& path, long numColumns, ValueType type = FLOAT32);
+
+    long numColumns() const override;
+    void rewind() override;
+    bool read(long maxRows, RowChunk& chunk) override;
+
+    /// \returns the number of rows in the file.
+    long numRows() const
+    {
+        return _numRows;
+    }
+
+private:
+    std::ifstream _stream;
+
+    long _numColumns = 0;
+
+    long _numRows = 0;
+
+    long _next = 0;
+
+    ValueType _type = FLOAT32;
+
+    std::vector<float> _buffer;
+
+};
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,331 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "dlib/serialize.h"
+#include "ofEvents.h"
+#include "ofUtils.h"
+#include "ofx/Dlib/Utils.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Load statistics for a single model.
+struct ModelLoadStats
+{
+    /// \brief The name the model was registered with.
+    std::string name;
+
+    /// \brief The path the model was loaded from, if any.
+    std::string path;
+
+    /// \brief True if the model finished loading without error.
+    bool ready = false;
+
+    /// \brief True if the model failed to load.
+    bool failed = false;
+
+    /// \brief The error message if the model failed to load.
+    std::string error;
+
+    /// \brief The wall-clock time spent loading the model in milliseconds.
+    double loadTimeMs = 0;
+
+    /// \brief The change in process resident memory during the load in bytes.
+    ///
+    /// When several models load at once the loads overlap, so this is only an
+    /// approximation of the memory attributable to a single model.
+    int64_t residentMemoryDelta = 0;
+
+    /// \brief The process resident memory when the load finished in bytes.
+    uint64_t residentMemory = 0;
+
+};
+
+
+/// \brief Load dlib models in parallel on background threads.
+///
+/// Each call to load() starts a background thread and returns immediately
+/// with a future for the loaded model. Pipelines can poll isReady() or get()
+/// and start working with the models that are available (e.g. run face
+/// detection while the recognition network is still loading).
+///
+/// Readiness events are dispatched on the thread that calls update(), which
+/// is typically the main thread.
+///
+///     ofxDlib::ModelLoader loader;
+///     loader.load<dlib::shape_predictor>("sp", "shape_predictor_68_face_landmarks.dat");
+///     ...
+///     if (auto sp = loader.get<dlib::shape_predictor>("sp")) { ... }
+///
+/// The destructor blocks until all pending loads are finished.
+class ModelLoader
+{
+public:
+    /// \brief A function that fills the passed model.
+    template <typename ModelType>
+    using LoadFunction = std::function<void(ModelType&)>;
+
+    /// \brief A shared future to a loaded model.
+    template <typename ModelType>
+    using Future = std::shared_future<std::shared_ptr<ModelType>>;
+
+    ModelLoader();
+
+    /// \brief Wait for any pending loads to complete before destruction.
+    ~ModelLoader();
+
+    /// \brief Deserialize a model from a file on a background thread.
+    /// \param name A unique name for the model.
+    /// \param path The path to the serialized model. Relative paths are
+    ///        resolved with ofToDataPath().
+    /// \returns a future for the loaded model.
+    /// \throws std::invalid_argument if the name is already registered.
+    /// \tparam ModelType A type that can be loaded with dlib::deserialize.
+    template <typename ModelType>
+    Future<ModelType> load(const std::string& name, const std::string& path);
+
+    /// \brief Create a model using a custom load function on a background thread.
+    ///
+    ///     loader.load<dlib::frontal_face_detector>("detector", [](dlib::frontal_face_detector& d) {
+    ///         d = dlib::get_frontal_face_detector();
+    ///     });
+    ///
+    /// \param name A unique name for the model.
+    /// \param loadFunction The function that fills a default constructed model.
+    /// \returns a future for the loaded model.
+    /// \throws std::invalid_argument if the name is already registered.
+    /// \tparam ModelType A default constructible model type.
+    template <typename ModelType>
+    Future<ModelType> load(const std::string& name, LoadFunction<ModelType> loadFunction);
+
+    /// \brief Get a loaded model without blocking.
+    /// \param name The name of the model.
+    /// \returns the model or nullptr if it is not ready, has failed or is
+    ///          not of the requested type.
+    template <typename ModelType>
+    std::shared_ptr<ModelType> get(const std::string& name) const;
+
+    /// \brief Get a loaded model, blocking until it is loaded.
+    /// \param name The name of the model.
+    /// \returns the model or nullptr if it failed or is not of the requested type.
+    template <typename ModelType>
+    std::shared_ptr<ModelType> wait(const std::string& name) const;
+
+    /// \param name The name of the model.
+    /// \returns true if the named model is loaded and ready for use.
+    bool isReady(const std::string& name) const;
+
+    /// \param names The names of the models.
+    /// \returns true if all of the named models are loaded and ready for use.
+    bool isReady(const std::vector<std::string>& names) const;
+
+    /// \returns true if any models are still loading.
+    bool isLoading() const;
+
+    /// \brief Block until all pending loads are finished.
+    void waitForAll() const;
+
+    /// \param name The name of the model.
+    /// \returns the load statistics for the named model.
+    ModelLoadStats stats(const std::string& name) const;
+
+    /// \returns the load statistics for all models in registration order.
+    std::vector<ModelLoadStats> stats() const;
+
+    /// \brief Dispatch readiness events for models that finished loading.
+    ///
+    /// Call this from the thread that should receive onModelLoaded events,
+    /// usually in ofApp::update().
+    void update();
+
+    /// \brief Notified from update() once for each model that finished or failed.
+    ofEvent<const ModelLoadStats> onModelLoaded;
+
+private:
+    struct AbstractEntry
+    {
+        virtual ~AbstractEntry()
+        {
+        }
+
+        virtual bool isFinished() const = 0;
+        virtual void wait() const = 0;
+
+        ModelLoadStats stats;
+        bool notified = false;
+    };
+
+    template <typename ModelType>
+    struct Entry: public AbstractEntry
+    {
+        bool isFinished() const override
+        {
+            return future.valid()
+                && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
+
+        void wait() const override
+        {
+            if (task.valid())
+                task.wait();
+        }
+
+        /// \brief The model, published before the stats are marked ready.
+        Future<ModelType> future;
+
+        /// \brief The worker, finished once the stats are recorded.
+        std::shared_future<void> task;
+    };
+
+    /// \brief Register a model and start loading it.
+    /// \throws std::invalid_argument if the name is already registered.
+    template <typename ModelType>
+    Future<ModelType> _load(const std::string& name,
+                            const std::string& path,
+                            LoadFunction<ModelType> loadFunction);
+
+    /// \brief Register a named entry.
+    /// \throws std::invalid_argument if the name is already registered.
+    void _add(const std::string& name, std::shared_ptr<AbstractEntry> entry);
+
+    /// \brief Record stats when a worker finishes.
+    void _finish(const std::string& name,
+                 double loadTimeMs,
+                 uint64_t residentMemoryBefore,
+                 const std::string& error);
+
+    /// \brief Guards the entries and their stats.
+    mutable std::mutex _mutex;
+
+    /// \brief The model entries keyed by name.
+    std::map<std::string, std::shared_ptr<AbstractEntry>> _entries;
+
+    /// \brief Model names in registration order.
+    std::vector<std::string> _names;
+
+};
+
+
+template <typename ModelType>
+ModelLoader::Future<ModelType> ModelLoader::load(const std::string& name,
+                                                 const std::string& path)
+{
+    std::string resolvedPath = ofToDataPath(path, true);
+
+    return _load<ModelType>(name, resolvedPath, [resolvedPath](ModelType& model) {
+        dlib::deserialize(resolvedPath) >> model;
+    });
+}
+
+
+template <typename ModelType>
+ModelLoader::Future<ModelType> ModelLoader::load(const std::string& name,
+                                                 LoadFunction<ModelType> loadFunction)
+{
+    return _load<ModelType>(name, "", loadFunction);
+}
+
+
+template <typename ModelType>
+ModelLoader::Future<ModelType> ModelLoader::_load(const std::string& name,
+                                                  const std::string& path,
+                                                  LoadFunction<ModelType> loadFunction)
+{
+    auto entry = std::make_shared<Entry<ModelType>>();
+    entry->stats.name = name;
+    entry->stats.path = path;
+
+    auto promise = std::make_shared<std::promise<std::shared_ptr<ModelType>>>();
+    entry->future = promise->get_future().share();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _add(name, entry);
+
+    entry->task = std::async(std::launch::async, [this, name, loadFunction, promise]() {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t residentMemoryBefore = residentMemoryBytes();
+
+        std::shared_ptr<ModelType> model;
+        std::string error;
+
+        try
+        {
+            model = std::make_shared<ModelType>();
+            loadFunction(*model);
+        }
+        catch (const std::exception& exc)
+        {
+            model.reset();
+            error = exc.what();
+        }
+
+        auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+
+        // Publish the model first, so get() never blocks once isReady() is
+        // true.
+        promise->set_value(model);
+        _finish(name, elapsed.count(), residentMemoryBefore, error);
+    }).share();
+
+    return entry->future;
+}
+
+
+template <typename ModelType>
+std::shared_ptr<ModelType> ModelLoader::get(const std::string& name) const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto iter = _entries.find(name);
+
+    if (iter == _entries.end())
+        return nullptr;
+
+    auto entry = std::dynamic_pointer_cast<Entry<ModelType>>(iter->second);
+
+    if (!entry || !entry->isFinished())
+        return nullptr;
+
+    return entry->future.get();
+}
+
+
+template <typename ModelType>
+std::shared_ptr<ModelType> ModelLoader::wait(const std::string& name) const
+{
+    std::shared_ptr<Entry<ModelType>> entry;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto iter = _entries.find(name);
+        if (iter != _entries.end())
+            entry = std::dynamic_pointer_cast<Entry<ModelType>>(iter->second);
+    }
+
+    if (!entry)
+        return nullptr;
+
+    // Waiting happens outside of the lock so the worker can record its stats.
+    return entry->future.get();
+}
+
+
+} } // namespace ofx::Dlib
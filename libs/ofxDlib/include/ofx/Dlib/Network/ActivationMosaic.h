@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <vector>
+#include "ofPixels.h"
+#include "ofRectangle.h"
+#include "ofx/Dlib/Network/ActivationStore.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Tiles the activations of an ActivationStore into a grayscale mosaic.
+///
+/// The store already holds every sample, so a mosaic is built by reading it
+/// and the network never runs again. A mosaic can show one channel of a layer
+/// for many samples, to compare how digits excite the same filter, or all
+/// channels of a layer for one sample, like ActivationTap.
+///
+///     ActivationMosaic mosaic;
+///     mosaic.buildChannel(store, store.indexOf(LeNet5::relu_3), 0);
+///     texture.loadData(mosaic.getPixels());
+class ActivationMosaic
+{
+public:
+    /// \brief How activation values are mapped to [0, 255].
+    enum Normalization
+    {
+        /// \brief Map each tile from its own minimum and maximum.
+        NORMALIZE_TILE,
+        /// \brief Map all tiles from the mosaic minimum and maximum.
+        NORMALIZE_MOSAIC
+    };
+
+    struct Settings
+    {
+        /// \brief The activation value mapping.
+        Normalization normalization = NORMALIZE_MOSAIC;
+
+        /// \brief The number of tile columns, or 0 for a square-ish grid.
+        std::size_t columns = 0;
+
+        /// \brief The gap between tiles in pixels.
+        std::size_t padding = 1;
+    };
+
+    /// \brief Create a mosaic with default settings.
+    ActivationMosaic();
+
+    /// \brief Create a mosaic.
+    /// \param settings The mosaic settings.
+    ActivationMosaic(const Settings& settings);
+
+    /// \brief Tile one channel of a layer for many samples.
+    /// \param store The activation store.
+    /// \param layer The layer index.
+    /// \param channel The channel index.
+    /// \param samples The sample indices in tile order, or empty for all.
+    /// \throws std::out_of_range if an index is invalid.
+    void buildChannel(const ActivationStore& store,
+                      std::size_t layer,
+                      std::size_t channel,
+                      const std::vector<std::size_t>& samples = {});
+
+    /// \brief Tile all channels of a layer for one sample.
+    /// \param store The activation store.
+    /// \param sample The sample index.
+    /// \param layer The layer index.
+    /// \throws std::out_of_range if an index is invalid.
+    void buildSample(const ActivationStore& store,
+                     std::size_t sample,
+                     std::size_t layer);
+
+    /// \returns the mosaic of the last build.
+    const ofPixels& getPixels() const
+    {
+        return _pixels;
+    }
+
+    /// \brief Get the location of a tile.
+    /// \param tile The tile index, i.e. the position in the sample list of
+    ///        buildChannel() or the channel index of buildSample().
+    /// \returns the tile rectangle in mosaic pixels.
+    ofRectangle getTile(std::size_t tile) const;
+
+    /// \returns the number of tiles of the last build.
+    std::size_t size() const
+    {
+        return _tiles.size();
+    }
+
+    /// \returns the settings.
+    const Settings& settings() const
+    {
+        return _settings;
+    }
+
+private:
+    /// \brief Tile the _nr x _nc planes of _tiles into _pixels.
+    void _build();
+
+    Settings _settings;
+
+    ofPixels _pixels;
+
+    /// \brief The planes of the current build, reused between builds.
+    std::vector<const float*> _tiles;
+
+    std::size_t _columns = 0;
+    long _nr = 0;
+    long _nc = 0;
+
+};
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,253 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <vector>
+#include "dlib/dnn.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Stores the tagged layer outputs of a whole batch of samples.
+///
+/// capture() runs the inputs through the network in batches and copies the
+/// output of every tagged layer, for every sample, into one contiguous array.
+/// The values of a sample are stored together, layer by layer, and each layer
+/// is stored channel by channel like a dlib::tensor sample:
+///
+///     [sample 0: layer 0 (k x nr x nc), layer 1, ...][sample 1: ...]
+///
+/// so data(sample, layer, channel) points at one nr x nc plane. Layers are
+/// ordered like dlib::visit_layers(), from the network output to the input.
+///
+/// The 11 tagged layers of LeNet5::TaggedNet hold 18,058 floats, about 72 kB
+/// per sample. Most of that is the first convolution and its relu, 6x28x28
+/// floats or about 19 kB each, and the second convolution and its relu,
+/// 16x14x14 floats or about 12.5 kB each. Pass a list of tags to keep only
+/// the layers of interest for large batches.
+///
+///     ActivationStore store;
+///     store.capture(net, images, { LeNet5::relu_3, LeNet5::relu_2 });
+///
+///     std::size_t layer = store.indexOf(LeNet5::relu_3);
+///     const float* plane = store.data(17, layer, 2);
+class ActivationStore
+{
+public:
+    /// \brief The shape and location of a captured layer.
+    struct Layer
+    {
+        /// \brief The tag id of the layer, e.g. LeNet5::relu_3.
+        unsigned long tag = 0;
+
+        /// \brief The number of channels.
+        long k = 0;
+
+        /// \brief The number of rows of each channel.
+        long nr = 0;
+
+        /// \brief The number of columns of each channel.
+        long nc = 0;
+
+        /// \brief The offset of the layer within a sample.
+        std::size_t offset = 0;
+
+        /// \returns the number of values of one channel.
+        std::size_t channelSize() const
+        {
+            return std::size_t(nr) * std::size_t(nc);
+        }
+
+        /// \returns the number of values of one sample.
+        std::size_t size() const
+        {
+            return std::size_t(k) * channelSize();
+        }
+    };
+
+    /// \brief Create an empty store.
+    ActivationStore();
+
+    /// \brief Run a batch through a network and store its tagged layer outputs.
+    ///
+    /// The network runs once per batchSize inputs, and the storage is reused
+    /// when the number of samples and the layer shapes don't change.
+    ///
+    /// \param net The network. Its layer outputs are overwritten.
+    /// \param inputs The network inputs.
+    /// \param tags The tag ids of the layers to store, or empty for all.
+    /// \param batchSize The number of inputs per forward pass.
+    /// \throws std::invalid_argument if one of the tags isn't in the network.
+    template <typename NET>
+    void capture(NET& net,
+                 const std::vector<typename NET::input_type>& inputs,
+                 const std::vector<unsigned long>& tags = {},
+                 std::size_t batchSize = 128);
+
+    /// \brief Remove all samples and layers.
+    void clear();
+
+    /// \returns the number of stored samples.
+    std::size_t numSamples() const
+    {
+        return _numSamples;
+    }
+
+    /// \returns the number of stored layers per sample.
+    std::size_t numLayers() const
+    {
+        return _layers.size();
+    }
+
+    /// \returns the number of values stored per sample.
+    std::size_t sampleSize() const
+    {
+        return _sampleSize;
+    }
+
+    /// \returns the stored layers.
+    const std::vector<Layer>& layers() const
+    {
+        return _layers;
+    }
+
+    /// \brief Get a stored layer.
+    /// \param layer The layer index.
+    /// \returns the layer.
+    /// \throws std::out_of_range if the index is invalid.
+    const Layer& layer(std::size_t layer) const;
+
+    /// \brief Find a stored layer by tag.
+    /// \param tag The tag id, e.g. LeNet5::relu_3.
+    /// \returns the index of the first layer with the tag.
+    /// \throws std::invalid_argument if no stored layer has the tag.
+    std::size_t indexOf(unsigned long tag) const;
+
+    /// \brief Get the values of one channel of one sample.
+    /// \param sample The sample index.
+    /// \param layer The layer index.
+    /// \param channel The channel index.
+    /// \returns a pointer to nr x nc values, row major.
+    /// \throws std::out_of_range if an index is invalid.
+    const float* data(std::size_t sample,
+                      std::size_t layer,
+                      std::size_t channel = 0) const;
+
+    /// \returns all values.
+    const std::vector<float>& values() const
+    {
+        return _values;
+    }
+
+private:
+    /// \brief A tagged layer output found by visit_layers().
+    struct Output
+    {
+        unsigned long tag = 0;
+        const dlib::tensor* tensor = nullptr;
+    };
+
+    /// \brief Collects the tagged layer outputs in output to input order.
+    struct Visitor
+    {
+        std::vector<Output>& outputs;
+
+        template <unsigned long ID, typename SUBNET, typename E>
+        void operator()(std::size_t, dlib::add_tag_layer<ID, SUBNET, E>& l)
+        {
+            outputs.push_back({ ID, &l.get_output() });
+        }
+
+        template <typename T>
+        void operator()(std::size_t, T&)
+        {
+        }
+    };
+
+    /// \brief Select the outputs to store and lay out the storage.
+    /// \returns the output index of each stored layer.
+    std::vector<std::size_t> _allocate(const std::vector<Output>& outputs,
+                                       const std::vector<unsigned long>& tags,
+                                       std::size_t numSamples);
+
+    /// \brief Copy every sample of a layer output.
+    /// \param firstSample The index of the tensor's first sample in the store.
+    /// \param layer The layer index.
+    /// \param output The layer output.
+    void _copy(std::size_t firstSample,
+               std::size_t layer,
+               const dlib::tensor& output);
+
+    /// \brief Run the whole network, excluding the loss.
+    template <typename NET>
+    static auto _forwardNetwork(NET& net, const dlib::tensor& input, int) -> decltype(net.loss_details(), void())
+    {
+        net.subnet().forward(input);
+    }
+
+    template <typename NET>
+    static void _forwardNetwork(NET& net, const dlib::tensor& input, long)
+    {
+        net.forward(input);
+    }
+
+    std::vector<Layer> _layers;
+
+    std::size_t _numSamples = 0;
+    std::size_t _sampleSize = 0;
+
+    std::vector<float> _values;
+
+};
+
+
+template <typename NET>
+void ActivationStore::capture(NET& net,
+                              const std::vector<typename NET::input_type>& inputs,
+                              const std::vector<unsigned long>& tags,
+                              std::size_t batchSize)
+{
+    batchSize = std::max(std::size_t(1), batchSize);
+
+    if (inputs.empty())
+    {
+        clear();
+        return;
+    }
+
+    dlib::resizable_tensor input;
+    std::vector<Output> outputs;
+    std::vector<std::size_t> selected;
+
+    for (std::size_t first = 0; first < inputs.size(); first += batchSize)
+    {
+        const std::size_t last = std::min(inputs.size(), first + batchSize);
+
+        net.to_tensor(inputs.begin() + first, inputs.begin() + last, input);
+        _forwardNetwork(net, input, 0);
+
+        // The outputs are found after each pass since a forward pass may
+        // reallocate them.
+        outputs.clear();
+        Visitor visitor = { outputs };
+        dlib::visit_layers(net, visitor);
+
+        if (first == 0)
+            selected = _allocate(outputs, tags, inputs.size());
+
+        for (std::size_t i = 0; i < selected.size(); ++i)
+            _copy(first, i, *outputs[selected[i]].tensor);
+    }
+}
+
+
+} } // namespace ofx::Dlib
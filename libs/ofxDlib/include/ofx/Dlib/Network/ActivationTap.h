@@ -0,0 +1,212 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dlib/dnn.h"
+#include "ofPixels.h"
+#include "ofRectangle.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Captures layer outputs and tiles them into atlases off the inference thread.
+///
+/// After each forward pass the inference thread copies the selected layer
+/// outputs into a reusable snapshot and submits it. A worker thread then
+/// normalizes every channel and tiles them into one grayscale atlas per layer.
+/// The main thread picks up finished atlases with update().
+///
+/// Snapshots are buffered so that neither side waits for the other. The
+/// inference thread fills one snapshot while the worker reads another. If the
+/// worker is still busy when a new snapshot is submitted, the pending snapshot
+/// is replaced by the newer one and the older one is dropped.
+///
+///     // Inference thread.
+///     net(image);
+///     tap.capture<LeNet5::tag_9_relu_3>("con_1", net);
+///     tap.capture<LeNet5::tag_6_relu_2>("con_0", net);
+///     tap.submit();
+///
+///     // Main thread.
+///     if (tap.update())
+///         texture.loadData(tap.getAtlas("con_1"));
+class ActivationTap
+{
+public:
+    /// \brief How channel values are mapped to [0, 255].
+    enum Normalization
+    {
+        /// \brief Map each channel from its own minimum and maximum.
+        NORMALIZE_CHANNEL,
+        /// \brief Map all channels of a layer from the layer minimum and maximum.
+        NORMALIZE_LAYER
+    };
+
+    struct Settings
+    {
+        /// \brief The channel value mapping.
+        Normalization normalization = NORMALIZE_CHANNEL;
+
+        /// \brief The number of channel columns, or 0 for a square-ish grid.
+        std::size_t columns = 0;
+
+        /// \brief The gap between channel tiles in pixels.
+        std::size_t padding = 1;
+    };
+
+    /// \brief Start the worker thread with default settings.
+    ActivationTap();
+
+    /// \brief Start the worker thread.
+    /// \param settings The atlas settings.
+    ActivationTap(const Settings& settings);
+
+    /// \brief Stop the worker thread.
+    ~ActivationTap();
+
+    ActivationTap(const ActivationTap&) = delete;
+    ActivationTap& operator = (const ActivationTap&) = delete;
+
+    /// \brief Copy one sample of a tensor into the current snapshot.
+    ///
+    /// The snapshot storage is reused, so after the first capture of a layer
+    /// this only copies the sample's values.
+    ///
+    /// \param name The name of the layer, used to look up its atlas.
+    /// \param output The layer output.
+    /// \param sample The index of the sample to capture.
+    void capture(const std::string& name,
+                 const dlib::tensor& output,
+                 long sample = 0);
+
+    /// \brief Copy the output of a tagged layer into the current snapshot.
+    /// \param name The name of the layer, used to look up its atlas.
+    /// \param net The network that has just run a forward pass.
+    /// \param sample The index of the sample to capture.
+    /// \tparam TAG_TYPE The tag of the layer, e.g. LeNet5::tag_9_relu_3.
+    template <template<typename> class TAG_TYPE, typename NET>
+    void capture(const std::string& name, const NET& net, long sample = 0)
+    {
+        capture(name, dlib::layer<TAG_TYPE>(net).get_output(), sample);
+    }
+
+    /// \brief Hand the current snapshot to the worker thread.
+    ///
+    /// This only swaps buffers and never waits for the worker.
+    void submit();
+
+    /// \brief Pick up the latest finished atlases.
+    ///
+    /// Call this from the thread that reads the atlases, e.g. in ofApp::update().
+    ///
+    /// \returns true if new atlases are available.
+    bool update();
+
+    /// \brief Get the atlas of a layer.
+    /// \param name The name used with capture().
+    /// \returns the atlas, or empty pixels if the layer is unknown.
+    const ofPixels& getAtlas(const std::string& name) const;
+
+    /// \brief Get the location of a channel in a layer's atlas.
+    /// \param name The name used with capture().
+    /// \param channel The channel index.
+    /// \returns the tile rectangle in atlas pixels.
+    ofRectangle getTile(const std::string& name, std::size_t channel) const;
+
+    /// \returns the names of the layers with atlases.
+    std::vector<std::string> getNames() const;
+
+    /// \returns the number of snapshots turned into atlases.
+    uint64_t getFrameCount() const;
+
+    /// \returns the number of snapshots replaced before the worker got to them.
+    uint64_t getDroppedCount() const;
+
+private:
+    /// \brief A copy of one sample of a layer output.
+    struct LayerSnapshot
+    {
+        long k = 0;
+        long nr = 0;
+        long nc = 0;
+        std::vector<float> data;
+    };
+
+    /// \brief The outputs captured after one forward pass.
+    struct Snapshot
+    {
+        std::map<std::string, LayerSnapshot> layers;
+    };
+
+    /// \brief A tiled layer output.
+    struct Atlas
+    {
+        ofPixels pixels;
+        std::size_t columns = 0;
+        long nr = 0;
+        long nc = 0;
+    };
+
+    typedef std::map<std::string, Atlas> Atlases;
+
+    /// \brief The worker thread loop.
+    void _run();
+
+    /// \brief Tile a layer snapshot into an atlas.
+    void _build(const LayerSnapshot& layer, Atlas& atlas) const;
+
+    Settings _settings;
+
+    /// \brief The snapshot filled by capture(). Only used by the inference thread.
+    std::unique_ptr<Snapshot> _writeSnapshot;
+
+    /// \brief The submitted snapshot waiting for the worker.
+    std::unique_ptr<Snapshot> _pendingSnapshot;
+
+    /// \brief The snapshot the worker is reading.
+    std::unique_ptr<Snapshot> _workSnapshot;
+
+    /// \brief True if _pendingSnapshot holds a new snapshot.
+    bool _hasPendingSnapshot = false;
+
+    /// \brief The atlases the worker is writing.
+    std::unique_ptr<Atlases> _workAtlases;
+
+    /// \brief The finished atlases waiting for update().
+    std::unique_ptr<Atlases> _pendingAtlases;
+
+    /// \brief The atlases returned by getAtlas().
+    std::unique_ptr<Atlases> _atlases;
+
+    /// \brief True if _pendingAtlases holds new atlases.
+    bool _hasPendingAtlases = false;
+
+    uint64_t _frameCount = 0;
+    uint64_t _droppedCount = 0;
+
+    bool _running = true;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _condition;
+    std::thread _thread;
+
+};
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,412 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <typeinfo>
+#include <vector>
+#include "dlib/dnn.h"
+#include "dlib/con_fused.h"
+#include "ofx/Dlib/Network/LayerParameters.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Copies a trained network into an inference network that uses fused
+/// layers.
+///
+/// The destination network must have the same structure as the source
+/// network, except that a con<...> optionally followed by affine<...> and
+/// relu<...> may be replaced by a single dlib::con_affine<...> or
+/// dlib::con_affine_relu<...> layer. The affine scale is folded into the
+/// filters, the affine shift is folded into the biases and the relu is
+/// applied in the convolution's output pass. All other layers are copied.
+///
+/// For example, the fused form of
+///
+///     relu<affine<con<32,7,7,2,2,input_rgb_image>>>
+///
+/// is
+///
+///     con_affine_relu<32,7,7,2,2,input_rgb_image>
+///
+/// Only per-channel (CONV_MODE) affine layers can be folded. Networks trained
+/// with bn_con should be deserialized into their affine equivalent first.
+class LayerFusion
+{
+public:
+    /// \brief Copy and fold the parameters of \p src into \p dst.
+    /// \param src The trained source network.
+    /// \param dst The fused destination network.
+    /// \param sample An input used to allocate the destination's layers. It
+    ///        is run through \p dst once, so a small input is cheapest.
+    /// \throws std::invalid_argument if the networks are not compatible.
+    template <typename SRC, typename DST>
+    static void fuse(SRC& src, DST& dst, const typename DST::input_type& sample);
+
+private:
+    /// \brief A layer of the source network.
+    struct Unit
+    {
+        enum Type
+        {
+            CONVOLUTION,
+            AFFINE,
+            RELU,
+            TAG,
+            SKIP,
+            OTHER
+        };
+
+        Type type = OTHER;
+
+        /// \brief The type of the layer details, if any.
+        const std::type_info* layerType = nullptr;
+
+        /// \brief The serialized layer details, if any.
+        std::string serialized;
+
+        /// \brief The tag id for TAG and SKIP units.
+        unsigned long tag = 0;
+
+        /// \brief The shape of a CONVOLUTION unit.
+        ConvolutionParameters convolution;
+
+        /// \brief The filters of a CONVOLUTION unit.
+        std::vector<float> filters;
+
+        /// \brief The biases of a CONVOLUTION unit, or the shift of an AFFINE unit.
+        std::vector<float> biases;
+
+        /// \brief The scale of an AFFINE unit.
+        std::vector<float> scales;
+    };
+
+    /// \brief A layer of the destination network.
+    struct Sink
+    {
+        enum Type
+        {
+            FUSED,
+            TAG,
+            SKIP,
+            OTHER
+        };
+
+        Type type = OTHER;
+
+        const std::type_info* layerType = nullptr;
+
+        unsigned long tag = 0;
+
+        /// \brief The expected convolution shape of a FUSED sink.
+        ConvolutionParameters convolution;
+
+        /// \brief True if a FUSED sink applies a relu.
+        bool relu = false;
+
+        /// \brief Assigns the parameters of a FUSED or OTHER sink.
+        std::function<void(const Unit& convolution, const Unit* affine)> assignFused;
+        std::function<void(const Unit& unit)> assign;
+    };
+
+    /// \brief Collects the source layers in output to input order.
+    struct SourceVisitor
+    {
+        std::vector<Unit>& units;
+
+        template <typename LAYER_DETAILS, typename SUBNET, typename E>
+        void operator()(std::size_t, dlib::add_layer<LAYER_DETAILS, SUBNET, E>& l)
+        {
+            Unit unit;
+            unit.layerType = &typeid(LAYER_DETAILS);
+
+            std::ostringstream out;
+            dlib::serialize(l.layer_details(), out);
+            unit.serialized = out.str();
+
+            describe(unit, l.layer_details());
+            units.push_back(unit);
+        }
+
+        template <unsigned long ID, typename SUBNET, typename E>
+        void operator()(std::size_t, dlib::add_tag_layer<ID, SUBNET, E>&)
+        {
+            Unit unit;
+            unit.type = Unit::TAG;
+            unit.tag = ID;
+            units.push_back(unit);
+        }
+
+        template <template<typename> class TAG_TYPE, typename SUBNET>
+        void operator()(std::size_t, dlib::add_skip_layer<TAG_TYPE, SUBNET>&)
+        {
+            Unit unit;
+            unit.type = Unit::SKIP;
+            unit.tag = dlib::tag_id<TAG_TYPE>::id;
+            units.push_back(unit);
+        }
+
+        /// \brief Loss, input and repeat layers carry no parameters.
+        template <typename T>
+        void operator()(std::size_t, T&)
+        {
+        }
+
+        template <long NF, long NR, long NC, int SY, int SX, int PY, int PX>
+        static void describe(Unit& unit, const dlib::con_<NF, NR, NC, SY, SX, PY, PX>& details)
+        {
+            ConvolutionParameters p = getConvolutionParameters(details);
+
+            if (p.filters == nullptr)
+                throw std::invalid_argument("LayerFusion: con layer has no parameters. Was the network loaded?");
+
+            unit.type = Unit::CONVOLUTION;
+            unit.filters.assign(p.filters, p.filters + p.numFilters * p.filterSize());
+
+            if (p.biases)
+                unit.biases.assign(p.biases, p.biases + p.numFilters);
+            else
+                unit.biases.assign(p.numFilters, 0);
+
+            p.filters = nullptr;
+            p.biases = nullptr;
+            unit.convolution = p;
+        }
+
+        static void describe(Unit& unit, const dlib::affine_& details)
+        {
+            unit.type = Unit::AFFINE;
+
+            // Non per-channel affine layers are copied, but never folded.
+            if (getAffineParameters(details, unit.scales, unit.biases) != dlib::CONV_MODE)
+                unit.type = Unit::OTHER;
+        }
+
+        static void describe(Unit& unit, const dlib::relu_&)
+        {
+            unit.type = Unit::RELU;
+        }
+
+        template <typename LAYER_DETAILS>
+        static void describe(Unit&, const LAYER_DETAILS&)
+        {
+        }
+    };
+
+    /// \brief Collects the destination layers in output to input order.
+    struct DestinationVisitor
+    {
+        std::vector<Sink>& sinks;
+
+        template <typename LAYER_DETAILS, typename SUBNET, typename E>
+        void operator()(std::size_t, dlib::add_layer<LAYER_DETAILS, SUBNET, E>& l)
+        {
+            Sink sink;
+            sink.layerType = &typeid(LAYER_DETAILS);
+
+            LAYER_DETAILS* details = &l.layer_details();
+
+            sink.assign = [details](const Unit& unit)
+            {
+                std::istringstream in(unit.serialized);
+                dlib::deserialize(*details, in);
+            };
+
+            describe(sink, l.layer_details());
+            sinks.push_back(sink);
+        }
+
+        template <unsigned long ID, typename SUBNET, typename E>
+        void operator()(std::size_t, dlib::add_tag_layer<ID, SUBNET, E>&)
+        {
+            Sink sink;
+            sink.type = Sink::TAG;
+            sink.tag = ID;
+            sinks.push_back(sink);
+        }
+
+        template <template<typename> class TAG_TYPE, typename SUBNET>
+        void operator()(std::size_t, dlib::add_skip_layer<TAG_TYPE, SUBNET>&)
+        {
+            Sink sink;
+            sink.type = Sink::SKIP;
+            sink.tag = dlib::tag_id<TAG_TYPE>::id;
+            sinks.push_back(sink);
+        }
+
+        template <typename T>
+        void operator()(std::size_t, T&)
+        {
+        }
+
+        template <long NF, long NR, long NC, int SY, int SX, dlib::fused_activation A, int PY, int PX>
+        static void describe(Sink& sink, dlib::con_fused_<NF, NR, NC, SY, SX, A, PY, PX>& details)
+        {
+            sink.type = Sink::FUSED;
+            sink.relu = (A == dlib::FUSED_RELU);
+            sink.convolution.numFilters = details.num_filters();
+            sink.convolution.nr = details.nr();
+            sink.convolution.nc = details.nc();
+            sink.convolution.strideY = details.stride_y();
+            sink.convolution.strideX = details.stride_x();
+            sink.convolution.paddingY = details.padding_y();
+            sink.convolution.paddingX = details.padding_x();
+
+            auto* target = &details;
+
+            sink.assignFused = [target](const Unit& convolution, const Unit* affine)
+            {
+                const ConvolutionParameters& p = convolution.convolution;
+                const long filterSize = p.filterSize();
+
+                std::vector<float> filters = convolution.filters;
+                std::vector<float> biases = convolution.biases;
+
+                if (affine)
+                {
+                    for (long f = 0; f < p.numFilters; ++f)
+                    {
+                        const float gamma = affine->scales[f];
+
+                        for (long i = 0; i < filterSize; ++i)
+                            filters[f * filterSize + i] *= gamma;
+
+                        biases[f] = biases[f] * gamma + affine->biases[f];
+                    }
+                }
+
+                target->set_fused_parameters(p.k, filters.data(), biases.data());
+            };
+        }
+
+        template <typename LAYER_DETAILS>
+        static void describe(Sink&, LAYER_DETAILS&)
+        {
+        }
+    };
+
+    static bool _sameShape(const ConvolutionParameters& a, const ConvolutionParameters& b)
+    {
+        return a.numFilters == b.numFilters
+            && a.nr == b.nr
+            && a.nc == b.nc
+            && a.strideY == b.strideY
+            && a.strideX == b.strideX
+            && a.paddingY == b.paddingY
+            && a.paddingX == b.paddingX;
+    }
+
+    static void _fail(std::size_t layer, const std::string& message)
+    {
+        throw std::invalid_argument("LayerFusion: destination layer " + std::to_string(layer) + ": " + message);
+    }
+
+};
+
+
+template <typename SRC, typename DST>
+void LayerFusion::fuse(SRC& src, DST& dst, const typename DST::input_type& sample)
+{
+    // Run the destination once so each layer is set up and won't reinitialize
+    // the parameters assigned below on the next forward pass.
+    dst(sample);
+
+    std::vector<Unit> units;
+    SourceVisitor sourceVisitor = { units };
+    dlib::visit_layers(src, sourceVisitor);
+
+    std::vector<Sink> sinks;
+    DestinationVisitor destinationVisitor = { sinks };
+    dlib::visit_layers(dst, destinationVisitor);
+
+    // visit_layers() goes from the output to the input.
+    std::reverse(units.begin(), units.end());
+    std::reverse(sinks.begin(), sinks.end());
+
+    std::size_t u = 0;
+
+    for (std::size_t s = 0; s < sinks.size(); ++s)
+    {
+        const Sink& sink = sinks[s];
+
+        if (u >= units.size())
+            _fail(s, "the source network has fewer layers.");
+
+        const Unit& unit = units[u];
+
+        switch (sink.type)
+        {
+            case Sink::FUSED:
+            {
+                if (unit.type != Unit::CONVOLUTION)
+                    _fail(s, "expected a con layer in the source network.");
+
+                if (!_sameShape(unit.convolution, sink.convolution))
+                    _fail(s, "the con layer shapes don't match.");
+
+                ++u;
+
+                const Unit* affine = nullptr;
+
+                if (u < units.size() && units[u].type == Unit::AFFINE)
+                    affine = &units[u++];
+
+                if (sink.relu)
+                {
+                    if (u >= units.size() || units[u].type != Unit::RELU)
+                        _fail(s, "expected a relu layer after the con layer in the source network.");
+                    ++u;
+                }
+
+                sink.assignFused(unit, affine);
+                break;
+            }
+            case Sink::TAG:
+            case Sink::SKIP:
+            {
+                const Unit::Type type = (sink.type == Sink::TAG ? Unit::TAG : Unit::SKIP);
+
+                if (unit.type != type || unit.tag != sink.tag)
+                    _fail(s, "the tag or skip layers don't match.");
+                ++u;
+                break;
+            }
+            case Sink::OTHER:
+            {
+                if (unit.layerType == nullptr || *unit.layerType != *sink.layerType)
+                    _fail(s, "the layer types don't match.");
+                sink.assign(unit);
+                ++u;
+                break;
+            }
+        }
+    }
+
+    if (u != units.size())
+        throw std::invalid_argument("LayerFusion: the source network has more layers than the destination.");
+}
+
+
+/// \brief Copy a trained network into an equivalent network with fused layers.
+/// \sa LayerFusion
+template <typename SRC, typename DST>
+void fuseLayers(SRC& src, DST& dst, const typename DST::input_type& sample)
+{
+    LayerFusion::fuse(src, dst, sample);
+}
+
+
+} } // namespace ofx::Dlib
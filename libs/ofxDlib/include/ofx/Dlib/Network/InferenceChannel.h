@@ -0,0 +1,408 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "dlib/dnn.h"
+#include "ofLog.h"
+#include "ofPixels.h"
+#include "ofx/Dlib/Utils.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Runs a grayscale image classifier on a worker thread.
+///
+/// The main thread submits CPU-side snapshots of what it draws and picks up
+/// the latest result with update(), so drawing never waits for the network.
+/// The worker converts each snapshot with downsampleToGrayscale() into an
+/// input matrix that is reused for every frame and runs its own copy of the
+/// network on it.
+///
+/// Like ActivationTap, snapshots are buffered so that neither side waits for
+/// the other. If the worker is still busy when a new snapshot is submitted,
+/// the pending snapshot is replaced by the newer one and the older one is
+/// dropped, so results never fall behind the drawing.
+///
+///     InferenceChannel<LeNet5::Net> channel(net);
+///
+///     // ofApp::update()
+///     fbo.readToPixels(pixels);
+///     channel.submit(pixels);
+///
+///     if (channel.update())
+///         label = channel.getResult().label;
+///
+/// A hook can be set to read the network on the worker thread after each
+/// forward pass, e.g. to capture layer outputs with an ActivationTap.
+///
+/// \tparam NET A network that takes a dlib::matrix<unsigned char>.
+template <typename NET>
+class InferenceChannel
+{
+public:
+    typedef typename NET::output_label_type label_type;
+
+    /// \brief Called on the worker thread after each forward pass.
+    typedef std::function<void(NET&)> Hook;
+
+    /// \brief The result of one snapshot.
+    struct Result
+    {
+        /// \brief The number of the result, starting at 1.
+        uint64_t frame = 0;
+
+        /// \brief The network input made from the snapshot.
+        dlib::matrix<unsigned char> input;
+
+        /// \brief The network output label.
+        label_type label;
+
+        /// \brief The output of the layer below the loss layer, e.g. the
+        ///        score of each class.
+        std::vector<float> output;
+
+        /// \brief The time from submit() until the result was ready in
+        ///        milliseconds.
+        double latencyMs = 0;
+
+        /// \brief The time spent converting the snapshot and running the
+        ///        network in milliseconds.
+        double inferenceMs = 0;
+    };
+
+    struct Settings
+    {
+        /// \brief The number of rows of the network input.
+        long rows = 28;
+
+        /// \brief The number of columns of the network input.
+        long columns = 28;
+    };
+
+    /// \brief Start the worker thread with default settings.
+    /// \param net The network to copy.
+    InferenceChannel(const NET& net);
+
+    /// \brief Start the worker thread.
+    /// \param net The network to copy.
+    /// \param settings The channel settings.
+    InferenceChannel(const NET& net, const Settings& settings);
+
+    /// \brief Stop the worker thread.
+    ~InferenceChannel();
+
+    InferenceChannel(const InferenceChannel&) = delete;
+    InferenceChannel& operator = (const InferenceChannel&) = delete;
+
+    /// \brief Set the function called on the worker thread after each
+    ///        forward pass.
+    /// \param hook The hook, or an empty function for none.
+    void setHook(Hook hook);
+
+    /// \brief Hand a snapshot to the worker thread.
+    ///
+    /// The pixels are copied into a reused buffer, so the caller may change
+    /// them right away. This never waits for the worker.
+    ///
+    /// \param pixels The pixels to classify.
+    void submit(const ofPixels& pixels);
+
+    /// \brief Hand a ready network input to the worker thread.
+    ///
+    /// Use this for inputs that are already rows x columns, e.g. from a
+    /// StrokeRasterizer. This never waits for the worker.
+    ///
+    /// \param input The network input.
+    void submit(const dlib::matrix<unsigned char>& input);
+
+    /// \brief Pick up the latest result.
+    ///
+    /// Call this from the thread that reads the result, e.g. in
+    /// ofApp::update().
+    ///
+    /// \returns true if a new result is available.
+    bool update();
+
+    /// \returns the result picked up by the last update().
+    const Result& getResult() const
+    {
+        return *_result;
+    }
+
+    /// \returns the number of snapshots the worker has finished.
+    uint64_t getFrameCount() const;
+
+    /// \returns the number of snapshots replaced before the worker got to them.
+    uint64_t getDroppedCount() const;
+
+    /// \returns the settings.
+    const Settings& settings() const
+    {
+        return _settings;
+    }
+
+private:
+    typedef std::chrono::high_resolution_clock clock;
+
+    /// \brief A submitted frame.
+    struct Snapshot
+    {
+        ofPixels pixels;
+        dlib::matrix<unsigned char> input;
+
+        /// \brief True if input was submitted instead of pixels.
+        bool hasInput = false;
+    };
+
+    /// \brief Hand the write snapshot to the worker thread.
+    void _submit();
+
+    /// \brief The worker thread loop.
+    void _run();
+
+    Settings _settings;
+
+    /// \brief The worker's copy of the network.
+    NET _net;
+
+    Hook _hook;
+
+    /// \brief The snapshot filled by submit(). Only used by the main thread.
+    std::unique_ptr<Snapshot> _writeSnapshot;
+
+    /// \brief The submitted snapshot waiting for the worker.
+    std::unique_ptr<Snapshot> _pendingSnapshot;
+
+    /// \brief The snapshot the worker is reading.
+    std::unique_ptr<Snapshot> _workSnapshot;
+
+    /// \brief The time the pending snapshot was submitted.
+    clock::time_point _pendingTime;
+
+    /// \brief True if _pendingSnapshot holds a new snapshot.
+    bool _hasPendingSnapshot = false;
+
+    /// \brief The result the worker is writing.
+    std::unique_ptr<Result> _workResult;
+
+    /// \brief The finished result waiting for update().
+    std::unique_ptr<Result> _pendingResult;
+
+    /// \brief The result returned by getResult().
+    std::unique_ptr<Result> _result;
+
+    /// \brief True if _pendingResult holds a new result.
+    bool _hasPendingResult = false;
+
+    uint64_t _frameCount = 0;
+    uint64_t _droppedCount = 0;
+
+    bool _running = true;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _condition;
+    std::thread _thread;
+
+};
+
+
+template <typename NET>
+InferenceChannel<NET>::InferenceChannel(const NET& net):
+    InferenceChannel(net, Settings())
+{
+}
+
+
+template <typename NET>
+InferenceChannel<NET>::InferenceChannel(const NET& net, const Settings& settings):
+    _settings(settings),
+    _net(net),
+    _writeSnapshot(new Snapshot()),
+    _pendingSnapshot(new Snapshot()),
+    _workSnapshot(new Snapshot()),
+    _workResult(new Result()),
+    _pendingResult(new Result()),
+    _result(new Result())
+{
+    _result->input = dlib::zeros_matrix<unsigned char>(_settings.rows, _settings.columns);
+    _thread = std::thread(&InferenceChannel::_run, this);
+}
+
+
+template <typename NET>
+InferenceChannel<NET>::~InferenceChannel()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+    }
+
+    _condition.notify_all();
+
+    if (_thread.joinable())
+        _thread.join();
+}
+
+
+template <typename NET>
+void InferenceChannel<NET>::setHook(Hook hook)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _hook = hook;
+}
+
+
+template <typename NET>
+void InferenceChannel<NET>::submit(const ofPixels& pixels)
+{
+    // ofPixels keeps its allocation when the size and format don't change.
+    _writeSnapshot->pixels = pixels;
+    _writeSnapshot->hasInput = false;
+    _submit();
+}
+
+
+template <typename NET>
+void InferenceChannel<NET>::submit(const dlib::matrix<unsigned char>& input)
+{
+    _writeSnapshot->input = input;
+    _writeSnapshot->hasInput = true;
+    _submit();
+}
+
+
+template <typename NET>
+void InferenceChannel<NET>::_submit()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        if (_hasPendingSnapshot)
+            ++_droppedCount;
+
+        std::swap(_writeSnapshot, _pendingSnapshot);
+        _pendingTime = clock::now();
+        _hasPendingSnapshot = true;
+    }
+
+    _condition.notify_one();
+}
+
+
+template <typename NET>
+bool InferenceChannel<NET>::update()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (!_hasPendingResult)
+        return false;
+
+    std::swap(_result, _pendingResult);
+    _hasPendingResult = false;
+    return true;
+}
+
+
+template <typename NET>
+uint64_t InferenceChannel<NET>::getFrameCount() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _frameCount;
+}
+
+
+template <typename NET>
+uint64_t InferenceChannel<NET>::getDroppedCount() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _droppedCount;
+}
+
+
+template <typename NET>
+void InferenceChannel<NET>::_run()
+{
+    while (true)
+    {
+        clock::time_point submitted;
+        Hook hook;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _condition.wait(lock, [&]() {
+                return _hasPendingSnapshot || !_running;
+            });
+
+            if (!_running)
+                return;
+
+            std::swap(_pendingSnapshot, _workSnapshot);
+            _hasPendingSnapshot = false;
+            submitted = _pendingTime;
+            hook = _hook;
+        }
+
+        auto start = clock::now();
+
+        try
+        {
+            if (_workSnapshot->hasInput)
+            {
+                _workResult->input = _workSnapshot->input;
+            }
+            else
+            {
+                downsampleToGrayscale(_workSnapshot->pixels,
+                                      _settings.rows,
+                                      _settings.columns,
+                                      _workResult->input);
+            }
+
+            _workResult->label = _net(_workResult->input);
+
+            const dlib::tensor& output = _net.subnet().get_output();
+            _workResult->output.assign(output.begin(), output.end());
+
+            if (hook)
+                hook(_net);
+        }
+        catch (const std::exception& exc)
+        {
+            ofLogError("InferenceChannel::_run") << exc.what();
+            continue;
+        }
+
+        auto end = clock::now();
+
+        _workResult->inferenceMs = std::chrono::duration<double, std::milli>(end - start).count();
+        _workResult->latencyMs = std::chrono::duration<double, std::milli>(end - submitted).count();
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _workResult->frame = ++_frameCount;
+            std::swap(_workResult, _pendingResult);
+            _hasPendingResult = true;
+        }
+    }
+}
+
+
+} } // namespace ofx::Dlib
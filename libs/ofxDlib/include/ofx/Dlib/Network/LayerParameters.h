@@ -0,0 +1,202 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include "dlib/dnn.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief A read-only view of a convolution layer's parameters.
+///
+/// Filters are stored as [num_filters][k][nr][nc] followed by one bias per
+/// filter, which is the layout dlib::con_ uses for get_layer_params().
+struct ConvolutionParameters
+{
+    long numFilters = 0;
+    long k = 0;
+    long nr = 0;
+    long nc = 0;
+    long strideY = 1;
+    long strideX = 1;
+    long paddingY = 0;
+    long paddingX = 0;
+
+    /// \brief The filter weights or nullptr if the layer is not set up.
+    const float* filters = nullptr;
+
+    /// \brief The biases or nullptr if the layer has none.
+    const float* biases = nullptr;
+
+    /// \returns the number of weights in a single filter.
+    long filterSize() const
+    {
+        return k * nr * nc;
+    }
+};
+
+
+/// \brief A read-only view of a fully connected layer's parameters.
+///
+/// Weights are stored as [num_inputs][num_outputs] followed by one bias per
+/// output, which is the layout dlib::fc_ uses for get_layer_params().
+struct FullyConnectedParameters
+{
+    long numInputs = 0;
+    long numOutputs = 0;
+
+    /// \brief The weights or nullptr if the layer is not set up.
+    const float* weights = nullptr;
+
+    /// \brief The biases or nullptr if the layer has none.
+    const float* biases = nullptr;
+};
+
+
+namespace Detail {
+
+
+template <typename LAYER>
+auto isBiasDisabled(const LAYER& layer, int) -> decltype(layer.bias_is_disabled(), bool())
+{
+    return layer.bias_is_disabled();
+}
+
+
+template <typename LAYER>
+bool isBiasDisabled(const LAYER&, long)
+{
+    return false;
+}
+
+
+} // namespace Detail
+
+
+/// \brief Determine if a convolution layer stores biases.
+///
+/// dlib::con_ always stores one bias per filter, unless it is built with a
+/// dlib that supports disable_bias() and the bias was disabled.
+///
+/// The parameter size can't tell the two apart: for a 1 x 1 kernel, F
+/// filters with k inputs and biases have as many values as F filters with
+/// k + 1 inputs and no biases.
+///
+/// \param layer The convolution layer.
+/// \returns true if the layer has biases.
+template <long NF, long NR, long NC, int SY, int SX, int PY, int PX>
+bool hasBiases(const dlib::con_<NF, NR, NC, SY, SX, PY, PX>& layer)
+{
+    return !Detail::isBiasDisabled(layer, 0);
+}
+
+
+/// \brief Get a view of a dlib::con_ layer's parameters.
+/// \param layer The convolution layer.
+/// \returns a view pointing into the layer's parameter tensor.
+template <long NF, long NR, long NC, int SY, int SX, int PY, int PX>
+ConvolutionParameters getConvolutionParameters(const dlib::con_<NF, NR, NC, SY, SX, PY, PX>& layer)
+{
+    ConvolutionParameters result;
+    result.numFilters = layer.num_filters();
+    result.nr = layer.nr();
+    result.nc = layer.nc();
+    result.strideY = layer.stride_y();
+    result.strideX = layer.stride_x();
+    result.paddingY = layer.padding_y();
+    result.paddingX = layer.padding_x();
+
+    const dlib::tensor& params = layer.get_layer_params();
+
+    if (params.size() == 0)
+        return result;
+
+    const long planeSize = result.numFilters * result.nr * result.nc;
+    const long size = long(params.size());
+
+    // dlib stores one bias per filter after the filters.
+    const bool biases = hasBiases(layer);
+
+    result.k = (biases ? size - result.numFilters : size) / planeSize;
+    result.filters = params.host();
+    result.biases = biases ? params.host() + result.numFilters * result.filterSize() : nullptr;
+    return result;
+}
+
+
+/// \brief Get a view of a dlib::fc_ layer's parameters.
+/// \param layer The fully connected layer.
+/// \returns a view pointing into the layer's parameter tensor.
+template <unsigned long N, dlib::fc_bias_mode M>
+FullyConnectedParameters getFullyConnectedParameters(const dlib::fc_<N, M>& layer)
+{
+    FullyConnectedParameters result;
+    result.numOutputs = long(layer.get_num_outputs());
+
+    const dlib::tensor& params = layer.get_layer_params();
+
+    if (params.size() == 0)
+        return result;
+
+    bool hasBiases = (M == dlib::FC_HAS_BIAS);
+
+    result.numInputs = long(params.size()) / result.numOutputs - (hasBiases ? 1 : 0);
+    result.weights = params.host();
+    result.biases = hasBiases ? params.host() + result.numInputs * result.numOutputs : nullptr;
+    return result;
+}
+
+
+/// \brief Get the scale (gamma) and shift (beta) of a dlib::affine_ layer.
+///
+/// dlib::affine_ does not expose its parameters, so they are read back from
+/// the layer's serialized form.
+///
+/// \param layer The affine layer.
+/// \param gamma The output scale values.
+/// \param beta The output shift values.
+/// \returns the layer mode, dlib::CONV_MODE for per-channel parameters.
+/// \throws dlib::serialization_error if the layer format is unknown.
+inline dlib::layer_mode getAffineParameters(const dlib::affine_& layer,
+                                            std::vector<float>& gamma,
+                                            std::vector<float>& beta)
+{
+    std::stringstream ss;
+    dlib::serialize(layer, ss);
+
+    std::string version;
+    dlib::resizable_tensor params;
+    dlib::alias_tensor gammaAlias;
+    dlib::alias_tensor betaAlias;
+    int mode = 0;
+
+    dlib::deserialize(version, ss);
+
+    if (version.find("affine_") != 0)
+        throw dlib::serialization_error("Unexpected version '" + version + "' found while reading affine_ parameters.");
+
+    dlib::deserialize(params, ss);
+    dlib::deserialize(gammaAlias, ss);
+    dlib::deserialize(betaAlias, ss);
+    dlib::deserialize(mode, ss);
+
+    const float* data = params.host();
+    gamma.assign(data, data + gammaAlias.size());
+    beta.assign(data + gammaAlias.size(), data + gammaAlias.size() + betaAlias.size());
+
+    return static_cast<dlib::layer_mode>(mode);
+}
+
+
+} } // namespace ofx::Dlib
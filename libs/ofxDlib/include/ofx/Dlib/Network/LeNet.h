@@ -9,6 +9,7 @@
 
 
 #include "dlib/dnn.h"
+#include "ofx/Dlib/Network/NetworkView.h"
 
 
 namespace ofx {
@@ -45,6 +46,10 @@ using Net = dlib::loss_multiclass_log<dlib::fc<10,
                                       dlib::input<dlib::matrix<unsigned char>>
                                       >>>>>>>>>>>>;
 
+// The tags below are only needed by TaggedNet, which is kept so networks
+// trained with it still load. New code can inspect LeNet5::Net directly with
+// NetView, except for the fc and con outputs, which the relu layers overwrite
+// in place. Tags keep those outputs.
 static const std::size_t ln_base    = 1100;
 static const std::size_t fc_0       = ln_base + 0;
 static const std::size_t relu_0     = ln_base + 1;
@@ -61,7 +66,7 @@ static const std::size_t con_1      = ln_base + 10;
 template <typename SUBNET> using tag_0_fc_0       = dlib::add_tag_layer<fc_0,       SUBNET>;
 template <typename SUBNET> using tag_1_relu_0     = dlib::add_tag_layer<relu_0,     SUBNET>;
 template <typename SUBNET> using tag_2_fc_1       = dlib::add_tag_layer<fc_1,       SUBNET>;
-template <typename SUBNET> using tag_3_relu_1     = dlib::add_tag_layer<relu_2,     SUBNET>;
+template <typename SUBNET> using tag_3_relu_1     = dlib::add_tag_layer<relu_1,     SUBNET>;
 template <typename SUBNET> using tag_4_fc_2       = dlib::add_tag_layer<fc_2,       SUBNET>;
 template <typename SUBNET> using tag_5_max_pool_0 = dlib::add_tag_layer<max_pool_0, SUBNET>;
 template <typename SUBNET> using tag_6_relu_2     = dlib::add_tag_layer<relu_2,     SUBNET>;
@@ -84,7 +89,18 @@ using TaggedNet = dlib::loss_multiclass_log<
                     tag_10_con_1<dlib::con<6,5,5,1,1,
                     dlib::input<dlib::matrix<unsigned char>
                     >>>>>>>>>>>>>>>>>>>>>>>>;
-    
-    
-    
+
+
+/// \brief Typed access to the layers of LeNet5::Net without tags.
+///
+/// The layer indices used by NetView::output<I>() and parameters<I>() are:
+///
+///     0 loss, 1 fc 10, 2 relu, 3 fc 84, 4 relu, 5 fc 120, 6 max_pool,
+///     7 relu, 8 con 16, 9 max_pool, 10 relu, 11 con 6, 12 input
+///
+/// The relu layers run in place, so layers 3, 5, 8 and 11 have no output of
+/// their own and NetView::output<I>() doesn't compile for them.
+using NetView = NetworkView<Net>;
+
+
 } } } // namespace ofx::Dlib::LeNet5
@@ -0,0 +1,406 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include "dlib/dnn.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Compile time facts about the details of a computational layer.
+///
+/// These mirror the checks dlib makes to decide whether a layer runs in
+/// place over the output of the layer below it.
+template <typename LAYER_DETAILS>
+struct LayerDetailsTraits
+{
+private:
+    template <typename T>
+    static constexpr auto _isInPlace(int) -> decltype(std::declval<T&>().forward_inplace(std::declval<const dlib::tensor&>(),
+                                                                                          std::declval<dlib::tensor&>()), bool())
+    {
+        return true;
+    }
+
+    template <typename T>
+    static constexpr bool _isInPlace(long)
+    {
+        return false;
+    }
+
+    template <typename T>
+    static constexpr auto _backwardRequiresOutput(int) -> decltype(std::declval<T&>().backward(std::declval<const dlib::tensor&>(),
+                                                                                                std::declval<const dlib::tensor&>(),
+                                                                                                std::declval<int&>(),
+                                                                                                std::declval<dlib::tensor&>()), bool())
+    {
+        return true;
+    }
+
+    template <typename T>
+    static constexpr auto _backwardRequiresOutput(long) -> decltype(std::declval<T&>().backward_inplace(std::declval<const dlib::tensor&>(),
+                                                                                                         std::declval<const dlib::tensor&>(),
+                                                                                                         std::declval<dlib::tensor&>(),
+                                                                                                         std::declval<dlib::tensor&>()), bool())
+    {
+        return true;
+    }
+
+    template <typename T>
+    static constexpr bool _backwardRequiresOutput(...)
+    {
+        return false;
+    }
+
+public:
+    /// \brief True if the layer can compute its output in place over its
+    ///        input, like relu.
+    static const bool IS_IN_PLACE = _isInPlace<LAYER_DETAILS>(0);
+
+    /// \brief True if the layer's backward pass reads its own output, which
+    ///        keeps an in-place layer above it from overwriting that output.
+    static const bool REQUIRES_OUTPUT = _backwardRequiresOutput<LAYER_DETAILS>(0);
+};
+
+
+/// \brief Compile time facts about one layer type of a dlib network.
+///
+/// The default describes loss, input and other layers without their own
+/// parameters.
+template <typename LAYER>
+struct LayerTraits
+{
+    /// \brief True if the layer has layer_details() and parameters.
+    static const bool IS_COMPUTATIONAL = false;
+
+    /// \brief True if the layer is an add_tag_layer.
+    static const bool IS_TAG = false;
+
+    /// \brief The tag id of an add_tag_layer, otherwise 0.
+    static const unsigned long TAG = 0;
+
+    /// \brief True if the layer runs in place over the output below it.
+    static const bool IS_IN_PLACE = false;
+
+    /// \brief True if the layer keeps its output from being overwritten by
+    ///        an in-place layer above it.
+    static const bool REQUIRES_OUTPUT = true;
+};
+
+
+template <typename LAYER_DETAILS, typename SUBNET, typename E>
+struct LayerTraits<dlib::add_layer<LAYER_DETAILS, SUBNET, E>>
+{
+    typedef LAYER_DETAILS details_type;
+
+    static const bool IS_COMPUTATIONAL = true;
+    static const bool IS_TAG = false;
+    static const unsigned long TAG = 0;
+    static const bool IS_IN_PLACE = LayerDetailsTraits<LAYER_DETAILS>::IS_IN_PLACE;
+    static const bool REQUIRES_OUTPUT = LayerDetailsTraits<LAYER_DETAILS>::REQUIRES_OUTPUT;
+};
+
+
+template <unsigned long ID, typename SUBNET, typename E>
+struct LayerTraits<dlib::add_tag_layer<ID, SUBNET, E>>
+{
+    static const bool IS_COMPUTATIONAL = false;
+    static const bool IS_TAG = true;
+    static const unsigned long TAG = ID;
+    static const bool IS_IN_PLACE = false;
+    static const bool REQUIRES_OUTPUT = true;
+};
+
+
+/// \brief Typed, index addressable access to every layer of a dlib network.
+///
+/// A view is a reference to a network. It adds nothing to the network type and
+/// no work to its forward pass, so any network's parameters and outputs can
+/// be inspected without a second tagged copy of its definition. Layers are
+/// numbered like dlib::layer<i>(net), from the loss layer at 0 to the input
+/// layer at NUM_LAYERS - 1, and every access is resolved at compile time:
+///
+///     LeNet5::Net net;
+///     NetworkView<LeNet5::Net> view(net);
+///
+///     net(image);
+///
+///     // The output of the first relu and the filters of the first con.
+///     const dlib::tensor& relu = view.output<10>();
+///     const dlib::tensor& filters = view.parameters<11>();
+///
+/// dlib runs layers like relu in place over the output of the layer below
+/// them when that layer doesn't need its output for the backward pass. In
+/// LeNet5::Net each relu overwrites the output of the fc or con below it, so
+/// after a forward pass those layers only hold the activated values.
+/// isOverwritten<I>() is true for such layers, output<I>() refuses to
+/// compile for them and forEachOutput() skips them. To read pre-activation
+/// outputs, tag the layers, since a tag keeps the layer above it from running
+/// in place (see LeNet5::TaggedNet).
+///
+/// The forEach functions walk all layers with the loop unrolled at compile
+/// time, so each call sees the exact layer type:
+///
+///     view.forEachOutput([](std::size_t i, const dlib::tensor& output) {
+///         std::cout << i << ": " << output.k() << "x" << output.nr() << "x" << output.nc() << std::endl;
+///     });
+///
+/// Layer indices can also be given at run time. These are looked up with the
+/// same unrolled walk.
+///
+/// \tparam NET The network type, which may be const.
+template <typename NET>
+class NetworkView
+{
+public:
+    typedef NET net_type;
+
+    /// \brief The number of layers, including the loss and input layers.
+    static const std::size_t NUM_LAYERS = std::remove_const<NET>::type::num_layers;
+
+    /// \brief The type of layer I.
+    template <std::size_t I>
+    using layer_type = typename std::remove_reference<decltype(dlib::layer<I>(std::declval<NET&>()))>::type;
+
+    /// \brief The traits of layer I.
+    template <std::size_t I>
+    using traits = LayerTraits<typename std::remove_const<layer_type<I>>::type>;
+
+    /// \brief The parameter tensor type of layer I, const for a const network.
+    template <std::size_t I>
+    using parameters_type = typename std::conditional<std::is_const<layer_type<I>>::value,
+                                                      const dlib::tensor,
+                                                      dlib::tensor>::type;
+
+    /// \brief Create a view of a network.
+    /// \param net The network. It must outlive the view.
+    explicit NetworkView(NET& net): _net(net)
+    {
+    }
+
+    /// \returns the network.
+    NET& net() const
+    {
+        return _net;
+    }
+
+    /// \returns layer I.
+    template <std::size_t I>
+    layer_type<I>& layer() const
+    {
+        static_assert(I < NUM_LAYERS, "NetworkView: Layer index out of range.");
+        return dlib::layer<I>(_net);
+    }
+
+    /// \returns true if the output of layer I is overwritten in place by the
+    ///          layer above it during a forward pass.
+    template <std::size_t I>
+    static constexpr bool isOverwritten()
+    {
+        return _isOverwritten(std::integral_constant<std::size_t, I>());
+    }
+
+    /// \returns the output of layer I from the last forward pass.
+    template <std::size_t I>
+    const dlib::tensor& output() const
+    {
+        static_assert(_hasOutput<layer_type<I>>(0), "NetworkView: Loss and input layers have no output.");
+        static_assert(!isOverwritten<I>(), "NetworkView: The layer above overwrites this output in place. Tag the layer to keep it.");
+        return layer<I>().get_output();
+    }
+
+    /// \returns the parameters of computational layer I.
+    template <std::size_t I>
+    parameters_type<I>& parameters() const
+    {
+        static_assert(traits<I>::IS_COMPUTATIONAL, "NetworkView: Only computational layers have parameters.");
+        return layer<I>().layer_details().get_layer_params();
+    }
+
+    /// \returns the index of the first layer tagged with TAG.
+    template <unsigned long TAG>
+    static constexpr std::size_t indexOf()
+    {
+        static_assert(_indexOf<TAG>(std::integral_constant<std::size_t, 0>()) < NUM_LAYERS,
+                      "NetworkView: The network has no layer with this tag.");
+        return _indexOf<TAG>(std::integral_constant<std::size_t, 0>());
+    }
+
+    /// \brief Get the output of a layer by run time index.
+    /// \param i The layer index.
+    /// \returns the output of layer i from the last forward pass.
+    /// \throws std::out_of_range if layer i has no output or it is
+    ///         overwritten in place.
+    const dlib::tensor& output(std::size_t i) const
+    {
+        const dlib::tensor* result = nullptr;
+
+        forEachOutput([&](std::size_t j, const dlib::tensor& output) {
+            if (i == j)
+                result = &output;
+        });
+
+        if (result == nullptr)
+            throw std::out_of_range("NetworkView: Layer " + std::to_string(i) + " has no output.");
+
+        return *result;
+    }
+
+    /// \brief Call a visitor with every layer, in index order.
+    /// \param visitor Called as visitor(std::integral_constant<std::size_t, I>(), layer<I>()).
+    template <typename VISITOR>
+    void forEachLayer(VISITOR&& visitor) const
+    {
+        _forEachLayer(visitor, std::integral_constant<std::size_t, 0>());
+    }
+
+    /// \brief Call a visitor with the output of every layer that has one.
+    ///
+    /// Layers whose output is overwritten in place are skipped.
+    ///
+    /// \param visitor Called as visitor(std::size_t i, const dlib::tensor& output).
+    template <typename VISITOR>
+    void forEachOutput(VISITOR&& visitor) const
+    {
+        OutputVisitor<VISITOR> v = { visitor };
+        forEachLayer(v);
+    }
+
+    /// \brief Call a visitor with the parameters of every computational layer.
+    /// \param visitor Called as visitor(std::size_t i, tensor& parameters), with
+    ///        a const tensor for a const network.
+    template <typename VISITOR>
+    void forEachParameters(VISITOR&& visitor) const
+    {
+        ParametersVisitor<VISITOR> v = { visitor };
+        forEachLayer(v);
+    }
+
+private:
+    template <typename VISITOR>
+    struct OutputVisitor
+    {
+        VISITOR& visitor;
+
+        template <std::size_t I, typename LAYER>
+        void operator()(std::integral_constant<std::size_t, I>, LAYER& l)
+        {
+            if (!isOverwritten<I>())
+                _visitOutput(visitor, I, l, 0);
+        }
+    };
+
+    template <typename VISITOR>
+    struct ParametersVisitor
+    {
+        VISITOR& visitor;
+
+        template <std::size_t I, typename LAYER>
+        void operator()(std::integral_constant<std::size_t, I>, LAYER& l)
+        {
+            _visitParameters(visitor, I, l, 0);
+        }
+    };
+
+    template <typename VISITOR, std::size_t I>
+    void _forEachLayer(VISITOR& visitor, std::integral_constant<std::size_t, I> index) const
+    {
+        visitor(index, layer<I>());
+        _forEachLayer(visitor, std::integral_constant<std::size_t, I + 1>());
+    }
+
+    template <typename VISITOR>
+    void _forEachLayer(VISITOR&, std::integral_constant<std::size_t, NUM_LAYERS>) const
+    {
+    }
+
+    template <std::size_t I>
+    static constexpr bool _isOverwritten(std::integral_constant<std::size_t, I>)
+    {
+        return traits<I - 1>::IS_IN_PLACE && traits<I>::IS_COMPUTATIONAL && !traits<I>::REQUIRES_OUTPUT;
+    }
+
+    static constexpr bool _isOverwritten(std::integral_constant<std::size_t, 0>)
+    {
+        return false;
+    }
+
+    template <typename LAYER>
+    static constexpr auto _hasOutput(int) -> decltype(std::declval<LAYER&>().get_output(), bool())
+    {
+        return true;
+    }
+
+    template <typename LAYER>
+    static constexpr bool _hasOutput(long)
+    {
+        return false;
+    }
+
+    template <typename VISITOR, typename LAYER>
+    static auto _visitOutput(VISITOR& visitor, std::size_t i, LAYER& l, int) -> decltype(l.get_output(), void())
+    {
+        visitor(i, l.get_output());
+    }
+
+    template <typename VISITOR, typename LAYER>
+    static void _visitOutput(VISITOR&, std::size_t, LAYER&, long)
+    {
+    }
+
+    template <typename VISITOR, typename LAYER>
+    static auto _visitParameters(VISITOR& visitor, std::size_t i, LAYER& l, int) -> decltype(l.layer_details().get_layer_params(), void())
+    {
+        visitor(i, l.layer_details().get_layer_params());
+    }
+
+    template <typename VISITOR, typename LAYER>
+    static void _visitParameters(VISITOR&, std::size_t, LAYER&, long)
+    {
+    }
+
+    /// \returns the index of the first layer at or after I tagged with TAG,
+    ///          or NUM_LAYERS if there is none.
+    template <unsigned long TAG, std::size_t I>
+    static constexpr std::size_t _indexOf(std::integral_constant<std::size_t, I>)
+    {
+        return (traits<I>::IS_TAG && traits<I>::TAG == TAG)
+            ? I
+            : _indexOf<TAG>(std::integral_constant<std::size_t, I + 1>());
+    }
+
+    template <unsigned long TAG>
+    static constexpr std::size_t _indexOf(std::integral_constant<std::size_t, NUM_LAYERS>)
+    {
+        return NUM_LAYERS;
+    }
+
+    NET& _net;
+
+};
+
+
+/// \brief Create a view of a network.
+/// \param net The network. It must outlive the view.
+/// \returns the view.
+template <typename NET>
+NetworkView<NET> makeNetworkView(NET& net)
+{
+    return NetworkView<NET>(net);
+}
+
+
+} } // namespace ofx::Dlib
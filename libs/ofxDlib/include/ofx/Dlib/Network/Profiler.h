@@ -0,0 +1,426 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "dlib/dnn.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief The forward pass timing of a single computational layer.
+struct LayerProfile
+{
+    /// \brief The layer index as used by dlib::layer<i>(net).
+    std::size_t index = 0;
+
+    /// \brief The layer type, e.g. "con" or "relu".
+    std::string type;
+
+    /// \brief The full layer description as printed by dlib.
+    std::string description;
+
+    /// \brief The id of the tag layer directly above this layer or 0 if none.
+    unsigned long tag = 0;
+
+    /// \brief True if the layer runs in place on its input.
+    bool inPlace = false;
+
+    /// \brief The output tensor shape.
+    long numSamples = 0;
+    long k = 0;
+    long nr = 0;
+    long nc = 0;
+
+    /// \brief The bytes read from the input tensor.
+    uint64_t inputBytes = 0;
+
+    /// \brief The bytes written to the output tensor.
+    uint64_t outputBytes = 0;
+
+    /// \brief The bytes of the layer's parameters.
+    uint64_t parameterBytes = 0;
+
+    /// \brief The mean forward time in milliseconds.
+    double meanMs = 0;
+
+    /// \brief The fastest forward time in milliseconds.
+    double minMs = 0;
+
+    /// \returns the bytes moved by one forward pass of this layer.
+    uint64_t bytesMoved() const
+    {
+        return inputBytes + outputBytes + parameterBytes;
+    }
+
+    /// \returns a short label for the layer, e.g. "12 con (tag 1107)".
+    std::string name() const;
+};
+
+
+/// \brief The per-layer forward pass timings of a network.
+struct NetworkProfile
+{
+    /// \brief The computational layers in execution order (input first).
+    std::vector<LayerProfile> layers;
+
+    /// \brief The number of samples in the profiled batch.
+    long numSamples = 0;
+
+    /// \brief The number of timed iterations per layer.
+    std::size_t iterations = 0;
+
+    /// \brief The mean time of a full forward pass in milliseconds.
+    double totalMs = 0;
+
+    /// \returns the sum of the mean layer times in milliseconds.
+    double layerMs() const;
+
+    /// \returns a table of the layers sorted from slowest to fastest.
+    std::string toString() const;
+
+    /// \brief Get the profile in the Chrome trace event format.
+    ///
+    /// The layers are laid out end to end in execution order. Load the file
+    /// in chrome://tracing or https://ui.perfetto.dev to view it.
+    ///
+    /// \returns the trace as JSON.
+    std::string toChromeTrace() const;
+
+    /// \brief Save the Chrome trace JSON to a file.
+    /// \param path The file path, relative to the data folder.
+    /// \returns true if the file was written.
+    bool saveChromeTrace(const std::string& path) const;
+
+    /// \brief Compare two profiles of the same network layout.
+    ///
+    /// Layers are matched by their position in execution order. Layers that
+    /// got slower by more than \p threshold are marked.
+    ///
+    /// \param baseline The reference profile, e.g. of a previous model version.
+    /// \param current The profile to compare.
+    /// \param threshold The relative slowdown considered a regression.
+    /// \returns a table of layer time changes.
+    static std::string compare(const NetworkProfile& baseline,
+                               const NetworkProfile& current,
+                               double threshold = 0.1);
+};
+
+
+/// \brief Measures the forward pass time of each layer of a dlib network.
+///
+/// The network is run once to set up its layers. Each computational layer is
+/// then run in isolation on the cached output of the layer below it, so the
+/// time of a layer doesn't include any other layer. In-place layers such as
+/// relu or affine write to a scratch tensor instead of their input.
+///
+/// Layers that change state during forward(), such as bn_con in training mode
+/// or dropout, are run once per iteration like any other layer. Profile the
+/// inference form of a network (e.g. anet_type) to get representative times.
+///
+/// Usage:
+///
+///     NetworkProfile profile = NetworkProfiler::profile(net, images);
+///     std::cout << profile.toString() << std::endl;
+///     profile.saveChromeTrace("profile.json");
+class NetworkProfiler
+{
+public:
+    /// \brief Profile a network on a batch of inputs.
+    /// \param net The network to profile.
+    /// \param samples The inputs forming one batch.
+    /// \param iterations The number of timed runs of each layer.
+    /// \returns the network profile.
+    template <typename NET>
+    static NetworkProfile profile(NET& net,
+                                  const std::vector<typename NET::input_type>& samples,
+                                  std::size_t iterations = 10);
+
+    /// \brief Profile a network on a single input.
+    template <typename NET>
+    static NetworkProfile profile(NET& net,
+                                  const typename NET::input_type& sample,
+                                  std::size_t iterations = 10);
+
+    /// \brief Profile a network on an input tensor.
+    /// \param net The network to profile.
+    /// \param input An input tensor created with net.to_tensor().
+    /// \param iterations The number of timed runs of each layer.
+    /// \returns the network profile.
+    template <typename NET>
+    static NetworkProfile profile(NET& net,
+                                  const dlib::tensor& input,
+                                  std::size_t iterations = 10);
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    /// \brief A visited layer.
+    struct Step
+    {
+        /// \brief The layer's output or nullptr if it has none.
+        const dlib::tensor* output = nullptr;
+
+        /// \brief Runs the layer on an input tensor, empty if not computational.
+        std::function<void(const dlib::tensor&, dlib::resizable_tensor&)> run;
+
+        /// \brief The id of a tag layer, or 0.
+        unsigned long tag = 0;
+
+        LayerProfile profile;
+    };
+
+    /// \brief Stands in for the input layer below the first computational layer.
+    struct InputView
+    {
+        const dlib::tensor& input;
+
+        const dlib::tensor& get_output() const
+        {
+            return input;
+        }
+    };
+
+    /// \brief Collects the layers in output to input order.
+    struct Visitor
+    {
+        std::vector<Step>& steps;
+
+        template <typename LAYER_DETAILS, typename SUBNET, typename E>
+        void operator()(std::size_t i, dlib::add_layer<LAYER_DETAILS, SUBNET, E>& l)
+        {
+            Step step;
+            step.output = &l.get_output();
+            step.profile.index = i;
+            step.profile.parameterBytes = l.layer_details().get_layer_params().size() * sizeof(float);
+
+            std::ostringstream ss;
+            ss << l.layer_details();
+            step.profile.description = ss.str();
+            std::replace(step.profile.description.begin(), step.profile.description.end(), '\t', ' ');
+            step.profile.type = step.profile.description.substr(0, step.profile.description.find(' '));
+
+            auto* layer = &l;
+
+            step.run = [layer](const dlib::tensor& input, dlib::resizable_tensor& output)
+            {
+                _run(*layer, input, output, 0);
+            };
+
+            step.profile.inPlace = _isInPlace(l.layer_details(), 0);
+
+            steps.push_back(step);
+        }
+
+        template <unsigned long ID, typename SUBNET, typename E>
+        void operator()(std::size_t, dlib::add_tag_layer<ID, SUBNET, E>& l)
+        {
+            Step step;
+            step.output = &l.get_output();
+            step.tag = ID;
+            steps.push_back(step);
+        }
+
+        /// \brief Skip, repeat, loss and input layers.
+        template <typename T>
+        void operator()(std::size_t, T& l)
+        {
+            Step step;
+            step.output = _output(l, 0);
+            steps.push_back(step);
+        }
+    };
+
+    template <typename T>
+    static auto _output(T& l, int) -> decltype(&l.get_output())
+    {
+        return &l.get_output();
+    }
+
+    template <typename T>
+    static const dlib::tensor* _output(T&, long)
+    {
+        return nullptr;
+    }
+
+    template <typename DETAILS>
+    static auto _isInPlace(DETAILS& details, int) -> decltype(details.forward_inplace(std::declval<const dlib::tensor&>(), std::declval<dlib::tensor&>()), bool())
+    {
+        return true;
+    }
+
+    template <typename DETAILS>
+    static bool _isInPlace(DETAILS&, long)
+    {
+        return false;
+    }
+
+    /// \brief Run a layer whose subnet has an output.
+    template <typename LAYER>
+    static auto _run(LAYER& layer, const dlib::tensor&, dlib::resizable_tensor& output, int) -> decltype(layer.subnet().get_output(), void())
+    {
+        _forward(layer.layer_details(), layer.subnet(), output, 0);
+    }
+
+    /// \brief Run a layer directly above an input layer.
+    template <typename LAYER>
+    static void _run(LAYER& layer, const dlib::tensor& input, dlib::resizable_tensor& output, long)
+    {
+        InputView view = { input };
+        _forward(layer.layer_details(), view, output, 0);
+    }
+
+    template <typename DETAILS, typename SUBNET>
+    static auto _forward(DETAILS& details, const SUBNET& sub, dlib::resizable_tensor& output, int) -> decltype(details.forward_inplace(sub.get_output(), output), void())
+    {
+        output.copy_size(sub.get_output());
+        details.forward_inplace(sub.get_output(), output);
+    }
+
+    template <typename DETAILS, typename SUBNET>
+    static void _forward(DETAILS& details, const SUBNET& sub, dlib::resizable_tensor& output, long)
+    {
+        details.forward(sub, output);
+    }
+
+    /// \brief Run the whole network, excluding the loss.
+    template <typename NET>
+    static auto _forwardNetwork(NET& net, const dlib::tensor& input, int) -> decltype(net.loss_details(), void())
+    {
+        net.subnet().forward(input);
+    }
+
+    template <typename NET>
+    static void _forwardNetwork(NET& net, const dlib::tensor& input, long)
+    {
+        net.forward(input);
+    }
+
+    static double _elapsedMs(const Clock::time_point& start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+};
+
+
+template <typename NET>
+NetworkProfile NetworkProfiler::profile(NET& net,
+                                        const std::vector<typename NET::input_type>& samples,
+                                        std::size_t iterations)
+{
+    dlib::resizable_tensor input;
+    net.to_tensor(samples.begin(), samples.end(), input);
+    return profile(net, input, iterations);
+}
+
+
+template <typename NET>
+NetworkProfile NetworkProfiler::profile(NET& net,
+                                        const typename NET::input_type& sample,
+                                        std::size_t iterations)
+{
+    dlib::resizable_tensor input;
+    net.to_tensor(&sample, &sample + 1, input);
+    return profile(net, input, iterations);
+}
+
+
+template <typename NET>
+NetworkProfile NetworkProfiler::profile(NET& net,
+                                        const dlib::tensor& input,
+                                        std::size_t iterations)
+{
+    iterations = std::max(std::size_t(1), iterations);
+
+    NetworkProfile result;
+    result.numSamples = input.num_samples();
+    result.iterations = iterations;
+
+    // Set up all layers and fill their outputs.
+    _forwardNetwork(net, input, 0);
+
+    auto start = Clock::now();
+    for (std::size_t i = 0; i < iterations; ++i)
+        _forwardNetwork(net, input, 0);
+    result.totalMs = _elapsedMs(start) / iterations;
+
+    std::vector<Step> steps;
+    Visitor visitor = { steps };
+    dlib::visit_layers(net, visitor);
+
+    dlib::resizable_tensor scratch;
+
+    for (std::size_t s = 0; s < steps.size(); ++s)
+    {
+        Step& step = steps[s];
+
+        if (!step.run)
+            continue;
+
+        // The input of a layer is the output of the next layer towards the
+        // network input, or the network input itself.
+        const dlib::tensor* layerInput = &input;
+
+        for (std::size_t j = s + 1; j < steps.size(); ++j)
+        {
+            if (steps[j].output)
+            {
+                layerInput = steps[j].output;
+                break;
+            }
+        }
+
+        if (s > 0 && steps[s - 1].tag != 0)
+            step.profile.tag = steps[s - 1].tag;
+
+        step.run(*layerInput, scratch);
+
+        double totalMs = 0;
+        double minMs = std::numeric_limits<double>::max();
+
+        for (std::size_t i = 0; i < iterations; ++i)
+        {
+            auto layerStart = Clock::now();
+            step.run(*layerInput, scratch);
+            double ms = _elapsedMs(layerStart);
+            totalMs += ms;
+            minMs = std::min(minMs, ms);
+        }
+
+        step.profile.meanMs = totalMs / iterations;
+        step.profile.minMs = minMs;
+        step.profile.numSamples = scratch.num_samples();
+        step.profile.k = scratch.k();
+        step.profile.nr = scratch.nr();
+        step.profile.nc = scratch.nc();
+        step.profile.inputBytes = layerInput->size() * sizeof(float);
+        step.profile.outputBytes = scratch.size() * sizeof(float);
+
+        result.layers.push_back(step.profile);
+    }
+
+    // visit_layers() goes from the output to the input.
+    std::reverse(result.layers.begin(), result.layers.end());
+
+    return result;
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,574 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "dlib/dnn.h"
+#include "dlib/threads.h"
+#include "ofx/Dlib/Network/LayerParameters.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief An int8 post-training quantized inference engine for dlib networks.
+///
+/// quantize() walks a trained dlib network and converts it into a flat list
+/// of operations. Affine layers that directly follow a convolution are folded
+/// into the convolution and trailing relu layers are fused into its output.
+/// Convolution and fully connected weights are then quantized to int8 with
+/// one scale per output channel.
+///
+/// At inference time activations are quantized to int8 with one scale per
+/// sample and multiplied with int32 accumulation. The dot products use
+/// AVX-512 VNNI or AVX2 when the addon is compiled with those instructions
+/// enabled (see addon_config.mk) and fall back to portable code otherwise.
+///
+/// Activation scales are computed on the fly for each sample unless
+/// calibrate() has been called with a representative set of inputs, so a
+/// sample's output never depends on the rest of its batch. Calibrated scales
+/// avoid the extra pass over every activation and are recommended.
+///
+/// Supported layers are con, fc, fc_no_bias, affine, relu, max_pool,
+/// avg_pool, avg_pool_everything, tags, skips and add_prev, which covers
+/// the face recognition ResNet.
+///
+///     anet_type net;
+///     dlib::deserialize("dlib_face_recognition_resnet_model_v1.dat") >> net;
+///
+///     ofxDlib::QuantizedNetwork qnet;
+///     qnet.quantize(net);
+///     qnet.calibrate(net, faces.begin(), faces.end());
+///
+///     std::vector<dlib::matrix<float, 0, 1>> descriptors = qnet(net, faces);
+///
+class QuantizedNetwork
+{
+public:
+    enum Precision
+    {
+        /// \brief Run the engine with float weights and activations.
+        PRECISION_FLOAT32,
+        /// \brief Run the engine with int8 weights and activations.
+        PRECISION_INT8
+    };
+
+    /// \brief A single operation in the quantized network.
+    struct Layer
+    {
+        enum Type
+        {
+            CONVOLUTION,
+            FULLY_CONNECTED,
+            AFFINE,
+            RELU,
+            MAX_POOL,
+            AVG_POOL,
+            TAG,
+            SKIP,
+            ADD_PREV
+        };
+
+        Type type = RELU;
+
+        /// \brief The tag id for TAG, SKIP and ADD_PREV layers.
+        unsigned long tag = 0;
+
+        /// \brief Output channels (CONVOLUTION) or outputs (FULLY_CONNECTED).
+        long numOutputs = 0;
+
+        /// \brief Input channels (CONVOLUTION) or inputs (FULLY_CONNECTED).
+        long numInputs = 0;
+
+        /// \brief Filter or pooling window size. 0 pools the whole input.
+        long nr = 0;
+        long nc = 0;
+        long strideY = 1;
+        long strideX = 1;
+        long paddingY = 0;
+        long paddingX = 0;
+
+        /// \brief True if a relu is applied to the output.
+        bool relu = false;
+
+        /// \brief Float weights stored as [numOutputs][numInputs * nr * nc].
+        std::vector<float> weights;
+
+        /// \brief Biases for CONVOLUTION / FULLY_CONNECTED or beta for AFFINE.
+        std::vector<float> biases;
+
+        /// \brief Gamma for AFFINE layers.
+        std::vector<float> scales;
+
+        /// \brief Int8 weights stored as [numOutputs][quantizedStride].
+        std::vector<int8_t> quantizedWeights;
+
+        /// \brief One dequantization scale per output.
+        std::vector<float> quantizedScales;
+
+        /// \brief The padded row length of quantizedWeights.
+        std::size_t quantizedStride = 0;
+
+        /// \brief The calibrated input activation scale, 0 if dynamic.
+        float inputScale = 0;
+
+        /// \returns the number of weights per output.
+        std::size_t rowSize() const
+        {
+            return std::size_t(numInputs * std::max(nr, 1L) * std::max(nc, 1L));
+        }
+    };
+
+    /// \brief Create an empty network.
+    QuantizedNetwork();
+
+    /// \brief Convert a trained dlib network into quantized form.
+    /// \param net The trained network. It must have been run or deserialized
+    ///        so that all layer parameters are allocated.
+    /// \throws std::invalid_argument if the network has unsupported layers.
+    template <typename NET>
+    void quantize(NET& net);
+
+    /// \brief Calibrate the activation scales with representative inputs.
+    ///
+    /// The network is run in float precision and the largest absolute input
+    /// to each quantized layer is recorded.
+    ///
+    /// \param net The network used to convert inputs to tensors.
+    /// \param begin The first input.
+    /// \param end One past the last input.
+    /// \param batchSize The number of inputs to run at once.
+    template <typename NET, typename forward_iterator>
+    void calibrate(const NET& net,
+                   forward_iterator begin,
+                   forward_iterator end,
+                   std::size_t batchSize = 32);
+
+    /// \brief Calibrate the activation scales with an input tensor.
+    /// \param input The input tensor.
+    void calibrate(const dlib::tensor& input);
+
+    /// \brief Discard calibration and use dynamic activation scales.
+    void clearCalibration();
+
+    /// \brief Run the network.
+    /// \param input The input tensor, usually created with net.to_tensor().
+    /// \param output The output of the final layer.
+    /// \param precision The arithmetic to use.
+    void forward(const dlib::tensor& input,
+                 dlib::resizable_tensor& output,
+                 Precision precision = PRECISION_INT8) const;
+
+    /// \brief Run the network on a range of inputs.
+    /// \param net The network used to convert inputs to tensors.
+    /// \param begin The first input.
+    /// \param end One past the last input.
+    /// \param precision The arithmetic to use.
+    /// \param batchSize The number of inputs to run at once.
+    /// \returns one output vector (e.g. face descriptor) per input.
+    template <typename NET, typename forward_iterator>
+    std::vector<dlib::matrix<float, 0, 1>> operator()(const NET& net,
+                                                      forward_iterator begin,
+                                                      forward_iterator end,
+                                                      Precision precision = PRECISION_INT8,
+                                                      std::size_t batchSize = 32) const;
+
+    /// \brief Run the network on a collection of inputs.
+    template <typename NET, typename INPUT_TYPE>
+    std::vector<dlib::matrix<float, 0, 1>> operator()(const NET& net,
+                                                      const std::vector<INPUT_TYPE>& inputs,
+                                                      Precision precision = PRECISION_INT8,
+                                                      std::size_t batchSize = 32) const
+    {
+        return (*this)(net, inputs.begin(), inputs.end(), precision, batchSize);
+    }
+
+    /// \returns the operations in execution order.
+    const std::vector<Layer>& layers() const;
+
+    /// \returns true if calibrate() has been called.
+    bool isCalibrated() const;
+
+    /// \returns the total size of the int8 weights in bytes.
+    std::size_t quantizedWeightBytes() const;
+
+    /// \returns the total size of the float weights in bytes.
+    std::size_t floatWeightBytes() const;
+
+private:
+    /// \brief Collects layers while visiting a dlib network.
+    struct Builder
+    {
+        std::vector<Layer>& layers;
+
+        template <typename LAYER_DETAILS, typename SUBNET, typename E>
+        void operator()(std::size_t, dlib::add_layer<LAYER_DETAILS, SUBNET, E>& l)
+        {
+            add(l.layer_details());
+        }
+
+        template <unsigned long ID, typename SUBNET, typename E>
+        void operator()(std::size_t, dlib::add_tag_layer<ID, SUBNET, E>&)
+        {
+            Layer layer;
+            layer.type = Layer::TAG;
+            layer.tag = ID;
+            layers.push_back(layer);
+        }
+
+        template <template<typename> class TAG_TYPE, typename SUBNET>
+        void operator()(std::size_t, dlib::add_skip_layer<TAG_TYPE, SUBNET>&)
+        {
+            Layer layer;
+            layer.type = Layer::SKIP;
+            layer.tag = dlib::tag_id<TAG_TYPE>::id;
+            layers.push_back(layer);
+        }
+
+        /// \brief Loss and input layers carry no computation.
+        template <typename T>
+        void operator()(std::size_t, T&)
+        {
+        }
+
+        template <long NF, long NR, long NC, int SY, int SX, int PY, int PX>
+        void add(const dlib::con_<NF, NR, NC, SY, SX, PY, PX>& details)
+        {
+            ConvolutionParameters p = getConvolutionParameters(details);
+
+            if (p.filters == nullptr)
+                throw std::invalid_argument("QuantizedNetwork: con layer has no parameters. Was the network loaded?");
+
+            Layer layer;
+            layer.type = Layer::CONVOLUTION;
+            layer.numOutputs = p.numFilters;
+            layer.numInputs = p.k;
+            layer.nr = p.nr;
+            layer.nc = p.nc;
+            layer.strideY = p.strideY;
+            layer.strideX = p.strideX;
+            layer.paddingY = p.paddingY;
+            layer.paddingX = p.paddingX;
+            layer.weights.assign(p.filters, p.filters + p.numFilters * p.filterSize());
+
+            if (p.biases)
+                layer.biases.assign(p.biases, p.biases + p.numFilters);
+            else
+                layer.biases.assign(p.numFilters, 0);
+
+            layers.push_back(layer);
+        }
+
+        template <unsigned long N, dlib::fc_bias_mode M>
+        void add(const dlib::fc_<N, M>& details)
+        {
+            FullyConnectedParameters p = getFullyConnectedParameters(details);
+
+            if (p.weights == nullptr)
+                throw std::invalid_argument("QuantizedNetwork: fc layer has no parameters. Was the network loaded?");
+
+            Layer layer;
+            layer.type = Layer::FULLY_CONNECTED;
+            layer.numOutputs = p.numOutputs;
+            layer.numInputs = p.numInputs;
+            layer.nr = 1;
+            layer.nc = 1;
+
+            // Transpose dlib's [inputs][outputs] layout so each output is a row.
+            layer.weights.resize(p.numInputs * p.numOutputs);
+            for (long i = 0; i < p.numInputs; ++i)
+                for (long o = 0; o < p.numOutputs; ++o)
+                    layer.weights[o * p.numInputs + i] = p.weights[i * p.numOutputs + o];
+
+            if (p.biases)
+                layer.biases.assign(p.biases, p.biases + p.numOutputs);
+            else
+                layer.biases.assign(p.numOutputs, 0);
+
+            layers.push_back(layer);
+        }
+
+        void add(const dlib::affine_& details)
+        {
+            Layer layer;
+            layer.type = Layer::AFFINE;
+
+            if (getAffineParameters(details, layer.scales, layer.biases) != dlib::CONV_MODE)
+                throw std::invalid_argument("QuantizedNetwork: only per-channel (CONV_MODE) affine layers are supported.");
+
+            layers.push_back(layer);
+        }
+
+        void add(const dlib::relu_&)
+        {
+            Layer layer;
+            layer.type = Layer::RELU;
+            layers.push_back(layer);
+        }
+
+        template <long NR, long NC, int SY, int SX, int PY, int PX>
+        void add(const dlib::max_pool_<NR, NC, SY, SX, PY, PX>& details)
+        {
+            layers.push_back(pool(Layer::MAX_POOL, details));
+        }
+
+        template <long NR, long NC, int SY, int SX, int PY, int PX>
+        void add(const dlib::avg_pool_<NR, NC, SY, SX, PY, PX>& details)
+        {
+            layers.push_back(pool(Layer::AVG_POOL, details));
+        }
+
+        template <template<typename> class TAG_TYPE>
+        void add(const dlib::add_prev_<TAG_TYPE>&)
+        {
+            Layer layer;
+            layer.type = Layer::ADD_PREV;
+            layer.tag = dlib::tag_id<TAG_TYPE>::id;
+            layers.push_back(layer);
+        }
+
+        template <typename LAYER_DETAILS>
+        void add(const LAYER_DETAILS&)
+        {
+            throw std::invalid_argument("QuantizedNetwork: unsupported layer type.");
+        }
+
+        template <typename POOL>
+        static Layer pool(typename Layer::Type type, const POOL& details)
+        {
+            Layer layer;
+            layer.type = type;
+            layer.nr = details.nr();
+            layer.nc = details.nc();
+            layer.strideY = details.stride_y();
+            layer.strideX = details.stride_x();
+            layer.paddingY = details.padding_y();
+            layer.paddingX = details.padding_x();
+            return layer;
+        }
+    };
+
+    /// \brief Reorder, fold and quantize the collected layers.
+    void _finalize();
+
+    /// \brief Run the network, optionally recording input magnitudes.
+    void _forward(const dlib::tensor& input,
+                  dlib::resizable_tensor& output,
+                  Precision precision,
+                  std::vector<float>* inputAbsMax) const;
+
+    /// \brief The operations in execution order.
+    std::vector<Layer> _layers;
+
+    /// \brief True if calibrate() has been called.
+    bool _calibrated = false;
+
+    /// \brief Worker threads shared by all layers.
+    std::shared_ptr<dlib::thread_pool> _threadPool;
+
+};
+
+
+/// \brief A comparison of a quantized network with its float reference.
+struct QuantizationReport
+{
+    /// \brief The number of inputs compared.
+    std::size_t numSamples = 0;
+
+    /// \brief The mean L2 distance between float and int8 outputs.
+    double meanOutputError = 0;
+
+    /// \brief The largest L2 distance between float and int8 outputs.
+    double maxOutputError = 0;
+
+    /// \brief The number of output pairs compared.
+    std::size_t numPairs = 0;
+
+    /// \brief The mean change of pairwise output distances.
+    double meanPairDistanceError = 0;
+
+    /// \brief The largest change of pairwise output distances.
+    double maxPairDistanceError = 0;
+
+    /// \brief The number of pairs whose same / different decision changed.
+    std::size_t numDecisionChanges = 0;
+
+    /// \brief The time dlib's float network took in milliseconds.
+    double float32Ms = 0;
+
+    /// \brief The time the int8 engine took in milliseconds.
+    double int8Ms = 0;
+
+    /// \returns the int8 speedup relative to dlib.
+    double speedup() const
+    {
+        return int8Ms > 0 ? float32Ms / int8Ms : 0;
+    }
+};
+
+
+/// \brief Compare a quantized network with the float dlib network it came from.
+///
+/// Outputs are compared directly and through their pairwise distances, which
+/// is what matters for metric networks like the face recognition ResNet.
+///
+/// \param net The float dlib network.
+/// \param quantizedNet The quantized network.
+/// \param inputs Inputs to compare on, e.g. aligned face chips.
+/// \param threshold The same / different distance threshold (0.6 for faces).
+/// \param batchSize The number of inputs to run at once.
+/// \returns a summary of the differences and timings.
+template <typename NET, typename INPUT_TYPE>
+QuantizationReport validate(NET& net,
+                            const QuantizedNetwork& quantizedNet,
+                            const std::vector<INPUT_TYPE>& inputs,
+                            double threshold = 0.6,
+                            std::size_t batchSize = 32)
+{
+    QuantizationReport report;
+    report.numSamples = inputs.size();
+
+    if (inputs.empty())
+        return report;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<dlib::matrix<float, 0, 1>> reference;
+    for (std::size_t i = 0; i < inputs.size(); i += batchSize)
+    {
+        std::vector<INPUT_TYPE> batch(inputs.begin() + i,
+                                      inputs.begin() + std::min(i + batchSize, inputs.size()));
+        for (auto& output: net(batch))
+            reference.push_back(dlib::matrix_cast<float>(dlib::reshape_to_column_vector(output)));
+    }
+    auto middle = std::chrono::steady_clock::now();
+    auto quantized = quantizedNet(net, inputs, QuantizedNetwork::PRECISION_INT8, batchSize);
+    auto end = std::chrono::steady_clock::now();
+
+    report.float32Ms = std::chrono::duration<double, std::milli>(middle - start).count();
+    report.int8Ms = std::chrono::duration<double, std::milli>(end - middle).count();
+
+    for (std::size_t i = 0; i < reference.size(); ++i)
+    {
+        double error = dlib::length(reference[i] - quantized[i]);
+        report.meanOutputError += error;
+        report.maxOutputError = std::max(report.maxOutputError, error);
+
+        for (std::size_t j = i + 1; j < reference.size(); ++j)
+        {
+            double d0 = dlib::length(reference[i] - reference[j]);
+            double d1 = dlib::length(quantized[i] - quantized[j]);
+            double pairError = std::abs(d0 - d1);
+            report.meanPairDistanceError += pairError;
+            report.maxPairDistanceError = std::max(report.maxPairDistanceError, pairError);
+
+            if ((d0 < threshold) != (d1 < threshold))
+                ++report.numDecisionChanges;
+
+            ++report.numPairs;
+        }
+    }
+
+    report.meanOutputError /= reference.size();
+
+    if (report.numPairs > 0)
+        report.meanPairDistanceError /= report.numPairs;
+
+    return report;
+}
+
+
+template <typename NET>
+void QuantizedNetwork::quantize(NET& net)
+{
+    _layers.clear();
+    _calibrated = false;
+
+    // Layers are visited from the output to the input.
+    Builder builder = { _layers };
+    dlib::visit_layers(net, builder);
+
+    _finalize();
+}
+
+
+template <typename NET, typename forward_iterator>
+void QuantizedNetwork::calibrate(const NET& net,
+                                 forward_iterator begin,
+                                 forward_iterator end,
+                                 std::size_t batchSize)
+{
+    dlib::resizable_tensor input;
+
+    while (begin != end)
+    {
+        forward_iterator batchEnd = begin;
+        std::size_t count = 0;
+        while (batchEnd != end && count < batchSize)
+        {
+            ++batchEnd;
+            ++count;
+        }
+
+        net.to_tensor(begin, batchEnd, input);
+        calibrate(input);
+        begin = batchEnd;
+    }
+}
+
+
+template <typename NET, typename forward_iterator>
+std::vector<dlib::matrix<float, 0, 1>> QuantizedNetwork::operator()(const NET& net,
+                                                                    forward_iterator begin,
+                                                                    forward_iterator end,
+                                                                    Precision precision,
+                                                                    std::size_t batchSize) const
+{
+    std::vector<dlib::matrix<float, 0, 1>> results;
+    dlib::resizable_tensor input;
+    dlib::resizable_tensor output;
+
+    while (begin != end)
+    {
+        forward_iterator batchEnd = begin;
+        std::size_t count = 0;
+        while (batchEnd != end && count < batchSize)
+        {
+            ++batchEnd;
+            ++count;
+        }
+
+        net.to_tensor(begin, batchEnd, input);
+        forward(input, output, precision);
+
+        const long sampleSize = output.k() * output.nr() * output.nc();
+        const float* data = output.host();
+
+        for (long n = 0; n < output.num_samples(); ++n)
+        {
+            dlib::matrix<float, 0, 1> result(sampleSize);
+            std::copy(data + n * sampleSize, data + (n + 1) * sampleSize, result.begin());
+            results.push_back(result);
+        }
+
+        begin = batchEnd;
+    }
+
+    return results;
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,151 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <stdexcept>
+#include <vector>
+#include "dlib/dnn.h"
+#include "dlib/of_image.h"
+#include "ofPixels.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Non-owning ofFloatPixels views of the planes of a dlib::tensor.
+///
+/// Each (sample, k) plane of the tensor is exposed as a single channel
+/// ofFloatPixels that points directly into the tensor's host memory, so no
+/// values are copied. The plane size is taken from the tensor at runtime.
+///
+/// The views are only valid while the tensor is alive and not resized. A
+/// forward pass may reallocate a layer output, so create new views after each
+/// forward pass. Copying an ofFloatPixels view makes a deep copy, which is
+/// the way to keep a plane or to modify it, e.g. with ofxDlib::map().
+///
+///     TensorPixels planes(dlib::layer<LeNet5::tag_9_relu_3>(net).get_output());
+///     for (long k = 0; k < planes.k(); ++k)
+///         texture[k].loadData(planes.plane(0, k));
+class TensorPixels
+{
+public:
+    /// \brief Create views of all planes of a tensor.
+    /// \param tensor The tensor to view.
+    TensorPixels(const dlib::tensor& tensor):
+        _numSamples(tensor.num_samples()),
+        _k(tensor.k()),
+        _nr(tensor.nr()),
+        _nc(tensor.nc())
+    {
+        // The views are read-only, ofPixels just lacks a const external mode.
+        float* data = const_cast<float*>(tensor.host());
+
+        _planes.resize(std::size_t(_numSamples * _k));
+
+        for (std::size_t i = 0; i < _planes.size(); ++i)
+        {
+            _planes[i].setFromExternalPixels(data + i * _nr * _nc,
+                                             std::size_t(_nc),
+                                             std::size_t(_nr),
+                                             OF_PIXELS_GRAY);
+        }
+    }
+
+    TensorPixels(const TensorPixels&) = delete;
+    TensorPixels& operator = (const TensorPixels&) = delete;
+
+    TensorPixels(TensorPixels&&) = default;
+    TensorPixels& operator = (TensorPixels&&) = default;
+
+    /// \returns the number of samples.
+    long numSamples() const
+    {
+        return _numSamples;
+    }
+
+    /// \returns the number of channels per sample.
+    long k() const
+    {
+        return _k;
+    }
+
+    /// \returns the plane height.
+    long nr() const
+    {
+        return _nr;
+    }
+
+    /// \returns the plane width.
+    long nc() const
+    {
+        return _nc;
+    }
+
+    /// \returns the number of planes.
+    std::size_t size() const
+    {
+        return _planes.size();
+    }
+
+    /// \brief Get a view of a single plane.
+    /// \param sample The sample index.
+    /// \param k The channel index.
+    /// \returns a view of the plane.
+    /// \throws std::out_of_range if the indices are out of range.
+    const ofFloatPixels& plane(long sample, long k) const
+    {
+        if (sample < 0 || sample >= _numSamples || k < 0 || k >= _k)
+            throw std::out_of_range("TensorPixels: plane index out of range.");
+
+        return _planes[std::size_t(sample * _k + k)];
+    }
+
+    /// \brief Get a plane as a dlib generic image.
+    ///
+    /// The result can be passed to dlib image processing functions that take
+    /// a const image.
+    ///
+    /// \param sample The sample index.
+    /// \param k The channel index.
+    /// \returns a generic image view of the plane.
+    const dlib::of_image<float, float> image(long sample, long k) const
+    {
+        return dlib::of_image<float, float>(const_cast<ofFloatPixels*>(&plane(sample, k)));
+    }
+
+    /// \returns all plane views, sample-major.
+    const std::vector<ofFloatPixels>& planes() const
+    {
+        return _planes;
+    }
+
+private:
+    long _numSamples = 0;
+    long _k = 0;
+    long _nr = 0;
+    long _nc = 0;
+
+    std::vector<ofFloatPixels> _planes;
+
+};
+
+
+/// \brief Get views of the output planes of a tagged layer.
+/// \param net The network that has run a forward pass.
+/// \returns views of the layer output.
+/// \tparam TAG_TYPE The tag of the layer, e.g. LeNet5::tag_9_relu_3.
+template <template<typename> class TAG_TYPE, typename NET>
+inline TensorPixels layerOutputsToPixels(const NET& net)
+{
+    return TensorPixels(dlib::layer<TAG_TYPE>(net).get_output());
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,178 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <vector>
+#include "dlib/dnn.h"
+#include "ofPixels.h"
+#include "ofx/Dlib/Network/LayerParameters.h"
+#include "ofRectangle.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Packs the filters of a convolution layer into one float atlas.
+///
+/// dlib stores the parameters of a con layer as num_filters x k x nr x nc
+/// weights followed by the biases. Every nr x nc kernel slice, one per filter
+/// and input channel, becomes a tile of a single grayscale ofFloatPixels with
+/// values in [0, 1], so the whole layer is uploaded as one texture. The tiles
+/// are ordered filter by filter, and tiles() gives the location of each.
+///
+/// The values are mapped in two passes over whole filters, which are
+/// contiguous in the parameter tensor: one finds the range of each filter and
+/// one writes the mapped values. Both use AVX when the addon is compiled with
+/// it, and large layers are split across threads by filter.
+///
+///     WeightAtlas atlas;
+///     atlas.build(dlib::layer<LeNet5::tag_10_con_1, 1>(net).layer_details());
+///     texture.loadData(atlas.getPixels());
+class WeightAtlas
+{
+public:
+    /// \brief How weights are mapped to [0, 1].
+    enum Normalization
+    {
+        /// \brief Map each filter from its own minimum and maximum.
+        NORMALIZE_FILTER,
+        /// \brief Map all filters from the layer minimum and maximum.
+        NORMALIZE_GLOBAL
+    };
+
+    struct Settings
+    {
+        /// \brief The weight mapping.
+        Normalization normalization = NORMALIZE_FILTER;
+
+        /// \brief True to map a range symmetric around zero, so zero weights
+        ///        are mid gray.
+        bool symmetric = false;
+
+        /// \brief The number of tile columns, or 0 for a square-ish grid. Use
+        ///        the number of input channels for one row per filter.
+        std::size_t columns = 0;
+
+        /// \brief The gap between tiles in pixels.
+        std::size_t padding = 1;
+    };
+
+    /// \brief The location of one kernel slice in the atlas.
+    struct Tile
+    {
+        /// \brief The filter index.
+        std::size_t filter = 0;
+
+        /// \brief The input channel index.
+        std::size_t channel = 0;
+
+        /// \brief The tile rectangle in atlas pixels.
+        ofRectangle rectangle;
+
+        /// \brief The weight mapped to 0.
+        float minValue = 0;
+
+        /// \brief The weight mapped to 1.
+        float maxValue = 0;
+    };
+
+    /// \brief Create an atlas with default settings.
+    WeightAtlas();
+
+    /// \brief Create an atlas.
+    /// \param settings The atlas settings.
+    WeightAtlas(const Settings& settings);
+
+    /// \brief Pack the filters of a convolution layer.
+    ///
+    /// The number of input channels is taken from the layer, which knows
+    /// whether it stores biases.
+    ///
+    /// \param details The layer details, e.g. layer.layer_details() of a con layer.
+    /// \throws std::invalid_argument if the layer is not set up.
+    template <long NF, long NR, long NC, int SY, int SX, int PY, int PX>
+    void build(const dlib::con_<NF, NR, NC, SY, SX, PY, PX>& details)
+    {
+        const ConvolutionParameters parameters = getConvolutionParameters(details);
+
+        build(details.get_layer_params(),
+              parameters.numFilters,
+              parameters.k,
+              parameters.nr,
+              parameters.nc);
+    }
+
+    /// \brief Pack the filters of convolution parameters.
+    ///
+    /// A bias per filter after the weights is allowed and ignored.
+    ///
+    /// \param parameters The parameters, e.g. layer_details().get_layer_params().
+    /// \param numFilters The number of filters.
+    /// \param k The number of input channels.
+    /// \param nr The number of kernel rows.
+    /// \param nc The number of kernel columns.
+    /// \throws std::invalid_argument if the parameters don't match the shape.
+    void build(const dlib::tensor& parameters,
+               long numFilters,
+               long k,
+               long nr,
+               long nc);
+
+    /// \returns the atlas of the last build.
+    const ofFloatPixels& getPixels() const
+    {
+        return _pixels;
+    }
+
+    /// \returns the location of each kernel slice, filter by filter.
+    const std::vector<Tile>& tiles() const
+    {
+        return _tiles;
+    }
+
+    /// \brief Get the tile of a kernel slice.
+    /// \param filter The filter index.
+    /// \param channel The input channel index.
+    /// \returns the tile.
+    /// \throws std::out_of_range if an index is invalid.
+    const Tile& tile(std::size_t filter, std::size_t channel) const;
+
+    /// \returns the number of filters of the last build.
+    std::size_t numFilters() const
+    {
+        return _numFilters;
+    }
+
+    /// \returns the number of input channels of the last build.
+    std::size_t numChannels() const
+    {
+        return _numChannels;
+    }
+
+    /// \returns the settings.
+    const Settings& settings() const
+    {
+        return _settings;
+    }
+
+private:
+    Settings _settings;
+
+    ofFloatPixels _pixels;
+
+    std::vector<Tile> _tiles;
+
+    std::size_t _numFilters = 0;
+    std::size_t _numChannels = 0;
+
+};
+
+
+} } // namespace ofx::Dlib
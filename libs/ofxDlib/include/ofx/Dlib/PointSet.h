@@ -0,0 +1,203 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "dlib/geometry.h"
+#include "dlib/pixel.h"
+#include "ofColor.h"
+#include "ofMesh.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief A read-only view of a contiguous array.
+///
+/// The view doesn't own the memory, which must outlive it.
+template <typename T>
+class ArrayView
+{
+public:
+    ArrayView()
+    {
+    }
+
+    ArrayView(const T* data, std::size_t size): _data(data), _size(size)
+    {
+    }
+
+    const T* data() const
+    {
+        return _data;
+    }
+
+    std::size_t size() const
+    {
+        return _size;
+    }
+
+    bool empty() const
+    {
+        return _size == 0;
+    }
+
+    const T& operator [] (std::size_t i) const
+    {
+        return _data[i];
+    }
+
+    const T* begin() const
+    {
+        return _data;
+    }
+
+    const T* end() const
+    {
+        return _data + _size;
+    }
+
+    /// \returns a copy of the elements.
+    std::vector<T> toVector() const
+    {
+        return std::vector<T>(begin(), end());
+    }
+
+private:
+    const T* _data = nullptr;
+    std::size_t _size = 0;
+
+};
+
+
+/// \brief True if an array of FROM can be read as an array of TO.
+///
+/// dlib::vector<T, N> and glm::tvecN<T> both hold N packed values of T. This
+/// is checked at compile time, so a glm or dlib configuration that pads or
+/// over-aligns either type fails to build instead of reading garbage.
+template <typename FROM, typename TO>
+struct IsLayoutCompatible: std::integral_constant<bool, sizeof(FROM) == sizeof(TO)
+                                                     && alignof(FROM) % alignof(TO) == 0>
+{
+};
+
+
+/// \brief View dlib vectors as glm vectors with no copies.
+/// \param points The dlib points.
+/// \returns a view of the points as glm vectors.
+template <typename T>
+inline ArrayView<glm::tvec2<T>> toOf(const std::vector<dlib::vector<T, 2>>& points)
+{
+    static_assert(IsLayoutCompatible<dlib::vector<T, 2>, glm::tvec2<T>>::value,
+                  "dlib::vector<T, 2> and glm::tvec2<T> have different layouts.");
+    return ArrayView<glm::tvec2<T>>(reinterpret_cast<const glm::tvec2<T>*>(points.data()), points.size());
+}
+
+
+/// \brief View dlib vectors as glm vectors with no copies.
+///
+/// The view can be uploaded directly, e.g. with ofVbo::setVertexData().
+///
+/// \param points The dlib points.
+/// \returns a view of the points as glm vectors.
+template <typename T>
+inline ArrayView<glm::tvec3<T>> toOf(const std::vector<dlib::vector<T, 3>>& points)
+{
+    static_assert(IsLayoutCompatible<dlib::vector<T, 3>, glm::tvec3<T>>::value,
+                  "dlib::vector<T, 3> and glm::tvec3<T> have different layouts.");
+    return ArrayView<glm::tvec3<T>>(reinterpret_cast<const glm::tvec3<T>*>(points.data()), points.size());
+}
+
+
+/// \brief View glm vectors as dlib vectors with no copies.
+/// \param points The glm points.
+/// \returns a view of the points as dlib vectors.
+template <typename T>
+inline ArrayView<dlib::vector<T, 2>> toDlib(const std::vector<glm::tvec2<T>>& points)
+{
+    static_assert(IsLayoutCompatible<glm::tvec2<T>, dlib::vector<T, 2>>::value,
+                  "glm::tvec2<T> and dlib::vector<T, 2> have different layouts.");
+    return ArrayView<dlib::vector<T, 2>>(reinterpret_cast<const dlib::vector<T, 2>*>(points.data()), points.size());
+}
+
+
+/// \brief View glm vectors as dlib vectors with no copies.
+///
+/// This lets dlib geometry run directly on mesh vertices, e.g.
+/// `toDlib(mesh.getVertices())`.
+///
+/// \param points The glm points.
+/// \returns a view of the points as dlib vectors.
+template <typename T>
+inline ArrayView<dlib::vector<T, 3>> toDlib(const std::vector<glm::tvec3<T>>& points)
+{
+    static_assert(IsLayoutCompatible<glm::tvec3<T>, dlib::vector<T, 3>>::value,
+                  "glm::tvec3<T> and dlib::vector<T, 3> have different layouts.");
+    return ArrayView<dlib::vector<T, 3>>(reinterpret_cast<const dlib::vector<T, 3>*>(points.data()), points.size());
+}
+
+
+/// \brief Convert dlib pixels to float colors.
+///
+/// Each channel is mapped from [0, 255] to [0, 1] with a lookup table and the
+/// alpha is 1, the same as ofFloatColor(toOf(pixel)) for every pixel.
+///
+/// \param pixels The input pixels.
+/// \param size The number of pixels.
+/// \param colors The output colors, with room for size colors.
+void toOf(const dlib::rgb_pixel* pixels, std::size_t size, ofFloatColor* colors);
+
+
+/// \brief Convert dlib pixels to float colors.
+/// \param pixels The input pixels.
+/// \param colors The output colors. It is resized to the number of pixels.
+inline void toOf(const std::vector<dlib::rgb_pixel>& pixels, std::vector<ofFloatColor>& colors)
+{
+    colors.resize(pixels.size());
+    toOf(pixels.data(), pixels.size(), colors.data());
+}
+
+
+/// \brief Replace the vertices and colors of a mesh.
+///
+/// Each attribute is resized once and written in a single pass, instead of
+/// growing one point at a time with ofMesh::addVertex() and addColor().
+///
+/// \param mesh The mesh to fill. Its other attributes are unchanged.
+/// \param points The vertices.
+/// \param colors The vertex colors, or empty to clear the colors.
+/// \throws std::invalid_argument if there are colors but not one per point.
+template <typename T>
+void setPoints(ofMesh& mesh,
+               const std::vector<dlib::vector<T, 3>>& points,
+               const std::vector<dlib::rgb_pixel>& colors = std::vector<dlib::rgb_pixel>())
+{
+    if (!colors.empty() && colors.size() != points.size())
+        throw std::invalid_argument("setPoints: There must be one color per point.");
+
+    auto& vertices = mesh.getVertices();
+    vertices.resize(points.size());
+
+    const ArrayView<glm::tvec3<T>> view = toOf(points);
+    std::transform(view.begin(), view.end(), vertices.begin(), [](const glm::tvec3<T>& point) {
+        return glm::vec3(point);
+    });
+
+    auto& meshColors = mesh.getColors();
+    meshColors.resize(colors.size());
+    toOf(colors.data(), colors.size(), meshColors.data());
+}
+
+
+} } // namespace ofx::Dlib
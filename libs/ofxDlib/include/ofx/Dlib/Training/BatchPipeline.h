@@ -0,0 +1,373 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dlib/rand.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Timing statistics of a BatchPipeline.
+struct BatchPipelineStats
+{
+    /// \brief The number of batches returned by next().
+    uint64_t numBatches = 0;
+
+    /// \brief The total time next() waited for a batch in milliseconds.
+    ///
+    /// If this grows while training, the workers can't keep up with the
+    /// trainer and more workers (or cheaper augmentation) are needed.
+    double stallMs = 0;
+
+    /// \brief The total time the workers spent making batches in milliseconds.
+    double produceMs = 0;
+
+    /// \brief The total time the workers waited for queue space in milliseconds.
+    double idleMs = 0;
+
+    /// \returns the mean time next() waited per batch in milliseconds.
+    double meanStallMs() const
+    {
+        return numBatches > 0 ? stallMs / numBatches : 0;
+    }
+
+    /// \returns the mean time to make one batch on one worker in milliseconds.
+    double meanProduceMs() const
+    {
+        return numBatches > 0 ? produceMs / numBatches : 0;
+    }
+};
+
+
+/// \brief Makes training mini-batches on worker threads ahead of the trainer.
+///
+/// Each worker repeatedly calls the batch function to fill a mini-batch
+/// (e.g. sampling, cropping and augmenting images) and puts the result into a
+/// bounded prefetch queue. The training loop takes ready batches with next()
+/// and only waits if the queue is empty.
+///
+/// Every worker has its own dlib::rand seeded from the pipeline seed and the
+/// worker index. Batch i is always made by worker i % numWorkers and next()
+/// returns batches in index order, so for a given seed and number of workers
+/// the sequence of batches is reproducible.
+///
+///     BatchPipeline<matrix<unsigned char>, unsigned long> pipeline(
+///         [&](BatchPipeline<matrix<unsigned char>, unsigned long>::Batch& batch, dlib::rand& rnd) {
+///             batch.samples.resize(128);
+///             batch.labels.resize(128);
+///             for (std::size_t i = 0; i < 128; ++i)
+///             {
+///                 auto idx = rnd.get_random_32bit_number() % images.size();
+///                 batch.samples[i] = images[idx];
+///                 batch.labels[i] = labels[idx];
+///             }
+///         });
+///
+///     BatchPipeline<matrix<unsigned char>, unsigned long>::Batch batch;
+///     while (trainer.get_learning_rate() >= 1e-6 && pipeline.next(batch))
+///         trainer.train_one_step(batch.samples, batch.labels);
+///
+/// \tparam SampleType The input type of the network.
+/// \tparam LabelType The training label type of the network.
+template <typename SampleType, typename LabelType>
+class BatchPipeline
+{
+public:
+    /// \brief A mini-batch.
+    struct Batch
+    {
+        std::vector<SampleType> samples;
+        std::vector<LabelType> labels;
+
+        /// \brief The position of the batch in the sequence.
+        uint64_t index = 0;
+
+        /// \brief The worker that made the batch.
+        std::size_t worker = 0;
+    };
+
+    /// \brief Fills a batch.
+    ///
+    /// Batches are recycled, so the batch passed in may hold the data of an
+    /// earlier batch. Resizing and assigning the samples reuses their memory.
+    /// The function is called concurrently from all workers and must only
+    /// share read-only data. Per-worker state (e.g. a dlib::random_cropper)
+    /// can be indexed with batch.worker.
+    typedef std::function<void(Batch& batch, dlib::rand& rnd)> BatchFunction;
+
+    struct Settings
+    {
+        /// \brief The number of worker threads.
+        std::size_t numWorkers = std::max(1u, std::thread::hardware_concurrency() / 2);
+
+        /// \brief The maximum number of ready batches waiting for next().
+        std::size_t queueSize = 4;
+
+        /// \brief The seed of the worker random number generators.
+        uint64_t seed = 0;
+    };
+
+    /// \brief Start the workers with default settings.
+    /// \param batchFunction The function that fills a batch.
+    BatchPipeline(BatchFunction batchFunction);
+
+    /// \brief Start the workers.
+    /// \param batchFunction The function that fills a batch.
+    /// \param settings The pipeline settings.
+    BatchPipeline(BatchFunction batchFunction, const Settings& settings);
+
+    /// \brief Stop and join the workers.
+    ~BatchPipeline();
+
+    BatchPipeline(const BatchPipeline&) = delete;
+    BatchPipeline& operator = (const BatchPipeline&) = delete;
+
+    /// \brief Get the next batch, waiting if none is ready.
+    ///
+    /// The batch previously held by \p batch is given back to the workers
+    /// for reuse.
+    ///
+    /// \param batch The batch to fill.
+    /// \returns false if the pipeline was stopped.
+    /// \throws any exception thrown by the batch function.
+    bool next(Batch& batch);
+
+    /// \brief Stop the workers. Pending and future next() calls return false.
+    void stop();
+
+    /// \returns the settings.
+    const Settings& settings() const
+    {
+        return _settings;
+    }
+
+    /// \returns a copy of the current statistics.
+    BatchPipelineStats stats() const;
+
+    /// \brief Reset the statistics.
+    void resetStats();
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    void _run(std::size_t worker);
+
+    static double _elapsedMs(const Clock::time_point& start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    BatchFunction _batchFunction;
+
+    Settings _settings;
+
+    /// \brief Ready batches by index.
+    std::map<uint64_t, Batch> _ready;
+
+    /// \brief Batches returned by next() for reuse.
+    std::vector<Batch> _free;
+
+    /// \brief The index of the next batch returned by next().
+    uint64_t _nextIndex = 0;
+
+    BatchPipelineStats _stats;
+
+    std::exception_ptr _exception;
+
+    bool _running = true;
+
+    mutable std::mutex _mutex;
+
+    /// \brief Signals a new ready batch.
+    std::condition_variable _readyCondition;
+
+    /// \brief Signals free queue space.
+    std::condition_variable _spaceCondition;
+
+    std::vector<std::thread> _threads;
+
+};
+
+
+template <typename SampleType, typename LabelType>
+BatchPipeline<SampleType, LabelType>::BatchPipeline(BatchFunction batchFunction):
+    BatchPipeline(batchFunction, Settings())
+{
+}
+
+
+template <typename SampleType, typename LabelType>
+BatchPipeline<SampleType, LabelType>::BatchPipeline(BatchFunction batchFunction,
+                                                    const Settings& settings):
+    _batchFunction(batchFunction),
+    _settings(settings)
+{
+    _settings.numWorkers = std::max(std::size_t(1), _settings.numWorkers);
+    _settings.queueSize = std::max(std::size_t(1), _settings.queueSize);
+
+    for (std::size_t i = 0; i < _settings.numWorkers; ++i)
+        _threads.emplace_back(&BatchPipeline::_run, this, i);
+}
+
+
+template <typename SampleType, typename LabelType>
+BatchPipeline<SampleType, LabelType>::~BatchPipeline()
+{
+    stop();
+
+    for (auto& thread: _threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+
+template <typename SampleType, typename LabelType>
+bool BatchPipeline<SampleType, LabelType>::next(Batch& batch)
+{
+    auto start = Clock::now();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _readyCondition.wait(lock, [&]() {
+        return !_running || _exception || _ready.find(_nextIndex) != _ready.end();
+    });
+
+    if (_exception)
+        std::rethrow_exception(_exception);
+
+    if (!_running)
+        return false;
+
+    auto iter = _ready.find(_nextIndex);
+
+    std::swap(batch, iter->second);
+    _free.push_back(std::move(iter->second));
+    _ready.erase(iter);
+
+    ++_nextIndex;
+    ++_stats.numBatches;
+    _stats.stallMs += _elapsedMs(start);
+
+    lock.unlock();
+    _spaceCondition.notify_all();
+
+    return true;
+}
+
+
+template <typename SampleType, typename LabelType>
+void BatchPipeline<SampleType, LabelType>::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+    }
+
+    _readyCondition.notify_all();
+    _spaceCondition.notify_all();
+}
+
+
+template <typename SampleType, typename LabelType>
+BatchPipelineStats BatchPipeline<SampleType, LabelType>::stats() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+
+template <typename SampleType, typename LabelType>
+void BatchPipeline<SampleType, LabelType>::resetStats()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stats = BatchPipelineStats();
+}
+
+
+template <typename SampleType, typename LabelType>
+void BatchPipeline<SampleType, LabelType>::_run(std::size_t worker)
+{
+    dlib::rand rnd;
+    rnd.set_seed(std::to_string(_settings.seed) + ":" + std::to_string(worker));
+
+    for (uint64_t index = worker; ; index += _settings.numWorkers)
+    {
+        Batch batch;
+
+        {
+            auto start = Clock::now();
+
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            // Stay at most queueSize batches ahead of the consumer.
+            _spaceCondition.wait(lock, [&]() {
+                return !_running || index < _nextIndex + _settings.queueSize;
+            });
+
+            if (!_running)
+                return;
+
+            _stats.idleMs += _elapsedMs(start);
+
+            if (!_free.empty())
+            {
+                batch = std::move(_free.back());
+                _free.pop_back();
+            }
+        }
+
+        batch.index = index;
+        batch.worker = worker;
+
+        auto start = Clock::now();
+
+        try
+        {
+            _batchFunction(batch, rnd);
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _exception = std::current_exception();
+            _running = false;
+            lock.unlock();
+            _readyCondition.notify_all();
+            _spaceCondition.notify_all();
+            return;
+        }
+
+        double produceMs = _elapsedMs(start);
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _stats.produceMs += produceMs;
+            _ready[index] = std::move(batch);
+        }
+
+        _readyCondition.notify_all();
+    }
+}
+
+
+} } // namespace ofx::Dlib
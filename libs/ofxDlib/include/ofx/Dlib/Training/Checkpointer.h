@@ -0,0 +1,346 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dlib/dnn.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief The cost of one checkpoint.
+struct CheckpointStats
+{
+    /// \brief The sequence number of the checkpoint.
+    uint64_t sequence = 0;
+
+    /// \brief The training step of the checkpoint.
+    uint64_t step = 0;
+
+    /// \brief The path of the checkpoint manifest.
+    std::string path;
+
+    /// \brief The time the training thread spent copying parameters in milliseconds.
+    double snapshotMs = 0;
+
+    /// \brief The time the background thread spent hashing and writing in milliseconds.
+    double writeMs = 0;
+
+    /// \brief The number of parameter tensors.
+    std::size_t numTensors = 0;
+
+    /// \brief The number of tensors that changed and were written.
+    std::size_t numWritten = 0;
+
+    /// \brief The size of all parameter tensors in bytes.
+    uint64_t totalBytes = 0;
+
+    /// \brief The number of bytes written.
+    uint64_t bytesWritten = 0;
+
+    /// \returns a one line summary for the training log.
+    std::string toString() const;
+};
+
+
+/// \brief Writes parameter checkpoints on a background thread.
+///
+/// snapshot() copies the parameters of every layer into a staging buffer,
+/// which is the only work done on the training thread. A background thread
+/// then hashes each tensor and writes the tensors whose contents changed
+/// since they were last written.
+///
+/// Tensors are stored once per content hash in the checkpoint directory and
+/// every checkpoint is a small manifest listing the tensors it uses, so
+/// layers that don't change (e.g. frozen layers or layers with a zero
+/// learning rate multiplier) are written only once. The newest N manifests
+/// are kept. Tensors no longer used by any manifest are deleted.
+///
+/// Manifests are numbered in the order they are written, continuing from
+/// the checkpoints already in the directory, so the newest checkpoint is
+/// always the one written last, even if a resumed run counts its steps
+/// from 0 again.
+///
+/// Snapshots are double buffered like ActivationTap. If the writer is still
+/// busy when a new snapshot is taken, a snapshot that hasn't been started yet
+/// is replaced and counted as dropped.
+///
+///     Checkpointer checkpointer;
+///     ...
+///     if (checkpointer.isDue())
+///         checkpointer.snapshot(trainer.get_net(), trainer.get_train_one_step_calls(), trainer.get_learning_rate());
+///
+/// Checkpoints hold the layer parameters and the learning rate only. Solver
+/// state (e.g. sgd momentum), the trainer's count of steps without progress
+/// and layer statistics that aren't parameters (e.g. bn_con running means)
+/// are not saved, so a resumed trainer restarts its momentum and waits for
+/// a full run of steps without progress before lowering the learning rate
+/// again. restore() needs a network that has been set up, e.g. by running
+/// it on one sample.
+class Checkpointer
+{
+public:
+    struct Settings
+    {
+        /// \brief The checkpoint directory, relative to the data folder.
+        std::string directory = "checkpoints";
+
+        /// \brief The number of checkpoints to keep.
+        std::size_t numCheckpoints = 3;
+
+        /// \brief The time between checkpoints used by isDue().
+        std::chrono::seconds interval = std::chrono::minutes(5);
+
+        /// \brief Log the cost of each checkpoint with ofLogNotice().
+        bool verbose = true;
+    };
+
+    /// \brief Start the writer thread with default settings.
+    Checkpointer();
+
+    /// \brief Start the writer thread.
+    /// \param settings The checkpoint settings.
+    Checkpointer(const Settings& settings);
+
+    /// \brief Write the pending snapshot and stop the writer thread.
+    ~Checkpointer();
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator = (const Checkpointer&) = delete;
+
+    /// \returns true if the interval has passed since the last snapshot.
+    bool isDue() const;
+
+    /// \brief Copy the network parameters and hand them to the writer.
+    ///
+    /// The network is only read. It is taken by const reference so the
+    /// result of dlib::dnn_trainer::get_net() can be passed directly.
+    ///
+    /// \param net The network.
+    /// \param step The training step, stored with the checkpoint.
+    /// \param learningRate The learning rate, stored with the checkpoint.
+    template <typename NET>
+    void snapshot(const NET& net, uint64_t step, double learningRate = 0);
+
+    /// \brief Wait until all snapshots are written.
+    void flush();
+
+    /// \returns the cost of the last written checkpoint.
+    CheckpointStats getLastStats() const;
+
+    /// \returns the number of snapshots replaced before they were written.
+    uint64_t getDroppedCount() const;
+
+    /// \returns the checkpoint manifests, oldest first.
+    std::vector<std::string> getCheckpoints() const;
+
+    /// \brief Load the parameters of a checkpoint into a network.
+    /// \param net A network of the checkpointed type that has been set up.
+    /// \param manifest The manifest path.
+    /// \param learningRate If not nullptr, set to the stored learning rate,
+    ///        or 0 if none was stored.
+    /// \returns true if all parameters were loaded.
+    template <typename NET>
+    bool restore(NET& net, const std::string& manifest, double* learningRate = nullptr) const;
+
+    /// \brief Load the newest checkpoint into a network.
+    /// \param net A network of the checkpointed type that has been set up.
+    /// \param learningRate If not nullptr, set to the stored learning rate,
+    ///        or 0 if none was stored.
+    /// \returns the step of the checkpoint, or 0 if none was loaded.
+    template <typename NET>
+    uint64_t restoreLatest(NET& net, double* learningRate = nullptr) const;
+
+private:
+    /// \brief A copy of the network parameters.
+    struct Snapshot
+    {
+        uint64_t step = 0;
+        double learningRate = 0;
+        double snapshotMs = 0;
+        std::vector<std::vector<float>> tensors;
+    };
+
+    /// \brief A manifest entry.
+    struct Entry
+    {
+        uint64_t size = 0;
+        uint64_t hash = 0;
+    };
+
+    /// \brief Hand the write snapshot to the writer thread.
+    void _submit();
+
+    /// \brief Read a manifest.
+    bool _readManifest(const std::string& path,
+                       uint64_t& step,
+                       double& learningRate,
+                       std::vector<Entry>& entries) const;
+
+    /// \brief Read a tensor file into a buffer.
+    bool _readTensor(const Entry& entry, float* data) const;
+
+    /// \brief Write a snapshot. Called on the writer thread.
+    void _write(const Snapshot& snapshot);
+
+    /// \brief Delete old manifests and unused tensors. Called on the writer thread.
+    void _rotate();
+
+    /// \returns the path of a tensor file.
+    std::string _tensorPath(const Entry& entry) const;
+
+    /// \brief The writer thread loop.
+    void _run();
+
+    Settings _settings;
+
+    /// \brief The absolute checkpoint directory.
+    std::string _directory;
+
+    /// \brief The snapshot filled by snapshot(). Only used by the training thread.
+    std::unique_ptr<Snapshot> _writeSnapshot;
+
+    /// \brief The submitted snapshot waiting for the writer.
+    std::unique_ptr<Snapshot> _pendingSnapshot;
+
+    /// \brief The snapshot the writer is writing.
+    std::unique_ptr<Snapshot> _workSnapshot;
+
+    bool _hasPendingSnapshot = false;
+    bool _writing = false;
+
+    /// \brief The tensor files known to exist. Only used by the writer thread.
+    std::set<std::string> _written;
+
+    /// \brief The sequence number of the last manifest. Only used by the
+    ///        writer thread after construction.
+    uint64_t _sequence = 0;
+
+    std::chrono::steady_clock::time_point _lastSnapshot;
+
+    CheckpointStats _lastStats;
+    uint64_t _droppedCount = 0;
+
+    bool _running = true;
+
+    mutable std::mutex _mutex;
+    std::condition_variable _condition;
+    std::condition_variable _idleCondition;
+    std::thread _thread;
+
+};
+
+
+template <typename NET>
+void Checkpointer::snapshot(const NET& net, uint64_t step, double learningRate)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::vector<float>>& tensors = _writeSnapshot->tensors;
+    std::size_t count = 0;
+
+    // dlib only visits non-const networks. The parameters are only read.
+    dlib::visit_layer_parameters(const_cast<NET&>(net), [&](std::size_t, dlib::tensor& t) {
+        if (count == tensors.size())
+            tensors.emplace_back();
+
+        const float* data = t.host();
+        tensors[count++].assign(data, data + t.size());
+    });
+
+    tensors.resize(count);
+
+    _writeSnapshot->step = step;
+    _writeSnapshot->learningRate = learningRate;
+    _writeSnapshot->snapshotMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    _submit();
+}
+
+
+template <typename NET>
+bool Checkpointer::restore(NET& net, const std::string& manifest, double* learningRate) const
+{
+    uint64_t step = 0;
+    double rate = 0;
+    std::vector<Entry> entries;
+
+    if (!_readManifest(manifest, step, rate, entries))
+        return false;
+
+    // Read everything first so a damaged checkpoint leaves the network intact.
+    std::vector<std::vector<float>> values(entries.size());
+
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        values[i].resize(std::size_t(entries[i].size));
+
+        if (!values[i].empty() && !_readTensor(entries[i], values[i].data()))
+            return false;
+    }
+
+    std::size_t count = 0;
+    bool result = true;
+
+    dlib::visit_layer_parameters(net, [&](std::size_t, dlib::tensor& t) {
+        if (count >= values.size() || values[count].size() != t.size())
+            result = false;
+
+        ++count;
+    });
+
+    if (!result || count != values.size())
+        return false;
+
+    count = 0;
+
+    dlib::visit_layer_parameters(net, [&](std::size_t, dlib::tensor& t) {
+        std::copy(values[count].begin(), values[count].end(), t.host());
+        ++count;
+    });
+
+    if (learningRate)
+        *learningRate = rate;
+
+    return true;
+}
+
+
+template <typename NET>
+uint64_t Checkpointer::restoreLatest(NET& net, double* learningRate) const
+{
+    auto checkpoints = getCheckpoints();
+
+    // Fall back to older checkpoints if the newest one is damaged.
+    for (auto iter = checkpoints.rbegin(); iter != checkpoints.rend(); ++iter)
+    {
+        uint64_t step = 0;
+        double rate = 0;
+        std::vector<Entry> entries;
+
+        if (_readManifest(*iter, step, rate, entries) && restore(net, *iter, learningRate))
+            return step;
+    }
+
+    return 0;
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,911 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dlib/dir_nav.h"
+#include "dlib/dnn.h"
+#include "dlib/statistics/running_gradient.h"
+#include "ofLog.h"
+#include "ofx/Dlib/Training/Telemetry.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Trains a network on many CPU cores with data-parallel replicas.
+///
+/// Each mini-batch is split into one shard per replica. Every replica runs
+/// the forward and backward pass of its shard on its own thread. The
+/// gradients are then summed with a binary tree reduction: in round r the
+/// replica with index i (a multiple of 2^(r+1)) adds the gradients of replica
+/// i + 2^r. Replicas signal that their subtree is reduced with an atomic step
+/// stamp, so the reduction takes no locks. The first replica is the trained
+/// network itself. It runs the solver step and the other replicas copy its
+/// new parameters.
+///
+/// The learning rate schedule follows dlib::dnn_trainer: the learning rate
+/// is shrunk when the loss has not decreased for a number of steps. The
+/// synchronization file works like dnn_trainer's. It is written at an
+/// interval, alternating between two files so an interrupted write never
+/// destroys the last checkpoint, and an existing file is loaded when it is
+/// set, so an interrupted run continues where it stopped.
+///
+/// The files are shared with dnn_trainer. Each one starts with a
+/// dnn_trainer record of the network and the learning rate schedule, which
+/// dnn_trainer::set_synchronization_file() loads. dnn_trainer can't be
+/// given solver state or a step count, so the record has fresh solvers and
+/// no steps, and a second record after it keeps the solvers, step count and
+/// recent losses for ParallelTrainer. A dnn_trainer sync file loads here
+/// with its solvers and step count but without the recent losses, so the
+/// next learning rate shrink waits for a full window of new steps.
+///
+///     ParallelTrainer<LeNet5::Net> trainer(net, dlib::sgd());
+///     trainer.setLearningRate(0.01);
+///     trainer.setSynchronizationFile("mnist_sync", std::chrono::seconds(20));
+///     trainer.train(images, labels);
+///
+/// With setTelemetry(), every step reports its forward, backward, sync and
+/// update times, its loss and its gradient norms. The phase times are those
+/// of the slowest replica.
+///
+/// Layers that keep statistics outside of their parameters (e.g. bn_con
+/// running means) only update the statistics of the first replica.
+///
+/// \tparam NET The network type.
+/// \tparam SOLVER The solver type, e.g. dlib::sgd or dlib::adam.
+template <typename NET, typename SOLVER = dlib::sgd>
+class ParallelTrainer
+{
+public:
+    typedef typename NET::input_type input_type;
+    typedef typename NET::training_label_type training_label_type;
+
+    struct Settings
+    {
+        /// \brief The number of network replicas, each on its own thread.
+        std::size_t numReplicas = std::max(1u, std::thread::hardware_concurrency());
+    };
+
+    /// \brief Create a trainer with default settings.
+    /// \param net The network to train.
+    /// \param solver The solver copied to every layer.
+    ParallelTrainer(NET& net, const SOLVER& solver = SOLVER());
+
+    /// \brief Create a trainer.
+    /// \param net The network to train.
+    /// \param solver The solver copied to every layer.
+    /// \param settings The trainer settings.
+    ParallelTrainer(NET& net, const SOLVER& solver, const Settings& settings);
+
+    /// \brief Write the synchronization file and stop the workers.
+    ~ParallelTrainer();
+
+    ParallelTrainer(const ParallelTrainer&) = delete;
+    ParallelTrainer& operator = (const ParallelTrainer&) = delete;
+
+    /// \brief Run one solver step on a mini-batch.
+    ///
+    /// The mini-batch is split evenly between the replicas. If it has fewer
+    /// samples than there are replicas, only some replicas are used.
+    ///
+    /// If a replica throws, the step is abandoned and the exception is
+    /// rethrown here. The parameters are left as they were before the step,
+    /// and the next step can run as usual.
+    ///
+    /// \param data The samples.
+    /// \param labels The labels of the samples.
+    /// \throws std::invalid_argument if the sizes don't match.
+    void trainOneStep(const std::vector<input_type>& data,
+                      const std::vector<training_label_type>& labels);
+
+    /// \brief Train until the learning rate drops below the minimum.
+    ///
+    /// Like dlib::dnn_trainer::train(), each epoch shuffles the data and
+    /// trains on consecutive mini-batches.
+    ///
+    /// \param data The samples.
+    /// \param labels The labels of the samples.
+    void train(const std::vector<input_type>& data,
+               const std::vector<training_label_type>& labels);
+
+    /// \returns the trained network.
+    NET& getNet()
+    {
+        return _net;
+    }
+
+    /// \returns the number of replicas.
+    std::size_t numReplicas() const
+    {
+        return _settings.numReplicas;
+    }
+
+    void setLearningRate(double learningRate)
+    {
+        _learningRate = learningRate;
+        _stepsSinceLastShrink = 0;
+        _previousLossValues.clear();
+    }
+
+    double getLearningRate() const
+    {
+        return _learningRate;
+    }
+
+    void setMinLearningRate(double minLearningRate)
+    {
+        _minLearningRate = minLearningRate;
+    }
+
+    double getMinLearningRate() const
+    {
+        return _minLearningRate;
+    }
+
+    void setLearningRateShrinkFactor(double shrinkFactor)
+    {
+        _shrinkFactor = shrinkFactor;
+    }
+
+    void setIterationsWithoutProgressThreshold(std::size_t threshold)
+    {
+        _iterationsWithoutProgressThreshold = threshold;
+    }
+
+    void setMiniBatchSize(std::size_t size)
+    {
+        _miniBatchSize = std::max(std::size_t(1), size);
+    }
+
+    /// \brief Print the progress to std::cout.
+    void beVerbose()
+    {
+        _verbose = true;
+    }
+
+    /// \returns the number of trainOneStep() calls.
+    uint64_t getTrainOneStepCalls() const
+    {
+        return _steps;
+    }
+
+    /// \returns the number of steps since the learning rate last changed.
+    uint64_t getStepsWithoutProgress() const
+    {
+        return _previousLossValues.empty() ? 0 : dlib::count_steps_without_decrease(_previousLossValues);
+    }
+
+    /// \returns the mean loss of the recent steps.
+    double getAverageLoss() const;
+
+    /// \brief Save the training state regularly and resume from it.
+    ///
+    /// If the file (or its alternate, with an appended underscore) exists,
+    /// the newer of the two is loaded.
+    ///
+    /// \param filename The synchronization file name.
+    /// \param interval The time between writes.
+    void setSynchronizationFile(const std::string& filename,
+                                std::chrono::seconds interval = std::chrono::minutes(15));
+
+    /// \brief Report every step to a telemetry object.
+    ///
+    /// train() also reports the time it spends copying mini-batches as
+    /// TrainingTelemetry::PHASE_DATA.
+    ///
+    /// \param telemetry The telemetry, which must outlive the trainer, or
+    ///        nullptr to stop reporting.
+    void setTelemetry(TrainingTelemetry* telemetry)
+    {
+        _telemetry = telemetry;
+    }
+
+private:
+    /// \brief Write the training state to the older of the two files.
+    void _sync();
+
+    /// \brief Load a synchronization file written by this class or by
+    ///        dlib::dnn_trainer.
+    /// \returns false if the file can't be read.
+    bool _load(const std::string& filename, uint64_t& steps);
+
+    /// \brief Set up the network and make the replicas on the first step.
+    void _initialize(const input_type& sample);
+
+    /// \brief Spin until an atomic stamp reaches a step.
+    /// \returns false if another worker failed.
+    bool _waitFor(const std::atomic<uint64_t>& stamp, uint64_t step) const;
+
+    /// \brief The worker thread loop.
+    void _run(std::size_t worker);
+
+    /// \brief One worker's part of a step.
+    void _step(std::size_t worker, uint64_t step);
+
+    NET& _net;
+
+    Settings _settings;
+
+    /// \brief The solver every layer starts with.
+    SOLVER _solver;
+
+    std::vector<SOLVER> _solvers;
+
+    /// \brief The replicas of workers 1..N-1. Worker 0 uses _net.
+    std::vector<std::unique_ptr<NET>> _replicas;
+
+    bool _initialized = false;
+
+    /// \brief The current mini-batch.
+    const std::vector<input_type>* _data = nullptr;
+    const std::vector<training_label_type>* _labels = nullptr;
+
+    /// \brief The number of replicas used for the current mini-batch.
+    std::size_t _numActive = 0;
+
+    /// \brief Per worker input tensors.
+    std::vector<dlib::resizable_tensor> _inputs;
+
+    /// \brief Per worker parameter gradients.
+    std::vector<std::vector<dlib::tensor*>> _gradients;
+
+    /// \brief Per worker shard losses.
+    std::vector<double> _losses;
+
+    /// \brief Per worker phase times of the current step in milliseconds.
+    std::vector<std::array<double, TrainingTelemetry::NUM_PHASES>> _phaseMs;
+
+    TrainingTelemetry* _telemetry = nullptr;
+
+    /// \brief The parameters of _net after the solver step.
+    std::vector<dlib::tensor*> _masterParameters;
+
+    /// \brief The last step in which each worker's subtree was reduced.
+    std::unique_ptr<std::atomic<uint64_t>[]> _reduced;
+
+    /// \brief The last step in which the solver updated _net.
+    std::atomic<uint64_t> _updated;
+
+    /// \brief True if a worker threw an exception in the current step.
+    std::atomic<bool> _failed;
+
+    /// \brief The first exception of the current step.
+    std::exception_ptr _exception;
+
+    double _learningRate = 1e-2;
+    double _minLearningRate = 1e-5;
+    double _shrinkFactor = 0.1;
+    std::size_t _iterationsWithoutProgressThreshold = 2000;
+    std::size_t _miniBatchSize = 128;
+    uint64_t _stepsSinceLastShrink = 0;
+    std::deque<double> _previousLossValues;
+
+    bool _verbose = false;
+    std::chrono::steady_clock::time_point _lastVerbose;
+
+    std::string _syncFilename;
+    std::chrono::seconds _syncInterval;
+    std::chrono::steady_clock::time_point _lastSync;
+
+    /// \brief True if the next sync writes the alternate file.
+    bool _syncAlternate = false;
+
+    /// \brief The number of completed steps.
+    uint64_t _steps = 0;
+
+    /// \brief The step the workers should run.
+    uint64_t _jobStep = 0;
+
+    /// \brief The number of workers done with _jobStep.
+    std::size_t _finished = 0;
+
+    bool _running = true;
+
+    std::mutex _mutex;
+    std::condition_variable _startCondition;
+    std::condition_variable _doneCondition;
+    std::vector<std::thread> _threads;
+
+};
+
+
+template <typename NET, typename SOLVER>
+ParallelTrainer<NET, SOLVER>::ParallelTrainer(NET& net, const SOLVER& solver):
+    ParallelTrainer(net, solver, Settings())
+{
+}
+
+
+template <typename NET, typename SOLVER>
+ParallelTrainer<NET, SOLVER>::ParallelTrainer(NET& net,
+                                              const SOLVER& solver,
+                                              const Settings& settings):
+    _net(net),
+    _settings(settings),
+    _solver(solver),
+    _solvers(NET::num_computational_layers, solver),
+    _updated(0),
+    _failed(false)
+{
+    _settings.numReplicas = std::max(std::size_t(1), _settings.numReplicas);
+
+    const std::size_t count = _settings.numReplicas;
+
+    _inputs.resize(count);
+    _gradients.resize(count);
+    _losses.resize(count);
+    _phaseMs.resize(count);
+    _reduced.reset(new std::atomic<uint64_t>[count]);
+
+    for (std::size_t i = 0; i < count; ++i)
+        _reduced[i].store(0);
+
+    for (std::size_t i = 0; i < count; ++i)
+        _threads.emplace_back(&ParallelTrainer::_run, this, i);
+}
+
+
+template <typename NET, typename SOLVER>
+ParallelTrainer<NET, SOLVER>::~ParallelTrainer()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+    }
+
+    _startCondition.notify_all();
+
+    for (auto& thread: _threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+
+    if (!_syncFilename.empty() && _steps > 0)
+    {
+        try
+        {
+            _sync();
+        }
+        catch (const std::exception& exc)
+        {
+            ofLogError("ParallelTrainer::~ParallelTrainer") << exc.what();
+        }
+    }
+}
+
+
+template <typename NET, typename SOLVER>
+void ParallelTrainer<NET, SOLVER>::trainOneStep(const std::vector<input_type>& data,
+                                                const std::vector<training_label_type>& labels)
+{
+    if (data.size() != labels.size())
+        throw std::invalid_argument("ParallelTrainer: data and labels must have the same size.");
+
+    if (data.empty())
+        return;
+
+    if (!_initialized)
+        _initialize(data.front());
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _data = &data;
+        _labels = &labels;
+        _numActive = std::min(data.size(), _settings.numReplicas);
+        _finished = 0;
+        ++_jobStep;
+    }
+
+    _startCondition.notify_all();
+
+    std::exception_ptr exception;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _doneCondition.wait(lock, [&]() {
+            return _finished == _settings.numReplicas;
+        });
+
+        // Clear the failure so it doesn't fail the next step too.
+        std::swap(exception, _exception);
+        _failed = false;
+    }
+
+    if (exception)
+    {
+        // The solver didn't run, but the replicas may have stopped anywhere
+        // in the step, so they are copied from _net again.
+        _initialized = false;
+        std::rethrow_exception(exception);
+    }
+
+    double loss = 0;
+
+    for (std::size_t i = 0; i < _numActive; ++i)
+        loss += _losses[i];
+
+    if (_telemetry)
+    {
+        // Replicas run in parallel, so the slowest one sets the step time.
+        for (std::size_t phase = 0; phase < TrainingTelemetry::NUM_PHASES; ++phase)
+        {
+            double ms = 0;
+
+            for (auto& phaseMs: _phaseMs)
+                ms = std::max(ms, phaseMs[phase]);
+
+            if (ms > 0)
+                _telemetry->addPhaseTime(TrainingTelemetry::Phase(phase), ms);
+        }
+
+        _telemetry->endStep(data.size(), loss / double(data.size()), _learningRate);
+    }
+
+    ++_steps;
+    ++_stepsSinceLastShrink;
+
+    // The learning rate schedule of dlib::dnn_trainer.
+    _previousLossValues.push_back(loss / double(data.size()));
+
+    if (_previousLossValues.size() >= _iterationsWithoutProgressThreshold)
+    {
+        if (dlib::count_steps_without_decrease(_previousLossValues) >= _iterationsWithoutProgressThreshold
+        &&  dlib::count_steps_without_decrease_robust(_previousLossValues) >= _iterationsWithoutProgressThreshold)
+        {
+            _learningRate *= _shrinkFactor;
+            _stepsSinceLastShrink = 0;
+            _previousLossValues.clear();
+        }
+    }
+
+    while (_previousLossValues.size() > _iterationsWithoutProgressThreshold)
+        _previousLossValues.pop_front();
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (_verbose && now - _lastVerbose > std::chrono::seconds(20))
+    {
+        _lastVerbose = now;
+        std::cout << "step#: " << _steps
+                  << "  learning rate: " << _learningRate
+                  << "  average loss: " << getAverageLoss()
+                  << "  steps without apparent progress: " << getStepsWithoutProgress()
+                  << "  replicas: " << _numActive
+                  << std::endl;
+    }
+
+    if (!_syncFilename.empty() && now - _lastSync > _syncInterval)
+    {
+        _sync();
+        _lastSync = now;
+    }
+}
+
+
+template <typename NET, typename SOLVER>
+void ParallelTrainer<NET, SOLVER>::train(const std::vector<input_type>& data,
+                                         const std::vector<training_label_type>& labels)
+{
+    if (data.size() != labels.size())
+        throw std::invalid_argument("ParallelTrainer: data and labels must have the same size.");
+
+    std::vector<std::size_t> order(data.size());
+
+    for (std::size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+
+    dlib::rand rnd;
+    rnd.set_seed(std::to_string(_steps));
+
+    std::vector<input_type> batchData;
+    std::vector<training_label_type> batchLabels;
+
+    while (_learningRate >= _minLearningRate)
+    {
+        // Fisher-Yates shuffle with dlib::rand so runs are reproducible.
+        for (std::size_t i = order.size(); i > 1; --i)
+            std::swap(order[i - 1], order[rnd.get_random_64bit_number() % i]);
+
+        for (std::size_t first = 0;
+             first < order.size() && _learningRate >= _minLearningRate;
+             first += _miniBatchSize)
+        {
+            std::size_t last = std::min(first + _miniBatchSize, order.size());
+
+            auto start = std::chrono::high_resolution_clock::now();
+
+            batchData.resize(last - first);
+            batchLabels.resize(last - first);
+
+            for (std::size_t i = first; i < last; ++i)
+            {
+                batchData[i - first] = data[order[i]];
+                batchLabels[i - first] = labels[order[i]];
+            }
+
+            if (_telemetry)
+                _telemetry->addPhaseTime(TrainingTelemetry::PHASE_DATA, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
+
+            trainOneStep(batchData, batchLabels);
+        }
+    }
+}
+
+
+template <typename NET, typename SOLVER>
+double ParallelTrainer<NET, SOLVER>::getAverageLoss() const
+{
+    if (_previousLossValues.empty())
+        return 0;
+
+    double sum = 0;
+
+    for (auto loss: _previousLossValues)
+        sum += loss;
+
+    return sum / double(_previousLossValues.size());
+}
+
+
+template <typename NET, typename SOLVER>
+void ParallelTrainer<NET, SOLVER>::setSynchronizationFile(const std::string& filename,
+                                                          std::chrono::seconds interval)
+{
+    _syncFilename = filename;
+    _syncInterval = interval;
+    _lastSync = std::chrono::steady_clock::now();
+
+    uint64_t steps0 = 0;
+    uint64_t steps1 = 0;
+
+    bool has0 = dlib::file_exists(filename);
+    bool has1 = dlib::file_exists(filename + "_");
+
+    // Load the newer file last so its state wins.
+    if (has0 && has1)
+    {
+        _load(filename, steps0);
+        _load(filename + "_", steps1);
+
+        if (steps0 > steps1)
+            _load(filename, steps0);
+
+        _syncAlternate = steps0 > steps1;
+    }
+    else if (has0)
+    {
+        _load(filename, steps0);
+        _syncAlternate = true;
+    }
+    else if (has1)
+    {
+        _load(filename + "_", steps1);
+    }
+}
+
+
+template <typename NET, typename SOLVER>
+void ParallelTrainer<NET, SOLVER>::_sync()
+{
+    // Alternate files so an interrupted write keeps the previous state.
+    const std::string filename = _syncAlternate ? _syncFilename + "_" : _syncFilename;
+    _syncAlternate = !_syncAlternate;
+
+    std::vector<double> previousLossValues(_previousLossValues.begin(),
+                                           _previousLossValues.end());
+
+    // A dnn_trainer with the same network and schedule writes the record
+    // dnn_trainer reads. The rest of the state follows it.
+    dlib::dnn_trainer<NET, SOLVER> trainer(_net, _solver);
+    trainer.set_learning_rate(_learningRate);
+    trainer.set_min_learning_rate(_minLearningRate);
+    trainer.set_learning_rate_shrink_factor(_shrinkFactor);
+    trainer.set_iterations_without_progress_threshold(_iterationsWithoutProgressThreshold);
+    trainer.set_mini_batch_size(_miniBatchSize);
+
+    dlib::serialize(filename) << trainer
+                              << std::string("ofxDlib::ParallelTrainer2")
+                              << _solvers
+                              << _steps
+                              << _stepsSinceLastShrink
+                              << previousLossValues;
+}
+
+
+template <typename NET, typename SOLVER>
+bool ParallelTrainer<NET, SOLVER>::_load(const std::string& filename, uint64_t& steps)
+{
+    try
+    {
+        std::ifstream in(filename, std::ios::binary);
+
+        if (!in)
+            throw dlib::serialization_error("Unable to open " + filename);
+
+        NET net;
+        dlib::dnn_trainer<NET, SOLVER> trainer(net, _solver);
+
+        // The friend deserialize() of dnn_trainer is only found through ADL.
+        deserialize(trainer, in);
+
+        std::vector<SOLVER> solvers = trainer.get_solvers();
+        uint64_t stepsSinceLastShrink = 0;
+        std::vector<double> previousLossValues;
+        steps = trainer.get_train_one_step_calls();
+
+        // Files written by ParallelTrainer continue with the solver state
+        // and step count, which dnn_trainer's record doesn't hold.
+        if (in.peek() != std::ifstream::traits_type::eof())
+        {
+            std::string version;
+            dlib::deserialize(version, in);
+
+            if (version != "ofxDlib::ParallelTrainer2")
+                throw dlib::serialization_error("Unexpected version '" + version + "' found while loading " + filename);
+
+            dlib::deserialize(solvers, in);
+            dlib::deserialize(steps, in);
+            dlib::deserialize(stepsSinceLastShrink, in);
+            dlib::deserialize(previousLossValues, in);
+        }
+
+        _learningRate = trainer.get_learning_rate();
+        _minLearningRate = trainer.get_min_learning_rate();
+        _shrinkFactor = trainer.get_learning_rate_shrink_factor();
+        _iterationsWithoutProgressThreshold = std::size_t(trainer.get_iterations_without_progress_threshold());
+        _net = net;
+        _solvers = solvers;
+        _steps = steps;
+        _stepsSinceLastShrink = stepsSinceLastShrink;
+        _previousLossValues.assign(previousLossValues.begin(), previousLossValues.end());
+
+        // Replicas are copied from the loaded network on the next step.
+        _initialized = false;
+        return true;
+    }
+    catch (const std::exception& exc)
+    {
+        ofLogError("ParallelTrainer::_load") << "Unable to load " << filename << ": " << exc.what();
+        steps = 0;
+        return false;
+    }
+}
+
+
+template <typename NET, typename SOLVER>
+void ParallelTrainer<NET, SOLVER>::_initialize(const input_type& sample)
+{
+    // Run one sample so every layer allocates its parameters. The replicas
+    // are then exact copies and stay in sync through the parameter broadcast.
+    _net(sample);
+
+    _replicas.clear();
+
+    for (std::size_t i = 1; i < _settings.numReplicas; ++i)
+        _replicas.emplace_back(new NET(_net));
+
+    _initialized = true;
+}
+
+
+template <typename NET, typename SOLVER>
+bool ParallelTrainer<NET, SOLVER>::_waitFor(const std::atomic<uint64_t>& stamp,
+                                            uint64_t step) const
+{
+    while (stamp.load(std::memory_order_acquire) != step)
+    {
+        if (_failed.load(std::memory_order_relaxed))
+            return false;
+
+        std::this_thread::yield();
+    }
+
+    return true;
+}
+
+
+template <typename NET, typename SOLVER>
+void ParallelTrainer<NET, SOLVER>::_run(std::size_t worker)
+{
+    uint64_t step = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _startCondition.wait(lock, [&]() {
+                return !_running || _jobStep != step;
+            });
+
+            if (!_running)
+                return;
+
+            step = _jobStep;
+        }
+
+        try
+        {
+            _step(worker, step);
+        }
+        catch (...)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            if (!_exception)
+                _exception = std::current_exception();
+
+            _failed = true;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            ++_finished;
+        }
+
+        _doneCondition.notify_one();
+    }
+}
+
+
+template <typename NET, typename SOLVER>
+void ParallelTrainer<NET, SOLVER>::_step(std::size_t worker, uint64_t step)
+{
+    NET& replica = worker == 0 ? _net : *_replicas[worker - 1];
+
+    const std::size_t numActive = _numActive;
+
+    std::array<double, TrainingTelemetry::NUM_PHASES>& phaseMs = _phaseMs[worker];
+    phaseMs.fill(0);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Add the time since the last call to a phase.
+    auto lap = [&](TrainingTelemetry::Phase phase) {
+        auto now = std::chrono::high_resolution_clock::now();
+        phaseMs[phase] += std::chrono::duration<double, std::milli>(now - start).count();
+        start = now;
+    };
+
+    if (worker < numActive)
+    {
+        // Split the mini-batch into contiguous, nearly equal shards.
+        const std::size_t size = _data->size();
+        const std::size_t first = size * worker / numActive;
+        const std::size_t last = size * (worker + 1) / numActive;
+
+        replica.to_tensor(_data->begin() + first, _data->begin() + last, _inputs[worker]);
+
+        // The loss is the shard mean, so the gradients are weighted by the
+        // shard size to sum up to the mean gradient of the whole mini-batch.
+        const double weight = double(last - first) / double(size);
+
+        // This is compute_parameter_gradients() split in two so the passes
+        // can be timed separately.
+        _losses[worker] = double(last - first) * replica.compute_loss(_inputs[worker],
+                                                                      _labels->begin() + first);
+
+        lap(TrainingTelemetry::PHASE_FORWARD);
+
+        replica.back_propagate_error(_inputs[worker]);
+
+        std::vector<dlib::tensor*>& gradients = _gradients[worker];
+        gradients.clear();
+
+        dlib::visit_layer_parameter_gradients(replica, [&](std::size_t, dlib::tensor& t) {
+            gradients.push_back(&t);
+        });
+
+        if (numActive > 1)
+        {
+            const float scale = float(weight);
+
+            for (auto gradient: gradients)
+            {
+                float* data = gradient->host();
+
+                for (std::size_t i = 0; i < gradient->size(); ++i)
+                    data[i] *= scale;
+            }
+        }
+
+        lap(TrainingTelemetry::PHASE_BACKWARD);
+
+        // Tree reduction. A worker adds its partners' subtrees until it is
+        // the partner of a lower worker, then publishes its sum.
+        for (std::size_t stride = 1; stride < numActive; stride *= 2)
+        {
+            if (worker % (2 * stride) != 0)
+            {
+                _reduced[worker].store(step, std::memory_order_release);
+                break;
+            }
+
+            const std::size_t partner = worker + stride;
+
+            if (partner >= numActive)
+                continue;
+
+            if (!_waitFor(_reduced[partner], step))
+                return;
+
+            // Waiting for the partner is load imbalance, not sync time.
+            start = std::chrono::high_resolution_clock::now();
+
+            const std::vector<dlib::tensor*>& partnerGradients = _gradients[partner];
+
+            for (std::size_t j = 0; j < gradients.size(); ++j)
+            {
+                float* data = gradients[j]->host();
+                const float* other = partnerGradients[j]->host();
+
+                for (std::size_t i = 0; i < gradients[j]->size(); ++i)
+                    data[i] += other[i];
+            }
+
+            lap(TrainingTelemetry::PHASE_SYNC);
+        }
+    }
+
+    if (worker == 0)
+    {
+        // _net now holds the gradient of the whole mini-batch.
+        if (_telemetry)
+            _telemetry->recordGradientNorms(_net);
+
+        start = std::chrono::high_resolution_clock::now();
+
+        _net.update_parameters(dlib::make_sstack(_solvers), _learningRate);
+
+        lap(TrainingTelemetry::PHASE_UPDATE);
+
+        _masterParameters.clear();
+
+        dlib::visit_layer_parameters(_net, [&](std::size_t, dlib::tensor& t) {
+            _masterParameters.push_back(&t);
+        });
+
+        _updated.store(step, std::memory_order_release);
+    }
+    else
+    {
+        if (!_waitFor(_updated, step))
+            return;
+
+        start = std::chrono::high_resolution_clock::now();
+
+        std::size_t index = 0;
+
+        dlib::visit_layer_parameters(replica, [&](std::size_t, dlib::tensor& t) {
+            dlib::memcpy(t, *_masterParameters[index++]);
+        });
+
+        lap(TrainingTelemetry::PHASE_SYNC);
+    }
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,320 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#pragma once
+
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "dlib/dnn.h"
+#include "ofParameter.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+/// \brief Collects throughput, phase timing, memory and gradient statistics
+/// of a training run.
+///
+/// The training thread times the phases of each step and calls endStep()
+/// when the step is done. Each step becomes a Record in a bounded history
+/// that can be exported as CSV or JSON, and can also be streamed to a CSV
+/// file while training.
+///
+/// The phase split answers whether a run is input-bound or compute-bound:
+/// if PHASE_DATA takes most of the step time, a faster input pipeline (e.g.
+/// BatchPipeline with more workers) helps more than more compute.
+///
+///     TrainingTelemetry telemetry;
+///     ...
+///     {
+///         auto timer = telemetry.time(TrainingTelemetry::PHASE_DATA);
+///         pipeline.next(batch);
+///     }
+///     {
+///         auto timer = telemetry.time(TrainingTelemetry::PHASE_COMPUTE);
+///         trainer.train_one_step(batch.samples, batch.labels);
+///     }
+///     telemetry.endStep(batch.samples.size());
+///
+/// ParallelTrainer reports the forward, backward, sync and update phases and
+/// the gradient norms itself when it is given a telemetry object. With
+/// dlib::dnn_trainer those phases run on the trainer's thread and can't be
+/// separated, so the time train_one_step() blocks is reported as
+/// PHASE_COMPUTE.
+///
+/// The live view is a set of ofParameter values. update() copies the average
+/// of the recent steps into them and must be called on the thread that reads
+/// them, e.g. in ofApp::update(). The parameters can be added to an ofxGui
+/// panel directly.
+///
+/// All methods are thread-safe.
+class TrainingTelemetry
+{
+public:
+    /// \brief The parts of a training step.
+    enum Phase
+    {
+        /// \brief Loading and augmenting the mini-batch.
+        PHASE_DATA,
+        /// \brief Converting the mini-batch to a tensor and the forward pass.
+        PHASE_FORWARD,
+        /// \brief The backward pass.
+        PHASE_BACKWARD,
+        /// \brief Summing gradients and copying parameters between replicas.
+        PHASE_SYNC,
+        /// \brief The solver step.
+        PHASE_UPDATE,
+        /// \brief Forward, backward and update when they can't be separated.
+        PHASE_COMPUTE,
+        NUM_PHASES
+    };
+
+    /// \brief The statistics of one training step.
+    ///
+    /// Values that weren't measured in a step are NaN.
+    struct Record
+    {
+        /// \brief The step number, starting at 1.
+        uint64_t step = 0;
+
+        /// \brief The time since the telemetry started in seconds.
+        double time = 0;
+
+        /// \brief The number of samples in the step.
+        std::size_t numSamples = 0;
+
+        /// \brief The wall time since the previous step in milliseconds.
+        double stepMs = 0;
+
+        /// \brief The number of samples per second.
+        double samplesPerSecond = 0;
+
+        /// \brief The time spent in each phase in milliseconds.
+        std::array<double, NUM_PHASES> phaseMs;
+
+        /// \brief The training loss.
+        double loss = std::numeric_limits<double>::quiet_NaN();
+
+        /// \brief The learning rate.
+        double learningRate = std::numeric_limits<double>::quiet_NaN();
+
+        /// \brief The resident memory at the end of the step in bytes.
+        uint64_t residentBytes = 0;
+
+        /// \brief The highest resident memory of the process in bytes.
+        uint64_t peakResidentBytes = 0;
+
+        /// \brief The L2 norm of all parameter gradients.
+        double gradientNorm = std::numeric_limits<double>::quiet_NaN();
+
+        /// \brief The L2 norm of each parameter tensor's gradient, in the
+        ///        order of dlib::visit_layer_parameter_gradients().
+        std::vector<double> layerGradientNorms;
+
+        Record()
+        {
+            phaseMs.fill(0);
+        }
+
+        /// \returns the step time not covered by any phase in milliseconds.
+        double otherMs() const;
+
+        /// \returns a one line summary for the training log.
+        std::string toString() const;
+    };
+
+    /// \brief Times a phase until it is destroyed.
+    class Timer
+    {
+    public:
+        Timer(TrainingTelemetry* telemetry, Phase phase);
+        Timer(Timer&& other);
+        ~Timer();
+
+        Timer(const Timer&) = delete;
+        Timer& operator = (const Timer&) = delete;
+
+    private:
+        TrainingTelemetry* _telemetry = nullptr;
+        Phase _phase;
+        std::chrono::high_resolution_clock::time_point _start;
+    };
+
+    struct Settings
+    {
+        /// \brief The number of records kept in the history.
+        std::size_t maxRecords = 100000;
+
+        /// \brief The number of recent steps averaged by the live view.
+        std::size_t window = 50;
+
+        /// \brief A CSV file each record is appended to, or empty for none.
+        std::string csvPath;
+    };
+
+    /// \brief Create a telemetry object with default settings.
+    TrainingTelemetry();
+
+    /// \brief Create a telemetry object.
+    /// \param settings The telemetry settings.
+    TrainingTelemetry(const Settings& settings);
+
+    /// \brief Close the CSV file.
+    ~TrainingTelemetry();
+
+    TrainingTelemetry(const TrainingTelemetry&) = delete;
+    TrainingTelemetry& operator = (const TrainingTelemetry&) = delete;
+
+    /// \brief Time a phase of the current step.
+    /// \param phase The phase.
+    /// \returns a timer that adds its lifetime to the phase.
+    Timer time(Phase phase)
+    {
+        return Timer(this, phase);
+    }
+
+    /// \brief Add time to a phase of the current step.
+    /// \param phase The phase.
+    /// \param ms The time in milliseconds.
+    void addPhaseTime(Phase phase, double ms);
+
+    /// \brief Set the gradient norms of the current step.
+    /// \param layerNorms The L2 norm of each parameter tensor's gradient.
+    void setGradientNorms(const std::vector<double>& layerNorms);
+
+    /// \brief Measure the gradient norms of the current step.
+    ///
+    /// With dlib::dnn_trainer, pass trainer.get_net() to measure the
+    /// gradients of its last step. get_net() waits for the trainer, so this
+    /// should only be done every few steps.
+    ///
+    /// \param net The network after its backward pass.
+    template <typename NET>
+    void recordGradientNorms(NET& net);
+
+    /// \brief Finish the current step.
+    /// \param numSamples The number of samples in the step.
+    /// \param loss The training loss, or NaN if it isn't known.
+    /// \param learningRate The learning rate, or NaN if it isn't known.
+    void endStep(std::size_t numSamples,
+                 double loss = std::numeric_limits<double>::quiet_NaN(),
+                 double learningRate = std::numeric_limits<double>::quiet_NaN());
+
+    /// \brief Clear the history and restart the clock.
+    void reset();
+
+    /// \returns the number of finished steps.
+    uint64_t getStepCount() const;
+
+    /// \returns the last record.
+    Record getLast() const;
+
+    /// \brief Average the recent records.
+    ///
+    /// Times are averaged, throughput is the total number of samples over the
+    /// total time and memory is the latest value.
+    ///
+    /// \param count The number of records to average.
+    /// \returns the average record.
+    Record getAverage(std::size_t count) const;
+
+    /// \returns a copy of the history, oldest first.
+    std::vector<Record> getRecords() const;
+
+    /// \returns the history as CSV text with a header line.
+    std::string toCsv() const;
+
+    /// \returns the history and the averages of all records as JSON text.
+    std::string toJson() const;
+
+    /// \brief Save the history as CSV.
+    /// \param path The file path, relative to the data folder.
+    /// \returns true if the file was written.
+    bool saveCsv(const std::string& path) const;
+
+    /// \brief Save the history as JSON.
+    /// \param path The file path, relative to the data folder.
+    /// \returns true if the file was written.
+    bool saveJson(const std::string& path) const;
+
+    /// \brief Copy the average of the recent steps into the live parameters.
+    void update();
+
+    /// \returns the live parameters.
+    ofParameterGroup& parameters()
+    {
+        return _parameters;
+    }
+
+    /// \returns the name of a phase.
+    static std::string toString(Phase phase);
+
+private:
+    /// \brief Average records. Must be called with _mutex locked.
+    Record _average(std::size_t count) const;
+
+    Settings _settings;
+
+    /// \brief The record of the step in progress.
+    Record _current;
+
+    std::deque<Record> _records;
+
+    uint64_t _steps = 0;
+
+    std::chrono::steady_clock::time_point _start;
+    std::chrono::steady_clock::time_point _lastStep;
+
+    std::ofstream _csv;
+
+    ofParameterGroup _parameters;
+    ofParameter<int> _step;
+    ofParameter<float> _samplesPerSecond;
+    ofParameter<float> _stepMs;
+    std::array<ofParameter<float>, NUM_PHASES> _phasePercent;
+    ofParameter<float> _otherPercent;
+    ofParameter<float> _loss;
+    ofParameter<float> _learningRate;
+    ofParameter<float> _residentMB;
+    ofParameter<float> _peakResidentMB;
+    ofParameter<float> _gradientNorm;
+
+    mutable std::mutex _mutex;
+
+};
+
+
+template <typename NET>
+void TrainingTelemetry::recordGradientNorms(NET& net)
+{
+    std::vector<double> layerNorms;
+
+    dlib::visit_layer_parameter_gradients(net, [&](std::size_t, dlib::tensor& t) {
+        const float* data = t.host();
+        double sum = 0;
+
+        for (std::size_t i = 0; i < t.size(); ++i)
+            sum += double(data[i]) * double(data[i]);
+
+        layerNorms.push_back(std::sqrt(sum));
+    });
+
+    setGradientNorms(layerNorms);
+}
+
+
+} } // namespace ofx::Dlib
@@ -8,6 +8,8 @@
 #pragma once
 
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 #include "dlib/geometry.h"
 #include "dlib/image_processing/full_object_detection.h"
@@ -24,6 +26,16 @@ namespace ofx {
 namespace Dlib {
 
 
+/// \brief Get the resident memory (resident set size) of this process.
+/// \returns the resident memory in bytes or 0 if unavailable.
+uint64_t residentMemoryBytes();
+
+
+/// \brief Get the highest resident memory of this process since it started.
+/// \returns the peak resident memory in bytes or 0 if unavailable.
+uint64_t peakResidentMemoryBytes();
+
+
 /// \brief Wrap a dlib::vector to a glm vector with no copies.
 /// \param v The input dlib vector.
 /// \tparam T vector data type.
@@ -150,6 +162,79 @@ inline ofPixels_<PixelType> toGrayscale(const ofPixels_<PixelType>& pixels)
 }
 
 
+/// \brief Downsample, convert to grayscale and quantize in one pass.
+///
+/// Each output pixel is the mean brightness of the box of input pixels it
+/// covers, where brightness is the largest color channel as in
+/// ofColor::getBrightness() and alpha is ignored. The result is scaled to
+/// [0, 255] and rounded. This replaces toGrayscale(), ofPixels::resize() and a
+/// copy into a dlib::matrix with a single read of the input and no temporary
+/// images.
+///
+/// Only interleaved formats with 1 to 4 channels are supported.
+///
+/// \param pixels The pixels to convert.
+/// \param rows The number of output rows.
+/// \param columns The number of output columns.
+/// \param out The output matrix. Its memory is reused if it has the same size.
+/// \tparam PixelType The openFrameworks ofPixels internal pixel type.
+template <typename PixelType>
+inline void downsampleToGrayscale(const ofPixels_<PixelType>& pixels,
+                                  long rows,
+                                  long columns,
+                                  dlib::matrix<unsigned char>& out)
+{
+    out.set_size(rows, columns);
+
+    const long width = pixels.getWidth();
+    const long height = pixels.getHeight();
+    const std::size_t channels = pixels.getNumChannels();
+
+    if (width == 0 || height == 0 || channels == 0 || channels > 4)
+    {
+        out = 0;
+        return;
+    }
+
+    // Gray + alpha and RGBA have an alpha channel that isn't a color.
+    const std::size_t colors = channels == 2 ? 1 : std::min(channels, std::size_t(3));
+    const double scale = 255.0 / double(ofColor_<PixelType>::limit());
+    const PixelType* data = pixels.getData();
+
+    for (long r = 0; r < rows; ++r)
+    {
+        const long y0 = r * height / rows;
+        const long y1 = std::max(y0 + 1, (r + 1) * height / rows);
+
+        for (long c = 0; c < columns; ++c)
+        {
+            const long x0 = c * width / columns;
+            const long x1 = std::max(x0 + 1, (c + 1) * width / columns);
+
+            double sum = 0;
+
+            for (long y = y0; y < y1; ++y)
+            {
+                const PixelType* p = data + (y * width + x0) * channels;
+
+                for (long x = x0; x < x1; ++x, p += channels)
+                {
+                    PixelType brightness = p[0];
+
+                    for (std::size_t i = 1; i < colors; ++i)
+                        brightness = std::max(brightness, p[i]);
+
+                    sum += double(brightness);
+                }
+            }
+
+            const double value = scale * sum / double((y1 - y0) * (x1 - x0)) + 0.5;
+            out(r, c) = static_cast<unsigned char>(std::min(255.0, std::max(0.0, value)));
+        }
+    }
+}
+
+
 /// \brief A helper function to convert an ofPixels object to grayscale.
 ///
 /// When loading images into dlib array2d, matrix, etc with non 8-bit values,
@@ -263,6 +348,9 @@ enum ImageMapType
     IMAGE_MAP_SAMPLE
 };
     
+/// \brief Copy each channel of the first sample of a tagged layer's output.
+///
+/// Use TensorPixels to view the channels without copying.
 template <template<typename> class TAG_TYPE, std::size_t NR, std::size_t NC, typename NET>
 inline std::vector<dlib::matrix<float, NR, NC>> layerOutputsToMatrices(const NET& net)
 {
@@ -275,19 +363,24 @@ inline std::vector<dlib::matrix<float, NR, NC>> layerOutputsToMatrices(const NET
     auto output_nr = lo.nr();
     auto output_nc = lo.nc();
     auto output_k = lo.k();
-    auto output_ns = lo.num_samples();
     
-    for (std::size_t k = 0; k < output_k; ++k)
+    for (long k = 0; k < output_k; ++k)
     {
-        std::size_t offset = output_ns * k * output_nr * output_nc;
+        std::size_t offset = k * output_nr * output_nc;
         dlib::alias_tensor a(1, 1, output_nr, output_nc);
         dlib::matrix<float, NR, NC> m = dlib::mat(a(lo, offset));
         matrices.push_back(m);
     }
+
+    return matrices;
 }
 
     
     
+/// \brief Copy each channel of a tagged layer's output to a texture.
+///
+/// This runs synchronously on the calling thread. Use ActivationTap to build
+/// layer visualizations without blocking inference.
 template <template<typename> class TAG_TYPE, std::size_t NR, std::size_t NC, typename NET>
 inline std::vector<ofTexture> layerOutputsToTextures(const NET& net)
 {
@@ -302,7 +395,7 @@ inline std::vector<ofTexture> layerOutputsToTextures(const NET& net)
     auto& layer_parameters = layer_details.get_layer_params();
     
     auto output_nr = layer_output.nr();
-    auto output_nc = layer_output.nr();
+    auto output_nc = layer_output.nc();
     auto output_k = layer_output.k();
     auto output_ns = layer_output.num_samples();
     
@@ -313,8 +406,6 @@ inline std::vector<ofTexture> layerOutputsToTextures(const NET& net)
         dlib::matrix<float, NR, NC> m = dlib::mat(a(layer_output, offset));
         
         auto mm = std::minmax_element(m.begin(), m.end());
-        std::cout << "---- " << *mm.first << "," << *mm.second << std::endl;
-        std::cout << std::endl;
         ofFloatPixels p = toOf(m);
         
         map(p, *mm.first, *mm.second);
@@ -0,0 +1,613 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Data/PackedDataset.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include "dlib/data_io/image_dataset_metadata.h"
+#include "dlib/dir_nav.h"
+#include "dlib/image_io.h"
+#include "dlib/misc_api.h"
+#include "ofFileUtils.h"
+#include "ofLog.h"
+#if defined(TARGET_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace ofx {
+namespace Dlib {
+
+
+static_assert(sizeof(PackedDataset::Header) == 64, "PackedDataset::Header must be 64 bytes.");
+static_assert(sizeof(PackedDataset::Record) == 32, "PackedDataset::Record must be 32 bytes.");
+static_assert(sizeof(PackedDataset::Box) == 24, "PackedDataset::Box must be 24 bytes.");
+
+
+const char PackedDataset::MAGIC[8] = { 'O', 'F', 'X', 'D', 'L', 'I', 'B', 'P' };
+const uint32_t PackedDataset::VERSION = 1;
+const uint64_t PackedDataset::ALIGNMENT = 64;
+
+
+namespace {
+
+
+uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+
+/// \brief Reads the big-endian 32 bit integers of an MNIST IDX file.
+bool readBigEndian(std::ifstream& stream, uint32_t& value)
+{
+    unsigned char bytes[4];
+
+    if (!stream.read(reinterpret_cast<char*>(bytes), 4))
+        return false;
+
+    value = (uint32_t(bytes[0]) << 24)
+          | (uint32_t(bytes[1]) << 16)
+          | (uint32_t(bytes[2]) << 8)
+          | uint32_t(bytes[3]);
+
+    return true;
+}
+
+
+bool convertMnistFiles(const std::string& imagesPath,
+                       const std::string& labelsPath,
+                       const std::string& outputPath)
+{
+    std::ifstream images(imagesPath, std::ios::binary);
+    std::ifstream labels(labelsPath, std::ios::binary);
+
+    if (!images || !labels)
+    {
+        ofLogError("PackedDataset::convertMnist") << "Unable to open " << imagesPath << " or " << labelsPath;
+        return false;
+    }
+
+    uint32_t imagesMagic = 0;
+    uint32_t numImages = 0;
+    uint32_t nr = 0;
+    uint32_t nc = 0;
+    uint32_t labelsMagic = 0;
+    uint32_t numLabels = 0;
+
+    if (!readBigEndian(images, imagesMagic)
+    ||  !readBigEndian(images, numImages)
+    ||  !readBigEndian(images, nr)
+    ||  !readBigEndian(images, nc)
+    ||  !readBigEndian(labels, labelsMagic)
+    ||  !readBigEndian(labels, numLabels)
+    ||  imagesMagic != 2051
+    ||  labelsMagic != 2049
+    ||  numImages != numLabels)
+    {
+        ofLogError("PackedDataset::convertMnist") << "Invalid IDX header in " << imagesPath << " or " << labelsPath;
+        return false;
+    }
+
+    PackedDatasetWriter writer(outputPath, 1);
+
+    if (!writer.isOpen())
+        return false;
+
+    std::vector<unsigned char> pixels(nr * nc);
+
+    for (uint32_t i = 0; i < numImages; ++i)
+    {
+        char label = 0;
+
+        if (!images.read(reinterpret_cast<char*>(pixels.data()), std::streamsize(pixels.size()))
+        ||  !labels.read(&label, 1))
+        {
+            ofLogError("PackedDataset::convertMnist") << "Unexpected end of file at record " << i << ".";
+            writer.abort();
+            return false;
+        }
+
+        writer.add(pixels.data(), nr, nc, static_cast<unsigned char>(label));
+    }
+
+    return writer.close();
+}
+
+
+} // namespace
+
+
+PackedDataset::PackedDataset()
+{
+}
+
+
+PackedDataset::PackedDataset(const std::string& path)
+{
+    if (!open(path))
+        throw std::runtime_error("PackedDataset: Unable to open " + path);
+}
+
+
+PackedDataset::~PackedDataset()
+{
+    close();
+}
+
+
+bool PackedDataset::open(const std::string& path)
+{
+    close();
+
+    const std::string fullPath = ofToDataPath(path, true);
+
+#if defined(TARGET_WIN32)
+    HANDLE file = CreateFileA(fullPath.c_str(),
+                              GENERIC_READ,
+                              FILE_SHARE_READ,
+                              nullptr,
+                              OPEN_EXISTING,
+                              FILE_FLAG_RANDOM_ACCESS,
+                              nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        ofLogError("PackedDataset::open") << "Unable to open " << fullPath;
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < LONGLONG(sizeof(Header)))
+    {
+        ofLogError("PackedDataset::open") << "Invalid file size: " << fullPath;
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (mapping == nullptr)
+    {
+        ofLogError("PackedDataset::open") << "Unable to map " << fullPath;
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (data == nullptr)
+    {
+        ofLogError("PackedDataset::open") << "Unable to map " << fullPath;
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    _file = file;
+    _mapping = mapping;
+    _size = uint64_t(fileSize.QuadPart);
+#else
+    int file = ::open(fullPath.c_str(), O_RDONLY);
+
+    if (file < 0)
+    {
+        ofLogError("PackedDataset::open") << "Unable to open " << fullPath;
+        return false;
+    }
+
+    struct stat status;
+
+    if (fstat(file, &status) != 0 || uint64_t(status.st_size) < sizeof(Header))
+    {
+        ofLogError("PackedDataset::open") << "Invalid file size: " << fullPath;
+        ::close(file);
+        return false;
+    }
+
+    void* data = mmap(nullptr, std::size_t(status.st_size), PROT_READ, MAP_SHARED, file, 0);
+
+    // The mapping keeps its own reference to the file.
+    ::close(file);
+
+    if (data == MAP_FAILED)
+    {
+        ofLogError("PackedDataset::open") << "Unable to map " << fullPath;
+        return false;
+    }
+
+    // Training reads records in random order, so don't read ahead.
+    madvise(data, std::size_t(status.st_size), MADV_RANDOM);
+
+    _size = uint64_t(status.st_size);
+#endif
+
+    _data = static_cast<const unsigned char*>(data);
+    _header = reinterpret_cast<const Header*>(_data);
+
+    const Header& header = *_header;
+
+    bool valid = std::equal(MAGIC, MAGIC + 8, header.magic)
+              && header.version == VERSION
+              && (header.channels == 1 || header.channels == 3)
+              && header.indexOffset % 8 == 0
+              && header.indexOffset <= _size
+              && header.numRecords <= (_size - header.indexOffset) / sizeof(Record)
+              && header.boxesOffset % 8 == 0
+              && header.boxesOffset <= _size
+              && header.numBoxes <= (_size - header.boxesOffset) / sizeof(Box)
+              && header.labelsOffset <= _size
+              && header.labelsSize <= _size - header.labelsOffset;
+
+    if (valid)
+    {
+        _records = reinterpret_cast<const Record*>(_data + header.indexOffset);
+        _boxes = reinterpret_cast<const Box*>(_data + header.boxesOffset);
+
+        // This only touches the index pages, not the pixel data.
+        for (uint64_t i = 0; valid && i < header.numRecords; ++i)
+        {
+            const Record& record = _records[i];
+            uint64_t recordSize = uint64_t(record.nr) * record.nc * header.channels;
+
+            valid = record.offset <= _size
+                 && recordSize <= _size - record.offset
+                 && record.firstBox <= header.numBoxes
+                 && record.numBoxes <= header.numBoxes - record.firstBox;
+        }
+
+        const unsigned char* labels = _data + header.labelsOffset;
+        const unsigned char* labelsEnd = labels + header.labelsSize;
+
+        while (valid && labels < labelsEnd)
+        {
+            uint32_t length = 0;
+
+            if (labelsEnd - labels < 4)
+            {
+                valid = false;
+                break;
+            }
+
+            std::memcpy(&length, labels, 4);
+            labels += 4;
+
+            if (uint64_t(labelsEnd - labels) < length)
+            {
+                valid = false;
+                break;
+            }
+
+            _boxLabels.emplace_back(reinterpret_cast<const char*>(labels), length);
+            labels += length;
+        }
+
+        for (uint64_t i = 0; valid && i < header.numBoxes; ++i)
+            valid = _boxes[i].label < _boxLabels.size();
+    }
+
+    if (!valid)
+    {
+        ofLogError("PackedDataset::open") << "Invalid dataset file: " << fullPath;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+void PackedDataset::close()
+{
+    if (_data != nullptr)
+    {
+#if defined(TARGET_WIN32)
+        UnmapViewOfFile(_data);
+        CloseHandle(_mapping);
+        CloseHandle(_file);
+        _mapping = nullptr;
+        _file = nullptr;
+#else
+        munmap(const_cast<unsigned char*>(_data), std::size_t(_size));
+#endif
+    }
+
+    _data = nullptr;
+    _size = 0;
+    _header = nullptr;
+    _records = nullptr;
+    _boxes = nullptr;
+    _boxLabels.clear();
+}
+
+
+ofPixels PackedDataset::pixels(std::size_t i) const
+{
+    ofPixels result;
+
+    // The view is read-only, ofPixels just lacks a const external mode.
+    result.setFromExternalPixels(const_cast<unsigned char*>(data(i)),
+                                 std::size_t(nc(i)),
+                                 std::size_t(nr(i)),
+                                 channels() == 1 ? OF_PIXELS_GRAY : OF_PIXELS_RGB);
+
+    return result;
+}
+
+
+std::vector<dlib::mmod_rect> PackedDataset::boxes(std::size_t i) const
+{
+    const Record& record = _records[i];
+
+    std::vector<dlib::mmod_rect> results;
+    results.reserve(record.numBoxes);
+
+    for (uint64_t b = record.firstBox; b < record.firstBox + record.numBoxes; ++b)
+    {
+        const Box& box = _boxes[b];
+
+        dlib::mmod_rect rect(dlib::rectangle(box.left, box.top, box.right, box.bottom));
+        rect.ignore = box.ignore != 0;
+        rect.label = _boxLabels[box.label];
+
+        results.push_back(rect);
+    }
+
+    return results;
+}
+
+
+bool PackedDataset::convertMnist(const std::string& folder,
+                                 const std::string& trainingPath,
+                                 const std::string& testingPath)
+{
+    const std::string fullFolder = ofToDataPath(folder, true);
+
+    return convertMnistFiles(ofFilePath::join(fullFolder, "train-images-idx3-ubyte"),
+                             ofFilePath::join(fullFolder, "train-labels-idx1-ubyte"),
+                             trainingPath)
+        && convertMnistFiles(ofFilePath::join(fullFolder, "t10k-images-idx3-ubyte"),
+                             ofFilePath::join(fullFolder, "t10k-labels-idx1-ubyte"),
+                             testingPath);
+}
+
+
+bool PackedDataset::convertImageDataset(const std::string& xmlPath,
+                                        const std::string& outputPath)
+{
+    const std::string fullXmlPath = ofToDataPath(xmlPath, true);
+
+    dlib::image_dataset_metadata::dataset metadata;
+
+    try
+    {
+        dlib::image_dataset_metadata::load_image_dataset_metadata(metadata, fullXmlPath);
+    }
+    catch (const std::exception& exc)
+    {
+        ofLogError("PackedDataset::convertImageDataset") << exc.what();
+        return false;
+    }
+
+    PackedDatasetWriter writer(outputPath, 3);
+
+    if (!writer.isOpen())
+        return false;
+
+    // Image file names are relative to the XML file.
+    dlib::locally_change_current_dir chdir(dlib::get_parent_directory(dlib::file(fullXmlPath)));
+
+    dlib::matrix<dlib::rgb_pixel> image;
+    std::vector<dlib::mmod_rect> boxes;
+
+    for (auto& entry: metadata.images)
+    {
+        try
+        {
+            dlib::load_image(image, entry.filename);
+        }
+        catch (const std::exception& exc)
+        {
+            ofLogError("PackedDataset::convertImageDataset") << "Unable to load " << entry.filename << ": " << exc.what();
+            writer.abort();
+            return false;
+        }
+
+        boxes.clear();
+
+        for (auto& box: entry.boxes)
+        {
+            dlib::mmod_rect rect(box.rect);
+            rect.ignore = box.ignore;
+            rect.label = box.label;
+            boxes.push_back(rect);
+        }
+
+        writer.add(image, 0, boxes);
+    }
+
+    return writer.close();
+}
+
+
+PackedDatasetWriter::PackedDatasetWriter(const std::string& path,
+                                         std::size_t channels)
+{
+    if (channels != 1 && channels != 3)
+        throw std::invalid_argument("PackedDatasetWriter: channels must be 1 or 3.");
+
+    std::memset(&_header, 0, sizeof(_header));
+    std::copy(PackedDataset::MAGIC, PackedDataset::MAGIC + 8, _header.magic);
+    _header.version = PackedDataset::VERSION;
+    _header.channels = uint32_t(channels);
+
+    _path = ofToDataPath(path, true);
+
+    _stream.open(_path, std::ios::binary | std::ios::trunc);
+
+    if (!_stream)
+    {
+        ofLogError("PackedDatasetWriter") << "Unable to create " << _path;
+        return;
+    }
+
+    // The header is rewritten by close().
+    _stream.write(reinterpret_cast<const char*>(&_header), sizeof(_header));
+    _offset = sizeof(_header);
+}
+
+
+PackedDatasetWriter::~PackedDatasetWriter()
+{
+    if (!_stream.is_open())
+        return;
+
+    if (_failed)
+        _remove();
+    else
+        close();
+}
+
+
+bool PackedDatasetWriter::isOpen() const
+{
+    return _stream.is_open() && _stream.good();
+}
+
+
+void PackedDatasetWriter::add(const unsigned char* pixels,
+                              long nr,
+                              long nc,
+                              unsigned long label,
+                              const std::vector<dlib::mmod_rect>& boxes)
+{
+    if (nr < 0 || nc < 0)
+        throw std::invalid_argument("PackedDatasetWriter: invalid image size.");
+
+    static const char padding[64] = { 0 };
+
+    uint64_t offset = alignUp(_offset, PackedDataset::ALIGNMENT);
+    _stream.write(padding, std::streamsize(offset - _offset));
+
+    uint64_t size = uint64_t(nr) * uint64_t(nc) * _header.channels;
+    _stream.write(reinterpret_cast<const char*>(pixels), std::streamsize(size));
+    _offset = offset + size;
+
+    if (!_stream.good())
+        _failed = true;
+
+    PackedDataset::Record record;
+    record.offset = offset;
+    record.nr = uint32_t(nr);
+    record.nc = uint32_t(nc);
+    record.label = uint32_t(label);
+    record.numBoxes = uint32_t(boxes.size());
+    record.firstBox = _boxes.size();
+    _records.push_back(record);
+
+    for (auto& rect: boxes)
+    {
+        auto iter = std::find(_boxLabels.begin(), _boxLabels.end(), rect.label);
+
+        if (iter == _boxLabels.end())
+            iter = _boxLabels.insert(iter, rect.label);
+
+        PackedDataset::Box box;
+        box.left = int32_t(rect.rect.left());
+        box.top = int32_t(rect.rect.top());
+        box.right = int32_t(rect.rect.right());
+        box.bottom = int32_t(rect.rect.bottom());
+        box.ignore = rect.ignore ? 1 : 0;
+        box.label = uint32_t(iter - _boxLabels.begin());
+        _boxes.push_back(box);
+    }
+}
+
+
+bool PackedDatasetWriter::close()
+{
+    if (!_stream.is_open())
+        return false;
+
+    if (_failed)
+    {
+        ofLogError("PackedDatasetWriter::close") << "A record couldn't be written, removing " << _path;
+        _remove();
+        return false;
+    }
+
+    static const char padding[8] = { 0 };
+
+    uint64_t indexOffset = alignUp(_offset, 8);
+    _stream.write(padding, std::streamsize(indexOffset - _offset));
+    _stream.write(reinterpret_cast<const char*>(_records.data()),
+                  std::streamsize(_records.size() * sizeof(PackedDataset::Record)));
+
+    uint64_t boxesOffset = indexOffset + _records.size() * sizeof(PackedDataset::Record);
+    _stream.write(reinterpret_cast<const char*>(_boxes.data()),
+                  std::streamsize(_boxes.size() * sizeof(PackedDataset::Box)));
+
+    uint64_t labelsOffset = boxesOffset + _boxes.size() * sizeof(PackedDataset::Box);
+    uint64_t labelsSize = 0;
+
+    for (auto& label: _boxLabels)
+    {
+        uint32_t length = uint32_t(label.size());
+        _stream.write(reinterpret_cast<const char*>(&length), 4);
+        _stream.write(label.data(), std::streamsize(length));
+        labelsSize += 4 + length;
+    }
+
+    _header.numRecords = _records.size();
+    _header.indexOffset = indexOffset;
+    _header.numBoxes = _boxes.size();
+    _header.boxesOffset = boxesOffset;
+    _header.labelsOffset = labelsOffset;
+    _header.labelsSize = labelsSize;
+
+    _stream.seekp(0);
+    _stream.write(reinterpret_cast<const char*>(&_header), sizeof(_header));
+
+    bool result = _stream.good();
+
+    _stream.close();
+
+    if (!result || _stream.fail())
+    {
+        ofLogError("PackedDatasetWriter::close") << "Unable to write the dataset, removing " << _path;
+        std::remove(_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+void PackedDatasetWriter::abort()
+{
+    _failed = true;
+
+    if (_stream.is_open())
+        _remove();
+}
+
+
+void PackedDatasetWriter::_remove()
+{
+    _stream.close();
+    std::remove(_path.c_str());
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,271 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Data/StreamingImageDataset.h"
+#include <chrono>
+#include "dlib/data_io/image_dataset_metadata.h"
+#include "dlib/image_io.h"
+#include "ofFileUtils.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+StreamingImageDataset::StreamingImageDataset(const std::string& xmlPath):
+    StreamingImageDataset(xmlPath, Settings())
+{
+}
+
+
+StreamingImageDataset::StreamingImageDataset(const std::string& xmlPath,
+                                             const Settings& settings):
+    _settings(settings)
+{
+    const std::string fullXmlPath = ofToDataPath(xmlPath, true);
+
+    dlib::image_dataset_metadata::dataset metadata;
+    dlib::image_dataset_metadata::load_image_dataset_metadata(metadata, fullXmlPath);
+
+    // The decode threads can't change the working directory, so image paths
+    // relative to the XML file are resolved here.
+    const std::string directory = ofFilePath::getEnclosingDirectory(fullXmlPath, false);
+
+    _filenames.reserve(metadata.images.size());
+    _boxes.reserve(metadata.images.size());
+
+    for (auto& image: metadata.images)
+    {
+        if (ofFilePath::isAbsolute(image.filename))
+            _filenames.push_back(image.filename);
+        else
+            _filenames.push_back(ofFilePath::join(directory, image.filename));
+
+        std::vector<dlib::mmod_rect> rects;
+
+        for (auto& box: image.boxes)
+        {
+            dlib::mmod_rect rect(box.rect);
+            rect.ignore = box.ignore;
+            rect.label = box.label;
+            rects.push_back(rect);
+        }
+
+        _boxes.push_back(rects);
+    }
+
+    _settings.numThreads = std::max(std::size_t(1), _settings.numThreads);
+
+    for (std::size_t i = 0; i < _settings.numThreads; ++i)
+        _threads.emplace_back(&StreamingImageDataset::_run, this);
+}
+
+
+StreamingImageDataset::~StreamingImageDataset()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+    }
+
+    _condition.notify_all();
+
+    for (auto& thread: _threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+
+StreamingImageDataset::ImagePtr StreamingImageDataset::get(std::size_t i)
+{
+    std::shared_future<ImagePtr> future;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        auto iter = _cache.find(i);
+
+        if (iter != _cache.end())
+        {
+            _lru.splice(_lru.begin(), _lru, iter->second.position);
+            ++_stats.hits;
+            return iter->second.image;
+        }
+
+        auto pending = _pending.find(i);
+
+        if (pending != _pending.end())
+        {
+            // Move a prefetched image that hasn't started yet to the front.
+            auto queued = std::find(_queue.begin(), _queue.end(), i);
+
+            if (queued != _queue.end())
+            {
+                _queue.erase(queued);
+                _queue.push_front(i);
+            }
+
+            future = pending->second.future;
+        }
+        else
+        {
+            future = _enqueue(i, true);
+        }
+    }
+
+    _condition.notify_one();
+
+    return future.get();
+}
+
+
+StreamingImageDataset::image_type StreamingImageDataset::operator [] (std::size_t i)
+{
+    return *get(i);
+}
+
+
+void StreamingImageDataset::prefetch(const std::vector<std::size_t>& indices)
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        for (auto i: indices)
+        {
+            if (_cache.find(i) == _cache.end() && _pending.find(i) == _pending.end())
+                _enqueue(i, false);
+        }
+    }
+
+    _condition.notify_all();
+}
+
+
+StreamingImageDatasetStats StreamingImageDataset::stats() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+
+void StreamingImageDataset::resetStats()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _stats.hits = 0;
+    _stats.misses = 0;
+    _stats.evictions = 0;
+    _stats.decodeMs = 0;
+}
+
+
+std::shared_future<StreamingImageDataset::ImagePtr> StreamingImageDataset::_enqueue(std::size_t i,
+                                                                                   bool first)
+{
+    Pending& pending = _pending[i];
+    pending.future = pending.promise.get_future().share();
+
+    if (first)
+        _queue.push_front(i);
+    else
+        _queue.push_back(i);
+
+    ++_stats.misses;
+
+    return pending.future;
+}
+
+
+void StreamingImageDataset::_evict()
+{
+    // Always keep the most recent image, even if it is larger than the cache.
+    while (_stats.cachedBytes > _settings.cacheBytes && _lru.size() > 1)
+    {
+        auto iter = _cache.find(_lru.back());
+        _stats.cachedBytes -= iter->second.bytes;
+        _cache.erase(iter);
+        _lru.pop_back();
+        ++_stats.evictions;
+    }
+
+    _stats.numCached = _cache.size();
+}
+
+
+void StreamingImageDataset::_run()
+{
+    while (true)
+    {
+        std::size_t index = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _condition.wait(lock, [&]() {
+                return !_queue.empty() || !_running;
+            });
+
+            if (!_running)
+                return;
+
+            index = _queue.front();
+            _queue.pop_front();
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        ImagePtr image;
+        std::exception_ptr exception;
+
+        try
+        {
+            auto decoded = std::make_shared<image_type>();
+            dlib::load_image(*decoded, _filenames[index]);
+            image = decoded;
+        }
+        catch (...)
+        {
+            exception = std::current_exception();
+        }
+
+        double decodeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+        std::promise<ImagePtr> promise;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            auto pending = _pending.find(index);
+            promise = std::move(pending->second.promise);
+            _pending.erase(pending);
+
+            _stats.decodeMs += decodeMs;
+
+            if (image)
+            {
+                _lru.push_front(index);
+
+                Entry& entry = _cache[index];
+                entry.image = image;
+                entry.bytes = uint64_t(image->size()) * sizeof(dlib::rgb_pixel);
+                entry.position = _lru.begin();
+
+                _stats.cachedBytes += entry.bytes;
+                _evict();
+            }
+        }
+
+        if (image)
+            promise.set_value(image);
+        else
+            promise.set_exception(exception);
+    }
+}
+
+
+} } // namespace ofx::Dlib
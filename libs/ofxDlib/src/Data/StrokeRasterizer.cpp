@@ -0,0 +1,213 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Data/StrokeRasterizer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace ofx {
+namespace Dlib {
+
+
+StrokeRasterizer::StrokeRasterizer(): StrokeRasterizer(Settings())
+{
+}
+
+
+StrokeRasterizer::StrokeRasterizer(const Settings& settings):
+    _settings(settings)
+{
+    _settings.size = std::max(1L, _settings.size);
+    _settings.supersampling = std::max(1L, _settings.supersampling);
+    _settings.width = std::max(1.0f, _settings.width);
+    _settings.height = std::max(1.0f, _settings.height);
+
+    _bufferSize = _settings.size * _settings.supersampling;
+    _scale = glm::vec2(_bufferSize / _settings.width, _bufferSize / _settings.height);
+    _buffer.resize(_bufferSize * _bufferSize);
+    _sums.resize((_bufferSize + 1) * (_bufferSize + 1));
+    _input.set_size(_settings.size, _settings.size);
+
+    clear();
+}
+
+
+void StrokeRasterizer::clear()
+{
+    std::fill(_buffer.begin(), _buffer.end(), 0.0f);
+    _inkMin = glm::ivec2(std::numeric_limits<int>::max());
+    _inkMax = glm::ivec2(std::numeric_limits<int>::min());
+    _last = glm::vec2(0, 0);
+    _dirty = true;
+}
+
+
+void StrokeRasterizer::moveTo(const glm::vec2& position)
+{
+    _last = position * _scale;
+    _drawSegment(_last, _last);
+}
+
+
+void StrokeRasterizer::lineTo(const glm::vec2& position)
+{
+    glm::vec2 next = position * _scale;
+    _drawSegment(_last, next);
+    _last = next;
+}
+
+
+void StrokeRasterizer::setRadius(float radius)
+{
+    _settings.radius = radius;
+}
+
+
+const dlib::matrix<unsigned char>& StrokeRasterizer::input()
+{
+    if (_dirty)
+    {
+        _resample();
+        _dirty = false;
+    }
+
+    return _input;
+}
+
+
+void StrokeRasterizer::_drawSegment(const glm::vec2& a, const glm::vec2& b)
+{
+    const float radius = _settings.radius * 0.5f * (_scale.x + _scale.y);
+
+    const long x0 = std::max(0L, long(std::floor(std::min(a.x, b.x) - radius - 1)));
+    const long y0 = std::max(0L, long(std::floor(std::min(a.y, b.y) - radius - 1)));
+    const long x1 = std::min(_bufferSize - 1, long(std::ceil(std::max(a.x, b.x) + radius + 1)));
+    const long y1 = std::min(_bufferSize - 1, long(std::ceil(std::max(a.y, b.y) + radius + 1)));
+
+    const glm::vec2 ab = b - a;
+    const float length2 = glm::dot(ab, ab);
+
+    for (long y = y0; y <= y1; ++y)
+    {
+        float* row = &_buffer[y * _bufferSize];
+
+        for (long x = x0; x <= x1; ++x)
+        {
+            // The distance from the pixel center to the segment gives the
+            // coverage of a one pixel wide edge.
+            const glm::vec2 p(x + 0.5f, y + 0.5f);
+            const float t = length2 > 0 ? glm::clamp(glm::dot(p - a, ab) / length2, 0.0f, 1.0f) : 0.0f;
+            const float coverage = glm::clamp(radius + 0.5f - glm::length(p - (a + t * ab)), 0.0f, 1.0f);
+
+            if (coverage > row[x])
+            {
+                row[x] = coverage;
+                _inkMin = glm::min(_inkMin, glm::ivec2(x, y));
+                _inkMax = glm::max(_inkMax, glm::ivec2(x, y));
+            }
+        }
+    }
+
+    _dirty = true;
+}
+
+
+void StrokeRasterizer::_resample()
+{
+    if (empty())
+    {
+        _input = 0;
+        return;
+    }
+
+    const long n = _bufferSize;
+    const long stride = n + 1;
+
+    double mass = 0;
+    double massX = 0;
+    double massY = 0;
+
+    for (long y = 0; y < n; ++y)
+    {
+        double rowSum = 0;
+
+        for (long x = 0; x < n; ++x)
+        {
+            const double v = _buffer[y * n + x];
+            rowSum += v;
+            mass += v;
+            massX += v * (x + 0.5);
+            massY += v * (y + 0.5);
+            _sums[(y + 1) * stride + x + 1] = _sums[y * stride + x + 1] + rowSum;
+        }
+    }
+
+    // Buffer pixels per input pixel and the buffer point at the input center.
+    double step = double(_settings.supersampling);
+    double centerX = 0.5 * n;
+    double centerY = 0.5 * n;
+
+    if (_settings.normalize && mass > 0)
+    {
+        const long extent = std::max(_inkMax.x - _inkMin.x, _inkMax.y - _inkMin.y) + 1;
+        step = double(extent) / _settings.boxSize;
+        centerX = massX / mass;
+        centerY = massY / mass;
+    }
+
+    const double half = 0.5 * step;
+    const double area = step * step;
+    const double inputCenter = 0.5 * _settings.size;
+
+    for (long r = 0; r < _settings.size; ++r)
+    {
+        const double y = (r + 0.5 - inputCenter) * step + centerY;
+
+        for (long c = 0; c < _settings.size; ++c)
+        {
+            const double x = (c + 0.5 - inputCenter) * step + centerX;
+
+            const double sum = _integral(x + half, y + half)
+                             - _integral(x - half, y + half)
+                             - _integral(x + half, y - half)
+                             + _integral(x - half, y - half);
+
+            const double value = 255.0 * sum / area + 0.5;
+            _input(r, c) = static_cast<unsigned char>(std::min(255.0, std::max(0.0, value)));
+        }
+    }
+}
+
+
+double StrokeRasterizer::_integral(double x, double y) const
+{
+    const long n = _bufferSize;
+    const long stride = n + 1;
+
+    // The ink outside of the buffer is zero, so the table is clamped.
+    x = std::min(double(n), std::max(0.0, x));
+    y = std::min(double(n), std::max(0.0, y));
+
+    const long x0 = std::min(n - 1, long(x));
+    const long y0 = std::min(n - 1, long(y));
+    const double fx = x - x0;
+    const double fy = y - y0;
+
+    // The integral of a piecewise constant image is exactly bilinear inside
+    // each pixel.
+    const double* s = &_sums[y0 * stride + x0];
+
+    return s[0] * (1 - fx) * (1 - fy)
+         + s[1] * fx * (1 - fy)
+         + s[stride] * (1 - fx) * fy
+         + s[stride + 1] * fx * fy;
+}
+
+
+} } // namespace ofx::Dlib
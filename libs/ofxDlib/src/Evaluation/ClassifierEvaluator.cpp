@@ -0,0 +1,159 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Evaluation/ClassifierEvaluator.h"
+#include <iomanip>
+#include <sstream>
+
+
+namespace ofx {
+namespace Dlib {
+
+
+void ClassificationReport::reset(std::size_t classes, std::size_t topK)
+{
+    numClasses = classes;
+    confusion.assign(numClasses * numClasses, 0);
+    topKRight.assign(topK, 0);
+    numSamples = 0;
+}
+
+
+void ClassificationReport::add(std::size_t truth,
+                               std::size_t predicted,
+                               std::size_t rank)
+{
+    ++confusion[truth * numClasses + predicted];
+
+    for (std::size_t k = rank; k < topKRight.size(); ++k)
+        ++topKRight[k];
+
+    ++numSamples;
+}
+
+
+void ClassificationReport::merge(const ClassificationReport& other)
+{
+    for (std::size_t i = 0; i < confusion.size() && i < other.confusion.size(); ++i)
+        confusion[i] += other.confusion[i];
+
+    for (std::size_t i = 0; i < topKRight.size() && i < other.topKRight.size(); ++i)
+        topKRight[i] += other.topKRight[i];
+
+    numSamples += other.numSamples;
+    loadMs += other.loadMs;
+    inferenceMs += other.inferenceMs;
+}
+
+
+uint64_t ClassificationReport::numRight() const
+{
+    uint64_t right = 0;
+
+    for (std::size_t c = 0; c < numClasses; ++c)
+        right += count(c, c);
+
+    return right;
+}
+
+
+double ClassificationReport::accuracy() const
+{
+    return numSamples > 0 ? double(numRight()) / double(numSamples) : 0;
+}
+
+
+double ClassificationReport::topKAccuracy(std::size_t k) const
+{
+    if (k == 0 || k > topKRight.size() || numSamples == 0)
+        return 0;
+
+    return double(topKRight[k - 1]) / double(numSamples);
+}
+
+
+double ClassificationReport::precision(std::size_t c) const
+{
+    uint64_t predicted = 0;
+
+    for (std::size_t truth = 0; truth < numClasses; ++truth)
+        predicted += count(truth, c);
+
+    return predicted > 0 ? double(count(c, c)) / double(predicted) : 0;
+}
+
+
+double ClassificationReport::recall(std::size_t c) const
+{
+    uint64_t actual = 0;
+
+    for (std::size_t predicted = 0; predicted < numClasses; ++predicted)
+        actual += count(c, predicted);
+
+    return actual > 0 ? double(count(c, c)) / double(actual) : 0;
+}
+
+
+std::string ClassificationReport::toString() const
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(4);
+    ss << "accuracy: " << accuracy() << " (" << numRight() << " right, " << numWrong() << " wrong)";
+
+    if (topKRight.size() > 1)
+        ss << ", top-" << topKRight.size() << ": " << topKAccuracy(topKRight.size());
+
+    ss << std::endl;
+
+    ss << std::setprecision(1);
+    ss << numSamples << " samples in " << elapsedMs << " ms";
+    ss << " (" << samplesPerSecond() << " samples/s, " << numReplicas << " replicas";
+    ss << ", load " << loadMs << " ms, inference " << inferenceMs << " ms)" << std::endl;
+
+    ss << std::setprecision(4);
+    ss << std::setw(8) << "class" << std::setw(12) << "precision" << std::setw(12) << "recall" << std::setw(12) << "samples" << std::endl;
+
+    for (std::size_t c = 0; c < numClasses; ++c)
+    {
+        uint64_t actual = 0;
+
+        for (std::size_t predicted = 0; predicted < numClasses; ++predicted)
+            actual += count(c, predicted);
+
+        ss << std::setw(8) << c << std::setw(12) << precision(c) << std::setw(12) << recall(c) << std::setw(12) << actual << std::endl;
+    }
+
+    return ss.str();
+}
+
+
+std::string ClassificationReport::confusionToString() const
+{
+    std::ostringstream ss;
+    ss << "rows: true class, columns: predicted class" << std::endl;
+    ss << std::setw(8) << "";
+
+    for (std::size_t c = 0; c < numClasses; ++c)
+        ss << std::setw(8) << c;
+
+    ss << std::endl;
+
+    for (std::size_t truth = 0; truth < numClasses; ++truth)
+    {
+        ss << std::setw(8) << truth;
+
+        for (std::size_t predicted = 0; predicted < numClasses; ++predicted)
+            ss << std::setw(8) << count(truth, predicted);
+
+        ss << std::endl;
+    }
+
+    return ss.str();
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,126 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Evaluation/DetectionEvaluator.h"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+
+namespace ofx {
+namespace Dlib {
+
+
+void DetectionReport::merge(const DetectionReport& other)
+{
+    numImages += other.numImages;
+    numTruth += other.numTruth;
+    numHits += other.numHits;
+    numMissing += other.numMissing;
+    detections.insert(detections.end(), other.detections.begin(), other.detections.end());
+    latenciesMs.insert(latenciesMs.end(), other.latenciesMs.begin(), other.latenciesMs.end());
+    loadMs += other.loadMs;
+}
+
+
+void DetectionReport::finish()
+{
+    // The order of dlib::test_object_detection_function(), which makes the
+    // result independent of which replica found which detection.
+    std::sort(detections.rbegin(), detections.rend());
+    std::sort(latenciesMs.begin(), latenciesMs.end());
+}
+
+
+double DetectionReport::precision() const
+{
+    if (detections.empty())
+        return 1;
+
+    std::size_t hits = 0;
+
+    for (auto& detection: detections)
+    {
+        if (detection.second)
+            ++hits;
+    }
+
+    return double(hits) / double(detections.size());
+}
+
+
+double DetectionReport::recall() const
+{
+    return numTruth > 0 ? double(numHits) / double(numTruth) : 1;
+}
+
+
+double DetectionReport::averagePrecision() const
+{
+    return dlib::average_precision(detections, numMissing);
+}
+
+
+dlib::matrix<double, 1, 3> DetectionReport::toMatrix() const
+{
+    dlib::matrix<double, 1, 3> result;
+    result = precision(), recall(), averagePrecision();
+    return result;
+}
+
+
+double DetectionReport::meanLatencyMs() const
+{
+    if (latenciesMs.empty())
+        return 0;
+
+    double sum = 0;
+
+    for (auto ms: latenciesMs)
+        sum += ms;
+
+    return sum / double(latenciesMs.size());
+}
+
+
+double DetectionReport::latencyPercentileMs(double percentile) const
+{
+    if (latenciesMs.empty())
+        return 0;
+
+    percentile = std::min(100.0, std::max(0.0, percentile));
+
+    // Nearest rank: the smallest latency with at least p percent at or below it.
+    std::size_t rank = std::size_t(std::ceil(percentile / 100.0 * double(latenciesMs.size())));
+
+    return latenciesMs[std::min(latenciesMs.size(), std::max(std::size_t(1), rank)) - 1];
+}
+
+
+std::string DetectionReport::toString() const
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(4);
+    ss << "precision: " << precision();
+    ss << ", recall: " << recall();
+    ss << ", average precision: " << averagePrecision();
+    ss << " (" << numHits << "/" << numTruth << " boxes found, " << detections.size() << " detections)" << std::endl;
+
+    ss << std::setprecision(2);
+    ss << numImages << " images in " << elapsedMs << " ms";
+    ss << " (" << imagesPerSecond() << " images/s, " << numReplicas << " replicas, load " << loadMs << " ms)" << std::endl;
+    ss << "latency ms: mean " << meanLatencyMs();
+    ss << ", p50 " << latencyPercentileMs(50);
+    ss << ", p90 " << latencyPercentileMs(90);
+    ss << ", p99 " << latencyPercentileMs(99);
+    ss << ", max " << latencyPercentileMs(100);
+
+    return ss.str();
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,436 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Math/LinearAlgebraBenchmark.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <thread>
+#include "dlib/matrix.h"
+#include "ofFileUtils.h"
+#include "ofLog.h"
+#include "ofx/Dlib/Math/BlockedMultiply.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+namespace {
+
+
+typedef std::chrono::high_resolution_clock Clock;
+
+
+double elapsedMs(const Clock::time_point& start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+/// \brief One operation and backend.
+struct Case
+{
+    std::string operation;
+    std::string backend;
+
+    /// \brief The nominal operations are flopsPerCube * n^3.
+    double flopsPerCube;
+
+    /// \brief Run the operation once and return a value of its result.
+    std::function<double()> run;
+};
+
+
+const char* yesNo(bool value)
+{
+    return value ? "yes" : "no";
+}
+
+
+} // namespace
+
+
+const LinearAlgebraResult* LinearAlgebraReport::find(const std::string& operation,
+                                                     const std::string& backend,
+                                                     long size) const
+{
+    for (auto& result: results)
+    {
+        if (result.operation == operation && result.backend == backend && result.size == size)
+            return &result;
+    }
+
+    return nullptr;
+}
+
+
+std::string LinearAlgebraReport::toString() const
+{
+    std::ostringstream ss;
+    ss << configuration << std::endl;
+
+    std::vector<std::string> operations;
+
+    for (auto& result: results)
+    {
+        if (std::find(operations.begin(), operations.end(), result.operation) == operations.end())
+            operations.push_back(result.operation);
+    }
+
+    for (auto& operation: operations)
+    {
+        std::vector<std::string> backends;
+        std::vector<long> sizes;
+
+        for (auto& result: results)
+        {
+            if (result.operation != operation)
+                continue;
+
+            if (std::find(backends.begin(), backends.end(), result.backend) == backends.end())
+                backends.push_back(result.backend);
+
+            if (std::find(sizes.begin(), sizes.end(), result.size) == sizes.end())
+                sizes.push_back(result.size);
+        }
+
+        ss << std::endl << operation << " (GFLOP/s)" << std::endl;
+        ss << std::setw(8) << "n";
+
+        for (auto& backend: backends)
+            ss << std::setw(14) << backend;
+
+        ss << std::endl;
+
+        for (long size: sizes)
+        {
+            ss << std::setw(8) << size;
+
+            for (auto& backend: backends)
+            {
+                const LinearAlgebraResult* result = find(operation, backend, size);
+
+                if (result == nullptr || result->skipped)
+                    ss << std::setw(14) << "-";
+                else
+                    ss << std::setw(14) << std::fixed << std::setprecision(2) << result->gflops();
+            }
+
+            ss << std::endl;
+        }
+    }
+
+    ss << std::endl << notes();
+
+    return ss.str();
+}
+
+
+std::string LinearAlgebraReport::notes() const
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1);
+
+    const std::string multiplyBackend = LinearAlgebraBenchmark::usesBLAS() ? "dlib+blas" : "dlib";
+
+    if (LinearAlgebraBenchmark::usesBLAS())
+        ss << "dlib uses BLAS for matrix products." << std::endl;
+    else
+        ss << "dlib was built without BLAS, so matrix products use its single threaded built-in kernel." << std::endl;
+
+    // Compare the multiplies over the sizes both ran.
+    long crossover = 0;
+    long largest = 0;
+    double speedup = 0;
+
+    for (auto& result: results)
+    {
+        if (result.operation != "gemm" || result.backend != "blocked" || result.skipped)
+            continue;
+
+        const LinearAlgebraResult* other = find("gemm", multiplyBackend, result.size);
+
+        if (other == nullptr || other->skipped || other->gflops() == 0)
+            continue;
+
+        const double ratio = result.gflops() / other->gflops();
+
+        if (ratio > 1.2 && crossover == 0)
+            crossover = result.size;
+        else if (ratio <= 1.2)
+            crossover = 0;
+
+        if (result.size > largest)
+        {
+            largest = result.size;
+            speedup = ratio;
+        }
+    }
+
+    if (largest > 0)
+    {
+        if (speedup > 1.2)
+        {
+            ss << "blockedMultiply() is " << speedup << "x faster than " << multiplyBackend;
+            ss << " at n = " << largest;
+
+            if (crossover > 0)
+                ss << " and faster from n = " << crossover;
+
+            ss << ". Use it for large products";
+
+            if (!LinearAlgebraBenchmark::usesBLAS())
+                ss << ", or build dlib with a multithreaded BLAS and compare again";
+
+            ss << "." << std::endl;
+        }
+        else if (speedup < 1 / 1.2)
+        {
+            ss << multiplyBackend << " is " << 1 / speedup << "x faster than blockedMultiply()";
+            ss << " at n = " << largest << ". Keep using dlib's multiply." << std::endl;
+        }
+        else
+        {
+            ss << multiplyBackend << " and blockedMultiply() are within 20% at n = " << largest << "." << std::endl;
+        }
+    }
+
+    if (LinearAlgebraBenchmark::usesLAPACK())
+        ss << "dlib uses LAPACK for svd, eigen and inverse." << std::endl;
+    else
+        ss << "dlib was built without LAPACK, so svd, eigen and inverse use its built-in code. Build dlib with LAPACK and compare the reports." << std::endl;
+
+    bool skipped = std::any_of(results.begin(), results.end(), [](const LinearAlgebraResult& result) {
+        return result.skipped;
+    });
+
+    if (skipped)
+        ss << "Sizes marked - were skipped because a run was predicted to take longer than the time limit." << std::endl;
+
+    return ss.str();
+}
+
+
+std::string LinearAlgebraReport::toCSV() const
+{
+    std::ostringstream ss;
+    ss << "operation,backend,size,iterations,mean_ms,min_ms,gflops,skipped" << std::endl;
+
+    for (auto& result: results)
+    {
+        ss << result.operation << ",";
+        ss << result.backend << ",";
+        ss << result.size << ",";
+        ss << result.iterations << ",";
+        ss << result.meanMs << ",";
+        ss << result.minMs << ",";
+        ss << result.gflops() << ",";
+        ss << (result.skipped ? 1 : 0) << std::endl;
+    }
+
+    return ss.str();
+}
+
+
+bool LinearAlgebraReport::saveCSV(const std::string& path) const
+{
+    ofBuffer buffer(toCSV());
+    return ofBufferToFile(path, buffer);
+}
+
+
+LinearAlgebraReport LinearAlgebraBenchmark::run()
+{
+    return run(Settings());
+}
+
+
+LinearAlgebraReport LinearAlgebraBenchmark::run(const Settings& settings)
+{
+    LinearAlgebraReport report;
+    report.configuration = configuration();
+
+    dlib::matrix<double> a;
+    dlib::matrix<double> b;
+    dlib::matrix<double> c;
+    dlib::matrix<double> u;
+    dlib::matrix<double> w;
+    dlib::matrix<double> v;
+
+    const std::string multiplyBackend = usesBLAS() ? "dlib+blas" : "dlib";
+    const std::string decompositionBackend = usesLAPACK() ? "dlib+lapack" : "dlib";
+
+    std::vector<Case> cases;
+
+    if (settings.gemm)
+    {
+        cases.push_back({ "gemm", multiplyBackend, 2, [&]() {
+            c = a * b;
+            return c(0, 0);
+        }});
+
+        cases.push_back({ "gemm", "blocked", 2, [&]() {
+            blockedMultiply(a, b, c, settings.numThreads);
+            return c(0, 0);
+        }});
+    }
+
+    if (settings.svd)
+    {
+        cases.push_back({ "svd", decompositionBackend, 21, [&]() {
+            dlib::svd3(a, u, w, v);
+            return w(0);
+        }});
+    }
+
+    if (settings.eigen)
+    {
+        cases.push_back({ "eigen", decompositionBackend, 9, [&]() {
+            dlib::eigenvalue_decomposition<dlib::matrix<double>> decomposition(dlib::make_symmetric(a));
+            return decomposition.get_real_eigenvalues()(0);
+        }});
+    }
+
+    if (settings.inverse)
+    {
+        cases.push_back({ "inverse", decompositionBackend, 2, [&]() {
+            c = dlib::inv(a);
+            return c(0, 0);
+        }});
+    }
+
+    // Keeps the results in use so no run can be optimized away.
+    volatile double sink = 0;
+
+    for (auto& benchmark: cases)
+    {
+        long lastSize = 0;
+        double lastMs = 0;
+
+        for (long size: settings.sizes)
+        {
+            LinearAlgebraResult result;
+            result.operation = benchmark.operation;
+            result.backend = benchmark.backend;
+            result.size = size;
+            result.flops = benchmark.flopsPerCube * double(size) * double(size) * double(size);
+
+            // All operations are O(n^3), so the last size predicts this one.
+            const double scale = lastSize > 0 ? double(size) / lastSize : 0;
+
+            if (lastMs * scale * scale * scale > settings.maxSeconds * 1000)
+            {
+                result.skipped = true;
+                report.results.push_back(result);
+                continue;
+            }
+
+            a = dlib::randm(size, size);
+            b = dlib::randm(size, size);
+
+            // The first run warms up the caches and allocations. It's only
+            // kept if it is too slow to repeat.
+            auto start = Clock::now();
+            sink = sink + benchmark.run();
+            double ms = elapsedMs(start);
+
+            if (ms > settings.maxSeconds * 1000)
+            {
+                result.iterations = 1;
+                result.meanMs = ms;
+                result.minMs = ms;
+            }
+            else
+            {
+                double totalMs = 0;
+                result.minMs = std::numeric_limits<double>::max();
+
+                while (result.iterations == 0 || totalMs < settings.minSeconds * 1000)
+                {
+                    start = Clock::now();
+                    sink = sink + benchmark.run();
+                    ms = elapsedMs(start);
+
+                    totalMs += ms;
+                    result.minMs = std::min(result.minMs, ms);
+                    ++result.iterations;
+                }
+
+                result.meanMs = totalMs / result.iterations;
+            }
+
+            lastSize = size;
+            lastMs = result.minMs;
+
+            ofLogNotice("LinearAlgebraBenchmark::run") << result.operation << " " << result.backend
+                                                       << " n = " << size << ": " << result.gflops() << " GFLOP/s";
+
+            report.results.push_back(result);
+        }
+    }
+
+    return report;
+}
+
+
+std::string LinearAlgebraBenchmark::configuration()
+{
+    bool cuda = false;
+    bool avx = false;
+    bool avx2 = false;
+    bool fma = false;
+
+#if defined(DLIB_USE_CUDA)
+    cuda = true;
+#endif
+#if defined(__AVX__)
+    avx = true;
+#endif
+#if defined(__AVX2__)
+    avx2 = true;
+#endif
+#if defined(__FMA__)
+    fma = true;
+#endif
+
+    std::ostringstream ss;
+    ss << "BLAS: " << yesNo(usesBLAS());
+    ss << ", LAPACK: " << yesNo(usesLAPACK());
+    ss << ", CUDA: " << yesNo(cuda);
+    ss << ", AVX: " << yesNo(avx);
+    ss << ", AVX2: " << yesNo(avx2);
+    ss << ", FMA: " << yesNo(fma);
+    ss << ", hardware threads: " << std::thread::hardware_concurrency();
+    return ss.str();
+}
+
+
+bool LinearAlgebraBenchmark::usesBLAS()
+{
+#if defined(DLIB_USE_BLAS)
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+bool LinearAlgebraBenchmark::usesLAPACK()
+{
+#if defined(DLIB_USE_LAPACK)
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,456 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Math/RandomizedSVD.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "dlib/rand.h"
+#include "dlib/threads.h"
+#include "ofx/Dlib/Math/BlockedMultiply.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+namespace {
+
+
+/// \brief Chunks are split across threads in ranges of at least this many rows.
+const long MIN_ROWS_PER_THREAD = 64;
+
+/// \brief The per thread partial products of trans(C) (C Q) together hold at
+///        most this many values, which bounds memory for very wide sparse
+///        matrices.
+const std::size_t MAX_PARTIAL_VALUES = 16 * 1024 * 1024;
+
+
+/// \brief Replace the columns of z with an orthonormal basis of their span.
+void orthonormalize(dlib::matrix<double>& z)
+{
+    dlib::qr_decomposition<dlib::matrix<double>> qr(z);
+    z = qr.get_q();
+}
+
+
+/// \brief Call function(part, begin, end) for numParts equal row ranges.
+template <typename FUNCTION>
+void forEachRange(long numParts, long numRows, const FUNCTION& function)
+{
+    auto range = [&](long part) {
+        function(part, part * numRows / numParts, (part + 1) * numRows / numParts);
+    };
+
+    if (numParts <= 1)
+        range(0);
+    else
+        dlib::parallel_for(numParts, 0, numParts, range);
+}
+
+
+/// \brief p = rows q for sparse rows.
+void multiplySparse(const std::vector<SparseRow>& rows,
+                    const dlib::matrix<double>& q,
+                    dlib::matrix<double>& p,
+                    long numParts)
+{
+    const long l = q.nc();
+
+    p.set_size(long(rows.size()), l);
+    p = 0;
+
+    forEachRange(numParts, long(rows.size()), [&](long, long begin, long end) {
+        for (long i = begin; i < end; ++i)
+        {
+            double* pi = &p(i, 0);
+
+            for (auto& entry: rows[i])
+            {
+                const double* qj = &q(long(entry.first), 0);
+
+                for (long b = 0; b < l; ++b)
+                    pi[b] += entry.second * qj[b];
+            }
+        }
+    });
+}
+
+
+/// \brief z += trans(C) p for sparse rows [begin, end) of a chunk.
+void addTransposedProduct(const std::vector<SparseRow>& rows,
+                          const dlib::matrix<double>& p,
+                          long begin,
+                          long end,
+                          dlib::matrix<double>& z)
+{
+    const long l = z.nc();
+
+    for (long i = begin; i < end; ++i)
+    {
+        const double* pi = &p(i, 0);
+
+        for (auto& entry: rows[i])
+        {
+            double* zj = &z(long(entry.first), 0);
+
+            for (long b = 0; b < l; ++b)
+                zj[b] += entry.second * pi[b];
+        }
+    }
+}
+
+
+} // namespace
+
+
+RandomizedSVD::RandomizedSVD(): RandomizedSVD(Settings())
+{
+}
+
+
+RandomizedSVD::RandomizedSVD(const Settings& settings):
+    _settings(settings)
+{
+}
+
+
+void RandomizedSVD::compute(const dlib::matrix<double>& a)
+{
+    DenseRowReader reader(a);
+    compute(reader);
+}
+
+
+void RandomizedSVD::compute(const std::vector<SparseRow>& rows, long numColumns)
+{
+    SparseRowReader reader(rows, numColumns);
+    compute(reader);
+}
+
+
+void RandomizedSVD::compute(RowReader& reader)
+{
+    const long n = reader.numColumns();
+
+    if (n <= 0)
+        throw std::invalid_argument("RandomizedSVD: The matrix has no columns.");
+
+    if (_settings.rank <= 0 || _settings.oversampling < 0 || _settings.chunkRows <= 0)
+        throw std::invalid_argument("RandomizedSVD: The rank and chunk size must be positive.");
+
+    const long rank = std::min(_settings.rank, n);
+    const long l = std::min(rank + _settings.oversampling, n);
+
+    _numThreads = _settings.numThreads;
+
+    if (_numThreads == 0)
+        _numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // The random start. The seed makes repeated runs identical.
+    dlib::rand rnd;
+    rnd.set_seed(std::to_string(_settings.seed));
+
+    dlib::matrix<double> q(n, l);
+
+    for (long r = 0; r < n; ++r)
+        for (long c = 0; c < l; ++c)
+            q(r, c) = rnd.get_random_gaussian();
+
+    orthonormalize(q);
+
+    dlib::matrix<double> z;
+    _pass(reader, q, z, true);
+
+    for (std::size_t i = 0; i <= _settings.powerIterations; ++i)
+    {
+        q = z;
+        orthonormalize(q);
+        _pass(reader, q, z, false);
+    }
+
+    // Rayleigh-Ritz: the eigenvectors of trans(q) trans(A) A q rotate q onto
+    // the right singular vectors, and the eigenvalues are the squared
+    // singular values.
+    dlib::matrix<double> g(l, l);
+
+    for (long r = 0; r < l; ++r)
+    {
+        for (long c = 0; c < l; ++c)
+        {
+            double sum = 0;
+
+            for (long j = 0; j < n; ++j)
+                sum += q(j, r) * z(j, c);
+
+            g(r, c) = sum;
+        }
+    }
+
+    // Make it exactly symmetric, so dlib uses its symmetric solver.
+    for (long r = 0; r < l; ++r)
+    {
+        for (long c = r + 1; c < l; ++c)
+        {
+            const double value = 0.5 * (g(r, c) + g(c, r));
+            g(r, c) = value;
+            g(c, r) = value;
+        }
+    }
+
+    dlib::eigenvalue_decomposition<dlib::matrix<double>> eigen(g);
+    const dlib::matrix<double, 0, 1> eigenvalues = eigen.get_real_eigenvalues();
+    const dlib::matrix<double> eigenvectors = eigen.get_pseudo_v();
+
+    std::vector<long> order(l);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](long lhs, long rhs) {
+        return eigenvalues(lhs) > eigenvalues(rhs);
+    });
+
+    _singularValues.set_size(rank);
+    _v.set_size(n, rank);
+
+    for (long k = 0; k < rank; ++k)
+    {
+        const long index = order[k];
+
+        _singularValues(k) = std::sqrt(std::max(eigenvalues(index), 0.0));
+
+        for (long j = 0; j < n; ++j)
+        {
+            double sum = 0;
+
+            for (long c = 0; c < l; ++c)
+                sum += q(j, c) * eigenvectors(c, index);
+
+            _v(j, k) = sum;
+        }
+    }
+}
+
+
+dlib::matrix<double, 0, 1> RandomizedSVD::explainedVariance() const
+{
+    const double scale = _numRows > 1 ? 1.0 / (_numRows - 1) : 1.0;
+
+    dlib::matrix<double, 0, 1> variance(_singularValues.nr());
+
+    for (long k = 0; k < _singularValues.nr(); ++k)
+        variance(k) = _singularValues(k) * _singularValues(k) * scale;
+
+    return variance;
+}
+
+
+dlib::matrix<double> RandomizedSVD::project(const dlib::matrix<double>& rows) const
+{
+    if (rows.nc() != _v.nr())
+    {
+        throw std::invalid_argument("RandomizedSVD: Rows have " + std::to_string(rows.nc())
+                                    + " columns, expected " + std::to_string(_v.nr()) + ".");
+    }
+
+    dlib::matrix<double> centered(rows.nr(), rows.nc());
+
+    for (long r = 0; r < rows.nr(); ++r)
+        for (long c = 0; c < rows.nc(); ++c)
+            centered(r, c) = rows(r, c) - _mean(c);
+
+    dlib::matrix<double> projection;
+    blockedMultiply(centered, _v, projection, _numThreads);
+    return projection;
+}
+
+
+dlib::matrix<double> RandomizedSVD::u(const dlib::matrix<double>& rows) const
+{
+    dlib::matrix<double> projection = project(rows);
+
+    for (long c = 0; c < projection.nc(); ++c)
+    {
+        const double scale = _singularValues(c) > 0 ? 1.0 / _singularValues(c) : 0.0;
+
+        for (long r = 0; r < projection.nr(); ++r)
+            projection(r, c) *= scale;
+    }
+
+    return projection;
+}
+
+
+void RandomizedSVD::_pass(RowReader& reader,
+                          const dlib::matrix<double>& q,
+                          dlib::matrix<double>& z,
+                          bool first)
+{
+    const long n = q.nr();
+    const long l = q.nc();
+    const bool center = _settings.center && !first;
+
+    z.set_size(n, l);
+    z = 0;
+
+    dlib::matrix<double, 0, 1> sums;
+
+    if (first)
+    {
+        sums.set_size(n);
+        sums = 0;
+        _numRows = 0;
+    }
+
+    // Centering subtracts trans(mean) q from every row of C q, and
+    // mean * (the column sums of the centered C q) from trans(C) C q.
+    dlib::matrix<double, 0, 1> shift(l);
+    dlib::matrix<double, 0, 1> productSums(l);
+    shift = 0;
+    productSums = 0;
+
+    if (center)
+    {
+        for (long j = 0; j < n; ++j)
+            for (long b = 0; b < l; ++b)
+                shift(b) += _mean(j) * q(j, b);
+    }
+
+    // Threads get their own partial sums of trans(C) C q for sparse chunks.
+    const long maxParts = long(std::max<std::size_t>(1, MAX_PARTIAL_VALUES / std::size_t(n * l)));
+
+    reader.rewind();
+
+    while (reader.read(_settings.chunkRows, _chunk))
+    {
+        const long rows = _chunk.numRows();
+        const long numRowParts = std::max(1L, std::min(long(_numThreads), rows / MIN_ROWS_PER_THREAD));
+
+        if (_chunk.isSparse)
+        {
+            for (auto& row: _chunk.sparse)
+            {
+                for (auto& entry: row)
+                {
+                    if (entry.first >= static_cast<unsigned long>(n))
+                    {
+                        throw std::invalid_argument("RandomizedSVD: Column " + std::to_string(entry.first)
+                                                    + " is out of range.");
+                    }
+                }
+            }
+
+            multiplySparse(_chunk.sparse, q, _product, numRowParts);
+        }
+        else
+        {
+            if (_chunk.dense.nc() != n)
+                throw std::invalid_argument("RandomizedSVD: A chunk has the wrong number of columns.");
+
+            blockedMultiply(_chunk.dense, q, _product, _numThreads);
+        }
+
+        if (first)
+        {
+            _numRows += rows;
+
+            if (_chunk.isSparse)
+            {
+                for (auto& row: _chunk.sparse)
+                    for (auto& entry: row)
+                        sums(long(entry.first)) += entry.second;
+            }
+            else
+            {
+                for (long i = 0; i < rows; ++i)
+                    for (long j = 0; j < n; ++j)
+                        sums(j) += _chunk.dense(i, j);
+            }
+        }
+
+        if (center)
+        {
+            for (long i = 0; i < rows; ++i)
+            {
+                for (long b = 0; b < l; ++b)
+                {
+                    _product(i, b) -= shift(b);
+                    productSums(b) += _product(i, b);
+                }
+            }
+        }
+
+        if (!_chunk.isSparse)
+        {
+            // trans(C) (C q) is a second dense product. Transposing the chunk
+            // first lets blockedMultiply() split it across threads by the
+            // columns of C, which needs no partial sums.
+            _transposed = dlib::trans(_chunk.dense);
+            blockedMultiply(_transposed, _product, _chunkProduct, _numThreads);
+            z += _chunkProduct;
+            continue;
+        }
+
+        const long numParts = std::min(numRowParts, maxParts);
+
+        if (numParts == 1)
+        {
+            addTransposedProduct(_chunk.sparse, _product, 0, rows, z);
+        }
+        else
+        {
+            _partials.resize(numParts);
+
+            forEachRange(numParts, rows, [&](long part, long begin, long end) {
+                _partials[part].set_size(n, l);
+                _partials[part] = 0;
+                addTransposedProduct(_chunk.sparse, _product, begin, end, _partials[part]);
+            });
+
+            for (auto& partial: _partials)
+                for (long j = 0; j < n; ++j)
+                    for (long b = 0; b < l; ++b)
+                        z(j, b) += partial(j, b);
+        }
+    }
+
+    if (first)
+    {
+        if (_numRows == 0)
+            throw std::invalid_argument("RandomizedSVD: The matrix has no rows.");
+
+        _mean.set_size(n);
+        _mean = 0;
+
+        if (_settings.center)
+        {
+            for (long j = 0; j < n; ++j)
+                _mean(j) = sums(j) / _numRows;
+
+            // The mean isn't known during the first pass, so it is removed
+            // afterwards: trans(A - 1 mean') (A - 1 mean') q
+            // = trans(A) A q - numRows mean (mean' q).
+            for (long j = 0; j < n; ++j)
+                for (long b = 0; b < l; ++b)
+                    shift(b) += _mean(j) * q(j, b);
+
+            for (long j = 0; j < n; ++j)
+                for (long b = 0; b < l; ++b)
+                    z(j, b) -= _numRows * _mean(j) * shift(b);
+        }
+    }
+    else if (center)
+    {
+        for (long j = 0; j < n; ++j)
+            for (long b = 0; b < l; ++b)
+                z(j, b) -= _mean(j) * productSums(b);
+    }
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,169 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Math/RowReader.h"
+#include <algorithm>
+#include <stdexcept>
+
+
+namespace ofx {
+namespace Dlib {
+
+
+DenseRowReader::DenseRowReader(const dlib::matrix<double>& rows):
+    _rows(rows)
+{
+}
+
+
+long DenseRowReader::numColumns() const
+{
+    return _rows.nc();
+}
+
+
+void DenseRowReader::rewind()
+{
+    _next = 0;
+}
+
+
+bool DenseRowReader::read(long maxRows, RowChunk& chunk)
+{
+    const long count = std::min(maxRows, _rows.nr() - _next);
+
+    if (count <= 0)
+        return false;
+
+    chunk.isSparse = false;
+    chunk.sparse.clear();
+    chunk.dense.set_size(count, _rows.nc());
+
+    // Rows are contiguous, so the chunk is one copy.
+    std::copy(&_rows(_next, 0), &_rows(_next, 0) + count * _rows.nc(), &chunk.dense(0, 0));
+
+    _next += count;
+    return true;
+}
+
+
+SparseRowReader::SparseRowReader(const std::vector<SparseRow>& rows, long numColumns):
+    _rows(rows),
+    _numColumns(numColumns)
+{
+}
+
+
+long SparseRowReader::numColumns() const
+{
+    return _numColumns;
+}
+
+
+void SparseRowReader::rewind()
+{
+    _next = 0;
+}
+
+
+bool SparseRowReader::read(long maxRows, RowChunk& chunk)
+{
+    const std::size_t count = std::min(std::size_t(std::max(maxRows, 0L)), _rows.size() - _next);
+
+    if (count == 0)
+        return false;
+
+    chunk.isSparse = true;
+    chunk.dense.set_size(0, 0);
+
+    // Assigning the rows reuses the storage of the previous chunk.
+    chunk.sparse.resize(count);
+
+    for (std::size_t i = 0; i < count; ++i)
+        chunk.sparse[i] = _rows[_next + i];
+
+    _next += count;
+    return true;
+}
+
+
+FileRowReader::FileRowReader(const std::string& path, long numColumns, ValueType type):
+    _stream(path, std::ios::binary),
+    _numColumns(numColumns),
+    _type(type)
+{
+    if (!_stream)
+        throw std::runtime_error("FileRowReader: Unable to open " + path + ".");
+
+    if (numColumns <= 0)
+        throw std::invalid_argument("FileRowReader: The number of columns must be positive.");
+
+    const std::size_t rowSize = std::size_t(numColumns) * (type == FLOAT32 ? sizeof(float) : sizeof(double));
+
+    _stream.seekg(0, std::ios::end);
+    const std::size_t fileSize = std::size_t(_stream.tellg());
+    _stream.seekg(0, std::ios::beg);
+
+    if (fileSize % rowSize != 0)
+    {
+        throw std::runtime_error("FileRowReader: The size of " + path
+                                 + " isn't a multiple of " + std::to_string(rowSize)
+                                 + " byte rows.");
+    }
+
+    _numRows = long(fileSize / rowSize);
+}
+
+
+long FileRowReader::numColumns() const
+{
+    return _numColumns;
+}
+
+
+void FileRowReader::rewind()
+{
+    _stream.clear();
+    _stream.seekg(0, std::ios::beg);
+    _next = 0;
+}
+
+
+bool FileRowReader::read(long maxRows, RowChunk& chunk)
+{
+    const long count = std::min(maxRows, _numRows - _next);
+
+    if (count <= 0)
+        return false;
+
+    const std::size_t numValues = std::size_t(count * _numColumns);
+
+    chunk.isSparse = false;
+    chunk.sparse.clear();
+    chunk.dense.set_size(count, _numColumns);
+
+    if (_type == FLOAT64)
+    {
+        // Read straight into the chunk.
+        _stream.read(reinterpret_cast<char*>(&chunk.dense(0, 0)), numValues * sizeof(double));
+    }
+    else
+    {
+        _buffer.resize(numValues);
+        _stream.read(reinterpret_cast<char*>(_buffer.data()), numValues * sizeof(float));
+        std::copy(_buffer.begin(), _buffer.end(), &chunk.dense(0, 0));
+    }
+
+    if (!_stream)
+        throw std::runtime_error("FileRowReader: Unable to read row " + std::to_string(_next) + ".");
+
+    _next += count;
+    return true;
+}
+
+
+} } // namespace ofx::Dlib
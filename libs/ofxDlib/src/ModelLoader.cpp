@@ -0,0 +1,156 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/ModelLoader.h"
+#include <stdexcept>
+
+
+namespace ofx {
+namespace Dlib {
+
+
+ModelLoader::ModelLoader()
+{
+}
+
+
+ModelLoader::~ModelLoader()
+{
+    waitForAll();
+}
+
+
+bool ModelLoader::isReady(const std::string& name) const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto iter = _entries.find(name);
+    return iter != _entries.end() && iter->second->stats.ready;
+}
+
+
+bool ModelLoader::isReady(const std::vector<std::string>& names) const
+{
+    for (auto& name: names)
+    {
+        if (!isReady(name))
+            return false;
+    }
+
+    return true;
+}
+
+
+bool ModelLoader::isLoading() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for (auto& entry: _entries)
+    {
+        if (!entry.second->stats.ready && !entry.second->stats.failed)
+            return true;
+    }
+
+    return false;
+}
+
+
+void ModelLoader::waitForAll() const
+{
+    std::vector<std::shared_ptr<AbstractEntry>> entries;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (auto& entry: _entries)
+            entries.push_back(entry.second);
+    }
+
+    for (auto& entry: entries)
+        entry->wait();
+}
+
+
+ModelLoadStats ModelLoader::stats(const std::string& name) const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto iter = _entries.find(name);
+
+    if (iter != _entries.end())
+        return iter->second->stats;
+
+    return ModelLoadStats();
+}
+
+
+std::vector<ModelLoadStats> ModelLoader::stats() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    std::vector<ModelLoadStats> results;
+
+    for (auto& name: _names)
+        results.push_back(_entries.find(name)->second->stats);
+
+    return results;
+}
+
+
+void ModelLoader::update()
+{
+    std::vector<ModelLoadStats> finished;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        for (auto& name: _names)
+        {
+            auto& entry = _entries.find(name)->second;
+
+            if (!entry->notified && (entry->stats.ready || entry->stats.failed))
+            {
+                entry->notified = true;
+                finished.push_back(entry->stats);
+            }
+        }
+    }
+
+    // Notify outside of the lock so listeners can query the loader.
+    for (auto& stats: finished)
+        ofNotifyEvent(onModelLoaded, stats, this);
+}
+
+
+void ModelLoader::_add(const std::string& name,
+                       std::shared_ptr<AbstractEntry> entry)
+{
+    if (_entries.find(name) != _entries.end())
+        throw std::invalid_argument("ModelLoader: a model named \"" + name + "\" is already registered.");
+
+    _entries[name] = entry;
+    _names.push_back(name);
+}
+
+
+void ModelLoader::_finish(const std::string& name,
+                          double loadTimeMs,
+                          uint64_t residentMemoryBefore,
+                          const std::string& error)
+{
+    uint64_t residentMemoryAfter = residentMemoryBytes();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    auto& stats = _entries.find(name)->second->stats;
+    stats.loadTimeMs = loadTimeMs;
+    stats.residentMemory = residentMemoryAfter;
+    stats.residentMemoryDelta = int64_t(residentMemoryAfter) - int64_t(residentMemoryBefore);
+    stats.error = error;
+    stats.failed = !error.empty();
+    stats.ready = error.empty();
+}
+
+
+} } // namespace ofx::Dlib
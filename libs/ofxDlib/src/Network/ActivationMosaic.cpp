@@ -0,0 +1,172 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Network/ActivationMosaic.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+namespace ofx {
+namespace Dlib {
+
+
+ActivationMosaic::ActivationMosaic(): ActivationMosaic(Settings())
+{
+}
+
+
+ActivationMosaic::ActivationMosaic(const Settings& settings):
+    _settings(settings)
+{
+}
+
+
+void ActivationMosaic::buildChannel(const ActivationStore& store,
+                                    std::size_t layer,
+                                    std::size_t channel,
+                                    const std::vector<std::size_t>& samples)
+{
+    const ActivationStore::Layer& l = store.layer(layer);
+
+    _tiles.clear();
+
+    if (samples.empty())
+    {
+        for (std::size_t sample = 0; sample < store.numSamples(); ++sample)
+            _tiles.push_back(store.data(sample, layer, channel));
+    }
+    else
+    {
+        for (std::size_t sample: samples)
+            _tiles.push_back(store.data(sample, layer, channel));
+    }
+
+    _nr = l.nr;
+    _nc = l.nc;
+    _build();
+}
+
+
+void ActivationMosaic::buildSample(const ActivationStore& store,
+                                   std::size_t sample,
+                                   std::size_t layer)
+{
+    const ActivationStore::Layer& l = store.layer(layer);
+
+    _tiles.clear();
+
+    for (long channel = 0; channel < l.k; ++channel)
+        _tiles.push_back(store.data(sample, layer, channel));
+
+    _nr = l.nr;
+    _nc = l.nc;
+    _build();
+}
+
+
+ofRectangle ActivationMosaic::getTile(std::size_t tile) const
+{
+    if (_columns == 0 || tile >= _tiles.size())
+        return ofRectangle();
+
+    std::size_t column = tile % _columns;
+    std::size_t row = tile / _columns;
+
+    return ofRectangle(_settings.padding + column * (_nc + _settings.padding),
+                       _settings.padding + row * (_nr + _settings.padding),
+                       _nc,
+                       _nr);
+}
+
+
+void ActivationMosaic::_build()
+{
+    _columns = 0;
+
+    if (_tiles.empty() || _nr == 0 || _nc == 0)
+    {
+        _pixels.clear();
+        return;
+    }
+
+    const std::size_t n = _tiles.size();
+    const std::size_t nr = std::size_t(_nr);
+    const std::size_t nc = std::size_t(_nc);
+    const std::size_t padding = _settings.padding;
+
+    std::size_t columns = _settings.columns;
+
+    if (columns == 0)
+        columns = std::size_t(std::ceil(std::sqrt(double(n))));
+
+    columns = std::min(columns, n);
+
+    const std::size_t rows = (n + columns - 1) / columns;
+    const std::size_t width = padding + columns * (nc + padding);
+    const std::size_t height = padding + rows * (nr + padding);
+
+    // Reallocation only happens when the mosaic shape changes.
+    if (_pixels.getWidth() != width
+    ||  _pixels.getHeight() != height
+    ||  _pixels.getPixelFormat() != OF_PIXELS_GRAY)
+    {
+        _pixels.allocate(width, height, OF_PIXELS_GRAY);
+    }
+
+    _pixels.set(0);
+    _columns = columns;
+
+    const std::size_t planeSize = nr * nc;
+
+    float mosaicMin = std::numeric_limits<float>::max();
+    float mosaicMax = std::numeric_limits<float>::lowest();
+
+    if (_settings.normalization == NORMALIZE_MOSAIC)
+    {
+        for (const float* plane: _tiles)
+        {
+            auto range = std::minmax_element(plane, plane + planeSize);
+            mosaicMin = std::min(mosaicMin, *range.first);
+            mosaicMax = std::max(mosaicMax, *range.second);
+        }
+    }
+
+    unsigned char* pixels = _pixels.getData();
+
+    for (std::size_t tile = 0; tile < n; ++tile)
+    {
+        const float* plane = _tiles[tile];
+
+        float minValue = mosaicMin;
+        float maxValue = mosaicMax;
+
+        if (_settings.normalization == NORMALIZE_TILE)
+        {
+            auto range = std::minmax_element(plane, plane + planeSize);
+            minValue = *range.first;
+            maxValue = *range.second;
+        }
+
+        const float scale = maxValue > minValue ? 255.0f / (maxValue - minValue) : 0.0f;
+
+        const std::size_t x = padding + (tile % columns) * (nc + padding);
+        const std::size_t y = padding + (tile / columns) * (nr + padding);
+
+        for (std::size_t r = 0; r < nr; ++r)
+        {
+            const float* in = plane + r * nc;
+            unsigned char* out = pixels + (y + r) * width + x;
+
+            for (std::size_t c = 0; c < nc; ++c)
+                out[c] = static_cast<unsigned char>((in[c] - minValue) * scale + 0.5f);
+        }
+    }
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,141 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Network/ActivationStore.h"
+#include <stdexcept>
+#include <string>
+
+
+namespace ofx {
+namespace Dlib {
+
+
+ActivationStore::ActivationStore()
+{
+}
+
+
+void ActivationStore::clear()
+{
+    _layers.clear();
+    _numSamples = 0;
+    _sampleSize = 0;
+    _values.clear();
+}
+
+
+const ActivationStore::Layer& ActivationStore::layer(std::size_t layer) const
+{
+    if (layer >= _layers.size())
+        throw std::out_of_range("ActivationStore: Invalid layer index " + std::to_string(layer) + ".");
+
+    return _layers[layer];
+}
+
+
+std::size_t ActivationStore::indexOf(unsigned long tag) const
+{
+    for (std::size_t i = 0; i < _layers.size(); ++i)
+    {
+        if (_layers[i].tag == tag)
+            return i;
+    }
+
+    throw std::invalid_argument("ActivationStore: No stored layer has tag " + std::to_string(tag) + ".");
+}
+
+
+const float* ActivationStore::data(std::size_t sample,
+                                   std::size_t layer,
+                                   std::size_t channel) const
+{
+    const Layer& l = this->layer(layer);
+
+    if (sample >= _numSamples)
+        throw std::out_of_range("ActivationStore: Invalid sample index " + std::to_string(sample) + ".");
+
+    if (channel >= std::size_t(l.k))
+        throw std::out_of_range("ActivationStore: Invalid channel index " + std::to_string(channel) + ".");
+
+    return _values.data() + sample * _sampleSize + l.offset + channel * l.channelSize();
+}
+
+
+std::vector<std::size_t> ActivationStore::_allocate(const std::vector<Output>& outputs,
+                                                    const std::vector<unsigned long>& tags,
+                                                    std::size_t numSamples)
+{
+    for (unsigned long tag: tags)
+    {
+        auto found = std::find_if(outputs.begin(), outputs.end(), [&](const Output& output) {
+            return output.tag == tag;
+        });
+
+        if (found == outputs.end())
+            throw std::invalid_argument("ActivationStore: The network has no layer with tag " + std::to_string(tag) + ".");
+    }
+
+    std::vector<std::size_t> selected;
+
+    _layers.clear();
+    _sampleSize = 0;
+
+    for (std::size_t i = 0; i < outputs.size(); ++i)
+    {
+        if (!tags.empty() && std::find(tags.begin(), tags.end(), outputs[i].tag) == tags.end())
+            continue;
+
+        const dlib::tensor& t = *outputs[i].tensor;
+
+        Layer layer;
+        layer.tag = outputs[i].tag;
+        layer.k = t.k();
+        layer.nr = t.nr();
+        layer.nc = t.nc();
+        layer.offset = _sampleSize;
+
+        _sampleSize += layer.size();
+        _layers.push_back(layer);
+        selected.push_back(i);
+    }
+
+    _numSamples = numSamples;
+
+    // std::vector keeps its capacity, so a capture of the same size doesn't
+    // reallocate.
+    _values.resize(_numSamples * _sampleSize);
+
+    return selected;
+}
+
+
+void ActivationStore::_copy(std::size_t firstSample,
+                            std::size_t layer,
+                            const dlib::tensor& output)
+{
+    const Layer& l = _layers[layer];
+    const std::size_t size = l.size();
+
+    if (output.k() != l.k || output.nr() != l.nr || output.nc() != l.nc)
+        throw std::invalid_argument("ActivationStore: The layer shape changed between batches.");
+
+    if (firstSample + std::size_t(output.num_samples()) > _numSamples)
+        throw std::out_of_range("ActivationStore: Too many samples.");
+
+    const float* in = output.host();
+    float* out = _values.data() + firstSample * _sampleSize + l.offset;
+
+    for (long sample = 0; sample < output.num_samples(); ++sample)
+    {
+        std::copy(in, in + size, out);
+        in += size;
+        out += _sampleSize;
+    }
+}
+
+
+} } // namespace ofx::Dlib
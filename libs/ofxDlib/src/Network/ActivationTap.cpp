@@ -0,0 +1,267 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Network/ActivationTap.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+
+namespace ofx {
+namespace Dlib {
+
+
+ActivationTap::ActivationTap(): ActivationTap(Settings())
+{
+}
+
+
+ActivationTap::ActivationTap(const Settings& settings):
+    _settings(settings),
+    _writeSnapshot(new Snapshot()),
+    _pendingSnapshot(new Snapshot()),
+    _workSnapshot(new Snapshot()),
+    _workAtlases(new Atlases()),
+    _pendingAtlases(new Atlases()),
+    _atlases(new Atlases())
+{
+    _thread = std::thread(&ActivationTap::_run, this);
+}
+
+
+ActivationTap::~ActivationTap()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+    }
+
+    _condition.notify_all();
+
+    if (_thread.joinable())
+        _thread.join();
+}
+
+
+void ActivationTap::capture(const std::string& name,
+                            const dlib::tensor& output,
+                            long sample)
+{
+    if (sample < 0 || sample >= output.num_samples())
+        throw std::out_of_range("ActivationTap: sample index out of range.");
+
+    LayerSnapshot& layer = _writeSnapshot->layers[name];
+    layer.k = output.k();
+    layer.nr = output.nr();
+    layer.nc = output.nc();
+
+    const std::size_t sampleSize = std::size_t(layer.k * layer.nr * layer.nc);
+    const float* data = output.host() + sample * sampleSize;
+
+    layer.data.resize(sampleSize);
+    std::copy(data, data + sampleSize, layer.data.begin());
+}
+
+
+void ActivationTap::submit()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        if (_hasPendingSnapshot)
+            ++_droppedCount;
+
+        std::swap(_writeSnapshot, _pendingSnapshot);
+        _hasPendingSnapshot = true;
+    }
+
+    _condition.notify_one();
+}
+
+
+bool ActivationTap::update()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (!_hasPendingAtlases)
+        return false;
+
+    std::swap(_atlases, _pendingAtlases);
+    _hasPendingAtlases = false;
+    return true;
+}
+
+
+const ofPixels& ActivationTap::getAtlas(const std::string& name) const
+{
+    static const ofPixels empty;
+
+    auto iter = _atlases->find(name);
+
+    if (iter != _atlases->end())
+        return iter->second.pixels;
+
+    return empty;
+}
+
+
+ofRectangle ActivationTap::getTile(const std::string& name, std::size_t channel) const
+{
+    auto iter = _atlases->find(name);
+
+    if (iter == _atlases->end() || iter->second.columns == 0)
+        return ofRectangle();
+
+    const Atlas& atlas = iter->second;
+
+    std::size_t column = channel % atlas.columns;
+    std::size_t row = channel / atlas.columns;
+
+    return ofRectangle(_settings.padding + column * (atlas.nc + _settings.padding),
+                       _settings.padding + row * (atlas.nr + _settings.padding),
+                       atlas.nc,
+                       atlas.nr);
+}
+
+
+std::vector<std::string> ActivationTap::getNames() const
+{
+    std::vector<std::string> names;
+
+    for (auto& entry: *_atlases)
+        names.push_back(entry.first);
+
+    return names;
+}
+
+
+uint64_t ActivationTap::getFrameCount() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _frameCount;
+}
+
+
+uint64_t ActivationTap::getDroppedCount() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _droppedCount;
+}
+
+
+void ActivationTap::_run()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _condition.wait(lock, [&]() {
+                return _hasPendingSnapshot || !_running;
+            });
+
+            if (!_running)
+                return;
+
+            std::swap(_pendingSnapshot, _workSnapshot);
+            _hasPendingSnapshot = false;
+        }
+
+        for (auto& entry: _workSnapshot->layers)
+            _build(entry.second, (*_workAtlases)[entry.first]);
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            std::swap(_workAtlases, _pendingAtlases);
+            _hasPendingAtlases = true;
+            ++_frameCount;
+        }
+    }
+}
+
+
+void ActivationTap::_build(const LayerSnapshot& layer, Atlas& atlas) const
+{
+    if (layer.k == 0 || layer.nr == 0 || layer.nc == 0)
+        return;
+
+    const std::size_t k = std::size_t(layer.k);
+    const std::size_t nr = std::size_t(layer.nr);
+    const std::size_t nc = std::size_t(layer.nc);
+    const std::size_t padding = _settings.padding;
+
+    std::size_t columns = _settings.columns;
+
+    if (columns == 0)
+        columns = std::size_t(std::ceil(std::sqrt(double(k))));
+
+    columns = std::min(columns, k);
+
+    const std::size_t rows = (k + columns - 1) / columns;
+    const std::size_t width = padding + columns * (nc + padding);
+    const std::size_t height = padding + rows * (nr + padding);
+
+    // Reallocation only happens when the layer shape changes.
+    if (atlas.pixels.getWidth() != width
+    ||  atlas.pixels.getHeight() != height
+    ||  atlas.pixels.getPixelFormat() != OF_PIXELS_GRAY)
+    {
+        atlas.pixels.allocate(width, height, OF_PIXELS_GRAY);
+    }
+
+    atlas.pixels.set(0);
+    atlas.columns = columns;
+    atlas.nr = layer.nr;
+    atlas.nc = layer.nc;
+
+    const std::size_t planeSize = nr * nc;
+
+    float layerMin = std::numeric_limits<float>::max();
+    float layerMax = std::numeric_limits<float>::lowest();
+
+    if (_settings.normalization == NORMALIZE_LAYER)
+    {
+        auto range = std::minmax_element(layer.data.begin(), layer.data.end());
+        layerMin = *range.first;
+        layerMax = *range.second;
+    }
+
+    unsigned char* pixels = atlas.pixels.getData();
+
+    for (std::size_t channel = 0; channel < k; ++channel)
+    {
+        const float* plane = layer.data.data() + channel * planeSize;
+
+        float minValue = layerMin;
+        float maxValue = layerMax;
+
+        if (_settings.normalization == NORMALIZE_CHANNEL)
+        {
+            auto range = std::minmax_element(plane, plane + planeSize);
+            minValue = *range.first;
+            maxValue = *range.second;
+        }
+
+        const float scale = maxValue > minValue ? 255.0f / (maxValue - minValue) : 0.0f;
+
+        const std::size_t x = padding + (channel % columns) * (nc + padding);
+        const std::size_t y = padding + (channel / columns) * (nr + padding);
+
+        for (std::size_t r = 0; r < nr; ++r)
+        {
+            const float* in = plane + r * nc;
+            unsigned char* out = pixels + (y + r) * width + x;
+
+            for (std::size_t c = 0; c < nc; ++c)
+                out[c] = static_cast<unsigned char>((in[c] - minValue) * scale + 0.5f);
+        }
+    }
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,652 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Network/LeNetKernel.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+
+namespace ofx {
+namespace Dlib {
+namespace LeNet5 {
+
+
+namespace {
+
+
+/// \brief The convolution size.
+const std::size_t KERNEL = 5;
+
+/// \brief The convolution padding, as in dlib::con with a stride of 1.
+const std::size_t PADDING = 2;
+
+const std::size_t SIZE_0 = InferenceKernel::INPUT_SIZE;
+const std::size_t PADDED_0 = SIZE_0 + 2 * PADDING;
+const std::size_t SIZE_1 = SIZE_0 / 2;
+const std::size_t PADDED_1 = SIZE_1 + 2 * PADDING;
+const std::size_t SIZE_2 = SIZE_1 / 2;
+
+const std::size_t FILTERS_0 = 6;
+const std::size_t FILTERS_1 = 16;
+const std::size_t OUTPUTS_0 = 120;
+const std::size_t OUTPUTS_1 = 84;
+const std::size_t OUTPUTS_2 = InferenceKernel::NUM_CLASSES;
+
+#if defined(__AVX512F__)
+/// \brief Channels are padded to a multiple of one AVX-512 register.
+const std::size_t LANES = 16;
+
+/// \brief The number of adjacent pixels each convolution computes at once.
+///        AVX-512 has 32 registers, enough for the accumulators of 14
+///        pixels, so every weight is loaded once per 14 multiply-adds.
+const std::size_t CONVOLUTION_PIXELS = 14;
+#else
+/// \brief Channels are padded to a multiple of one AVX register.
+const std::size_t LANES = 8;
+
+/// \brief The number of adjacent pixels each convolution computes at once.
+///        Their 10 accumulators, 2 weights and 1 input value fit in the 16
+///        AVX registers without spilling.
+const std::size_t CONVOLUTION_PIXELS = 5;
+#endif
+
+constexpr std::size_t padded(std::size_t size)
+{
+    return (size + LANES - 1) / LANES * LANES;
+}
+
+const std::size_t CHANNELS_1 = padded(FILTERS_1);
+const std::size_t CHANNELS_2 = padded(OUTPUTS_0);
+const std::size_t CHANNELS_3 = padded(OUTPUTS_1);
+const std::size_t CHANNELS_4 = padded(OUTPUTS_2);
+
+const std::size_t FEATURES = SIZE_2 * SIZE_2 * FILTERS_1;
+
+/// \brief The number of digits that share each pass over the weights of the
+///        first fully connected layer.
+const std::size_t BATCH = 8;
+
+
+// One SIMD register and the few operations the kernels need, so they are
+// written once for AVX and AVX-512.
+#if defined(__AVX512F__)
+
+typedef __m512 Register;
+
+inline Register load(const float* p)
+{
+    return _mm512_loadu_ps(p);
+}
+
+inline void store(float* p, Register v)
+{
+    _mm512_storeu_ps(p, v);
+}
+
+inline Register broadcast(const float* p)
+{
+    return _mm512_set1_ps(*p);
+}
+
+/// \returns a * b + c.
+inline Register multiplyAdd(Register a, Register b, Register c)
+{
+    return _mm512_fmadd_ps(a, b, c);
+}
+
+#elif defined(__AVX__)
+
+typedef __m256 Register;
+
+inline Register load(const float* p)
+{
+    return _mm256_loadu_ps(p);
+}
+
+inline void store(float* p, Register v)
+{
+    _mm256_storeu_ps(p, v);
+}
+
+inline Register broadcast(const float* p)
+{
+    return _mm256_broadcast_ss(p);
+}
+
+/// \returns a * b + c.
+inline Register multiplyAdd(Register a, Register b, Register c)
+{
+#if defined(__FMA__)
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(c, _mm256_mul_ps(a, b));
+#endif
+}
+
+#endif
+
+
+/// \brief Compute acc[p * accStride + n] += sum_t x[p * stride + t] * w[t * weightStride + n]
+///        for n < N and p < P.
+///
+/// The P sets of inputs share the weights, e.g. P adjacent pixels of a
+/// convolution or P digits of a batch, so every weight is loaded once for P
+/// multiply-adds. The accumulators stay in registers for all taps. Zero
+/// inputs, which are common after a relu, are skipped for the wide fully
+/// connected layers.
+///
+/// \tparam N The number of outputs, a multiple of LANES.
+/// \tparam P The number of input sets.
+template <std::size_t N, std::size_t P>
+inline void multiplyAccumulate(const float* x,
+                               std::size_t stride,
+                               const float* w,
+                               std::size_t taps,
+                               float* acc,
+                               std::size_t weightStride = N,
+                               std::size_t accStride = N)
+{
+    static_assert(N % LANES == 0, "N must be a multiple of LANES.");
+
+#if defined(__AVX__)
+    Register sums[P][N / LANES];
+
+    for (std::size_t p = 0; p < P; ++p)
+        for (std::size_t i = 0; i < N / LANES; ++i)
+            sums[p][i] = load(acc + p * accStride + i * LANES);
+
+    for (std::size_t t = 0; t < taps; ++t, w += weightStride)
+    {
+        if (P == 1 && N >= 64 && x[t] == 0)
+            continue;
+
+        Register weights[N / LANES];
+
+        for (std::size_t i = 0; i < N / LANES; ++i)
+            weights[i] = load(w + i * LANES);
+
+        for (std::size_t p = 0; p < P; ++p)
+        {
+            const Register v = broadcast(x + p * stride + t);
+
+            for (std::size_t i = 0; i < N / LANES; ++i)
+                sums[p][i] = multiplyAdd(v, weights[i], sums[p][i]);
+        }
+    }
+
+    for (std::size_t p = 0; p < P; ++p)
+        for (std::size_t i = 0; i < N / LANES; ++i)
+            store(acc + p * accStride + i * LANES, sums[p][i]);
+#else
+    for (std::size_t p = 0; p < P; ++p)
+    {
+        // Local accumulators don't alias the weights, so the compiler can
+        // keep them in vector registers.
+        float sums[N];
+        std::copy(acc + p * accStride, acc + p * accStride + N, sums);
+
+        const float* weights = w;
+
+        for (std::size_t t = 0; t < taps; ++t, weights += weightStride)
+        {
+            const float v = x[p * stride + t];
+
+            if (N >= 64 && v == 0)
+                continue;
+
+            for (std::size_t n = 0; n < N; ++n)
+                sums[n] += v * weights[n];
+        }
+
+        std::copy(sums, sums + N, acc + p * accStride);
+    }
+#endif
+}
+
+
+/// \brief The first 5x5 convolution, of the single channel input.
+///
+/// One input channel gives too few filters to fill a register, so this
+/// runs across adjacent output columns instead, with one accumulator per
+/// filter. The last block of a row overlaps the one before it.
+///
+/// \param in The padded input, PADDED_0 x PADDED_0.
+/// \param w The weights, FILTERS_0 x 5 x 5.
+/// \param b The biases, FILTERS_0.
+/// \param out The output, FILTERS_0 x SIZE_0 x SIZE_0, channels first.
+inline void convolveInput(const float* in, const float* w, const float* b, float* out)
+{
+    static_assert(SIZE_0 >= LANES, "A row must fill a register.");
+
+#if defined(__AVX__)
+    static_assert(SIZE_0 % 2 == 0, "Rows are computed in pairs.");
+
+    // Two output rows share each weight broadcast.
+    for (std::size_t r = 0; r < SIZE_0; r += 2)
+    {
+        for (std::size_t block = 0; block < SIZE_0; block += LANES)
+        {
+            const std::size_t c = std::min(block, SIZE_0 - LANES);
+
+            Register sums[2][FILTERS_0];
+
+            for (std::size_t f = 0; f < FILTERS_0; ++f)
+                sums[0][f] = sums[1][f] = broadcast(b + f);
+
+            for (std::size_t y = 0; y < KERNEL; ++y)
+            {
+                for (std::size_t x = 0; x < KERNEL; ++x)
+                {
+                    const Register v0 = load(in + (r + y) * PADDED_0 + c + x);
+                    const Register v1 = load(in + (r + y + 1) * PADDED_0 + c + x);
+
+                    for (std::size_t f = 0; f < FILTERS_0; ++f)
+                    {
+                        const Register weight = broadcast(w + (f * KERNEL + y) * KERNEL + x);
+                        sums[0][f] = multiplyAdd(v0, weight, sums[0][f]);
+                        sums[1][f] = multiplyAdd(v1, weight, sums[1][f]);
+                    }
+                }
+            }
+
+            for (std::size_t f = 0; f < FILTERS_0; ++f)
+            {
+                store(out + (f * SIZE_0 + r) * SIZE_0 + c, sums[0][f]);
+                store(out + (f * SIZE_0 + r + 1) * SIZE_0 + c, sums[1][f]);
+            }
+        }
+    }
+#else
+    for (std::size_t r = 0; r < SIZE_0; ++r)
+    {
+        for (std::size_t f = 0; f < FILTERS_0; ++f)
+        {
+            float* row = out + (f * SIZE_0 + r) * SIZE_0;
+            std::fill(row, row + SIZE_0, b[f]);
+
+            for (std::size_t y = 0; y < KERNEL; ++y)
+            {
+                for (std::size_t x = 0; x < KERNEL; ++x)
+                {
+                    const float weight = w[(f * KERNEL + y) * KERNEL + x];
+                    const float* inRow = in + (r + y) * PADDED_0 + x;
+
+                    for (std::size_t c = 0; c < SIZE_0; ++c)
+                        row[c] += weight * inRow[c];
+                }
+            }
+        }
+    }
+#endif
+}
+
+
+/// \brief A 5x5 convolution with padding 2 of a channels last image.
+/// \tparam SIZE The number of output rows and columns.
+/// \tparam CHANNELS The number of input channels.
+/// \tparam N The padded number of filters.
+/// \tparam P The number of adjacent output pixels computed at once. When
+///         SIZE isn't a multiple of P the last block of a row overlaps the
+///         one before it.
+/// \param in The padded input, (SIZE + 4) x (SIZE + 4) x CHANNELS.
+/// \param w The weights, 5 x 5 x CHANNELS x N.
+/// \param b The biases, N.
+/// \param out The output, SIZE x SIZE x N.
+template <std::size_t SIZE, std::size_t CHANNELS, std::size_t N, std::size_t P>
+inline void convolve(const float* in, const float* w, const float* b, float* out)
+{
+    static_assert(SIZE >= P, "SIZE must be at least P.");
+
+    const std::size_t stride = SIZE + 2 * PADDING;
+
+    // The 5 pixels of one kernel row are adjacent in memory, so each row is
+    // a single run of 5 x CHANNELS taps.
+    const std::size_t taps = KERNEL * CHANNELS;
+
+    for (std::size_t r = 0; r < SIZE; ++r)
+    {
+        for (std::size_t block = 0; block < SIZE; block += P)
+        {
+            const std::size_t c = std::min(block, SIZE - P);
+            float* pixels = out + (r * SIZE + c) * N;
+
+            for (std::size_t p = 0; p < P; ++p)
+                std::copy(b, b + N, pixels + p * N);
+
+            for (std::size_t y = 0; y < KERNEL; ++y)
+            {
+                multiplyAccumulate<N, P>(in + ((r + y) * stride + c) * CHANNELS,
+                                         CHANNELS,
+                                         w + y * taps * N,
+                                         taps,
+                                         pixels);
+            }
+        }
+    }
+}
+
+
+/// \brief A relu followed by a 2x2 max pool with stride 2.
+/// \tparam SIZE The number of input rows and columns.
+/// \tparam CHANNELS The number of channels to keep.
+/// \tparam N The padded number of input channels.
+/// \param in The input, SIZE x SIZE x N.
+/// \param out The output, with rows \p stride channels apart.
+/// \param stride The output row stride in channels.
+template <std::size_t SIZE, std::size_t CHANNELS, std::size_t N>
+inline void reluPool(const float* in, float* out, std::size_t stride)
+{
+    for (std::size_t r = 0; r < SIZE / 2; ++r)
+    {
+        for (std::size_t c = 0; c < SIZE / 2; ++c)
+        {
+            const float* p = in + (2 * r * SIZE + 2 * c) * N;
+            float* q = out + (r * stride + c) * CHANNELS;
+
+            // max(relu(x)) == relu(max(x)).
+            for (std::size_t k = 0; k < CHANNELS; ++k)
+            {
+                q[k] = std::max(std::max(std::max(p[k], p[N + k]),
+                                         std::max(p[SIZE * N + k], p[(SIZE + 1) * N + k])),
+                                0.0f);
+            }
+        }
+    }
+}
+
+
+/// \brief A relu followed by a 2x2 max pool with stride 2 of a channels
+///        first image.
+/// \tparam SIZE The number of input rows and columns.
+/// \tparam CHANNELS The number of channels.
+/// \param in The input, CHANNELS x SIZE x SIZE.
+/// \param out The output, channels last, with rows \p stride pixels apart.
+/// \param stride The output row stride in pixels.
+template <std::size_t SIZE, std::size_t CHANNELS>
+inline void reluPoolPlanes(const float* in, float* out, std::size_t stride)
+{
+    // Pool each plane first, where the rows are contiguous, then interleave.
+    float pooled[CHANNELS][SIZE / 2][SIZE / 2];
+
+    for (std::size_t k = 0; k < CHANNELS; ++k)
+    {
+        for (std::size_t r = 0; r < SIZE / 2; ++r, in += 2 * SIZE)
+        {
+            float rows[SIZE];
+
+            for (std::size_t c = 0; c < SIZE; ++c)
+                rows[c] = std::max(std::max(in[c], in[SIZE + c]), 0.0f);
+
+            for (std::size_t c = 0; c < SIZE / 2; ++c)
+                pooled[k][r][c] = std::max(rows[2 * c], rows[2 * c + 1]);
+        }
+    }
+
+    for (std::size_t r = 0; r < SIZE / 2; ++r)
+        for (std::size_t c = 0; c < SIZE / 2; ++c)
+            for (std::size_t k = 0; k < CHANNELS; ++k)
+                out[(r * stride + c) * CHANNELS + k] = pooled[k][r][c];
+}
+
+
+template <std::size_t N>
+inline void relu(float* data)
+{
+    for (std::size_t i = 0; i < N; ++i)
+        data[i] = std::max(data[i], 0.0f);
+}
+
+
+void checkImage(const dlib::matrix<unsigned char>& image)
+{
+    if (image.nr() != InferenceKernel::INPUT_SIZE || image.nc() != InferenceKernel::INPUT_SIZE)
+        throw std::invalid_argument("LeNet5::InferenceKernel: the image must be 28x28.");
+}
+
+
+void checkSize(const dlib::tensor& t, std::size_t size, std::size_t layer)
+{
+    if (t.size() != size)
+    {
+        throw std::invalid_argument("LeNet5::InferenceKernel: layer " + std::to_string(layer)
+                                    + " has " + std::to_string(t.size())
+                                    + " parameters, expected " + std::to_string(size) + ".");
+    }
+}
+
+
+} // namespace
+
+
+struct InferenceKernel::Weights
+{
+    float con0[FILTERS_0 * KERNEL * KERNEL] = { };
+    float con0Bias[FILTERS_0] = { };
+    float con1[KERNEL * KERNEL * FILTERS_0 * CHANNELS_1] = { };
+    float con1Bias[CHANNELS_1] = { };
+    float fc0[FEATURES * CHANNELS_2] = { };
+    float fc0Bias[CHANNELS_2] = { };
+    float fc1[OUTPUTS_0 * CHANNELS_3] = { };
+    float fc1Bias[CHANNELS_3] = { };
+    float fc2[OUTPUTS_1 * CHANNELS_4] = { };
+    float fc2Bias[CHANNELS_4] = { };
+};
+
+
+InferenceKernel::InferenceKernel()
+{
+}
+
+
+InferenceKernel::~InferenceKernel()
+{
+}
+
+
+void InferenceKernel::_load(const std::vector<const dlib::tensor*>& parameters)
+{
+    // fc 10, relu, fc 84, relu, fc 120, max_pool, relu, con 16, max_pool, relu, con 6.
+    const std::size_t sizes[] = {
+        (OUTPUTS_1 + 1) * OUTPUTS_2, 0,
+        (OUTPUTS_0 + 1) * OUTPUTS_1, 0,
+        (FEATURES + 1) * OUTPUTS_0, 0, 0,
+        FILTERS_1 * FILTERS_0 * KERNEL * KERNEL + FILTERS_1, 0, 0,
+        FILTERS_0 * KERNEL * KERNEL + FILTERS_0
+    };
+
+    const std::size_t numLayers = sizeof(sizes) / sizeof(sizes[0]);
+
+    if (parameters.size() != numLayers)
+    {
+        throw std::invalid_argument("LeNet5::InferenceKernel: the network has " + std::to_string(parameters.size())
+                                    + " layers, expected " + std::to_string(numLayers) + ".");
+    }
+
+    for (std::size_t i = 0; i < numLayers; ++i)
+        checkSize(*parameters[i], sizes[i], i);
+
+    std::unique_ptr<Weights> weights(new Weights());
+
+    // dlib::con stores filters as [filter][channel][row][column] followed by
+    // the biases. The first layer has one channel and keeps that order. The
+    // second becomes [row][column][channel][filter].
+    const float* p = parameters[10]->host();
+
+    std::copy(p, p + FILTERS_0 * KERNEL * KERNEL, weights->con0);
+    std::copy(p + FILTERS_0 * KERNEL * KERNEL, p + FILTERS_0 * (KERNEL * KERNEL + 1), weights->con0Bias);
+
+    p = parameters[7]->host();
+
+    for (std::size_t f = 0; f < FILTERS_1; ++f)
+    {
+        for (std::size_t k = 0; k < FILTERS_0; ++k)
+            for (std::size_t i = 0; i < KERNEL * KERNEL; ++i)
+                weights->con1[(i * FILTERS_0 + k) * CHANNELS_1 + f] = p[(f * FILTERS_0 + k) * KERNEL * KERNEL + i];
+
+        weights->con1Bias[f] = p[FILTERS_1 * FILTERS_0 * KERNEL * KERNEL + f];
+    }
+
+    // dlib::fc stores an [input][output] matrix with the biases as the last
+    // row. The inputs of the first one are reordered from channels first to
+    // the channels last order of the pooled activations.
+    p = parameters[4]->host();
+
+    for (std::size_t k = 0; k < FILTERS_1; ++k)
+    {
+        for (std::size_t i = 0; i < SIZE_2 * SIZE_2; ++i)
+        {
+            const float* row = p + (k * SIZE_2 * SIZE_2 + i) * OUTPUTS_0;
+            std::copy(row, row + OUTPUTS_0, weights->fc0 + (i * FILTERS_1 + k) * CHANNELS_2);
+        }
+    }
+
+    std::copy(p + FEATURES * OUTPUTS_0, p + (FEATURES + 1) * OUTPUTS_0, weights->fc0Bias);
+
+    p = parameters[2]->host();
+
+    for (std::size_t i = 0; i <= OUTPUTS_0; ++i)
+    {
+        float* row = i < OUTPUTS_0 ? weights->fc1 + i * CHANNELS_3 : weights->fc1Bias;
+        std::copy(p + i * OUTPUTS_1, p + (i + 1) * OUTPUTS_1, row);
+    }
+
+    p = parameters[0]->host();
+
+    for (std::size_t i = 0; i <= OUTPUTS_1; ++i)
+    {
+        float* row = i < OUTPUTS_1 ? weights->fc2 + i * CHANNELS_4 : weights->fc2Bias;
+        std::copy(p + i * OUTPUTS_2, p + (i + 1) * OUTPUTS_2, row);
+    }
+
+    _weights = std::move(weights);
+}
+
+
+void InferenceKernel::_features(const unsigned char* pixels, float* features) const
+{
+    const Weights& w = *_weights;
+
+    // dlib::input<matrix<unsigned char>> doesn't rescale pixel values.
+    alignas(64) float input[PADDED_0 * PADDED_0] = { };
+
+    for (std::size_t r = 0; r < SIZE_0; ++r)
+        for (std::size_t c = 0; c < SIZE_0; ++c)
+            input[(r + PADDING) * PADDED_0 + c + PADDING] = pixels[r * SIZE_0 + c];
+
+    alignas(64) float con0[FILTERS_0 * SIZE_0 * SIZE_0];
+    convolveInput(input, w.con0, w.con0Bias, con0);
+
+    alignas(64) float pool0[PADDED_1 * PADDED_1 * FILTERS_0] = { };
+    reluPoolPlanes<SIZE_0, FILTERS_0>(con0, pool0 + (PADDING * PADDED_1 + PADDING) * FILTERS_0, PADDED_1);
+
+    alignas(64) float con1[SIZE_1 * SIZE_1 * CHANNELS_1];
+    convolve<SIZE_1, FILTERS_0, CHANNELS_1, CONVOLUTION_PIXELS>(pool0, w.con1, w.con1Bias, con1);
+
+    reluPool<SIZE_1, FILTERS_1, CHANNELS_1>(con1, features, SIZE_2);
+}
+
+
+unsigned long InferenceKernel::_output(float* fc0, float* scores) const
+{
+    const Weights& w = *_weights;
+
+    relu<CHANNELS_2>(fc0);
+
+    alignas(64) float fc1[CHANNELS_3];
+    std::copy(w.fc1Bias, w.fc1Bias + CHANNELS_3, fc1);
+    multiplyAccumulate<CHANNELS_3, 1>(fc0, 0, w.fc1, OUTPUTS_0, fc1);
+    relu<CHANNELS_3>(fc1);
+
+    alignas(64) float fc2[CHANNELS_4];
+    std::copy(w.fc2Bias, w.fc2Bias + CHANNELS_4, fc2);
+    multiplyAccumulate<CHANNELS_4, 1>(fc1, 0, w.fc2, OUTPUTS_1, fc2);
+
+    if (scores)
+        std::copy(fc2, fc2 + OUTPUTS_2, scores);
+
+    // The first index wins ties, as in loss_multiclass_log.
+    return std::max_element(fc2, fc2 + OUTPUTS_2) - fc2;
+}
+
+
+unsigned long InferenceKernel::classify(const unsigned char* pixels, float* scores) const
+{
+    if (!_weights)
+        throw std::runtime_error("LeNet5::InferenceKernel: no network loaded.");
+
+    const Weights& w = *_weights;
+
+    alignas(64) float features[FEATURES];
+    _features(pixels, features);
+
+    alignas(64) float fc0[CHANNELS_2];
+    std::copy(w.fc0Bias, w.fc0Bias + CHANNELS_2, fc0);
+    multiplyAccumulate<CHANNELS_2, 1>(features, 0, w.fc0, FEATURES, fc0);
+
+    return _output(fc0, scores);
+}
+
+
+unsigned long InferenceKernel::operator () (const dlib::matrix<unsigned char>& image) const
+{
+    checkImage(image);
+    return classify(&image(0, 0));
+}
+
+
+std::vector<unsigned long> InferenceKernel::operator () (const std::vector<dlib::matrix<unsigned char>>& images) const
+{
+    if (!_weights)
+        throw std::runtime_error("LeNet5::InferenceKernel: no network loaded.");
+
+    for (auto& image: images)
+        checkImage(image);
+
+    const Weights& w = *_weights;
+
+    std::vector<unsigned long> labels(images.size());
+
+    // The first fully connected layer holds most of the weights, which
+    // don't fit in the L1 or L2 cache. It runs on BATCH digits at once, so
+    // each weight is read once per batch instead of once per digit.
+    std::unique_ptr<float[]> features(new float[BATCH * FEATURES]);
+    std::unique_ptr<float[]> fc0(new float[BATCH * CHANNELS_2]);
+
+    std::size_t first = 0;
+
+    for (; first + BATCH <= images.size(); first += BATCH)
+    {
+        for (std::size_t b = 0; b < BATCH; ++b)
+        {
+            _features(&images[first + b](0, 0), features.get() + b * FEATURES);
+            std::copy(w.fc0Bias, w.fc0Bias + CHANNELS_2, fc0.get() + b * CHANNELS_2);
+        }
+
+        for (std::size_t n = 0; n < CHANNELS_2; n += LANES)
+        {
+            multiplyAccumulate<LANES, BATCH>(features.get(), FEATURES,
+                                             w.fc0 + n, FEATURES,
+                                             fc0.get() + n,
+                                             CHANNELS_2, CHANNELS_2);
+        }
+
+        for (std::size_t b = 0; b < BATCH; ++b)
+            labels[first + b] = _output(fc0.get() + b * CHANNELS_2, nullptr);
+    }
+
+    for (; first < images.size(); ++first)
+        labels[first] = classify(&images[first](0, 0));
+
+    return labels;
+}
+
+
+} } } // namespace ofx::Dlib::LeNet5
@@ -0,0 +1,214 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Network/Profiler.h"
+#include <iomanip>
+#include "ofFileUtils.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+namespace {
+
+
+std::string escapeJson(const std::string& text)
+{
+    std::string result;
+
+    for (char c: text)
+    {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        result += c;
+    }
+
+    return result;
+}
+
+
+std::string shapeString(const LayerProfile& layer)
+{
+    std::ostringstream ss;
+    ss << layer.numSamples << "x" << layer.k << "x" << layer.nr << "x" << layer.nc;
+    return ss.str();
+}
+
+
+} // namespace
+
+
+std::string LayerProfile::name() const
+{
+    std::ostringstream ss;
+    ss << index << " " << type;
+
+    if (tag != 0)
+        ss << " (tag " << tag << ")";
+
+    return ss.str();
+}
+
+
+double NetworkProfile::layerMs() const
+{
+    double result = 0;
+    for (auto& layer: layers)
+        result += layer.meanMs;
+    return result;
+}
+
+
+std::string NetworkProfile::toString() const
+{
+    std::vector<LayerProfile> sorted = layers;
+
+    std::stable_sort(sorted.begin(), sorted.end(), [](const LayerProfile& a, const LayerProfile& b) {
+        return a.meanMs > b.meanMs;
+    });
+
+    const double sum = layerMs();
+
+    std::ostringstream ss;
+    ss << std::fixed;
+    ss << "Forward pass: " << std::setprecision(3) << totalMs << " ms";
+    ss << " (" << layers.size() << " layers, " << numSamples << " samples, ";
+    ss << iterations << " iterations, layer sum " << sum << " ms)" << std::endl;
+
+    ss << std::left;
+    ss << std::setw(28) << "layer";
+    ss << std::setw(20) << "output";
+    ss << std::right;
+    ss << std::setw(12) << "mean ms";
+    ss << std::setw(12) << "min ms";
+    ss << std::setw(9) << "%";
+    ss << std::setw(12) << "MB moved";
+    ss << std::setw(10) << "GB/s" << std::endl;
+
+    for (auto& layer: sorted)
+    {
+        double megabytes = layer.bytesMoved() / (1024.0 * 1024.0);
+        double bandwidth = layer.meanMs > 0 ? layer.bytesMoved() / (layer.meanMs * 1e6) : 0;
+
+        ss << std::left;
+        ss << std::setw(28) << layer.name();
+        ss << std::setw(20) << shapeString(layer);
+        ss << std::right;
+        ss << std::setw(12) << std::setprecision(4) << layer.meanMs;
+        ss << std::setw(12) << std::setprecision(4) << layer.minMs;
+        ss << std::setw(9) << std::setprecision(1) << (sum > 0 ? 100.0 * layer.meanMs / sum : 0);
+        ss << std::setw(12) << std::setprecision(2) << megabytes;
+        ss << std::setw(10) << std::setprecision(2) << bandwidth << std::endl;
+    }
+
+    return ss.str();
+}
+
+
+std::string NetworkProfile::toChromeTrace() const
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    ss << "{\"traceEvents\":[";
+
+    double timestamp = 0;
+
+    for (std::size_t i = 0; i < layers.size(); ++i)
+    {
+        const LayerProfile& layer = layers[i];
+        const double duration = layer.meanMs * 1000;
+
+        if (i > 0)
+            ss << ",";
+
+        ss << "\n{\"name\":\"" << escapeJson(layer.name()) << "\"";
+        ss << ",\"cat\":\"" << escapeJson(layer.type) << "\"";
+        ss << ",\"ph\":\"X\",\"pid\":0,\"tid\":0";
+        ss << ",\"ts\":" << timestamp;
+        ss << ",\"dur\":" << duration;
+        ss << ",\"args\":{";
+        ss << "\"description\":\"" << escapeJson(layer.description) << "\"";
+        ss << ",\"output\":\"" << shapeString(layer) << "\"";
+        ss << ",\"inPlace\":" << (layer.inPlace ? "true" : "false");
+        ss << ",\"minMs\":" << layer.minMs;
+        ss << ",\"inputBytes\":" << layer.inputBytes;
+        ss << ",\"outputBytes\":" << layer.outputBytes;
+        ss << ",\"parameterBytes\":" << layer.parameterBytes;
+        ss << "}}";
+
+        timestamp += duration;
+    }
+
+    ss << "\n],\"displayTimeUnit\":\"ms\"";
+    ss << ",\"otherData\":{";
+    ss << "\"totalMs\":" << totalMs;
+    ss << ",\"numSamples\":" << numSamples;
+    ss << ",\"iterations\":" << iterations;
+    ss << "}}\n";
+
+    return ss.str();
+}
+
+
+bool NetworkProfile::saveChromeTrace(const std::string& path) const
+{
+    ofBuffer buffer(toChromeTrace());
+    return ofBufferToFile(path, buffer);
+}
+
+
+std::string NetworkProfile::compare(const NetworkProfile& baseline,
+                                    const NetworkProfile& current,
+                                    double threshold)
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(3);
+
+    ss << "Forward pass: " << baseline.totalMs << " ms -> " << current.totalMs << " ms";
+
+    if (baseline.totalMs > 0)
+        ss << " (" << std::showpos << 100.0 * (current.totalMs / baseline.totalMs - 1.0) << std::noshowpos << "%)";
+
+    ss << std::endl;
+
+    if (baseline.layers.size() != current.layers.size())
+    {
+        ss << "The networks have a different number of layers (";
+        ss << baseline.layers.size() << " vs. " << current.layers.size() << ")." << std::endl;
+    }
+
+    std::size_t count = std::min(baseline.layers.size(), current.layers.size());
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const LayerProfile& before = baseline.layers[i];
+        const LayerProfile& after = current.layers[i];
+
+        double change = before.meanMs > 0 ? after.meanMs / before.meanMs - 1.0 : 0;
+
+        ss << std::left << std::setw(28) << after.name();
+        ss << std::right;
+        ss << std::setw(12) << before.meanMs << " -> ";
+        ss << std::setw(12) << after.meanMs;
+        ss << std::setw(10) << std::setprecision(1) << std::showpos << 100.0 * change << "%" << std::noshowpos;
+        ss << std::setprecision(3);
+
+        if (before.type != after.type)
+            ss << "  (was " << before.type << ")";
+
+        if (change > threshold)
+            ss << "  REGRESSION";
+
+        ss << std::endl;
+    }
+
+    return ss.str();
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,703 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Network/Quantization.h"
+#include <limits>
+#include <map>
+#include <thread>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+namespace ofx {
+namespace Dlib {
+
+
+namespace {
+
+
+/// \brief Quantized rows are padded to a multiple of one AVX2 register.
+const std::size_t QUANTIZED_ALIGNMENT = 32;
+
+/// \brief The number of output positions computed per task.
+const long POSITIONS_PER_BLOCK = 32;
+
+
+/// \brief A float NCHW activation tensor.
+struct Blob
+{
+    long n = 0;
+    long k = 0;
+    long nr = 0;
+    long nc = 0;
+    std::vector<float> data;
+
+    void setSize(long _n, long _k, long _nr, long _nc)
+    {
+        n = _n;
+        k = _k;
+        nr = _nr;
+        nc = _nc;
+        data.assign(std::size_t(n * k * nr * nc), 0);
+    }
+
+    long sampleSize() const
+    {
+        return k * nr * nc;
+    }
+};
+
+
+std::size_t alignedSize(std::size_t size)
+{
+    return (size + QUANTIZED_ALIGNMENT - 1) / QUANTIZED_ALIGNMENT * QUANTIZED_ALIGNMENT;
+}
+
+
+float absMax(const float* data, std::size_t size)
+{
+    float result = 0;
+    for (std::size_t i = 0; i < size; ++i)
+        result = std::max(result, std::abs(data[i]));
+    return result;
+}
+
+
+/// \brief Symmetric quantization to [-127, 127].
+///
+/// -128 is never produced so the sign trick used by the AVX2 kernels can't
+/// overflow.
+inline int8_t quantizeValue(float value, float inverseScale)
+{
+    float q = std::round(value * inverseScale);
+    return int8_t(std::min(127.0f, std::max(-127.0f, q)));
+}
+
+
+#if defined(__AVX2__)
+
+inline int32_t horizontalSum(__m256i v)
+{
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+
+/// \brief Multiply |a| (u8) with b * sign(a) (s8) and accumulate into int32 lanes.
+inline __m256i multiplyAccumulate(__m256i acc, __m256i absA, __m256i signedB)
+{
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+    return _mm256_dpbusd_epi32(acc, absA, signedB);
+#else
+    const __m256i ones = _mm256_set1_epi16(1);
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(absA, signedB), ones));
+#endif
+}
+
+#endif
+
+
+/// \brief Compute four int8 dot products that share the left operand.
+/// \param a The shared operand, size is a multiple of QUANTIZED_ALIGNMENT.
+/// \param b The first of four rows spaced \p stride apart.
+/// \param stride The row stride of b.
+/// \param result The four dot products.
+inline void dot4(const int8_t* a, const int8_t* b, std::size_t stride, int32_t* result)
+{
+#if defined(__AVX2__)
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256();
+    __m256i acc3 = _mm256_setzero_si256();
+
+    for (std::size_t i = 0; i < stride; i += QUANTIZED_ALIGNMENT)
+    {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i absA = _mm256_sign_epi8(va, va);
+        acc0 = multiplyAccumulate(acc0, absA, _mm256_sign_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)), va));
+        acc1 = multiplyAccumulate(acc1, absA, _mm256_sign_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + stride + i)), va));
+        acc2 = multiplyAccumulate(acc2, absA, _mm256_sign_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 2 * stride + i)), va));
+        acc3 = multiplyAccumulate(acc3, absA, _mm256_sign_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + 3 * stride + i)), va));
+    }
+
+    result[0] = horizontalSum(acc0);
+    result[1] = horizontalSum(acc1);
+    result[2] = horizontalSum(acc2);
+    result[3] = horizontalSum(acc3);
+#else
+    int32_t acc[4] = { 0, 0, 0, 0 };
+
+    for (std::size_t i = 0; i < stride; ++i)
+    {
+        int32_t v = a[i];
+        acc[0] += v * b[i];
+        acc[1] += v * b[stride + i];
+        acc[2] += v * b[2 * stride + i];
+        acc[3] += v * b[3 * stride + i];
+    }
+
+    std::copy(acc, acc + 4, result);
+#endif
+}
+
+
+/// \brief Compute a single int8 dot product.
+inline int32_t dot(const int8_t* a, const int8_t* b, std::size_t size)
+{
+#if defined(__AVX2__)
+    __m256i acc = _mm256_setzero_si256();
+
+    for (std::size_t i = 0; i < size; i += QUANTIZED_ALIGNMENT)
+    {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        acc = multiplyAccumulate(acc, _mm256_sign_epi8(va, va), _mm256_sign_epi8(vb, va));
+    }
+
+    return horizontalSum(acc);
+#else
+    int32_t acc = 0;
+    for (std::size_t i = 0; i < size; ++i)
+        acc += int32_t(a[i]) * int32_t(b[i]);
+    return acc;
+#endif
+}
+
+
+inline float dot(const float* a, const float* b, std::size_t size)
+{
+    float acc = 0;
+    for (std::size_t i = 0; i < size; ++i)
+        acc += a[i] * b[i];
+    return acc;
+}
+
+
+/// \brief Copy the receptive field of one output position into a row.
+template <typename T, typename Convert>
+void im2row(const Blob& in,
+            long n,
+            long oy,
+            long ox,
+            const QuantizedNetwork::Layer& layer,
+            T* row,
+            Convert convert)
+{
+    const float* sample = in.data.data() + n * in.sampleSize();
+    const long y0 = oy * layer.strideY - layer.paddingY;
+    const long x0 = ox * layer.strideX - layer.paddingX;
+
+    for (long c = 0; c < in.k; ++c)
+    {
+        const float* plane = sample + c * in.nr * in.nc;
+
+        for (long ky = 0; ky < layer.nr; ++ky)
+        {
+            const long y = y0 + ky;
+
+            for (long kx = 0; kx < layer.nc; ++kx)
+            {
+                const long x = x0 + kx;
+                bool inside = y >= 0 && y < in.nr && x >= 0 && x < in.nc;
+                *row++ = inside ? convert(plane[y * in.nc + x]) : T(0);
+            }
+        }
+    }
+}
+
+
+float outputValue(float value, bool relu)
+{
+    return relu ? std::max(0.0f, value) : value;
+}
+
+
+void convolution(const Blob& in,
+                 Blob& out,
+                 const QuantizedNetwork::Layer& layer,
+                 QuantizedNetwork::Precision precision,
+                 const std::vector<float>& inputScales,
+                 dlib::thread_pool& threadPool)
+{
+    if (in.k != layer.numInputs)
+        throw std::invalid_argument("QuantizedNetwork: convolution input has the wrong number of channels.");
+
+    const long outNr = 1 + (in.nr + 2 * layer.paddingY - layer.nr) / layer.strideY;
+    const long outNc = 1 + (in.nc + 2 * layer.paddingX - layer.nc) / layer.strideX;
+    const long positions = outNr * outNc;
+    const long blocks = (positions + POSITIONS_PER_BLOCK - 1) / POSITIONS_PER_BLOCK;
+    const std::size_t rowSize = layer.rowSize();
+    const std::size_t stride = layer.quantizedStride;
+    const long numOutputs = layer.numOutputs;
+    const long numOutputs4 = numOutputs / 4 * 4;
+
+    out.setSize(in.n, numOutputs, outNr, outNc);
+
+    for (long n = 0; n < in.n; ++n)
+    {
+        float* output = out.data.data() + n * out.sampleSize();
+        const float inputScale = inputScales[n];
+        const float inverseScale = 1.0f / inputScale;
+
+        dlib::parallel_for(threadPool, 0, blocks, [&](long block) {
+            const long begin = block * POSITIONS_PER_BLOCK;
+            const long end = std::min(positions, begin + POSITIONS_PER_BLOCK);
+
+            if (precision == QuantizedNetwork::PRECISION_INT8)
+            {
+                std::vector<int8_t> rows(std::size_t(end - begin) * stride, 0);
+
+                for (long p = begin; p < end; ++p)
+                {
+                    im2row(in, n, p / outNc, p % outNc, layer, &rows[(p - begin) * stride], [&](float v) {
+                        return quantizeValue(v, inverseScale);
+                    });
+                }
+
+                for (long p = begin; p < end; ++p)
+                {
+                    const int8_t* row = &rows[(p - begin) * stride];
+                    int32_t acc[4];
+                    long o = 0;
+
+                    for (; o < numOutputs4; o += 4)
+                    {
+                        dot4(row, &layer.quantizedWeights[o * stride], stride, acc);
+
+                        for (long i = 0; i < 4; ++i)
+                        {
+                            float value = acc[i] * inputScale * layer.quantizedScales[o + i] + layer.biases[o + i];
+                            output[(o + i) * positions + p] = outputValue(value, layer.relu);
+                        }
+                    }
+
+                    for (; o < numOutputs; ++o)
+                    {
+                        float value = dot(row, &layer.quantizedWeights[o * stride], stride) * inputScale * layer.quantizedScales[o] + layer.biases[o];
+                        output[o * positions + p] = outputValue(value, layer.relu);
+                    }
+                }
+            }
+            else
+            {
+                std::vector<float> row(rowSize);
+
+                for (long p = begin; p < end; ++p)
+                {
+                    im2row(in, n, p / outNc, p % outNc, layer, row.data(), [](float v) {
+                        return v;
+                    });
+
+                    for (long o = 0; o < numOutputs; ++o)
+                    {
+                        float value = dot(row.data(), &layer.weights[o * rowSize], rowSize) + layer.biases[o];
+                        output[o * positions + p] = outputValue(value, layer.relu);
+                    }
+                }
+            }
+        });
+    }
+}
+
+
+void fullyConnected(const Blob& in,
+                    Blob& out,
+                    const QuantizedNetwork::Layer& layer,
+                    QuantizedNetwork::Precision precision,
+                    const std::vector<float>& inputScales,
+                    dlib::thread_pool& threadPool)
+{
+    if (in.sampleSize() != layer.numInputs)
+        throw std::invalid_argument("QuantizedNetwork: fully connected input has the wrong size.");
+
+    const std::size_t stride = layer.quantizedStride;
+
+    out.setSize(in.n, layer.numOutputs, 1, 1);
+
+    std::vector<int8_t> rows;
+
+    if (precision == QuantizedNetwork::PRECISION_INT8)
+    {
+        rows.assign(std::size_t(in.n) * stride, 0);
+
+        for (long n = 0; n < in.n; ++n)
+        {
+            const float inverseScale = 1.0f / inputScales[n];
+
+            for (long i = 0; i < layer.numInputs; ++i)
+                rows[n * stride + i] = quantizeValue(in.data[n * layer.numInputs + i], inverseScale);
+        }
+    }
+
+    dlib::parallel_for(threadPool, 0, layer.numOutputs, [&](long o) {
+        for (long n = 0; n < in.n; ++n)
+        {
+            float value = 0;
+
+            if (precision == QuantizedNetwork::PRECISION_INT8)
+                value = dot(&rows[n * stride], &layer.quantizedWeights[o * stride], stride) * inputScales[n] * layer.quantizedScales[o];
+            else
+                value = dot(&in.data[n * layer.numInputs], &layer.weights[o * layer.numInputs], layer.numInputs);
+
+            out.data[n * layer.numOutputs + o] = outputValue(value + layer.biases[o], layer.relu);
+        }
+    });
+}
+
+
+void affine(Blob& blob, const QuantizedNetwork::Layer& layer)
+{
+    if (std::size_t(blob.k) != layer.scales.size())
+        throw std::invalid_argument("QuantizedNetwork: affine input has the wrong number of channels.");
+
+    const long planeSize = blob.nr * blob.nc;
+
+    for (long n = 0; n < blob.n; ++n)
+    {
+        for (long k = 0; k < blob.k; ++k)
+        {
+            float* plane = blob.data.data() + (n * blob.k + k) * planeSize;
+
+            for (long i = 0; i < planeSize; ++i)
+                plane[i] = outputValue(plane[i] * layer.scales[k] + layer.biases[k], layer.relu);
+        }
+    }
+}
+
+
+void relu(Blob& blob)
+{
+    for (auto& value: blob.data)
+        value = std::max(0.0f, value);
+}
+
+
+void pool(const Blob& in, Blob& out, const QuantizedNetwork::Layer& layer)
+{
+    // A window size of 0 means pool over the whole input.
+    const long windowNr = layer.nr == 0 ? in.nr : layer.nr;
+    const long windowNc = layer.nc == 0 ? in.nc : layer.nc;
+    const long outNr = 1 + (in.nr + 2 * layer.paddingY - windowNr) / layer.strideY;
+    const long outNc = 1 + (in.nc + 2 * layer.paddingX - windowNc) / layer.strideX;
+    const bool isMax = layer.type == QuantizedNetwork::Layer::MAX_POOL;
+
+    out.setSize(in.n, in.k, outNr, outNc);
+
+    float* output = out.data.data();
+
+    for (long plane = 0; plane < in.n * in.k; ++plane)
+    {
+        const float* input = in.data.data() + plane * in.nr * in.nc;
+
+        for (long oy = 0; oy < outNr; ++oy)
+        {
+            const long y0 = std::max(0L, oy * layer.strideY - layer.paddingY);
+            const long y1 = std::min(in.nr, oy * layer.strideY - layer.paddingY + windowNr);
+
+            for (long ox = 0; ox < outNc; ++ox)
+            {
+                const long x0 = std::max(0L, ox * layer.strideX - layer.paddingX);
+                const long x1 = std::min(in.nc, ox * layer.strideX - layer.paddingX + windowNc);
+
+                float value = isMax ? -std::numeric_limits<float>::infinity() : 0;
+
+                for (long y = y0; y < y1; ++y)
+                {
+                    for (long x = x0; x < x1; ++x)
+                    {
+                        float v = input[y * in.nc + x];
+                        value = isMax ? std::max(value, v) : value + v;
+                    }
+                }
+
+                long count = (y1 - y0) * (x1 - x0);
+
+                if (!isMax)
+                    value = count > 0 ? value / count : 0;
+
+                *output++ = value;
+            }
+        }
+    }
+}
+
+
+/// \brief Add two tensors, treating missing elements as zero like dlib's add_prev.
+void addPrevious(const Blob& a, const Blob& b, Blob& out, bool applyRelu)
+{
+    out.setSize(std::max(a.n, b.n), std::max(a.k, b.k), std::max(a.nr, b.nr), std::max(a.nc, b.nc));
+
+    for (const Blob* in: { &a, &b })
+    {
+        for (long n = 0; n < in->n; ++n)
+            for (long k = 0; k < in->k; ++k)
+                for (long r = 0; r < in->nr; ++r)
+                {
+                    const float* src = in->data.data() + ((n * in->k + k) * in->nr + r) * in->nc;
+                    float* dst = out.data.data() + ((n * out.k + k) * out.nr + r) * out.nc;
+
+                    for (long c = 0; c < in->nc; ++c)
+                        dst[c] += src[c];
+                }
+    }
+
+    if (applyRelu)
+        relu(out);
+}
+
+
+} // namespace
+
+
+QuantizedNetwork::QuantizedNetwork():
+    _threadPool(std::make_shared<dlib::thread_pool>(std::max(1u, std::thread::hardware_concurrency())))
+{
+}
+
+
+void QuantizedNetwork::calibrate(const dlib::tensor& input)
+{
+    std::vector<float> inputAbsMax(_layers.size(), 0);
+    dlib::resizable_tensor output;
+
+    _forward(input, output, PRECISION_FLOAT32, &inputAbsMax);
+
+    for (std::size_t i = 0; i < _layers.size(); ++i)
+    {
+        Layer& layer = _layers[i];
+
+        if (layer.type == Layer::CONVOLUTION || layer.type == Layer::FULLY_CONNECTED)
+        {
+            // Scales only grow so that every calibration batch is representable.
+            float scale = inputAbsMax[i] > 0 ? inputAbsMax[i] / 127.0f : 0;
+            layer.inputScale = _calibrated ? std::max(layer.inputScale, scale) : scale;
+        }
+    }
+
+    _calibrated = true;
+}
+
+
+void QuantizedNetwork::clearCalibration()
+{
+    for (auto& layer: _layers)
+        layer.inputScale = 0;
+
+    _calibrated = false;
+}
+
+
+void QuantizedNetwork::forward(const dlib::tensor& input,
+                               dlib::resizable_tensor& output,
+                               Precision precision) const
+{
+    _forward(input, output, precision, nullptr);
+}
+
+
+const std::vector<QuantizedNetwork::Layer>& QuantizedNetwork::layers() const
+{
+    return _layers;
+}
+
+
+bool QuantizedNetwork::isCalibrated() const
+{
+    return _calibrated;
+}
+
+
+std::size_t QuantizedNetwork::quantizedWeightBytes() const
+{
+    std::size_t size = 0;
+
+    for (auto& layer: _layers)
+        size += layer.quantizedWeights.size() + layer.quantizedScales.size() * sizeof(float);
+
+    return size;
+}
+
+
+std::size_t QuantizedNetwork::floatWeightBytes() const
+{
+    std::size_t size = 0;
+
+    for (auto& layer: _layers)
+        size += layer.weights.size() * sizeof(float);
+
+    return size;
+}
+
+
+void QuantizedNetwork::_finalize()
+{
+    // The visitor collects layers from the output to the input.
+    std::reverse(_layers.begin(), _layers.end());
+
+    std::vector<Layer> layers;
+
+    for (auto& layer: _layers)
+    {
+        Layer* previous = layers.empty() ? nullptr : &layers.back();
+
+        if (layer.type == Layer::AFFINE
+        &&  previous
+        &&  previous->type == Layer::CONVOLUTION
+        &&  !previous->relu
+        &&  long(layer.scales.size()) == previous->numOutputs)
+        {
+            // conv(x) * gamma + beta == conv'(x) with scaled filters and biases.
+            const std::size_t rowSize = previous->rowSize();
+
+            for (long o = 0; o < previous->numOutputs; ++o)
+            {
+                for (std::size_t i = 0; i < rowSize; ++i)
+                    previous->weights[o * rowSize + i] *= layer.scales[o];
+
+                previous->biases[o] = previous->biases[o] * layer.scales[o] + layer.biases[o];
+            }
+        }
+        else if (layer.type == Layer::RELU
+             &&  previous
+             &&  !previous->relu
+             &&  (previous->type == Layer::CONVOLUTION
+              ||  previous->type == Layer::FULLY_CONNECTED
+              ||  previous->type == Layer::AFFINE
+              ||  previous->type == Layer::ADD_PREV))
+        {
+            previous->relu = true;
+        }
+        else
+        {
+            layers.push_back(layer);
+        }
+    }
+
+    for (auto& layer: layers)
+    {
+        if (layer.type != Layer::CONVOLUTION && layer.type != Layer::FULLY_CONNECTED)
+            continue;
+
+        const std::size_t rowSize = layer.rowSize();
+        layer.quantizedStride = alignedSize(rowSize);
+        layer.quantizedWeights.assign(layer.numOutputs * layer.quantizedStride, 0);
+        layer.quantizedScales.assign(layer.numOutputs, 1);
+
+        for (long o = 0; o < layer.numOutputs; ++o)
+        {
+            const float* row = &layer.weights[o * rowSize];
+            float maximum = absMax(row, rowSize);
+            float scale = maximum > 0 ? maximum / 127.0f : 1.0f;
+
+            for (std::size_t i = 0; i < rowSize; ++i)
+                layer.quantizedWeights[o * layer.quantizedStride + i] = quantizeValue(row[i], 1.0f / scale);
+
+            layer.quantizedScales[o] = scale;
+        }
+    }
+
+    _layers = layers;
+}
+
+
+void QuantizedNetwork::_forward(const dlib::tensor& input,
+                                dlib::resizable_tensor& output,
+                                Precision precision,
+                                std::vector<float>* inputAbsMax) const
+{
+    Blob current;
+    current.setSize(input.num_samples(), input.k(), input.nr(), input.nc());
+    std::copy(input.host(), input.host() + input.size(), current.data.begin());
+
+    Blob next;
+    std::map<unsigned long, Blob> tags;
+    std::vector<float> scales;
+
+    for (std::size_t i = 0; i < _layers.size(); ++i)
+    {
+        const Layer& layer = _layers[i];
+
+        switch (layer.type)
+        {
+            case Layer::CONVOLUTION:
+            case Layer::FULLY_CONNECTED:
+            {
+                // Dynamic scales are found per sample, so a sample's result
+                // doesn't depend on the rest of the batch.
+                scales.assign(current.n, layer.inputScale);
+
+                if (inputAbsMax)
+                    (*inputAbsMax)[i] = 0;
+
+                for (long n = 0; n < current.n && (inputAbsMax || layer.inputScale <= 0); ++n)
+                {
+                    const float maximum = absMax(current.data.data() + n * current.sampleSize(), current.sampleSize());
+
+                    if (inputAbsMax)
+                        (*inputAbsMax)[i] = std::max((*inputAbsMax)[i], maximum);
+
+                    if (layer.inputScale <= 0)
+                        scales[n] = maximum / 127.0f;
+                }
+
+                for (auto& scale: scales)
+                {
+                    if (scale <= 0)
+                        scale = 1;
+                }
+
+                if (layer.type == Layer::CONVOLUTION)
+                    convolution(current, next, layer, precision, scales, *_threadPool);
+                else
+                    fullyConnected(current, next, layer, precision, scales, *_threadPool);
+
+                std::swap(current, next);
+                break;
+            }
+            case Layer::AFFINE:
+                affine(current, layer);
+                break;
+            case Layer::RELU:
+                relu(current);
+                break;
+            case Layer::MAX_POOL:
+            case Layer::AVG_POOL:
+                pool(current, next, layer);
+                std::swap(current, next);
+                break;
+            case Layer::TAG:
+                tags[layer.tag] = current;
+                break;
+            case Layer::SKIP:
+            {
+                auto iter = tags.find(layer.tag);
+                if (iter == tags.end())
+                    throw std::invalid_argument("QuantizedNetwork: skip layer refers to a missing tag.");
+                current = iter->second;
+                break;
+            }
+            case Layer::ADD_PREV:
+            {
+                auto iter = tags.find(layer.tag);
+                if (iter == tags.end())
+                    throw std::invalid_argument("QuantizedNetwork: add_prev layer refers to a missing tag.");
+                addPrevious(current, iter->second, next, layer.relu);
+                std::swap(current, next);
+                break;
+            }
+        }
+    }
+
+    output.set_size(current.n, current.k, current.nr, current.nc);
+    std::copy(current.data.begin(), current.data.end(), output.host());
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,243 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Network/WeightAtlas.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+
+namespace ofx {
+namespace Dlib {
+
+
+namespace {
+
+
+/// \brief Layers with at least this many filters are split across threads.
+const long PARALLEL_FILTERS = 64;
+
+
+void minMax(const float* data, std::size_t size, float& minValue, float& maxValue)
+{
+    float lo = std::numeric_limits<float>::max();
+    float hi = std::numeric_limits<float>::lowest();
+
+    std::size_t i = 0;
+
+#if defined(__AVX__)
+    if (size >= 8)
+    {
+        __m256 vlo = _mm256_loadu_ps(data);
+        __m256 vhi = vlo;
+
+        for (i = 8; i + 8 <= size; i += 8)
+        {
+            __m256 v = _mm256_loadu_ps(data + i);
+            vlo = _mm256_min_ps(vlo, v);
+            vhi = _mm256_max_ps(vhi, v);
+        }
+
+        float los[8];
+        float his[8];
+        _mm256_storeu_ps(los, vlo);
+        _mm256_storeu_ps(his, vhi);
+
+        for (std::size_t j = 0; j < 8; ++j)
+        {
+            lo = std::min(lo, los[j]);
+            hi = std::max(hi, his[j]);
+        }
+    }
+#endif
+
+    for (; i < size; ++i)
+    {
+        lo = std::min(lo, data[i]);
+        hi = std::max(hi, data[i]);
+    }
+
+    minValue = lo;
+    maxValue = hi;
+}
+
+
+/// \brief out[i] = (in[i] - offset) * scale.
+void mapRange(const float* in, std::size_t size, float offset, float scale, float* out)
+{
+    std::size_t i = 0;
+
+#if defined(__AVX__)
+    const __m256 vOffset = _mm256_set1_ps(offset);
+    const __m256 vScale = _mm256_set1_ps(scale);
+
+    for (; i + 8 <= size; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(in + i), vOffset), vScale));
+#endif
+
+    for (; i < size; ++i)
+        out[i] = (in[i] - offset) * scale;
+}
+
+
+template <typename FUNCTION>
+void forEachFilter(long numFilters, const FUNCTION& function)
+{
+    if (numFilters < PARALLEL_FILTERS)
+    {
+        for (long filter = 0; filter < numFilters; ++filter)
+            function(filter);
+    }
+    else
+    {
+        dlib::parallel_for(std::max(1u, std::thread::hardware_concurrency()), 0, numFilters, function);
+    }
+}
+
+
+} // namespace
+
+
+WeightAtlas::WeightAtlas(): WeightAtlas(Settings())
+{
+}
+
+
+WeightAtlas::WeightAtlas(const Settings& settings):
+    _settings(settings)
+{
+}
+
+
+void WeightAtlas::build(const dlib::tensor& parameters,
+                        long numFilters,
+                        long numChannels,
+                        long nr,
+                        long nc)
+{
+    if (numFilters <= 0 || numChannels <= 0 || nr <= 0 || nc <= 0)
+        throw std::invalid_argument("WeightAtlas: Invalid filter shape.");
+
+    const std::size_t k = std::size_t(numChannels);
+    const std::size_t planeSize = std::size_t(nr * nc);
+    const std::size_t size = parameters.size();
+    const std::size_t filterSize = k * planeSize;
+    const std::size_t numWeights = std::size_t(numFilters) * filterSize;
+
+    if (size != numWeights && size != numWeights + std::size_t(numFilters))
+    {
+        throw std::invalid_argument("WeightAtlas: " + std::to_string(size)
+                                    + " parameters don't match "
+                                    + std::to_string(numFilters) + " filters of "
+                                    + std::to_string(k) + "x"
+                                    + std::to_string(nr) + "x" + std::to_string(nc) + ".");
+    }
+
+    const std::size_t n = std::size_t(numFilters) * k;
+    const std::size_t padding = _settings.padding;
+
+    std::size_t columns = _settings.columns;
+
+    if (columns == 0)
+        columns = std::size_t(std::ceil(std::sqrt(double(n))));
+
+    columns = std::min(columns, n);
+
+    const std::size_t rows = (n + columns - 1) / columns;
+    const std::size_t width = padding + columns * (nc + padding);
+    const std::size_t height = padding + rows * (nr + padding);
+
+    // Reallocation only happens when the atlas shape changes.
+    if (_pixels.getWidth() != width
+    ||  _pixels.getHeight() != height
+    ||  _pixels.getPixelFormat() != OF_PIXELS_GRAY)
+    {
+        _pixels.allocate(width, height, OF_PIXELS_GRAY);
+    }
+
+    _pixels.set(0);
+    _tiles.resize(n);
+    _numFilters = std::size_t(numFilters);
+    _numChannels = k;
+
+    const float* weights = parameters.host();
+
+    std::vector<float> minValues(numFilters);
+    std::vector<float> maxValues(numFilters);
+
+    forEachFilter(numFilters, [&](long filter) {
+        minMax(weights + filter * filterSize, filterSize, minValues[filter], maxValues[filter]);
+    });
+
+    if (_settings.normalization == NORMALIZE_GLOBAL)
+    {
+        const float minValue = *std::min_element(minValues.begin(), minValues.end());
+        const float maxValue = *std::max_element(maxValues.begin(), maxValues.end());
+        std::fill(minValues.begin(), minValues.end(), minValue);
+        std::fill(maxValues.begin(), maxValues.end(), maxValue);
+    }
+
+    if (_settings.symmetric)
+    {
+        for (long filter = 0; filter < numFilters; ++filter)
+        {
+            const float limit = std::max(std::abs(minValues[filter]), std::abs(maxValues[filter]));
+            minValues[filter] = -limit;
+            maxValues[filter] = limit;
+        }
+    }
+
+    // Each filter is mapped as one contiguous run and then copied row by row
+    // into its tiles. Filters never share tiles, so threads don't overlap.
+    std::vector<float> mapped(numWeights);
+    float* pixels = _pixels.getData();
+
+    forEachFilter(numFilters, [&](long filter) {
+        const float minValue = minValues[filter];
+        const float maxValue = maxValues[filter];
+        const float scale = maxValue > minValue ? 1.0f / (maxValue - minValue) : 0.0f;
+
+        float* filterValues = mapped.data() + filter * filterSize;
+        mapRange(weights + filter * filterSize, filterSize, minValue, scale, filterValues);
+
+        for (std::size_t channel = 0; channel < k; ++channel)
+        {
+            const std::size_t index = filter * k + channel;
+            const std::size_t x = padding + (index % columns) * (nc + padding);
+            const std::size_t y = padding + (index / columns) * (nr + padding);
+            const float* in = filterValues + channel * planeSize;
+
+            for (long r = 0; r < nr; ++r)
+                std::copy(in + r * nc, in + (r + 1) * nc, pixels + (y + r) * width + x);
+
+            Tile& tile = _tiles[index];
+            tile.filter = std::size_t(filter);
+            tile.channel = channel;
+            tile.rectangle = ofRectangle(x, y, nc, nr);
+            tile.minValue = minValue;
+            tile.maxValue = maxValue;
+        }
+    });
+}
+
+
+const WeightAtlas::Tile& WeightAtlas::tile(std::size_t filter, std::size_t channel) const
+{
+    if (filter >= _numFilters || channel >= _numChannels)
+        throw std::out_of_range("WeightAtlas: Invalid tile index.");
+
+    return _tiles[filter * _numChannels + channel];
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,54 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/PointSet.h"
+#include <array>
+
+
+namespace ofx {
+namespace Dlib {
+
+
+namespace {
+
+
+/// \brief The float value of every 8-bit channel value.
+const std::array<float, 256>& channelTable()
+{
+    static const std::array<float, 256> table = []() {
+        std::array<float, 256> values;
+
+        for (std::size_t i = 0; i < values.size(); ++i)
+            values[i] = float(i) / 255.0f;
+
+        return values;
+    }();
+
+    return table;
+}
+
+
+} // namespace
+
+
+void toOf(const dlib::rgb_pixel* pixels, std::size_t size, ofFloatColor* colors)
+{
+    const float* table = channelTable().data();
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        const dlib::rgb_pixel& pixel = pixels[i];
+        ofFloatColor& color = colors[i];
+        color.r = table[pixel.red];
+        color.g = table[pixel.green];
+        color.b = table[pixel.blue];
+        color.a = 1.0f;
+    }
+}
+
+
+} } // namespace ofx::Dlib
@@ -0,0 +1,421 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Training/Checkpointer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include "ofFileUtils.h"
+#include "ofLog.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+namespace {
+
+
+const std::string MANIFEST_HEADER = "ofxDlib checkpoint 2";
+const std::string MANIFEST_PREFIX = "checkpoint_";
+const std::string MANIFEST_EXTENSION = "txt";
+const std::string TENSOR_EXTENSION = "bin";
+
+
+/// \brief A 64 bit hash of a float buffer.
+///
+/// This mixes eight bytes at a time, which is fast enough to hash large
+/// networks on the writer thread. It only needs to detect changes, not
+/// resist attacks.
+uint64_t hashTensor(const std::vector<float>& values)
+{
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(values.data());
+    const std::size_t size = values.size() * sizeof(float);
+
+    uint64_t hash = 0xcbf29ce484222325ULL ^ (size * 0x9e3779b97f4a7c15ULL);
+
+    std::size_t i = 0;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash ^= word;
+        hash *= 0x100000001b3ULL;
+        hash ^= hash >> 29;
+    }
+
+    for (; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+
+std::string manifestName(uint64_t sequence)
+{
+    std::ostringstream ss;
+    ss << MANIFEST_PREFIX << std::setw(12) << std::setfill('0') << sequence << "." << MANIFEST_EXTENSION;
+    return ss.str();
+}
+
+
+/// \returns the sequence number of a manifest name, or 0 if it has none.
+uint64_t manifestSequence(const std::string& name)
+{
+    if (name.find(MANIFEST_PREFIX) != 0)
+        return 0;
+
+    return std::strtoull(name.c_str() + MANIFEST_PREFIX.size(), nullptr, 10);
+}
+
+
+} // namespace
+
+
+std::string CheckpointStats::toString() const
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    ss << "checkpoint " << sequence << " at step " << step;
+    ss << ": snapshot " << snapshotMs << " ms";
+    ss << ", write " << writeMs << " ms";
+    ss << ", " << numWritten << "/" << numTensors << " tensors changed";
+    ss << ", " << bytesWritten / (1024.0 * 1024.0) << "/" << totalBytes / (1024.0 * 1024.0) << " MB written";
+    return ss.str();
+}
+
+
+Checkpointer::Checkpointer(): Checkpointer(Settings())
+{
+}
+
+
+Checkpointer::Checkpointer(const Settings& settings):
+    _settings(settings),
+    _writeSnapshot(new Snapshot()),
+    _pendingSnapshot(new Snapshot()),
+    _workSnapshot(new Snapshot()),
+    _lastSnapshot(std::chrono::steady_clock::now())
+{
+    _settings.numCheckpoints = std::max(std::size_t(1), _settings.numCheckpoints);
+    _directory = ofToDataPath(_settings.directory, true);
+
+    ofDirectory::createDirectory(_directory, false, true);
+
+    // Tensors written by an earlier run are reused.
+    ofDirectory directory(_directory);
+    directory.allowExt(TENSOR_EXTENSION);
+    directory.listDir();
+
+    for (std::size_t i = 0; i < directory.size(); ++i)
+        _written.insert(directory.getName(i));
+
+    // New checkpoints are numbered after those of an earlier run.
+    for (auto& checkpoint: getCheckpoints())
+        _sequence = std::max(_sequence, manifestSequence(ofFilePath::getFileName(checkpoint)));
+
+    _thread = std::thread(&Checkpointer::_run, this);
+}
+
+
+Checkpointer::~Checkpointer()
+{
+    flush();
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _running = false;
+    }
+
+    _condition.notify_all();
+
+    if (_thread.joinable())
+        _thread.join();
+}
+
+
+bool Checkpointer::isDue() const
+{
+    return std::chrono::steady_clock::now() - _lastSnapshot >= _settings.interval;
+}
+
+
+void Checkpointer::flush()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _idleCondition.wait(lock, [&]() {
+        return !_hasPendingSnapshot && !_writing;
+    });
+}
+
+
+CheckpointStats Checkpointer::getLastStats() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _lastStats;
+}
+
+
+uint64_t Checkpointer::getDroppedCount() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _droppedCount;
+}
+
+
+std::vector<std::string> Checkpointer::getCheckpoints() const
+{
+    ofDirectory directory(_directory);
+    directory.allowExt(MANIFEST_EXTENSION);
+    directory.listDir();
+    directory.sort();
+
+    std::vector<std::string> results;
+
+    // The zero padded sequence number makes name order write order.
+    for (std::size_t i = 0; i < directory.size(); ++i)
+    {
+        if (directory.getName(i).find(MANIFEST_PREFIX) == 0)
+            results.push_back(directory.getPath(i));
+    }
+
+    return results;
+}
+
+
+void Checkpointer::_submit()
+{
+    _lastSnapshot = std::chrono::steady_clock::now();
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        if (_hasPendingSnapshot)
+            ++_droppedCount;
+
+        std::swap(_writeSnapshot, _pendingSnapshot);
+        _hasPendingSnapshot = true;
+    }
+
+    _condition.notify_one();
+}
+
+
+bool Checkpointer::_readManifest(const std::string& path,
+                                 uint64_t& step,
+                                 double& learningRate,
+                                 std::vector<Entry>& entries) const
+{
+    std::ifstream stream(path);
+
+    std::string header;
+    std::string key;
+    std::size_t count = 0;
+
+    if (!std::getline(stream, header) || header != MANIFEST_HEADER)
+        return false;
+
+    if (!(stream >> key >> step) || key != "step")
+        return false;
+
+    if (!(stream >> key >> learningRate) || key != "learning_rate")
+        return false;
+
+    if (!(stream >> key >> count) || key != "tensors")
+        return false;
+
+    entries.resize(count);
+
+    for (auto& entry: entries)
+    {
+        if (!(stream >> entry.size >> std::hex >> entry.hash >> std::dec))
+            return false;
+    }
+
+    return true;
+}
+
+
+bool Checkpointer::_readTensor(const Entry& entry, float* data) const
+{
+    std::ifstream stream(_tensorPath(entry), std::ios::binary);
+    stream.read(reinterpret_cast<char*>(data), std::streamsize(entry.size * sizeof(float)));
+    return bool(stream);
+}
+
+
+void Checkpointer::_write(const Snapshot& snapshot)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    CheckpointStats stats;
+    stats.sequence = _sequence + 1;
+    stats.step = snapshot.step;
+    stats.snapshotMs = snapshot.snapshotMs;
+    stats.numTensors = snapshot.tensors.size();
+
+    std::ostringstream manifest;
+    manifest << MANIFEST_HEADER << std::endl;
+    manifest << "step " << snapshot.step << std::endl;
+    manifest << "learning_rate " << std::setprecision(17) << snapshot.learningRate << std::endl;
+    manifest << "tensors " << snapshot.tensors.size() << std::endl;
+
+    for (auto& tensor: snapshot.tensors)
+    {
+        Entry entry;
+        entry.size = tensor.size();
+        entry.hash = hashTensor(tensor);
+
+        const uint64_t bytes = entry.size * sizeof(float);
+        stats.totalBytes += bytes;
+
+        manifest << entry.size << " " << std::hex << std::setw(16) << std::setfill('0') << entry.hash << std::dec << std::setfill(' ') << std::endl;
+
+        const std::string path = _tensorPath(entry);
+        const std::string name = ofFilePath::getFileName(path);
+
+        if (_written.find(name) != _written.end())
+            continue;
+
+        // Write to a temporary file so a crash never leaves a partial tensor.
+        std::ofstream stream(path + ".tmp", std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char*>(tensor.data()), std::streamsize(bytes));
+        stream.close();
+
+        if (!stream || std::rename((path + ".tmp").c_str(), path.c_str()) != 0)
+        {
+            ofLogError("Checkpointer::_write") << "Unable to write " << path;
+            return;
+        }
+
+        _written.insert(name);
+        ++stats.numWritten;
+        stats.bytesWritten += bytes;
+    }
+
+    stats.path = ofFilePath::join(_directory, manifestName(stats.sequence));
+
+    {
+        std::ofstream stream(stats.path + ".tmp", std::ios::trunc);
+        stream << manifest.str();
+        stream.close();
+
+        if (!stream || std::rename((stats.path + ".tmp").c_str(), stats.path.c_str()) != 0)
+        {
+            ofLogError("Checkpointer::_write") << "Unable to write " << stats.path;
+            return;
+        }
+    }
+
+    _sequence = stats.sequence;
+
+    _rotate();
+
+    stats.writeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    if (_settings.verbose)
+        ofLogNotice("Checkpointer") << stats.toString();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _lastStats = stats;
+}
+
+
+void Checkpointer::_rotate()
+{
+    std::vector<std::string> checkpoints = getCheckpoints();
+
+    while (checkpoints.size() > _settings.numCheckpoints)
+    {
+        std::remove(checkpoints.front().c_str());
+        checkpoints.erase(checkpoints.begin());
+    }
+
+    std::set<std::string> used;
+
+    for (auto& checkpoint: checkpoints)
+    {
+        uint64_t step = 0;
+        double learningRate = 0;
+        std::vector<Entry> entries;
+
+        // Keep everything if a manifest can't be read.
+        if (!_readManifest(checkpoint, step, learningRate, entries))
+            return;
+
+        for (auto& entry: entries)
+            used.insert(ofFilePath::getFileName(_tensorPath(entry)));
+    }
+
+    for (auto iter = _written.begin(); iter != _written.end();)
+    {
+        if (used.find(*iter) == used.end())
+        {
+            std::remove(ofFilePath::join(_directory, *iter).c_str());
+            iter = _written.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+}
+
+
+std::string Checkpointer::_tensorPath(const Entry& entry) const
+{
+    std::ostringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << entry.hash;
+    ss << std::dec << "-" << entry.size << "." << TENSOR_EXTENSION;
+    return ofFilePath::join(_directory, ss.str());
+}
+
+
+void Checkpointer::_run()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _condition.wait(lock, [&]() {
+                return _hasPendingSnapshot || !_running;
+            });
+
+            if (!_hasPendingSnapshot && !_running)
+                return;
+
+            std::swap(_pendingSnapshot, _workSnapshot);
+            _hasPendingSnapshot = false;
+            _writing = true;
+        }
+
+        _write(*_workSnapshot);
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _writing = false;
+        }
+
+        _idleCondition.notify_all();
+    }
+}
+
+
+} } // namespace ofx::Dlib
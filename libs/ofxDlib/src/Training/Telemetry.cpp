@@ -0,0 +1,526 @@
+//
+// Copyright (c) 2018 Christopher Baker <https://christopherbaker.net>
+//
+// SPDX-License-Identifier:	MIT
+//
+
+
+#include "ofx/Dlib/Training/Telemetry.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include "ofFileUtils.h"
+#include "ofLog.h"
+#include "ofx/Dlib/Utils.h"
+
+
+namespace ofx {
+namespace Dlib {
+
+
+namespace {
+
+
+const double BYTES_PER_MB = 1024.0 * 1024.0;
+
+
+/// \brief Write a number, or a placeholder if it is NaN.
+void writeNumber(std::ostream& stream, double value, const std::string& missing)
+{
+    if (std::isnan(value))
+        stream << missing;
+    else
+        stream << value;
+}
+
+
+void writeCsvHeader(std::ostream& stream)
+{
+    stream << "step,time_s,samples,step_ms,samples_per_s";
+
+    for (std::size_t i = 0; i < TrainingTelemetry::NUM_PHASES; ++i)
+        stream << "," << TrainingTelemetry::toString(TrainingTelemetry::Phase(i)) << "_ms";
+
+    stream << ",other_ms,loss,learning_rate,resident_bytes,peak_resident_bytes,gradient_norm" << std::endl;
+}
+
+
+void writeCsvRow(std::ostream& stream, const TrainingTelemetry::Record& record)
+{
+    stream << record.step;
+    stream << "," << record.time;
+    stream << "," << record.numSamples;
+    stream << "," << record.stepMs;
+    stream << "," << record.samplesPerSecond;
+
+    for (auto ms: record.phaseMs)
+        stream << "," << ms;
+
+    stream << "," << record.otherMs();
+    stream << ",";
+    writeNumber(stream, record.loss, "");
+    stream << ",";
+    writeNumber(stream, record.learningRate, "");
+    stream << "," << record.residentBytes;
+    stream << "," << record.peakResidentBytes;
+    stream << ",";
+    writeNumber(stream, record.gradientNorm, "");
+    stream << std::endl;
+}
+
+
+void writeJsonRecord(std::ostream& stream, const TrainingTelemetry::Record& record)
+{
+    stream << "{\"step\": " << record.step;
+    stream << ", \"time_s\": " << record.time;
+    stream << ", \"samples\": " << record.numSamples;
+    stream << ", \"step_ms\": " << record.stepMs;
+    stream << ", \"samples_per_s\": " << record.samplesPerSecond;
+    stream << ", \"phase_ms\": {";
+
+    for (std::size_t i = 0; i < TrainingTelemetry::NUM_PHASES; ++i)
+    {
+        stream << (i > 0 ? ", " : "");
+        stream << "\"" << TrainingTelemetry::toString(TrainingTelemetry::Phase(i)) << "\": " << record.phaseMs[i];
+    }
+
+    stream << ", \"other\": " << record.otherMs() << "}";
+    stream << ", \"loss\": ";
+    writeNumber(stream, record.loss, "null");
+    stream << ", \"learning_rate\": ";
+    writeNumber(stream, record.learningRate, "null");
+    stream << ", \"resident_bytes\": " << record.residentBytes;
+    stream << ", \"peak_resident_bytes\": " << record.peakResidentBytes;
+    stream << ", \"gradient_norm\": ";
+    writeNumber(stream, record.gradientNorm, "null");
+
+    if (!record.layerGradientNorms.empty())
+    {
+        stream << ", \"layer_gradient_norms\": [";
+
+        for (std::size_t i = 0; i < record.layerGradientNorms.size(); ++i)
+            stream << (i > 0 ? ", " : "") << record.layerGradientNorms[i];
+
+        stream << "]";
+    }
+
+    stream << "}";
+}
+
+
+/// \brief Set a live value, widening the range so sliders can show it.
+void setLiveValue(ofParameter<float>& parameter, double value)
+{
+    if (std::isnan(value))
+        return;
+
+    if (value > parameter.getMax())
+        parameter.setMax(float(value * 1.5));
+
+    parameter = float(value);
+}
+
+
+} // namespace
+
+
+double TrainingTelemetry::Record::otherMs() const
+{
+    double sum = 0;
+
+    for (auto ms: phaseMs)
+        sum += ms;
+
+    return std::max(0.0, stepMs - sum);
+}
+
+
+std::string TrainingTelemetry::Record::toString() const
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    ss << "step " << step;
+    ss << ": " << samplesPerSecond << " samples/s";
+    ss << ", " << stepMs << " ms";
+
+    // Only list the phases that were timed.
+    for (std::size_t i = 0; i < NUM_PHASES; ++i)
+    {
+        if (phaseMs[i] > 0 && stepMs > 0)
+            ss << ", " << TrainingTelemetry::toString(Phase(i)) << " " << 100.0 * phaseMs[i] / stepMs << "%";
+    }
+
+    if (stepMs > 0)
+        ss << ", other " << 100.0 * otherMs() / stepMs << "%";
+
+    ss << ", peak " << peakResidentBytes / BYTES_PER_MB << " MB";
+
+    if (!std::isnan(loss))
+        ss << ", loss " << std::setprecision(5) << loss;
+
+    if (!std::isnan(gradientNorm))
+        ss << ", gradient norm " << std::setprecision(5) << gradientNorm;
+
+    return ss.str();
+}
+
+
+TrainingTelemetry::Timer::Timer(TrainingTelemetry* telemetry, Phase phase):
+    _telemetry(telemetry),
+    _phase(phase),
+    _start(std::chrono::high_resolution_clock::now())
+{
+}
+
+
+TrainingTelemetry::Timer::Timer(Timer&& other):
+    _telemetry(other._telemetry),
+    _phase(other._phase),
+    _start(other._start)
+{
+    other._telemetry = nullptr;
+}
+
+
+TrainingTelemetry::Timer::~Timer()
+{
+    if (_telemetry)
+        _telemetry->addPhaseTime(_phase, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - _start).count());
+}
+
+
+TrainingTelemetry::TrainingTelemetry(): TrainingTelemetry(Settings())
+{
+}
+
+
+TrainingTelemetry::TrainingTelemetry(const Settings& settings):
+    _settings(settings),
+    _start(std::chrono::steady_clock::now()),
+    _lastStep(_start)
+{
+    _settings.maxRecords = std::max(std::size_t(1), _settings.maxRecords);
+    _settings.window = std::max(std::size_t(1), _settings.window);
+
+    if (!_settings.csvPath.empty())
+    {
+        _csv.open(ofToDataPath(_settings.csvPath, true), std::ios::trunc);
+
+        if (_csv)
+        {
+            _csv << std::setprecision(10);
+            writeCsvHeader(_csv);
+        }
+        else
+        {
+            ofLogError("TrainingTelemetry::TrainingTelemetry") << "Unable to open " << _settings.csvPath;
+        }
+    }
+
+    _parameters.setName("Training");
+    _parameters.add(_step.set("Step", 0, 0, std::numeric_limits<int>::max()));
+    _parameters.add(_samplesPerSecond.set("Samples/s", 0, 0, 1));
+    _parameters.add(_stepMs.set("Step ms", 0, 0, 1));
+
+    for (std::size_t i = 0; i < NUM_PHASES; ++i)
+        _parameters.add(_phasePercent[i].set(toString(Phase(i)) + " %", 0, 0, 100));
+
+    _parameters.add(_otherPercent.set("other %", 0, 0, 100));
+    _parameters.add(_loss.set("Loss", 0, 0, 1));
+    _parameters.add(_learningRate.set("Learning rate", 0, 0, 1));
+    _parameters.add(_residentMB.set("Resident MB", 0, 0, 1));
+    _parameters.add(_peakResidentMB.set("Peak resident MB", 0, 0, 1));
+    _parameters.add(_gradientNorm.set("Gradient norm", 0, 0, 1));
+}
+
+
+TrainingTelemetry::~TrainingTelemetry()
+{
+    if (_csv.is_open())
+        _csv.close();
+}
+
+
+void TrainingTelemetry::addPhaseTime(Phase phase, double ms)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _current.phaseMs[phase] += ms;
+}
+
+
+void TrainingTelemetry::setGradientNorms(const std::vector<double>& layerNorms)
+{
+    double sum = 0;
+
+    for (auto norm: layerNorms)
+        sum += norm * norm;
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _current.layerGradientNorms = layerNorms;
+    _current.gradientNorm = std::sqrt(sum);
+}
+
+
+void TrainingTelemetry::endStep(std::size_t numSamples,
+                                double loss,
+                                double learningRate)
+{
+    const uint64_t residentBytes = residentMemoryBytes();
+    const uint64_t peakResidentBytes = peakResidentMemoryBytes();
+
+    auto now = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    Record record;
+    std::swap(record, _current);
+
+    record.step = ++_steps;
+    record.time = std::chrono::duration<double>(now - _start).count();
+    record.numSamples = numSamples;
+    record.stepMs = std::chrono::duration<double, std::milli>(now - _lastStep).count();
+    record.samplesPerSecond = record.stepMs > 0 ? 1000.0 * double(numSamples) / record.stepMs : 0;
+    record.loss = loss;
+    record.learningRate = learningRate;
+    record.residentBytes = residentBytes;
+    record.peakResidentBytes = std::max(peakResidentBytes, residentBytes);
+
+    _lastStep = now;
+
+    if (_csv.is_open())
+    {
+        writeCsvRow(_csv, record);
+
+        // Flush now and then so a crashed run keeps most of its log.
+        if (record.step % 100 == 0)
+            _csv.flush();
+    }
+
+    _records.push_back(std::move(record));
+
+    while (_records.size() > _settings.maxRecords)
+        _records.pop_front();
+}
+
+
+void TrainingTelemetry::reset()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _records.clear();
+    _current = Record();
+    _steps = 0;
+    _start = std::chrono::steady_clock::now();
+    _lastStep = _start;
+}
+
+
+uint64_t TrainingTelemetry::getStepCount() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _steps;
+}
+
+
+TrainingTelemetry::Record TrainingTelemetry::getLast() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _records.empty() ? Record() : _records.back();
+}
+
+
+TrainingTelemetry::Record TrainingTelemetry::getAverage(std::size_t count) const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return _average(count);
+}
+
+
+std::vector<TrainingTelemetry::Record> TrainingTelemetry::getRecords() const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    return std::vector<Record>(_records.begin(), _records.end());
+}
+
+
+std::string TrainingTelemetry::toCsv() const
+{
+    std::ostringstream ss;
+    ss << std::setprecision(10);
+    writeCsvHeader(ss);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    for (auto& record: _records)
+        writeCsvRow(ss, record);
+
+    return ss.str();
+}
+
+
+std::string TrainingTelemetry::toJson() const
+{
+    std::ostringstream ss;
+    ss << std::setprecision(10);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    ss << "{" << std::endl;
+    ss << "  \"average\": ";
+    writeJsonRecord(ss, _average(_records.size()));
+    ss << "," << std::endl;
+    ss << "  \"records\": [" << std::endl;
+
+    for (std::size_t i = 0; i < _records.size(); ++i)
+    {
+        ss << "    ";
+        writeJsonRecord(ss, _records[i]);
+        ss << (i + 1 < _records.size() ? "," : "") << std::endl;
+    }
+
+    ss << "  ]" << std::endl;
+    ss << "}" << std::endl;
+
+    return ss.str();
+}
+
+
+bool TrainingTelemetry::saveCsv(const std::string& path) const
+{
+    std::ofstream stream(ofToDataPath(path, true), std::ios::trunc);
+    stream << toCsv();
+
+    if (!stream)
+    {
+        ofLogError("TrainingTelemetry::saveCsv") << "Unable to write " << path;
+        return false;
+    }
+
+    return true;
+}
+
+
+bool TrainingTelemetry::saveJson(const std::string& path) const
+{
+    std::ofstream stream(ofToDataPath(path, true), std::ios::trunc);
+    stream << toJson();
+
+    if (!stream)
+    {
+        ofLogError("TrainingTelemetry::saveJson") << "Unable to write " << path;
+        return false;
+    }
+
+    return true;
+}
+
+
+void TrainingTelemetry::update()
+{
+    Record average = getAverage(_settings.window);
+
+    if (average.step == 0)
+        return;
+
+    _step = int(std::min(average.step, uint64_t(std::numeric_limits<int>::max())));
+
+    setLiveValue(_samplesPerSecond, average.samplesPerSecond);
+    setLiveValue(_stepMs, average.stepMs);
+
+    for (std::size_t i = 0; i < NUM_PHASES; ++i)
+        _phasePercent[i] = float(average.stepMs > 0 ? 100.0 * average.phaseMs[i] / average.stepMs : 0);
+
+    _otherPercent = float(average.stepMs > 0 ? 100.0 * average.otherMs() / average.stepMs : 0);
+
+    setLiveValue(_loss, average.loss);
+    setLiveValue(_learningRate, average.learningRate);
+    setLiveValue(_residentMB, average.residentBytes / BYTES_PER_MB);
+    setLiveValue(_peakResidentMB, average.peakResidentBytes / BYTES_PER_MB);
+    setLiveValue(_gradientNorm, average.gradientNorm);
+}
+
+
+std::string TrainingTelemetry::toString(Phase phase)
+{
+    switch (phase)
+    {
+        case PHASE_DATA:
+            return "data";
+        case PHASE_FORWARD:
+            return "forward";
+        case PHASE_BACKWARD:
+            return "backward";
+        case PHASE_SYNC:
+            return "sync";
+        case PHASE_UPDATE:
+            return "update";
+        case PHASE_COMPUTE:
+            return "compute";
+        case NUM_PHASES:
+            break;
+    }
+
+    return "unknown";
+}
+
+
+TrainingTelemetry::Record TrainingTelemetry::_average(std::size_t count) const
+{
+    Record average;
+
+    count = std::min(count, _records.size());
+
+    if (count == 0)
+        return average;
+
+    std::size_t numLosses = 0;
+    std::size_t numNorms = 0;
+    double loss = 0;
+    double gradientNorm = 0;
+
+    for (auto iter = _records.end() - std::ptrdiff_t(count); iter != _records.end(); ++iter)
+    {
+        average.numSamples += iter->numSamples;
+        average.stepMs += iter->stepMs;
+
+        for (std::size_t i = 0; i < NUM_PHASES; ++i)
+            average.phaseMs[i] += iter->phaseMs[i];
+
+        if (!std::isnan(iter->loss))
+        {
+            loss += iter->loss;
+            ++numLosses;
+        }
+
+        if (!std::isnan(iter->gradientNorm))
+        {
+            gradientNorm += iter->gradientNorm;
+            ++numNorms;
+        }
+    }
+
+    const Record& last = _records.back();
+
+    // Throughput is total samples over total time, not a mean of rates.
+    average.samplesPerSecond = average.stepMs > 0 ? 1000.0 * double(average.numSamples) / average.stepMs : 0;
+    average.stepMs /= double(count);
+
+    for (auto& ms: average.phaseMs)
+        ms /= double(count);
+
+    average.step = last.step;
+    average.time = last.time;
+    average.learningRate = last.learningRate;
+    average.residentBytes = last.residentBytes;
+    average.peakResidentBytes = last.peakResidentBytes;
+
+    if (numLosses > 0)
+        average.loss = loss / double(numLosses);
+
+    if (numNorms > 0)
+        average.gradientNorm = gradientNorm / double(numNorms);
+
+    return average;
+}
+
+
+} } // namespace ofx::Dlib
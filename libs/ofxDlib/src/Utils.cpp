@@ -6,10 +6,72 @@
 
 
 #include "ofx/Dlib/Utils.h"
+#if defined(TARGET_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(TARGET_OSX)
+#include <mach/mach.h>
+#include <sys/resource.h>
+#else
+#include <fstream>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
 
 
 namespace ofx {
 namespace Dlib {
 
 
+uint64_t residentMemoryBytes()
+{
+#if defined(TARGET_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.WorkingSetSize;
+    return 0;
+#elif defined(TARGET_OSX)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(),
+                  MACH_TASK_BASIC_INFO,
+                  reinterpret_cast<task_info_t>(&info),
+                  &count) == KERN_SUCCESS)
+    {
+        return info.resident_size;
+    }
+    return 0;
+#else
+    // The second field of statm is the resident set size in pages.
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    if (statm >> size >> resident)
+        return resident * uint64_t(sysconf(_SC_PAGESIZE));
+    return 0;
+#endif
+}
+
+
+uint64_t peakResidentMemoryBytes()
+{
+#if defined(TARGET_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#else
+    // ru_maxrss is in bytes on macOS and in kilobytes on Linux.
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(TARGET_OSX)
+    return uint64_t(usage.ru_maxrss);
+#else
+    return uint64_t(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+
 } } // namespace ofx::Dlib
@@ -8,12 +8,42 @@
 #pragma once
 
 
+#include "dlib/con_fused.h"
 #include "dlib/of_default_adapter.h"
 #include "dlib/of_image.h"
+#include "dlib/of_matrix.h"
 #include "dlib/to_of.h"
 //#include "ofx/Dlib/Types.h"
+#include "ofx/Dlib/ModelLoader.h"
+#include "ofx/Dlib/PointSet.h"
 #include "ofx/Dlib/Utils.h"
+#include "ofx/Dlib/Data/PackedDataset.h"
+#include "ofx/Dlib/Data/StrokeRasterizer.h"
+#include "ofx/Dlib/Data/StreamingImageDataset.h"
+#include "ofx/Dlib/Evaluation/ClassifierEvaluator.h"
+#include "ofx/Dlib/Evaluation/DetectionEvaluator.h"
+#include "ofx/Dlib/Math/BatchedJacobi.h"
+#include "ofx/Dlib/Math/BlockedMultiply.h"
+#include "ofx/Dlib/Math/LinearAlgebraBenchmark.h"
+#include "ofx/Dlib/Math/RandomizedSVD.h"
+#include "ofx/Dlib/Math/RowReader.h"
+#include "ofx/Dlib/Network/ActivationMosaic.h"
+#include "ofx/Dlib/Network/ActivationStore.h"
+#include "ofx/Dlib/Network/ActivationTap.h"
+#include "ofx/Dlib/Network/Fusion.h"
+#include "ofx/Dlib/Network/InferenceChannel.h"
+#include "ofx/Dlib/Network/LayerParameters.h"
 #include "ofx/Dlib/Network/LeNet.h"
+#include "ofx/Dlib/Network/LeNetKernel.h"
+#include "ofx/Dlib/Network/NetworkView.h"
+#include "ofx/Dlib/Network/Profiler.h"
+#include "ofx/Dlib/Network/Quantization.h"
+#include "ofx/Dlib/Network/TensorPixels.h"
+#include "ofx/Dlib/Network/WeightAtlas.h"
+#include "ofx/Dlib/Training/BatchPipeline.h"
+#include "ofx/Dlib/Training/Checkpointer.h"
+#include "ofx/Dlib/Training/ParallelTrainer.h"
+#include "ofx/Dlib/Training/Telemetry.h"
 
 
 #include <iostream>